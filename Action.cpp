@@ -0,0 +1,250 @@
+// email: shiraba01@gmail.com
+#include "Action.hpp"
+#include "Game.hpp"
+#include "Player.hpp"
+#include "Governor.hpp"
+#include "Spy.hpp"
+#include "Baron.hpp"
+#include "General.hpp"
+#include "Judge.hpp"
+
+#include <stdexcept>
+
+namespace coup {
+
+namespace {
+
+// Names as recorded by Player::setLastAction(), indexed by ActionKind
+const char* const ACTION_NAMES[NUM_ACTION_KINDS] = {
+    "gather", "tax", "bribe", "arrest", "sanction", "coup",
+    "invest", "blockTax", "blockBribe", "blockArrest", "blockCoup", "pass"
+};
+
+/**
+ * @brief Casts the acting player to the role class required by a role ability.
+ *
+ * @throws std::invalid_argument if the player does not have that role.
+ */
+template <typename RoleClass>
+RoleClass& asRole(Player& player, const char* message) {
+    RoleClass* role = dynamic_cast<RoleClass*>(&player);
+    if (!role) {
+        throw std::invalid_argument(message);
+    }
+    return *role;
+}
+
+/**
+ * @brief Appends an action to the output array unless it is full.
+ */
+inline void push(Action* out, size_t& count, ActionKind kind, size_t actor, size_t target = NO_TARGET) {
+    if (count < MAX_LEGAL_ACTIONS) {
+        out[count++] = Action{kind, static_cast<uint8_t>(actor), static_cast<uint8_t>(target)};
+    }
+}
+
+} // namespace
+
+/**
+ * @brief Returns the action name as recorded by Player::getLastAction().
+ *
+ * @param kind The action kind.
+ * @return const char* The action name.
+ */
+const char* actionName(ActionKind kind) {
+    size_t index = static_cast<size_t>(kind);
+    return index < NUM_ACTION_KINDS ? ACTION_NAMES[index] : "unknown";
+}
+
+/**
+ * @brief Parses an action name as recorded by Player::getLastAction().
+ *
+ * @param name The action name.
+ * @return ActionKind The matching action kind.
+ * @throws std::invalid_argument if the name is not a known action.
+ */
+ActionKind parseActionName(const std::string& name) {
+    for (size_t i = 0; i < NUM_ACTION_KINDS; ++i) {
+        if (name == ACTION_NAMES[i]) {
+            return static_cast<ActionKind>(i);
+        }
+    }
+    throw std::invalid_argument("Unknown action: " + name);
+}
+
+/**
+ * @brief Returns true if the action kind takes a target player.
+ *
+ * @param kind The action kind.
+ * @return true for arrest, sanction, coup and the blocking abilities.
+ */
+bool actionHasTarget(ActionKind kind) {
+    switch (kind) {
+        case ActionKind::Arrest:
+        case ActionKind::Sanction:
+        case ActionKind::Coup:
+        case ActionKind::BlockTax:
+        case ActionKind::BlockBribe:
+        case ActionKind::BlockArrest:
+        case ActionKind::BlockCoup:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Applies an action to the game through the normal Player APIs.
+ *
+ * @param game The game to play on.
+ * @param action The action to apply.
+ * @throws std::invalid_argument if a seat is out of range or the actor does not have the role.
+ * @throws std::runtime_error if the action breaks a game rule.
+ */
+void applyAction(Game& game, const Action& action) {
+    if (action.actor >= game.numPlayers()) {
+        throw std::invalid_argument("Invalid actor seat.");
+    }
+    if (actionHasTarget(action.kind) && action.target >= game.numPlayers()) {
+        throw std::invalid_argument("Invalid target seat.");
+    }
+
+    Player& actor = game.playerAt(action.actor);
+
+    switch (action.kind) {
+        case ActionKind::Gather:
+            actor.gather();
+            break;
+        case ActionKind::Tax:
+            actor.tax();
+            break;
+        case ActionKind::Bribe:
+            actor.bribe();
+            break;
+        case ActionKind::Arrest:
+            actor.arrest(game.playerAt(action.target));
+            break;
+        case ActionKind::Sanction:
+            actor.sanction(game.playerAt(action.target));
+            break;
+        case ActionKind::Coup:
+            actor.coup(game.playerAt(action.target));
+            break;
+        case ActionKind::Invest:
+            asRole<Baron>(actor, "Only a Baron can invest.").invest();
+            break;
+        case ActionKind::BlockTax:
+            asRole<Governor>(actor, "Only a Governor can block tax.").blockTax(game.playerAt(action.target));
+            break;
+        case ActionKind::BlockBribe:
+            asRole<Judge>(actor, "Only a Judge can block bribe.").blockBribe(game.playerAt(action.target));
+            break;
+        case ActionKind::BlockArrest:
+            asRole<Spy>(actor, "Only a Spy can block arrest.").blockArrestNextTurn(game.playerAt(action.target));
+            break;
+        case ActionKind::BlockCoup:
+            asRole<General>(actor, "Only a General can block coup.").blockCoup(game.playerAt(action.target));
+            break;
+        case ActionKind::Pass:
+            if (game.currentSeat() != action.actor) {
+                throw std::runtime_error("It's not " + actor.getName() + "'s turn.");
+            }
+            game.advanceTurn();
+            break;
+        default:
+            throw std::invalid_argument("Unknown action kind.");
+    }
+}
+
+/**
+ * @brief Generates the legal actions in the current position.
+ *
+ * The conditions mirror the checks made by the Player and role methods, so
+ * that applying any generated action never throws.
+ *
+ * @param game The game.
+ * @param out Array with room for MAX_LEGAL_ACTIONS actions.
+ * @return size_t Number of actions written to out.
+ */
+size_t legalActions(const Game& game, Action* out) {
+    const size_t n = game.numPlayers();
+    size_t alive = 0;
+    for (size_t s = 0; s < n; ++s) {
+        if (game.hasFlag(s, FLAG_ALIVE)) alive++;
+    }
+    if (alive < 2) {
+        return 0;
+    }
+
+    size_t count = 0;
+    const size_t cur = game.currentSeat();
+    const int coins = game.coinsAt(cur);
+    const int bank = game.getBankCoins();
+    const std::string role = game.playerAt(cur).getRole();
+
+    if (coins >= 10) {
+        // The 10-coin rule: the only move left is a coup
+        for (size_t t = 0; t < n; ++t) {
+            if (t != cur && game.hasFlag(t, FLAG_ALIVE)) push(out, count, ActionKind::Coup, cur, t);
+        }
+    } else {
+        const bool sanctioned = game.hasFlag(cur, FLAG_SANCTIONED);
+        if (!sanctioned && bank >= 1) push(out, count, ActionKind::Gather, cur);
+        if (!sanctioned && bank >= (role == "Governor" ? 3 : 2)) push(out, count, ActionKind::Tax, cur);
+        if (coins >= 4) push(out, count, ActionKind::Bribe, cur);
+        if (role == "Baron" && coins >= 3 && bank + 3 >= 6) push(out, count, ActionKind::Invest, cur);
+
+        for (size_t t = 0; t < n; ++t) {
+            if (t == cur || !game.hasFlag(t, FLAG_ALIVE)) continue;
+            const int targetCoins = game.coinsAt(t);
+            const std::string targetRole = game.playerAt(t).getRole();
+
+            if (game.hasFlag(cur, FLAG_ARREST_ENABLED) && game.lastArrestedAt(cur) != static_cast<int>(t) &&
+                targetCoins >= (targetRole == "Merchant" ? 2 : 1) && (targetRole != "General" || bank >= 1)) {
+                push(out, count, ActionKind::Arrest, cur, t);
+            }
+            if (coins >= (targetRole == "Judge" ? 4 : 3)) push(out, count, ActionKind::Sanction, cur, t);
+            if (coins >= 7) push(out, count, ActionKind::Coup, cur, t);
+            if (role == "Spy") push(out, count, ActionKind::BlockArrest, cur, t);
+        }
+
+        const int pending = game.pendingCoupSeat();
+        if (role == "General" && coins >= 5 && pending != NO_SEAT) {
+            push(out, count, ActionKind::BlockCoup, cur, static_cast<size_t>(pending));
+        }
+    }
+
+    // Pass is offered when every move above keeps the turn (or there is none),
+    // so that a player can never be stuck in a chain of extra turns
+    bool advances = false;
+    for (size_t i = 0; i < count; ++i) {
+        ActionKind kind = out[i].kind;
+        if (kind != ActionKind::Bribe && kind != ActionKind::BlockArrest && kind != ActionKind::BlockCoup) {
+            advances = true;
+            break;
+        }
+    }
+    if (!advances) {
+        push(out, count, ActionKind::Pass, cur);
+    }
+
+    // Reactions any alive player may use right now
+    for (size_t a = 0; a < n; ++a) {
+        if (!game.hasFlag(a, FLAG_ALIVE)) continue;
+        const std::string actorRole = game.playerAt(a).getRole();
+        const bool governor = actorRole == "Governor";
+        const bool judge = actorRole == "Judge";
+        if (!governor && !judge) continue;
+
+        for (size_t t = 0; t < n; ++t) {
+            if (t == a || !game.hasFlag(t, FLAG_ALIVE)) continue;
+            const std::string& last = game.playerAt(t).getLastAction();
+            if (governor && last == "tax" && game.coinsAt(t) >= 2) push(out, count, ActionKind::BlockTax, a, t);
+            if (judge && last == "bribe") push(out, count, ActionKind::BlockBribe, a, t);
+        }
+    }
+
+    return count;
+}
+
+} // namespace coup
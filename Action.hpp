@@ -0,0 +1,100 @@
+// email: shiraba01@gmail.com
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace coup {
+
+class Game;
+
+/**
+ * @brief Every move a player can make, as a compact code.
+ *
+ * The codes fit in 4 bits (used by the binary replay format). Pass is the
+ * GUI's "next turn" (Game::advanceTurn() without an action).
+ */
+enum class ActionKind : uint8_t {
+    Gather = 0,
+    Tax = 1,
+    Bribe = 2,
+    Arrest = 3,
+    Sanction = 4,
+    Coup = 5,
+    Invest = 6,       // Baron
+    BlockTax = 7,     // Governor
+    BlockBribe = 8,   // Judge
+    BlockArrest = 9,  // Spy
+    BlockCoup = 10,   // General
+    Pass = 11
+};
+
+// Number of action kinds
+constexpr size_t NUM_ACTION_KINDS = 12;
+
+// Target value of actions without a target (fits in 3 bits)
+constexpr uint8_t NO_TARGET = 7;
+
+// Upper bound on the number of legal actions in any position
+constexpr size_t MAX_LEGAL_ACTIONS = 64;
+
+/**
+ * @brief One move: who does what to whom (seats are Game seat indices).
+ */
+struct Action {
+    ActionKind kind = ActionKind::Pass;
+    uint8_t actor = 0;
+    uint8_t target = NO_TARGET;
+
+    bool operator==(const Action& other) const {
+        return kind == other.kind && actor == other.actor && target == other.target;
+    }
+    bool operator!=(const Action& other) const { return !(*this == other); }
+};
+
+/**
+ * @brief Returns the action name as recorded by Player::getLastAction() (e.g., "blockTax").
+ */
+const char* actionName(ActionKind kind);
+
+/**
+ * @brief Parses an action name as recorded by Player::getLastAction().
+ *
+ * @throws std::invalid_argument if the name is not a known action.
+ */
+ActionKind parseActionName(const std::string& name);
+
+/**
+ * @brief Returns true if the action kind takes a target player.
+ */
+bool actionHasTarget(ActionKind kind);
+
+/**
+ * @brief Applies an action to the game through the normal Player APIs.
+ *
+ * Role abilities are dispatched to the matching role class. The game rules
+ * are enforced by the Player methods themselves.
+ *
+ * @param game The game to play on.
+ * @param action The action to apply.
+ * @throws std::invalid_argument if a seat is out of range or the actor does not have the role.
+ * @throws std::runtime_error if the action breaks a game rule.
+ */
+void applyAction(Game& game, const Action& action);
+
+/**
+ * @brief Generates the legal actions in the current position.
+ *
+ * Lists the moves of the player whose turn it is (only coups when they hold 10
+ * or more coins, Pass only when no other move ends the turn), followed by the
+ * reactions other alive players may use now: Governor::blockTax and
+ * Judge::blockBribe. The order is deterministic. Every listed action can be
+ * applied with applyAction() without breaking a rule.
+ *
+ * @param game The game.
+ * @param out Array with room for MAX_LEGAL_ACTIONS actions.
+ * @return size_t Number of actions written to out (0 once the game is over).
+ */
+size_t legalActions(const Game& game, Action* out);
+
+} // namespace coup
@@ -0,0 +1,223 @@
+// email: shiraba01@gmail.com
+#include "Archive.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// The index and footer are read in place from the mapping
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "The archive format is little-endian"
+#endif
+
+namespace coup {
+
+namespace {
+
+const char ARCHIVE_MAGIC[8] = {'C', 'O', 'U', 'P', 'A', 'R', 'C', 'H'};
+constexpr uint8_t NO_WINNER = 0xFF;
+
+} // namespace
+
+/**
+ * @brief Returns the recorded final state as a GameOutcome.
+ *
+ * @return GameOutcome Plies, winner, bank, alive seats and coins.
+ */
+GameOutcome ArchiveEntry::outcome() const {
+    GameOutcome out;
+    out.plies = plies;
+    out.numPlayers = numPlayers;
+    out.winner = winner == NO_WINNER ? NO_SEAT : winner;
+    out.bank = bank;
+    out.aliveMask = aliveMask;
+    for (size_t s = 0; s < numPlayers && s < MAX_PLAYERS; ++s) {
+        out.coins[s] = coins[s];
+    }
+    return out;
+}
+
+/**
+ * @brief Creates (or truncates) the archive file.
+ *
+ * @param path Path of the archive.
+ * @throws std::runtime_error if the file cannot be opened.
+ */
+ArchiveWriter::ArchiveWriter(const std::string& path) {
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        throw std::runtime_error("Cannot create archive: " + path);
+    }
+    std::setvbuf(file, nullptr, _IOFBF, 1 << 20);
+}
+
+/**
+ * @brief Finishes the archive if finish() was not called (errors are ignored).
+ */
+ArchiveWriter::~ArchiveWriter() {
+    if (file) {
+        try {
+            finish();
+        } catch (const std::exception&) {
+            // Destructors must not throw; call finish() explicitly to see errors
+        }
+    }
+}
+
+/**
+ * @brief Appends one replay and its index entry.
+ *
+ * @param replay Pointer to the encoded replay.
+ * @param size Replay length in bytes.
+ * @param outcome Final state of the game.
+ * @return uint64_t The id of the game in the archive.
+ * @throws std::runtime_error on a write error or a malformed replay.
+ */
+uint64_t ArchiveWriter::add(const uint8_t* replay, size_t size, const GameOutcome& outcome) {
+    if (!file) {
+        throw std::runtime_error("Archive is already finished.");
+    }
+    ReplayReader reader(replay, size);
+    if (reader.numPlayers() != outcome.numPlayers) {
+        throw std::runtime_error("Outcome does not match the replay.");
+    }
+
+    ArchiveEntry entry;
+    std::memset(&entry, 0, sizeof(entry));
+    entry.offset = offset;
+    entry.length = static_cast<uint32_t>(size);
+    entry.plies = static_cast<uint32_t>(outcome.plies);
+    entry.numPlayers = static_cast<uint8_t>(outcome.numPlayers);
+    entry.winner = outcome.winner == NO_SEAT ? NO_WINNER : static_cast<uint8_t>(outcome.winner);
+    entry.bank = static_cast<uint8_t>(outcome.bank);
+    entry.aliveMask = outcome.aliveMask;
+    for (size_t s = 0; s < outcome.numPlayers; ++s) {
+        entry.roles[s] = static_cast<uint8_t>(reader.role(s));
+        entry.coins[s] = static_cast<uint8_t>(outcome.coins[s]);
+    }
+
+    if (std::fwrite(replay, 1, size, file) != size) {
+        throw std::runtime_error("Failed to write to archive.");
+    }
+    offset += size;
+    index.push_back(entry);
+    return index.size() - 1;
+}
+
+/**
+ * @brief Writes the index and footer and closes the file.
+ *
+ * @throws std::runtime_error on a write error.
+ */
+void ArchiveWriter::finish() {
+    if (!file) {
+        return;
+    }
+    std::FILE* f = file;
+    file = nullptr;
+
+    // Align the index so that entries can be read in place
+    static const uint8_t zeros[8] = {};
+    size_t padding = (8 - offset % 8) % 8;
+    bool ok = std::fwrite(zeros, 1, padding, f) == padding;
+
+    ArchiveFooter footer;
+    std::memcpy(footer.magic, ARCHIVE_MAGIC, sizeof(footer.magic));
+    footer.gameCount = index.size();
+    footer.indexOffset = offset + padding;
+    footer.entrySize = sizeof(ArchiveEntry);
+    footer.version = ARCHIVE_VERSION;
+
+    ok = ok && std::fwrite(index.data(), sizeof(ArchiveEntry), index.size(), f) == index.size();
+    ok = ok && std::fwrite(&footer, sizeof(footer), 1, f) == 1;
+    ok = (std::fclose(f) == 0) && ok;
+    if (!ok) {
+        throw std::runtime_error("Failed to write archive index.");
+    }
+}
+
+/**
+ * @brief Maps the archive and validates its footer.
+ *
+ * @param path Path of the archive.
+ * @throws std::runtime_error if the file cannot be mapped or is not a valid archive.
+ */
+ArchiveReader::ArchiveReader(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open archive: " + path);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(ArchiveFooter))) {
+        ::close(fd);
+        throw std::runtime_error("Not an archive: " + path);
+    }
+    mappedSize = static_cast<size_t>(st.st_size);
+    void* map = ::mmap(nullptr, mappedSize, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        throw std::runtime_error("Cannot map archive: " + path);
+    }
+    base = static_cast<const uint8_t*>(map);
+
+    const ArchiveFooter* footer = reinterpret_cast<const ArchiveFooter*>(base + mappedSize - sizeof(ArchiveFooter));
+    bool valid = std::memcmp(footer->magic, ARCHIVE_MAGIC, sizeof(footer->magic)) == 0 &&
+                 footer->version == ARCHIVE_VERSION && footer->entrySize == sizeof(ArchiveEntry) &&
+                 footer->indexOffset % 8 == 0 &&
+                 footer->indexOffset <= mappedSize - sizeof(ArchiveFooter) &&
+                 footer->gameCount == (mappedSize - sizeof(ArchiveFooter) - footer->indexOffset) / sizeof(ArchiveEntry);
+    if (!valid) {
+        ::munmap(const_cast<uint8_t*>(base), mappedSize);
+        throw std::runtime_error("Corrupted or unsupported archive: " + path);
+    }
+    entries = reinterpret_cast<const ArchiveEntry*>(base + footer->indexOffset);
+    count = footer->gameCount;
+    dataSize = footer->indexOffset;
+}
+
+/**
+ * @brief Unmaps the archive.
+ */
+ArchiveReader::~ArchiveReader() {
+    if (base) {
+        ::munmap(const_cast<uint8_t*>(base), mappedSize);
+    }
+}
+
+/**
+ * @brief Returns an allocation-free reader over the replay of a game.
+ *
+ * @param id Game id.
+ * @return ReplayReader Reader over the mapped replay bytes.
+ * @throws std::out_of_range if id is not a game of the archive.
+ * @throws std::runtime_error if its index entry points outside the data.
+ */
+ReplayReader ArchiveReader::replay(size_t id) const {
+    if (id >= count) {
+        throw std::out_of_range("No such game in the archive.");
+    }
+    if (entries[id].offset > dataSize || entries[id].length > dataSize - entries[id].offset) {
+        throw std::runtime_error("Archive index points outside the data.");
+    }
+    return ReplayReader(base + entries[id].offset, entries[id].length);
+}
+
+/**
+ * @brief Hints the kernel that the archive is about to be scanned from start to end.
+ */
+void ArchiveReader::adviseSequential() const {
+    ::madvise(const_cast<uint8_t*>(base), mappedSize, MADV_SEQUENTIAL);
+}
+
+/**
+ * @brief Hints the kernel that games are going to be looked up at random.
+ */
+void ArchiveReader::adviseRandom() const {
+    ::madvise(const_cast<uint8_t*>(base), mappedSize, MADV_RANDOM);
+}
+
+} // namespace coup
@@ -0,0 +1,150 @@
+// email: shiraba01@gmail.com
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "Game.hpp"
+#include "Replay.hpp"
+
+namespace coup {
+
+/**
+ * Single-file replay archive:
+ *
+ *   [replay 0][replay 1] ... [padding to 8 bytes][index: N x ArchiveEntry][footer]
+ *
+ * The index and footer are fixed-layout little-endian records that are read
+ * in place from a read-only memory mapping, so looking up or decoding game #N
+ * never copies or allocates, and archives larger than RAM are paged in on demand.
+ */
+constexpr uint32_t ARCHIVE_VERSION = 1;
+
+/**
+ * @brief Index record of one archived game (32 bytes).
+ */
+struct ArchiveEntry {
+    uint64_t offset;                  // Offset of the replay in the file
+    uint32_t length;                  // Replay length in bytes
+    uint32_t plies;                   // Number of actions
+    uint8_t numPlayers;
+    uint8_t winner;                   // Winner seat, or 0xFF if undecided
+    uint8_t roles[MAX_PLAYERS];       // Role code of every seat
+    uint8_t bank;                     // Final bank
+    uint8_t aliveMask;                // Final alive seats (bit per seat)
+    uint8_t coins[MAX_PLAYERS];       // Final coins of every seat
+
+    /**
+     * @brief Returns the recorded final state as a GameOutcome.
+     */
+    GameOutcome outcome() const;
+};
+static_assert(sizeof(ArchiveEntry) == 32, "ArchiveEntry must keep its on-disk layout");
+
+/**
+ * @brief Trailer at the very end of an archive (32 bytes).
+ */
+struct ArchiveFooter {
+    char magic[8];                    // "COUPARCH"
+    uint64_t gameCount;
+    uint64_t indexOffset;
+    uint32_t entrySize;               // sizeof(ArchiveEntry)
+    uint32_t version;                 // ARCHIVE_VERSION
+};
+static_assert(sizeof(ArchiveFooter) == 32, "ArchiveFooter must keep its on-disk layout");
+
+/**
+ * @brief Appends replays to a new archive file and writes the index on finish().
+ */
+class ArchiveWriter {
+public:
+    /**
+     * @brief Creates (or truncates) the archive file.
+     *
+     * @throws std::runtime_error if the file cannot be opened.
+     */
+    explicit ArchiveWriter(const std::string& path);
+
+    /**
+     * @brief Finishes the archive if finish() was not called.
+     */
+    ~ArchiveWriter();
+
+    ArchiveWriter(const ArchiveWriter&) = delete;
+    ArchiveWriter& operator=(const ArchiveWriter&) = delete;
+
+    /**
+     * @brief Appends one replay and its index entry.
+     *
+     * @param replay Pointer to the encoded replay.
+     * @param size Replay length in bytes.
+     * @param outcome Final state of the game (stored in the index).
+     * @return uint64_t The id of the game in the archive.
+     * @throws std::runtime_error on a write error or a malformed replay.
+     */
+    uint64_t add(const uint8_t* replay, size_t size, const GameOutcome& outcome);
+
+    /**
+     * @brief Writes the index and footer and closes the file.
+     */
+    void finish();
+
+    uint64_t gameCount() const { return index.size(); }
+
+private:
+    std::FILE* file = nullptr;
+    uint64_t offset = 0;
+    std::vector<ArchiveEntry> index;
+};
+
+/**
+ * @brief Read-only, memory-mapped view of an archive.
+ */
+class ArchiveReader {
+public:
+    /**
+     * @brief Maps the archive and validates its footer.
+     *
+     * @throws std::runtime_error if the file cannot be mapped or is not a valid archive.
+     */
+    explicit ArchiveReader(const std::string& path);
+
+    ~ArchiveReader();
+
+    ArchiveReader(const ArchiveReader&) = delete;
+    ArchiveReader& operator=(const ArchiveReader&) = delete;
+
+    // Number of games in the archive
+    size_t size() const { return count; }
+
+    // Index entry of a game (id < size())
+    const ArchiveEntry& entry(size_t id) const { return entries[id]; }
+
+    // Encoded replay bytes of a game, pointing into the mapping (unchecked)
+    const uint8_t* replayData(size_t id) const { return base + entries[id].offset; }
+
+    /**
+     * @brief Returns an allocation-free reader over the replay of a game.
+     *
+     * @throws std::out_of_range if id is not a game of the archive.
+     * @throws std::runtime_error if the index entry points outside the replay data.
+     */
+    ReplayReader replay(size_t id) const;
+
+    /**
+     * @brief Hints the kernel about the access pattern (scan vs. random lookups).
+     */
+    void adviseSequential() const;
+    void adviseRandom() const;
+
+private:
+    const uint8_t* base = nullptr;
+    size_t mappedSize = 0;
+    size_t dataSize = 0;              // Bytes before the index
+    const ArchiveEntry* entries = nullptr;
+    size_t count = 0;
+};
+
+} // namespace coup
@@ -0,0 +1,319 @@
+// email: shiraba01@gmail.com
+#include "BlockCodec.hpp"
+#include "Replay.hpp"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if defined(COUP_HAVE_ZSTD) && __has_include(<zstd.h>)
+#include <zstd.h>
+#define COUP_ZSTD 1
+#endif
+#if defined(COUP_HAVE_LZ4) && __has_include(<lz4.h>)
+#include <lz4.h>
+#define COUP_LZ4 1
+#endif
+
+namespace coup {
+
+namespace {
+
+// Record flags of the builtin codec
+constexpr uint8_t RECORD_VERBATIM = 1;     // Not a replay we understand: stored as is
+constexpr uint8_t RECORD_SAME_SETUP = 2;   // Same players and roles as the previous replay
+
+constexpr size_t SEED_OFFSET = 3;          // After "CR" and the version byte
+constexpr size_t SETUP_OFFSET = 11;        // Player count, then role/name of every seat
+constexpr size_t MIN_RUN = 4;              // Shorter repeats are cheaper as literals
+
+uint64_t zigzag(int64_t v) { return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63); }
+int64_t unzigzag(uint64_t v) { return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1); }
+
+/**
+ * @brief Returns the length of the header of a replay (0 if it is not a valid replay).
+ */
+size_t replayHeaderLength(const uint8_t* data, size_t size) {
+    if (size <= SETUP_OFFSET || data[0] != 'C' || data[1] != 'R' || data[2] != REPLAY_VERSION) {
+        return 0;
+    }
+    size_t p = SETUP_OFFSET + 1;
+    for (size_t i = 0; i < data[SETUP_OFFSET]; ++i) {
+        if (p + 2 > size) return 0;
+        p += 2 + data[p + 1];
+    }
+    return p <= size ? p : 0;
+}
+
+/**
+ * @brief Codes action bytes as runs: varint (length << 1 | isRepeat), then the byte or the literals.
+ */
+void encodeBody(const uint8_t* body, size_t size, std::vector<uint8_t>& out) {
+    size_t literalStart = 0;
+    size_t i = 0;
+    while (i < size) {
+        size_t run = 1;
+        while (i + run < size && body[i + run] == body[i]) run++;
+        if (run < MIN_RUN) {
+            i += run;
+            continue;
+        }
+        if (i > literalStart) {
+            putVarint(out, (i - literalStart) << 1);
+            out.insert(out.end(), body + literalStart, body + i);
+        }
+        putVarint(out, (run << 1) | 1);
+        out.push_back(body[i]);
+        i += run;
+        literalStart = i;
+    }
+    if (size > literalStart) {
+        putVarint(out, (size - literalStart) << 1);
+        out.insert(out.end(), body + literalStart, body + size);
+    }
+}
+
+void compressBuiltin(const uint8_t* raw, size_t size, std::vector<uint8_t>& out) {
+    const uint8_t* p = raw;
+    const uint8_t* end = raw + size;
+    uint64_t prevSeed = 0;
+    const uint8_t* prevSetup = nullptr;
+    size_t prevSetupLength = 0;
+
+    while (p < end) {
+        uint64_t length;
+        if (!getVarint(p, end, length) || length > static_cast<size_t>(end - p)) {
+            throw std::runtime_error("Malformed replay block.");
+        }
+        const uint8_t* replay = p;
+        p += length;
+
+        size_t headerLength = replayHeaderLength(replay, length);
+        if (headerLength == 0) {
+            out.push_back(RECORD_VERBATIM);
+            putVarint(out, length);
+            out.insert(out.end(), replay, replay + length);
+            continue;
+        }
+
+        uint64_t seed = 0;
+        for (int i = 0; i < 8; ++i) {
+            seed |= static_cast<uint64_t>(replay[SEED_OFFSET + i]) << (8 * i);
+        }
+        const uint8_t* setup = replay + SETUP_OFFSET;
+        const size_t setupLength = headerLength - SETUP_OFFSET;
+        const bool sameSetup = prevSetup && setupLength == prevSetupLength &&
+                               std::memcmp(setup, prevSetup, setupLength) == 0;
+
+        out.push_back(sameSetup ? RECORD_SAME_SETUP : 0);
+        putVarint(out, zigzag(static_cast<int64_t>(seed - prevSeed)));
+        if (!sameSetup) {
+            putVarint(out, setupLength);
+            out.insert(out.end(), setup, setup + setupLength);
+        }
+        putVarint(out, length - headerLength);
+        encodeBody(replay + headerLength, length - headerLength, out);
+
+        prevSeed = seed;
+        prevSetup = setup;
+        prevSetupLength = setupLength;
+    }
+}
+
+void decompressBuiltin(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+    const uint8_t* p = data;
+    const uint8_t* end = data + size;
+    uint64_t prevSeed = 0;
+    size_t prevSetup = 0;          // Offset of the previous setup in out
+    size_t prevSetupLength = 0;
+    std::vector<uint8_t> replay;
+
+    auto fail = []() { throw std::runtime_error("Corrupted replay block."); };
+
+    while (p < end) {
+        uint8_t flags = *p++;
+        uint64_t value;
+        if (flags & RECORD_VERBATIM) {
+            if (!getVarint(p, end, value) || value > static_cast<size_t>(end - p)) fail();
+            putVarint(out, value);
+            out.insert(out.end(), p, p + value);
+            p += value;
+            continue;
+        }
+
+        replay.clear();
+        replay.push_back('C');
+        replay.push_back('R');
+        replay.push_back(REPLAY_VERSION);
+        if (!getVarint(p, end, value)) fail();
+        uint64_t seed = prevSeed + static_cast<uint64_t>(unzigzag(value));
+        for (int i = 0; i < 8; ++i) {
+            replay.push_back(static_cast<uint8_t>(seed >> (8 * i)));
+        }
+        if (flags & RECORD_SAME_SETUP) {
+            if (prevSetupLength == 0) fail();
+            replay.insert(replay.end(), out.begin() + prevSetup, out.begin() + prevSetup + prevSetupLength);
+        } else {
+            if (!getVarint(p, end, value) || value == 0 || value > static_cast<size_t>(end - p)) fail();
+            replay.insert(replay.end(), p, p + value);
+            prevSetupLength = value;
+            p += value;
+        }
+
+        uint64_t bodyLength;
+        if (!getVarint(p, end, bodyLength)) fail();
+        const size_t headerLength = replay.size();
+        while (replay.size() - headerLength < bodyLength) {
+            if (!getVarint(p, end, value)) fail();
+            const uint64_t count = value >> 1;
+            if (count == 0 || count > bodyLength - (replay.size() - headerLength)) fail();
+            if (value & 1) {
+                if (p >= end) fail();
+                replay.insert(replay.end(), count, *p++);
+            } else {
+                if (count > static_cast<size_t>(end - p)) fail();
+                replay.insert(replay.end(), p, p + count);
+                p += count;
+            }
+        }
+
+        putVarint(out, replay.size());
+        prevSetup = out.size() + SETUP_OFFSET;
+        out.insert(out.end(), replay.begin(), replay.end());
+        prevSeed = seed;
+    }
+}
+
+} // namespace
+
+/**
+ * @brief Returns the best codec compiled into this build.
+ *
+ * @return BlockCodec Zstd if available, then Lz4, otherwise Builtin.
+ */
+BlockCodec defaultBlockCodec() {
+#if defined(COUP_ZSTD)
+    return BlockCodec::Zstd;
+#elif defined(COUP_LZ4)
+    return BlockCodec::Lz4;
+#else
+    return BlockCodec::Builtin;
+#endif
+}
+
+/**
+ * @brief Returns a printable codec name.
+ *
+ * @param codec The codec.
+ * @return const char* "builtin", "zstd" or "lz4".
+ */
+const char* blockCodecName(BlockCodec codec) {
+    switch (codec) {
+        case BlockCodec::Builtin: return "builtin";
+        case BlockCodec::Zstd: return "zstd";
+        case BlockCodec::Lz4: return "lz4";
+    }
+    return "unknown";
+}
+
+/**
+ * @brief Compresses a raw block of [varint length][replay bytes] records.
+ *
+ * @param codec The codec to use.
+ * @param raw Raw block.
+ * @param size Raw block size.
+ * @param out Receives the compressed block (cleared first).
+ * @throws std::runtime_error if the codec is not available in this build.
+ */
+void compressBlock(BlockCodec codec, const uint8_t* raw, size_t size, std::vector<uint8_t>& out) {
+    out.clear();
+    switch (codec) {
+        case BlockCodec::Builtin:
+            out.reserve(size / 2);
+            compressBuiltin(raw, size, out);
+            return;
+        case BlockCodec::Zstd:
+#if defined(COUP_ZSTD)
+        {
+            out.resize(ZSTD_compressBound(size));
+            size_t n = ZSTD_compress(out.data(), out.size(), raw, size, 3);
+            if (ZSTD_isError(n)) {
+                throw std::runtime_error("zstd compression failed.");
+            }
+            out.resize(n);
+            return;
+        }
+#else
+            break;
+#endif
+        case BlockCodec::Lz4:
+#if defined(COUP_LZ4)
+        {
+            out.resize(static_cast<size_t>(LZ4_compressBound(static_cast<int>(size))));
+            int n = LZ4_compress_default(reinterpret_cast<const char*>(raw), reinterpret_cast<char*>(out.data()),
+                                         static_cast<int>(size), static_cast<int>(out.size()));
+            if (n <= 0) {
+                throw std::runtime_error("lz4 compression failed.");
+            }
+            out.resize(static_cast<size_t>(n));
+            return;
+        }
+#else
+            break;
+#endif
+    }
+    throw std::runtime_error(std::string("Codec not available in this build: ") + blockCodecName(codec));
+}
+
+/**
+ * @brief Restores a raw block compressed by compressBlock().
+ *
+ * @param codec The codec used.
+ * @param data Compressed block.
+ * @param size Compressed size.
+ * @param rawSize Size of the raw block.
+ * @param out Receives the raw block (cleared first).
+ * @throws std::runtime_error if the data is corrupted or the codec is not available.
+ */
+void decompressBlock(BlockCodec codec, const uint8_t* data, size_t size, size_t rawSize, std::vector<uint8_t>& out) {
+    out.clear();
+    switch (codec) {
+        case BlockCodec::Builtin:
+            out.reserve(rawSize);
+            decompressBuiltin(data, size, out);
+            if (out.size() != rawSize) {
+                throw std::runtime_error("Corrupted replay block.");
+            }
+            return;
+        case BlockCodec::Zstd:
+#if defined(COUP_ZSTD)
+        {
+            out.resize(rawSize);
+            size_t n = ZSTD_decompress(out.data(), rawSize, data, size);
+            if (ZSTD_isError(n) || n != rawSize) {
+                throw std::runtime_error("Corrupted replay block.");
+            }
+            return;
+        }
+#else
+            break;
+#endif
+        case BlockCodec::Lz4:
+#if defined(COUP_LZ4)
+        {
+            out.resize(rawSize);
+            int n = LZ4_decompress_safe(reinterpret_cast<const char*>(data), reinterpret_cast<char*>(out.data()),
+                                        static_cast<int>(size), static_cast<int>(rawSize));
+            if (n < 0 || static_cast<size_t>(n) != rawSize) {
+                throw std::runtime_error("Corrupted replay block.");
+            }
+            return;
+        }
+#else
+            break;
+#endif
+    }
+    throw std::runtime_error(std::string("Codec not available in this build: ") + blockCodecName(codec));
+}
+
+} // namespace coup
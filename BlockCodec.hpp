@@ -0,0 +1,81 @@
+// email: shiraba01@gmail.com
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace coup {
+
+/**
+ * @brief Compression used for one block of a replay stream.
+ *
+ * Zstd and Lz4 are only available when the project is built with
+ * COUP_HAVE_ZSTD / COUP_HAVE_LZ4 (the Makefile enables them when the
+ * libraries are installed). Builtin is always available.
+ */
+enum class BlockCodec : uint8_t {
+    Builtin = 0,   // Replay-aware delta + varint + run-length coding
+    Zstd = 1,
+    Lz4 = 2
+};
+
+/**
+ * @brief Returns the best codec compiled into this build (Zstd, then Lz4, then Builtin).
+ */
+BlockCodec defaultBlockCodec();
+
+/**
+ * @brief Returns a printable codec name ("builtin", "zstd", "lz4").
+ */
+const char* blockCodecName(BlockCodec codec);
+
+// Varint helpers shared by the replay stream formats (LEB128, little-endian groups of 7 bits)
+inline void putVarint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+/**
+ * @brief Reads a varint; returns false if the input ends first.
+ */
+inline bool getVarint(const uint8_t*& p, const uint8_t* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        uint8_t byte = *p++;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Compresses a raw block: a sequence of [varint length][replay bytes] records.
+ *
+ * The builtin codec codes each replay against the previous one of the block:
+ * the seed as a zigzag varint delta, the player setup only when it changed,
+ * and the action bytes as literal runs and repeated-byte runs.
+ *
+ * @param codec The codec to use.
+ * @param raw Raw block.
+ * @param size Raw block size.
+ * @param out Receives the compressed block (cleared first).
+ * @throws std::runtime_error if the codec is not available in this build.
+ */
+void compressBlock(BlockCodec codec, const uint8_t* raw, size_t size, std::vector<uint8_t>& out);
+
+/**
+ * @brief Restores a raw block compressed by compressBlock().
+ *
+ * @param codec The codec used.
+ * @param data Compressed block.
+ * @param size Compressed size.
+ * @param rawSize Size of the raw block.
+ * @param out Receives the raw block (cleared first).
+ * @throws std::runtime_error if the data is corrupted or the codec is not available.
+ */
+void decompressBlock(BlockCodec codec, const uint8_t* data, size_t size, size_t rawSize, std::vector<uint8_t>& out);
+
+} // namespace coup
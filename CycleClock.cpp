@@ -0,0 +1,39 @@
+// email: shiraba01@gmail.com
+#include "CycleClock.hpp"
+
+namespace coup {
+
+namespace {
+
+// Calibration spell of cyclesPerNs()
+constexpr auto CALIBRATION = std::chrono::milliseconds(5);
+
+double calibrate() {
+#if defined(__x86_64__) || defined(__i386__)
+    const auto start = std::chrono::steady_clock::now();
+    const uint64_t first = cycleCount();
+    auto now = start;
+    while (now - start < CALIBRATION) {
+        now = std::chrono::steady_clock::now();
+    }
+    const uint64_t last = cycleCount();
+    const double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count());
+    return last > first ? static_cast<double>(last - first) / ns : 1.0;
+#else
+    return 1.0;
+#endif
+}
+
+} // namespace
+
+/**
+ * @brief Returns the cycleCount() ticks per nanosecond, measured against steady_clock once per process.
+ *
+ * The first call spins for a few milliseconds; later calls return the stored value.
+ */
+double cyclesPerNs() {
+    static const double rate = calibrate();
+    return rate;
+}
+
+} // namespace coup
@@ -0,0 +1,36 @@
+// email: shiraba01@gmail.com
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace coup {
+
+/**
+ * @brief Reads the CPU's cycle counter: the TSC on x86 (a few nanoseconds, no system call),
+ *        steady_clock nanoseconds elsewhere.
+ *
+ * The TSC of current x86 CPUs ticks at a constant rate on every core, so
+ * differences of two readings measure wall time once divided by cyclesPerNs().
+ */
+inline uint64_t cycleCount() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::steady_clock::now().time_since_epoch())
+                                     .count());
+#endif
+}
+
+/**
+ * @brief Returns the cycleCount() ticks per nanosecond, measured against steady_clock once per process.
+ *
+ * The first call spins for a few milliseconds; later calls return the stored value.
+ */
+double cyclesPerNs();
+
+} // namespace coup
@@ -0,0 +1,189 @@
+// email: shiraba01@gmail.com
+#include "EventExport.hpp"
+#include "Table.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace coup {
+
+namespace {
+
+// Upper bound on the length of one line (ids, names and six deltas)
+constexpr size_t MAX_LINE = 256;
+
+} // namespace
+
+/**
+ * @brief Exports to an open file (not closed by the exporter).
+ *
+ * @param out Destination file.
+ * @param options Sampling and buffer size.
+ * @throws std::invalid_argument if the file is null or an option is 0.
+ */
+JsonlExporter::JsonlExporter(std::FILE* out, const ExportOptions& options) : file(out), options(options) {
+    if (!file) {
+        throw std::invalid_argument("Exporter needs an open file.");
+    }
+    init();
+}
+
+/**
+ * @brief Creates (or truncates) a file and exports to it.
+ *
+ * @param path Path of the file.
+ * @param options Sampling and buffer size.
+ * @throws std::runtime_error if the file cannot be opened.
+ * @throws std::invalid_argument if an option is 0.
+ */
+JsonlExporter::JsonlExporter(const std::string& path, const ExportOptions& options) : options(options) {
+    if (options.sampleEvery == 0 || options.bufferSize == 0) {
+        throw std::invalid_argument("Sampling rate and buffer size must be positive.");
+    }
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        throw std::runtime_error("Cannot create event file: " + path);
+    }
+    owned = true;
+    init();
+}
+
+/**
+ * @brief Flushes the buffer (errors are ignored) and closes the file if the exporter opened it.
+ */
+JsonlExporter::~JsonlExporter() {
+    try {
+        flush();
+    } catch (const std::exception&) {
+        // Destructors must not throw; call flush() explicitly to see errors
+    }
+    if (owned) {
+        std::fclose(file);
+    }
+}
+
+/**
+ * @brief Allocates the line buffer once for the whole run.
+ */
+void JsonlExporter::init() {
+    if (options.sampleEvery == 0 || options.bufferSize == 0) {
+        throw std::invalid_argument("Sampling rate and buffer size must be positive.");
+    }
+    buffer.resize(std::max(options.bufferSize, 2 * MAX_LINE));
+}
+
+/**
+ * @brief Sets the id of the next game.
+ *
+ * @param id Game id.
+ */
+void JsonlExporter::setGameId(uint64_t id) {
+    nextGameId = id;
+}
+
+/**
+ * @brief Picks whether the game is exported and remembers the starting coins.
+ *
+ * @param table The table of the game.
+ */
+void JsonlExporter::onStart(const Table& table) {
+    gameId = nextGameId++;
+    sampled = options.sampleEvery == 1 || SplitMix64(gameId).next() % options.sampleEvery == 0;
+    const Game& game = table.getGame();
+    for (size_t seat = 0; seat < game.numPlayers(); ++seat) {
+        coins[seat] = game.coinsAt(seat);
+    }
+}
+
+/**
+ * @brief Formats one line for the action that was just applied.
+ *
+ * @param table The table of the game.
+ * @param action The action.
+ * @param ply Index of the action in the game.
+ */
+void JsonlExporter::onAction(const Table& table, const Action& action, size_t ply) {
+    const Game& game = table.getGame();
+    const size_t n = game.numPlayers();
+    if (!sampled) {
+        for (size_t seat = 0; seat < n; ++seat) coins[seat] = game.coinsAt(seat);
+        return;
+    }
+    if (used + MAX_LINE > buffer.size()) {
+        flush();
+    }
+
+    put("{\"game\":");
+    putInt(static_cast<int64_t>(gameId));
+    put(",\"ply\":");
+    putInt(static_cast<int64_t>(ply));
+    put(",\"actor\":");
+    putInt(action.actor);
+    put(",\"role\":");
+    putString(roleName(table.roleAt(action.actor)));
+    put(",\"action\":");
+    putString(actionName(action.kind));
+    put(",\"target\":");
+    if (actionHasTarget(action.kind)) {
+        putInt(action.target);
+    } else {
+        put("null");
+    }
+    put(",\"deltas\":[");
+    for (size_t seat = 0; seat < n; ++seat) {
+        const int now = game.coinsAt(seat);
+        if (seat) put(",");
+        putInt(now - coins[seat]);
+        coins[seat] = now;
+    }
+    put("],\"bank\":");
+    putInt(game.getBankCoins());
+    put("}\n");
+    events++;
+}
+
+/**
+ * @brief Writes the buffered lines to the file.
+ *
+ * @throws std::runtime_error on a write error.
+ */
+void JsonlExporter::flush() {
+    if (used == 0) {
+        return;
+    }
+    const size_t length = used;
+    used = 0;
+    bytes += length;
+    if (std::fwrite(buffer.data(), 1, length, file) != length) {
+        throw std::runtime_error("Failed to write events.");
+    }
+}
+
+/**
+ * @brief Appends a quoted string (role and action names need no escaping).
+ */
+void JsonlExporter::putString(const char* text) {
+    buffer[used++] = '"';
+    while (*text) buffer[used++] = *text++;
+    buffer[used++] = '"';
+}
+
+/**
+ * @brief Appends a decimal integer.
+ */
+void JsonlExporter::putInt(int64_t value) {
+    uint64_t magnitude = static_cast<uint64_t>(value);
+    if (value < 0) {
+        buffer[used++] = '-';
+        magnitude = 0 - magnitude;
+    }
+    char digits[20];
+    size_t count = 0;
+    do {
+        digits[count++] = static_cast<char>('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+    while (count) buffer[used++] = digits[--count];
+}
+
+} // namespace coup
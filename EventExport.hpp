@@ -0,0 +1,101 @@
+// email: shiraba01@gmail.com
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "Simulator.hpp"
+
+namespace coup {
+
+/**
+ * @brief Settings of a JsonlExporter.
+ */
+struct ExportOptions {
+    uint64_t sampleEvery = 1;         // Export about one game in sampleEvery (1 exports every game)
+    size_t bufferSize = 1 << 16;      // Bytes formatted in memory between two writes
+};
+
+/**
+ * @brief Writes one JSON line per action of the observed games.
+ *
+ *   {"game":12,"ply":3,"actor":1,"role":"Baron","action":"tax","target":null,"deltas":[0,2,0],"bank":96}
+ *
+ * deltas holds the coin change of every seat caused by the action. Lines are
+ * formatted by hand into a buffer that is reused for the whole run, so
+ * exporting does not allocate. Sampling picks whole games, by a hash of the
+ * game id, so the same games are exported whatever the thread that plays them.
+ */
+class JsonlExporter : public SimObserver {
+public:
+    /**
+     * @brief Exports to an open file (not closed by the exporter).
+     *
+     * @throws std::invalid_argument if the file is null or an option is 0.
+     */
+    explicit JsonlExporter(std::FILE* out, const ExportOptions& options = ExportOptions());
+
+    /**
+     * @brief Creates (or truncates) a file and exports to it.
+     *
+     * @throws std::runtime_error if the file cannot be opened.
+     * @throws std::invalid_argument if an option is 0.
+     */
+    explicit JsonlExporter(const std::string& path, const ExportOptions& options = ExportOptions());
+
+    /**
+     * @brief Flushes the buffer and closes the file if the exporter opened it.
+     */
+    ~JsonlExporter() override;
+
+    JsonlExporter(const JsonlExporter&) = delete;
+    JsonlExporter& operator=(const JsonlExporter&) = delete;
+
+    /**
+     * @brief Sets the id of the next game (written on every line and used for sampling).
+     *
+     * Without it, games are numbered 0, 1, 2... in the order they start.
+     */
+    void setGameId(uint64_t id);
+
+    void onStart(const Table& table) override;
+    void onAction(const Table& table, const Action& action, size_t ply) override;
+
+    /**
+     * @brief Writes the buffered lines to the file.
+     *
+     * @throws std::runtime_error on a write error.
+     */
+    void flush();
+
+    uint64_t eventCount() const { return events; }
+    uint64_t byteCount() const { return bytes + used; }
+
+private:
+    void init();
+    void put(const char* text, size_t length) {
+        for (size_t i = 0; i < length; ++i) buffer[used + i] = text[i];
+        used += length;
+    }
+    template <size_t N>
+    void put(const char (&text)[N]) { put(text, N - 1); }
+    void putString(const char* text);
+    void putInt(int64_t value);
+
+    std::FILE* file = nullptr;
+    bool owned = false;
+    ExportOptions options;
+    std::vector<char> buffer;
+    size_t used = 0;
+    uint64_t bytes = 0;
+    uint64_t events = 0;
+
+    uint64_t nextGameId = 0;
+    uint64_t gameId = 0;
+    bool sampled = true;
+    int coins[MAX_PLAYERS] = {};
+};
+
+} // namespace coup
@@ -0,0 +1,37 @@
+// email: shiraba01@gmail.com
+#include "Footprint.hpp"
+#include "Player.hpp"
+#include "Governor.hpp"
+#include "Spy.hpp"
+#include "Baron.hpp"
+#include "General.hpp"
+#include "Judge.hpp"
+#include "Merchant.hpp"
+
+namespace coup {
+
+// Player::memoryFootprint() reports sizeof(Player) for every role, which is
+// only correct as long as the roles do not add data members.
+static_assert(sizeof(Governor) == sizeof(Player), "Governor adds data members");
+static_assert(sizeof(Spy) == sizeof(Player), "Spy adds data members");
+static_assert(sizeof(Baron) == sizeof(Player), "Baron adds data members");
+static_assert(sizeof(General) == sizeof(Player), "General adds data members");
+static_assert(sizeof(Judge) == sizeof(Player), "Judge adds data members");
+static_assert(sizeof(Merchant) == sizeof(Player), "Merchant adds data members");
+
+/**
+ * @brief Returns the heap bytes owned by a string.
+ *
+ * @param str The string to inspect.
+ * @return size_t 0 if the characters are stored inside the string object, capacity() + 1 otherwise.
+ */
+size_t stringHeapBytes(const std::string& str) {
+    const char* data = str.data();
+    const char* object = reinterpret_cast<const char*>(&str);
+    if (data >= object && data < object + sizeof(std::string)) {
+        return 0;
+    }
+    return str.capacity() + 1;
+}
+
+} // namespace coup
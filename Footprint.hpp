@@ -0,0 +1,35 @@
+// email: shiraba01@gmail.com
+#pragma once
+#include <cstddef>
+#include <string>
+
+namespace coup {
+
+/**
+ * @brief Memory used by an object, split into its own size and the heap blocks it owns.
+ */
+struct MemoryFootprint {
+    size_t objectBytes = 0;   // sizeof() of the object(s) themselves
+    size_t heapBytes = 0;     // Heap blocks owned: string buffers, vector capacity
+
+    size_t total() const { return objectBytes + heapBytes; }
+
+    MemoryFootprint& operator+=(const MemoryFootprint& other) {
+        objectBytes += other.objectBytes;
+        heapBytes += other.heapBytes;
+        return *this;
+    }
+};
+
+/**
+ * @brief Returns the heap bytes owned by a string.
+ *
+ * Short strings live in the small-string buffer inside the object and own no
+ * heap block; longer ones own capacity() + 1 bytes (including the terminator).
+ *
+ * @param str The string to inspect.
+ * @return size_t Number of heap bytes owned by the string.
+ */
+size_t stringHeapBytes(const std::string& str);
+
+} // namespace coup
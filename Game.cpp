@@ -1,22 +1,59 @@
 // email: shiraba01@gmail.com
 #include "Game.hpp"
 #include "Player.hpp"
+#include "Action.hpp"
+#include "Roles.hpp"
+
+#include <cstring>
+
+// Snapshots are copied to and from SnapshotBlob as raw bytes
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "The game snapshot format is little-endian"
+#endif
 
 using namespace std;
 
 namespace coup {
 
+namespace {
+
+const char SNAPSHOT_MAGIC[4] = {'C', 'G', 'S', 'N'};
+
+/**
+ * @brief Returns the Role code of a player, or NO_CODE if the role is not one of Role.
+ */
+uint8_t roleCode(const Player& player) {
+    const string role = player.getRole();
+    for (size_t r = 0; r < NUM_ROLES; ++r) {
+        if (role == roleName(static_cast<Role>(r))) {
+            return static_cast<uint8_t>(r);
+        }
+    }
+    return NO_CODE;
+}
+
+} // namespace
+
 /**
  * @brief Adds a new player to the game.
  * 
+ * The new player's hot state starts alive, unsanctioned, with no coins and
+ * with arrest enabled.
+ *
  * @param player Pointer to the Player to add.
+ * @return size_t The seat index of the player in the hot state arrays.
  * @throws runtime_error if the maximum number of players (6) is exceeded.
  */
-void Game::add_player(Player* player) {
-    if (players_list.size() >= 6) {
+size_t Game::add_player(Player* player) {
+    if (players_list.size() >= MAX_PLAYERS) {
         throw std::runtime_error("Maximum number of players reached.");
     }
+    size_t seat = players_list.size();
+    hot.coins[seat] = 0;
+    hot.flags[seat] = FLAG_ALIVE | FLAG_ARREST_ENABLED;
+    hot.lastArrested[seat] = NO_SEAT;
     players_list.push_back(player);
+    return seat;
 }
 
 /**
@@ -26,9 +63,9 @@ void Game::add_player(Player* player) {
  */
 vector<string> Game::players() const {
     vector<string> active_names;
-    for (Player* p : players_list) {
-        if (p->isAlive()) {
-            active_names.push_back(p->getName());
+    for (size_t seat = 0; seat < players_list.size(); ++seat) {
+        if (hasFlag(seat, FLAG_ALIVE)) {
+            active_names.push_back(players_list[seat]->getName());
         }
     }
     return active_names;
@@ -41,6 +78,16 @@ vector<string> Game::players() const {
  * @throws runtime_error if there are no players or no active players.
  */
 string Game::turn() const {
+    return players_list[currentSeat()]->getName();
+}
+
+/**
+ * @brief Returns the seat index of the player whose turn it currently is.
+ * 
+ * @return size_t Seat of the current player.
+ * @throws runtime_error if there are no players or no active players.
+ */
+size_t Game::currentSeat() const {
     if (players_list.empty()) {
         throw std::runtime_error("No players in the game.");
     }
@@ -48,14 +95,14 @@ string Game::turn() const {
     // Make sure current_turn_index points to a living player
     size_t idx = current_turn_index;
     size_t count = 0;
-    while (!players_list[idx]->isAlive()) {
+    while (!hasFlag(idx, FLAG_ALIVE)) {
         idx = (idx + 1) % players_list.size();
         if (++count >= players_list.size()) {
             throw std::runtime_error("No active players.");
         }
     }
 
-    return players_list[idx]->getName();
+    return idx;
 }
 
 /**
@@ -74,13 +121,13 @@ void Game::eliminate_player(Player& target) {
  * @throws runtime_error if more than one player is still alive.
  */
 string Game::winner() const {
-    string winner_name;
+    size_t winner_seat = 0;
     int alive_count = 0;
 
-    for (Player* p : players_list) {
-        if (p->isAlive()) {
+    for (size_t seat = 0; seat < players_list.size(); ++seat) {
+        if (hasFlag(seat, FLAG_ALIVE)) {
             alive_count++;
-            winner_name = p->getName();
+            winner_seat = seat;
         }
     }
 
@@ -88,7 +135,7 @@ string Game::winner() const {
         throw std::runtime_error("The game is not over yet.");
     }
 
-    return winner_name;
+    return players_list[winner_seat]->getName();
 }
 
 /**
@@ -133,24 +180,24 @@ void Game::advanceTurn() {
         return;
     }
 
-    Player* current = players_list[current_turn_index];
+    size_t current = current_turn_index;
 
     // If the player has a pending extra turn, use it and stay on the same turn
-    if (current->hasPendingExtraTurn()) {
-        current->useExtraTurn(); // Consume the extra turn
-        current->onTurnStart();
+    if (hasFlag(current, FLAG_EXTRA_TURN)) {
+        setFlag(current, FLAG_EXTRA_TURN, false); // Consume the extra turn
+        players_list[current]->onTurnStart();
         return;
     }
 
     // Re-enable arrest at the start of the new player's turn
-    current->enableArrest();
+    setFlag(current, FLAG_ARREST_ENABLED, true);
 
     // Move to the next alive player
     size_t count = 0;
     do {
         current_turn_index = (current_turn_index + 1) % players_list.size();
         count++;
-    } while (!players_list[current_turn_index]->isAlive() && count <= players_list.size());
+    } while (!hasFlag(current_turn_index, FLAG_ALIVE) && count <= players_list.size());
 
     players_list[current_turn_index]->onTurnStart();
 }
@@ -181,4 +228,116 @@ bool Game::isCoupBlocked(Player* target) const {
     return pendingCoupTarget == target;
 }
 
+/**
+ * @brief Returns the seat of the player targeted by the pending coup.
+ * 
+ * @return int Seat index, or NO_SEAT if no coup is pending.
+ */
+int Game::pendingCoupSeat() const {
+    return pendingCoupTarget ? static_cast<int>(pendingCoupTarget->getSeat()) : NO_SEAT;
+}
+
+/**
+ * @brief Reports the memory used by the game.
+ * 
+ * @param includePlayers Also add the footprint of every registered Player.
+ * @return MemoryFootprint Object and heap bytes.
+ */
+MemoryFootprint Game::memoryFootprint(bool includePlayers) const {
+    MemoryFootprint fp;
+    fp.objectBytes = sizeof(Game);
+    fp.heapBytes = players_list.capacity() * sizeof(Player*);
+    if (includePlayers) {
+        for (Player* p : players_list) {
+            fp += p->memoryFootprint();
+        }
+    }
+    return fp;
+}
+
+/**
+ * @brief Writes a checkpoint of the game into a buffer.
+ *
+ * @param buffer Destination.
+ * @param capacity Size of the destination in bytes.
+ * @return size_t Number of bytes written.
+ * @throws invalid_argument if the buffer is too small.
+ * @throws runtime_error if a player's last action has no ActionKind code.
+ */
+size_t Game::saveSnapshot(uint8_t* buffer, size_t capacity) const {
+    if (capacity < sizeof(SnapshotBlob)) {
+        throw std::invalid_argument("Snapshot buffer is too small.");
+    }
+    SnapshotBlob blob;
+    std::memset(&blob, 0, sizeof(blob));
+    std::memcpy(blob.magic, SNAPSHOT_MAGIC, sizeof(blob.magic));
+    blob.version = SNAPSHOT_VERSION;
+    blob.numPlayers = static_cast<uint8_t>(players_list.size());
+    blob.pendingCoupSeat = static_cast<int8_t>(pendingCoupSeat());
+    blob.bank = coinBank;
+    blob.turnIndex = static_cast<uint8_t>(current_turn_index);
+    std::memcpy(blob.coins, hot.coins, sizeof(blob.coins));
+    std::memcpy(blob.flags, hot.flags, sizeof(blob.flags));
+    std::memcpy(blob.lastArrested, hot.lastArrested, sizeof(blob.lastArrested));
+    for (size_t seat = 0; seat < MAX_PLAYERS; ++seat) {
+        blob.roles[seat] = NO_CODE;
+        blob.lastActions[seat] = NO_CODE;
+    }
+    for (size_t seat = 0; seat < players_list.size(); ++seat) {
+        const Player& player = *players_list[seat];
+        blob.roles[seat] = roleCode(player);
+        if (!player.getLastAction().empty()) {
+            try {
+                blob.lastActions[seat] = static_cast<uint8_t>(parseActionName(player.getLastAction()));
+            } catch (const std::invalid_argument&) {
+                throw std::runtime_error("Cannot snapshot last action: " + player.getLastAction());
+            }
+        }
+    }
+    std::memcpy(buffer, &blob, sizeof(blob));
+    return sizeof(blob);
+}
+
+/**
+ * @brief Restores a checkpoint written by saveSnapshot().
+ *
+ * @param buffer Source.
+ * @param size Size of the source in bytes.
+ * @throws runtime_error if the blob is truncated, of another version, out of
+ *         range or does not match the seated players (the game is unchanged).
+ */
+void Game::loadSnapshot(const uint8_t* buffer, size_t size) {
+    if (size < sizeof(SnapshotBlob)) {
+        throw std::runtime_error("Truncated game snapshot.");
+    }
+    SnapshotBlob blob;
+    std::memcpy(&blob, buffer, sizeof(blob));
+    if (std::memcmp(blob.magic, SNAPSHOT_MAGIC, sizeof(blob.magic)) != 0 || blob.version != SNAPSHOT_VERSION) {
+        throw std::runtime_error("Not a game snapshot or unsupported version.");
+    }
+
+    const size_t n = players_list.size();
+    bool valid = blob.numPlayers == n && blob.turnIndex < (n ? n : 1) &&
+                 blob.pendingCoupSeat >= NO_SEAT && blob.pendingCoupSeat < static_cast<int>(n);
+    for (size_t seat = 0; valid && seat < n; ++seat) {
+        valid = blob.roles[seat] == roleCode(*players_list[seat]) &&
+                blob.lastArrested[seat] >= NO_SEAT && blob.lastArrested[seat] < static_cast<int>(n) &&
+                (blob.lastActions[seat] == NO_CODE || blob.lastActions[seat] < NUM_ACTION_KINDS);
+    }
+    if (!valid) {
+        throw std::runtime_error("Game snapshot does not match this game.");
+    }
+
+    coinBank = blob.bank;
+    current_turn_index = blob.turnIndex;
+    pendingCoupTarget = blob.pendingCoupSeat == NO_SEAT ? nullptr : players_list[blob.pendingCoupSeat];
+    std::memcpy(hot.coins, blob.coins, sizeof(hot.coins));
+    std::memcpy(hot.flags, blob.flags, sizeof(hot.flags));
+    std::memcpy(hot.lastArrested, blob.lastArrested, sizeof(hot.lastArrested));
+    for (size_t seat = 0; seat < n; ++seat) {
+        players_list[seat]->setLastAction(
+            blob.lastActions[seat] == NO_CODE ? "" : actionName(static_cast<ActionKind>(blob.lastActions[seat])));
+    }
+}
+
 } // namespace coup
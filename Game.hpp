@@ -4,13 +4,74 @@
 #include <vector>
 #include <string>
 #include <stdexcept>
+#include <cstdint>
+#include <cstddef>
+#include "Footprint.hpp"
 
 namespace coup {
 
 class Player;
+class GameHistory;
+
+// Maximum number of players at one table (enforced by Game::add_player)
+constexpr size_t MAX_PLAYERS = 6;
+
+// Bits of the per-player flag byte kept in the game's hot state
+enum PlayerFlag : uint8_t {
+    FLAG_ALIVE           = 1 << 0,  // The player is still in the game
+    FLAG_SANCTIONED      = 1 << 1,  // The player is blocked from economic actions
+    FLAG_EXTRA_TURN      = 1 << 2,  // The player has a pending extra turn
+    FLAG_ARREST_ENABLED  = 1 << 3   // The player may use arrest this turn
+};
+
+// Value of a last-arrested slot when the player has not arrested anyone yet
+constexpr int8_t NO_SEAT = -1;
+
+// Version of the SnapshotBlob layout written by Game::saveSnapshot
+constexpr uint16_t SNAPSHOT_VERSION = 1;
+
+// Code of a role or last action slot that is empty (no last action, or a player without a role)
+constexpr uint8_t NO_CODE = 0xFF;
+
+/**
+ * Fixed-layout binary checkpoint of a live game (little-endian, 56 bytes).
+ * Roles are stored as Role codes and last actions as ActionKind codes.
+ */
+struct SnapshotBlob {
+    char magic[4];                          // "CGSN"
+    uint16_t version;                       // SNAPSHOT_VERSION
+    uint8_t numPlayers;
+    int8_t pendingCoupSeat;                 // NO_SEAT if there is no pending coup
+    int32_t bank;
+    uint8_t turnIndex;
+    uint8_t reserved[3];
+    int16_t coins[MAX_PLAYERS];
+    uint8_t flags[MAX_PLAYERS];             // PlayerFlag bits
+    int8_t lastArrested[MAX_PLAYERS];
+    uint8_t roles[MAX_PLAYERS];             // Role code, or NO_CODE
+    uint8_t lastActions[MAX_PLAYERS];       // ActionKind code, or NO_CODE
+    uint8_t padding[4];
+};
+static_assert(sizeof(SnapshotBlob) == 56, "SnapshotBlob must keep its on-disk layout");
 
 class Game {
+    friend class GameHistory; // Captures and restores the game state for undo/history
+
 private:
+    /**
+     * Hot per-player state stored as a packed struct of arrays indexed by seat.
+     * Everything a turn reads or writes for every player (coins, status flags,
+     * last arrested seat) fits in 24 bytes, so a whole table shares a single
+     * cache line. Names, roles and last actions stay in the Player objects.
+     */
+    struct HotState {
+        int16_t coins[MAX_PLAYERS] = {};
+        uint8_t flags[MAX_PLAYERS] = {};
+        int8_t lastArrested[MAX_PLAYERS] = {NO_SEAT, NO_SEAT, NO_SEAT, NO_SEAT, NO_SEAT, NO_SEAT};
+    };
+
+    HotState hot;
+
     // List of all players in the game (only active ones are returned via players())
     std::vector<Player*> players_list;
 
@@ -28,9 +89,10 @@ public:
      * @brief Adds a player to the game.
      * 
      * @param player Pointer to the player to be added.
+     * @return size_t The seat index assigned to the player.
      * @throws std::runtime_error if too many players are added (checked in implementation).
      */
-    void add_player(Player* player);
+    size_t add_player(Player* player);
 
     /**
      * @brief Returns the names of all currently active (alive) players in the game.
@@ -110,6 +172,75 @@ public:
      * @return true if the coup is blocked; false otherwise.
      */
     bool isCoupBlocked(Player* target) const;
+
+    /**
+     * @brief Returns the number of seats (alive or eliminated) at the table.
+     */
+    size_t numPlayers() const { return players_list.size(); }
+
+    /**
+     * @brief Returns the player sitting at the given seat.
+     *
+     * @param seat Seat index (as returned by add_player).
+     * @throws std::out_of_range if the seat does not exist.
+     */
+    Player& playerAt(size_t seat) const { return *players_list.at(seat); }
+
+    /**
+     * @brief Returns the seat of the pending coup target, or NO_SEAT if there is none.
+     */
+    int pendingCoupSeat() const;
+
+    /**
+     * @brief Returns the seat index of the player whose turn it currently is.
+     *
+     * @throws std::runtime_error if there are no players or no active players.
+     */
+    size_t currentSeat() const;
+
+    /**
+     * @brief Reports the memory used by the game.
+     *
+     * @param includePlayers Also add the footprint of every registered Player.
+     * @return MemoryFootprint The Game object (including the hot per-seat state)
+     *         plus the capacity of the players vector, and optionally the players.
+     */
+    MemoryFootprint memoryFootprint(bool includePlayers = true) const;
+
+    /**
+     * @brief Writes a checkpoint of the game into a buffer (a SnapshotBlob).
+     *
+     * @param buffer Destination.
+     * @param capacity Size of the destination in bytes.
+     * @return size_t Number of bytes written (sizeof(SnapshotBlob)).
+     * @throws std::invalid_argument if the buffer is too small.
+     * @throws std::runtime_error if a player's last action has no ActionKind code.
+     */
+    size_t saveSnapshot(uint8_t* buffer, size_t capacity) const;
+
+    /**
+     * @brief Restores a checkpoint written by saveSnapshot().
+     *
+     * The same players (same count and roles, in the same seats) must already be
+     * seated. The blob is validated first, so on error the game is left unchanged.
+     *
+     * @param buffer Source.
+     * @param size Size of the source in bytes.
+     * @throws std::runtime_error if the blob is truncated, of another version,
+     *         out of range or does not match the seated players.
+     */
+    void loadSnapshot(const uint8_t* buffer, size_t size);
+
+    // Hot per-seat state (used by Player; seat is the index returned by add_player)
+    int coinsAt(size_t seat) const { return hot.coins[seat]; }
+    void setCoinsAt(size_t seat, int value) { hot.coins[seat] = static_cast<int16_t>(value); }
+    bool hasFlag(size_t seat, PlayerFlag flag) const { return (hot.flags[seat] & flag) != 0; }
+    void setFlag(size_t seat, PlayerFlag flag, bool value) {
+        if (value) hot.flags[seat] |= flag;
+        else hot.flags[seat] &= static_cast<uint8_t>(~flag);
+    }
+    int lastArrestedAt(size_t seat) const { return hot.lastArrested[seat]; }
+    void setLastArrestedAt(size_t seat, int target) { hot.lastArrested[seat] = static_cast<int8_t>(target); }
 };
 
 } // namespace coup
@@ -0,0 +1,103 @@
+// email: shiraba01@gmail.com
+#include "History.hpp"
+#include "Player.hpp"
+
+#include <stdexcept>
+#include <unordered_set>
+
+namespace coup {
+
+/**
+ * @brief Appends a snapshot of the current state of the game.
+ *
+ * Each seat is compared with the block of the previous snapshot; unchanged
+ * seats reuse that block and only changed seats allocate a new one.
+ *
+ * @param game The game to capture.
+ * @return size_t Index of the new snapshot.
+ */
+size_t GameHistory::record(const Game& game) {
+    GameSnapshot snap;
+    snap.bank = game.coinBank;
+    snap.turnIndex = game.current_turn_index;
+    snap.numPlayers = game.players_list.size();
+    snap.pendingCoupSeat = game.pendingCoupTarget ? static_cast<int>(game.pendingCoupTarget->getSeat()) : NO_SEAT;
+
+    const GameSnapshot* prev = snapshots.empty() ? nullptr : &snapshots.back();
+
+    for (size_t seat = 0; seat < snap.numPlayers; ++seat) {
+        const std::string& lastAction = game.players_list[seat]->getLastAction();
+        const SeatBlock* old = (prev && seat < prev->numPlayers) ? prev->seats[seat].get() : nullptr;
+
+        if (old && old->coins == game.hot.coins[seat] && old->flags == game.hot.flags[seat] &&
+            old->lastArrested == game.hot.lastArrested[seat] && old->lastAction == lastAction) {
+            snap.seats[seat] = prev->seats[seat];
+            continue;
+        }
+
+        auto block = std::make_shared<SeatBlock>();
+        block->coins = game.hot.coins[seat];
+        block->flags = game.hot.flags[seat];
+        block->lastArrested = game.hot.lastArrested[seat];
+        block->lastAction = lastAction;
+        snap.seats[seat] = std::move(block);
+    }
+
+    snapshots.push_back(std::move(snap));
+    return snapshots.size() - 1;
+}
+
+/**
+ * @brief Restores the game to a recorded snapshot.
+ *
+ * @param game The game to restore.
+ * @param index Index of the snapshot to restore.
+ * @throws std::out_of_range if index is not a recorded snapshot.
+ * @throws std::runtime_error if the game has a different number of players.
+ */
+void GameHistory::restore(Game& game, size_t index) const {
+    const GameSnapshot& snap = snapshots.at(index);
+    if (snap.numPlayers != game.players_list.size()) {
+        throw std::runtime_error("Snapshot does not match the number of players in the game.");
+    }
+
+    game.coinBank = snap.bank;
+    game.current_turn_index = snap.turnIndex;
+    game.pendingCoupTarget = snap.pendingCoupSeat == NO_SEAT ? nullptr : game.players_list[snap.pendingCoupSeat];
+
+    for (size_t seat = 0; seat < snap.numPlayers; ++seat) {
+        const SeatBlock& block = *snap.seats[seat];
+        game.hot.coins[seat] = static_cast<int16_t>(block.coins);
+        game.hot.flags[seat] = block.flags;
+        game.hot.lastArrested[seat] = block.lastArrested;
+        game.players_list[seat]->setLastAction(block.lastAction);
+    }
+}
+
+/**
+ * @brief Drops every snapshot from index `size` onwards.
+ *
+ * @param size Number of snapshots to keep.
+ */
+void GameHistory::truncate(size_t size) {
+    if (size < snapshots.size()) {
+        snapshots.resize(size);
+    }
+}
+
+/**
+ * @brief Counts the distinct SeatBlocks referenced by all snapshots.
+ *
+ * @return size_t Number of distinct blocks.
+ */
+size_t GameHistory::distinctBlocks() const {
+    std::unordered_set<const SeatBlock*> blocks;
+    for (const GameSnapshot& snap : snapshots) {
+        for (size_t seat = 0; seat < snap.numPlayers; ++seat) {
+            blocks.insert(snap.seats[seat].get());
+        }
+    }
+    return blocks.size();
+}
+
+} // namespace coup
@@ -0,0 +1,95 @@
+// email: shiraba01@gmail.com
+#pragma once
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Game.hpp"
+
+namespace coup {
+
+/**
+ * @brief Immutable state of one seat at a point in time.
+ *
+ * Blocks are shared between consecutive snapshots: a seat that did not change
+ * during a turn keeps pointing at the same block.
+ */
+struct SeatBlock {
+    int coins = 0;
+    uint8_t flags = 0;
+    int8_t lastArrested = NO_SEAT;
+    std::string lastAction;
+};
+
+/**
+ * @brief Persistent snapshot of a whole game.
+ *
+ * Only the table-wide scalars are copied; per-seat data is referenced through
+ * shared, immutable SeatBlocks.
+ */
+struct GameSnapshot {
+    int bank = 0;
+    size_t turnIndex = 0;
+    int pendingCoupSeat = NO_SEAT;
+    size_t numPlayers = 0;
+    std::array<std::shared_ptr<const SeatBlock>, MAX_PLAYERS> seats;
+};
+
+/**
+ * @brief Full history of a game built from structurally shared snapshots.
+ *
+ * Recording a turn costs one small snapshot plus a new SeatBlock for every seat
+ * that actually changed, so keeping the whole history of a long game is cheap.
+ * Restoring any past snapshot rewrites at most MAX_PLAYERS seats: O(1).
+ */
+class GameHistory {
+public:
+    /**
+     * @brief Appends a snapshot of the current state of the game.
+     *
+     * @param game The game to capture.
+     * @return size_t Index of the new snapshot.
+     */
+    size_t record(const Game& game);
+
+    /**
+     * @brief Restores the game to a recorded snapshot.
+     *
+     * The game must be the one (or have the same players as the one) that was recorded.
+     *
+     * @param game The game to restore.
+     * @param index Index of the snapshot to restore.
+     * @throws std::out_of_range if index is not a recorded snapshot.
+     * @throws std::runtime_error if the game has a different number of players.
+     */
+    void restore(Game& game, size_t index) const;
+
+    /**
+     * @brief Drops every snapshot from index `size` onwards (e.g., after an undo).
+     */
+    void truncate(size_t size);
+
+    /**
+     * @brief Returns the number of recorded snapshots.
+     */
+    size_t size() const { return snapshots.size(); }
+
+    /**
+     * @brief Returns the recorded snapshot at the given index.
+     */
+    const GameSnapshot& at(size_t index) const { return snapshots.at(index); }
+
+    /**
+     * @brief Returns the number of distinct SeatBlocks referenced by the history.
+     *
+     * Useful to check how much state is actually shared between snapshots.
+     */
+    size_t distinctBlocks() const;
+
+private:
+    std::vector<GameSnapshot> snapshots;
+};
+
+} // namespace coup
@@ -0,0 +1,316 @@
+// email: shiraba01@gmail.com
+#include "IndexedReplay.hpp"
+#include "Action.hpp"
+#include "BlockCodec.hpp"
+#include "Replay.hpp"
+
+#include <stdexcept>
+
+namespace coup {
+
+namespace {
+
+constexpr uint8_t MAGIC_0 = 'C';
+constexpr uint8_t MAGIC_1 = 'I';
+
+/**
+ * Carry-less range coder (Subbotin). Frequencies totals must stay below RC_BOT.
+ */
+constexpr uint32_t RC_TOP = 1u << 24;
+constexpr uint32_t RC_BOT = 1u << 16;
+
+class RangeEncoder {
+public:
+    explicit RangeEncoder(std::vector<uint8_t>& out) : out(out) {}
+
+    void encode(uint32_t cum, uint32_t freq, uint32_t total) {
+        range /= total;
+        low += cum * range;
+        range *= freq;
+        while ((low ^ (low + range)) < RC_TOP || (range < RC_BOT && ((range = -low & (RC_BOT - 1)), true))) {
+            out.push_back(static_cast<uint8_t>(low >> 24));
+            low <<= 8;
+            range <<= 8;
+        }
+    }
+
+    void finish() {
+        for (int i = 0; i < 4; ++i) {
+            out.push_back(static_cast<uint8_t>(low >> 24));
+            low <<= 8;
+        }
+    }
+
+private:
+    std::vector<uint8_t>& out;
+    uint32_t low = 0;
+    uint32_t range = 0xFFFFFFFFu;
+};
+
+class RangeDecoder {
+public:
+    RangeDecoder(const uint8_t* p, const uint8_t* end) : p(p), end(end) {
+        for (int i = 0; i < 4; ++i) {
+            code = (code << 8) | nextByte();
+        }
+    }
+
+    // Cumulative frequency of the next symbol (call consume() with its interval next)
+    uint32_t frequency(uint32_t total) {
+        range /= total;
+        uint32_t value = (code - low) / range;
+        if (value >= total) {
+            throw std::runtime_error("Corrupted indexed replay.");
+        }
+        return value;
+    }
+
+    void consume(uint32_t cum, uint32_t freq) {
+        low += cum * range;
+        range *= freq;
+        while ((low ^ (low + range)) < RC_TOP || (range < RC_BOT && ((range = -low & (RC_BOT - 1)), true))) {
+            code = (code << 8) | nextByte();
+            low <<= 8;
+            range <<= 8;
+        }
+    }
+
+private:
+    // The encoder's final bytes may be cut short by the caller; missing bytes read as zero
+    uint8_t nextByte() { return p < end ? *p++ : 0; }
+
+    const uint8_t* p;
+    const uint8_t* end;
+    uint32_t low = 0;
+    uint32_t code = 0;
+    uint32_t range = 0xFFFFFFFFu;
+};
+
+/**
+ * @brief Adaptive frequencies of up to N symbols, of which the first `active` are in use.
+ *
+ * The last symbol (N - 1) is always in use and serves as the escape of the index models.
+ */
+template <size_t N>
+class AdaptiveModel {
+public:
+    static constexpr uint32_t INCREMENT = 24;
+    static constexpr uint32_t LIMIT = RC_BOT - INCREMENT;
+
+    AdaptiveModel() {
+        for (size_t i = 0; i < N; ++i) freq[i] = 1;
+        total = N;
+    }
+
+    void encode(RangeEncoder& encoder, size_t symbol, size_t active) {
+        uint32_t cum = 0;
+        uint32_t activeTotal = 0;
+        for (size_t i = 0; i < active; ++i) {
+            if (i == symbol) cum = activeTotal;
+            activeTotal += freq[i];
+        }
+        if (symbol == N - 1) cum = activeTotal;
+        activeTotal += freq[N - 1];
+        encoder.encode(cum, freq[symbol], activeTotal);
+        update(symbol);
+    }
+
+    size_t decode(RangeDecoder& decoder, size_t active) {
+        uint32_t activeTotal = freq[N - 1];
+        for (size_t i = 0; i < active; ++i) activeTotal += freq[i];
+        uint32_t target = decoder.frequency(activeTotal);
+        uint32_t cum = 0;
+        size_t symbol = 0;
+        for (; symbol < active; ++symbol) {
+            if (target < cum + freq[symbol]) break;
+            cum += freq[symbol];
+        }
+        if (symbol == active) symbol = N - 1;
+        decoder.consume(cum, freq[symbol]);
+        update(symbol);
+        return symbol;
+    }
+
+private:
+    void update(size_t symbol) {
+        freq[symbol] += INCREMENT;
+        total += INCREMENT;
+        if (total > LIMIT) {
+            total = 0;
+            for (size_t i = 0; i < N; ++i) {
+                freq[i] = static_cast<uint16_t>((freq[i] + 1) / 2);
+                total += freq[i];
+            }
+        }
+    }
+
+    uint16_t freq[N];
+    uint32_t total;
+};
+
+// Index models are chosen by the number of legal moves (longer lists share the last model)
+constexpr size_t NUM_CONTEXTS = 24;
+constexpr size_t ESCAPE = MAX_LEGAL_ACTIONS;
+
+/**
+ * @brief The adaptive models of one replay (encoder and decoder evolve them identically).
+ */
+struct Models {
+    AdaptiveModel<MAX_LEGAL_ACTIONS + 1> index[NUM_CONTEXTS];
+    AdaptiveModel<NUM_ACTION_KINDS + 1> kind;       // Escaped actions; the extra symbol is unused
+    AdaptiveModel<8 + 1> target;
+    AdaptiveModel<MAX_PLAYERS + 1> actor;
+
+    AdaptiveModel<MAX_LEGAL_ACTIONS + 1>& forCount(size_t count) {
+        return index[count < NUM_CONTEXTS ? count : NUM_CONTEXTS - 1];
+    }
+};
+
+size_t plainHeaderLength(const ReplayReader& reader) {
+    size_t length = 12;
+    for (size_t s = 0; s < reader.numPlayers(); ++s) {
+        length += 2 + reader.name(s).size();
+    }
+    return length;
+}
+
+/**
+ * @brief Decodes an indexed replay, applying every action to a new table (and recording it if asked).
+ */
+std::unique_ptr<Table> decodeInto(const uint8_t* data, size_t size, ReplayRecorder* recorder) {
+    if (size < 3 || data[0] != MAGIC_0 || data[1] != MAGIC_1) {
+        throw std::runtime_error("Not an indexed replay.");
+    }
+    if (data[2] != INDEXED_REPLAY_VERSION) {
+        throw std::runtime_error("Unsupported indexed replay version.");
+    }
+    const uint8_t* p = data + 3;
+    const uint8_t* end = data + size;
+    uint64_t count;
+    uint64_t headerLength;
+    if (!getVarint(p, end, count) || !getVarint(p, end, headerLength) ||
+        headerLength > static_cast<size_t>(end - p)) {
+        throw std::runtime_error("Truncated indexed replay.");
+    }
+    ReplayReader reader(p, headerLength);
+    ReplayHeader header = reader.header();
+    p += headerLength;
+
+    auto table = std::make_unique<Table>(header.names, header.roles);
+    if (recorder) {
+        recorder->reset(header);
+    }
+    Game& game = table->getGame();
+    auto models = std::make_unique<Models>();
+    RangeDecoder decoder(p, end);
+    Action legal[MAX_LEGAL_ACTIONS];
+
+    for (uint64_t i = 0; i < count; ++i) {
+        const size_t n = legalActions(game, legal);
+        size_t symbol = models->forCount(n).decode(decoder, n);
+        Action action;
+        if (symbol == ESCAPE) {
+            action.kind = static_cast<ActionKind>(models->kind.decode(decoder, NUM_ACTION_KINDS));
+            action.target = static_cast<uint8_t>(models->target.decode(decoder, 8));
+            action.actor = static_cast<uint8_t>(models->actor.decode(decoder, MAX_PLAYERS));
+            if (static_cast<size_t>(action.kind) >= NUM_ACTION_KINDS || action.target >= 8 ||
+                action.actor >= MAX_PLAYERS) {
+                throw std::runtime_error("Corrupted indexed replay.");
+            }
+        } else {
+            action = legal[symbol];
+        }
+        if (recorder) {
+            recorder->apply(game, action);
+        } else {
+            applyAction(game, action);
+        }
+    }
+    return table;
+}
+
+} // namespace
+
+/**
+ * @brief Converts a plain binary replay to the legal-move-indexed format.
+ *
+ * @param replay Pointer to the plain replay bytes.
+ * @param size Number of bytes.
+ * @return std::vector<uint8_t> The indexed replay.
+ * @throws std::runtime_error if the replay is malformed or an action breaks a rule.
+ */
+std::vector<uint8_t> encodeIndexedReplay(const uint8_t* replay, size_t size) {
+    ReplayReader reader(replay, size);
+    ActionRecord record;
+    uint64_t count = 0;
+    while (reader.next(record)) {
+        count++;
+    }
+    reader.rewind();
+
+    std::vector<uint8_t> out;
+    out.reserve(32 + size / 2);
+    out.push_back(MAGIC_0);
+    out.push_back(MAGIC_1);
+    out.push_back(INDEXED_REPLAY_VERSION);
+    putVarint(out, count);
+    const size_t headerLength = plainHeaderLength(reader);
+    putVarint(out, headerLength);
+    out.insert(out.end(), replay, replay + headerLength);
+
+    ReplayHeader header = reader.header();
+    Table table(header.names, header.roles);
+    Game& game = table.getGame();
+    auto models = std::make_unique<Models>();
+    RangeEncoder encoder(out);
+    Action legal[MAX_LEGAL_ACTIONS];
+
+    while (reader.next(record)) {
+        const Action action = record.resolve(game);
+        const size_t n = legalActions(game, legal);
+        size_t symbol = ESCAPE;
+        for (size_t i = 0; i < n; ++i) {
+            if (legal[i] == action) {
+                symbol = i;
+                break;
+            }
+        }
+        models->forCount(n).encode(encoder, symbol, n);
+        if (symbol == ESCAPE) {
+            models->kind.encode(encoder, static_cast<size_t>(action.kind), NUM_ACTION_KINDS);
+            models->target.encode(encoder, action.target, 8);
+            models->actor.encode(encoder, action.actor, MAX_PLAYERS);
+        }
+        applyAction(game, action);
+    }
+    encoder.finish();
+    return out;
+}
+
+/**
+ * @brief Converts a legal-move-indexed replay back to the plain binary replay.
+ *
+ * @param data Pointer to the indexed replay bytes.
+ * @param size Number of bytes.
+ * @return std::vector<uint8_t> The plain replay, identical to the one that was encoded.
+ * @throws std::runtime_error if the data is malformed.
+ */
+std::vector<uint8_t> decodeIndexedReplay(const uint8_t* data, size_t size) {
+    ReplayRecorder recorder(ReplayHeader{0, {"P1", "P2"}, {Role::Spy, Role::Judge}});
+    decodeInto(data, size, &recorder);
+    return recorder.bytes();
+}
+
+/**
+ * @brief Reconstructs a game from a legal-move-indexed replay.
+ *
+ * @param data Pointer to the indexed replay bytes.
+ * @param size Number of bytes.
+ * @return std::unique_ptr<Table> The table in its final state.
+ * @throws std::runtime_error if the data is malformed.
+ */
+std::unique_ptr<Table> replayIndexedGame(const uint8_t* data, size_t size) {
+    return decodeInto(data, size, nullptr);
+}
+
+} // namespace coup
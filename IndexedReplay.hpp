@@ -0,0 +1,59 @@
+// email: shiraba01@gmail.com
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Table.hpp"
+
+namespace coup {
+
+/**
+ * Legal-move-indexed replay format (an alternative to the plain binary replay):
+ *
+ *   'C' 'I' version   varint action count   varint header length   plain replay header
+ *   arithmetic-coded actions
+ *
+ * Both sides regenerate legalActions() before every action, so an action is
+ * coded as its index in that list with an adaptive model chosen by the list
+ * length. A position with a single legal move (for example the forced coup
+ * at 10 coins) costs almost nothing. Actions the generator does not list are
+ * coded as an escape symbol followed by the action itself, so every plain
+ * replay can be converted.
+ */
+constexpr uint8_t INDEXED_REPLAY_VERSION = 1;
+
+/**
+ * @brief Converts a plain binary replay to the legal-move-indexed format.
+ *
+ * The game is replayed while encoding, so the cost is about one replay.
+ *
+ * @param replay Pointer to the plain replay bytes.
+ * @param size Number of bytes.
+ * @return std::vector<uint8_t> The indexed replay.
+ * @throws std::runtime_error if the replay is malformed or an action breaks a rule.
+ */
+std::vector<uint8_t> encodeIndexedReplay(const uint8_t* replay, size_t size);
+
+/**
+ * @brief Converts a legal-move-indexed replay back to the plain binary replay (byte for byte).
+ *
+ * @param data Pointer to the indexed replay bytes.
+ * @param size Number of bytes.
+ * @return std::vector<uint8_t> The plain replay.
+ * @throws std::runtime_error if the data is malformed.
+ */
+std::vector<uint8_t> decodeIndexedReplay(const uint8_t* data, size_t size);
+
+/**
+ * @brief Reconstructs a game from a legal-move-indexed replay.
+ *
+ * @param data Pointer to the indexed replay bytes.
+ * @param size Number of bytes.
+ * @return std::unique_ptr<Table> The table in its final state.
+ * @throws std::runtime_error if the data is malformed.
+ */
+std::unique_ptr<Table> replayIndexedGame(const uint8_t* data, size_t size);
+
+} // namespace coup
@@ -0,0 +1,90 @@
+// email: shiraba01@gmail.com
+#include "LatencyHistogram.hpp"
+
+#include <algorithm>
+
+namespace coup {
+
+namespace {
+
+// Values below this get one bucket each
+constexpr uint64_t LINEAR_LIMIT = 16;
+
+} // namespace
+
+/**
+ * @brief Returns the bucket of a value: its top 4 bits select one of 8 buckets per power of two.
+ */
+size_t LatencyHistogram::bucketOf(uint64_t micros) {
+    if (micros < LINEAR_LIMIT) {
+        return static_cast<size_t>(micros);
+    }
+    const unsigned msb = 63 - static_cast<unsigned>(__builtin_clzll(micros));
+    const size_t bucket = (msb - 3) * 8 + static_cast<size_t>(micros >> (msb - 3));
+    return std::min(bucket, NUM_BUCKETS - 1);
+}
+
+/**
+ * @brief Returns the lowest value of a bucket.
+ */
+uint64_t LatencyHistogram::bucketLow(size_t bucket) {
+    if (bucket < LINEAR_LIMIT) {
+        return bucket;
+    }
+    const unsigned shift = static_cast<unsigned>(bucket / 8 - 1);
+    return static_cast<uint64_t>(bucket % 8 + 8) << shift;
+}
+
+/**
+ * @brief Returns the lowest value above a bucket.
+ */
+uint64_t LatencyHistogram::bucketHigh(size_t bucket) {
+    return bucket + 1 < NUM_BUCKETS ? bucketLow(bucket + 1) : UINT64_MAX;
+}
+
+/**
+ * @brief Counts one latency.
+ *
+ * @param micros The latency in microseconds.
+ */
+void LatencyHistogram::record(uint64_t micros) {
+    counts[bucketOf(micros)]++;
+    samples++;
+    sum += micros;
+    largest = std::max(largest, micros);
+}
+
+/**
+ * @brief Adds the counts of another histogram.
+ */
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (size_t bucket = 0; bucket < NUM_BUCKETS; ++bucket) {
+        counts[bucket] += other.counts[bucket];
+    }
+    samples += other.samples;
+    sum += other.sum;
+    largest = std::max(largest, other.largest);
+}
+
+/**
+ * @brief Returns an upper bound of the latency below which a fraction p of the samples fall.
+ *
+ * @param p Fraction in [0, 1].
+ * @return uint64_t Upper bound of the bucket holding that sample (0 if empty), at most max().
+ */
+uint64_t LatencyHistogram::percentile(double p) const {
+    if (samples == 0) {
+        return 0;
+    }
+    const uint64_t rank = std::min(samples - 1, static_cast<uint64_t>(p * static_cast<double>(samples)));
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < NUM_BUCKETS; ++bucket) {
+        seen += counts[bucket];
+        if (seen > rank) {
+            return std::min(largest, bucketHigh(bucket) - 1);
+        }
+    }
+    return largest;
+}
+
+} // namespace coup
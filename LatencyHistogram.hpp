@@ -0,0 +1,57 @@
+// email: shiraba01@gmail.com
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace coup {
+
+/**
+ * @brief Histogram of latencies in microseconds with log-linear buckets.
+ *
+ * Values below 16 get a bucket each; above, every power of two is split into
+ * 8 buckets, so a bucket is at most 12.5% wide and percentiles are read
+ * within that precision. Recording is a few instructions and the histogram
+ * is a fixed array, so one can sit in every thread and be merged at the end.
+ */
+class LatencyHistogram {
+public:
+    static constexpr size_t NUM_BUCKETS = 320;
+
+    /**
+     * @brief Counts one latency.
+     */
+    void record(uint64_t micros);
+
+    /**
+     * @brief Adds the counts of another histogram.
+     */
+    void merge(const LatencyHistogram& other);
+
+    /**
+     * @brief Returns an upper bound of the latency below which a fraction p of the samples fall.
+     *
+     * @param p Fraction in [0, 1].
+     * @return uint64_t Upper bound of the bucket holding that sample (0 if empty), at most max().
+     */
+    uint64_t percentile(double p) const;
+
+    uint64_t count() const { return samples; }
+    uint64_t max() const { return largest; }
+    double mean() const { return samples ? static_cast<double>(sum) / samples : 0; }
+
+    // Samples in bucket i, which holds the values in [bucketLow(i), bucketHigh(i))
+    uint64_t at(size_t bucket) const { return counts[bucket]; }
+    static uint64_t bucketLow(size_t bucket);
+    static uint64_t bucketHigh(size_t bucket);
+
+private:
+    static size_t bucketOf(uint64_t micros);
+
+    std::array<uint64_t, NUM_BUCKETS> counts{};
+    uint64_t samples = 0;
+    uint64_t sum = 0;
+    uint64_t largest = 0;
+};
+
+} // namespace coup
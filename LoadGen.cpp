@@ -0,0 +1,601 @@
+// email: shiraba01@gmail.com
+#include "LoadGen.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "Table.hpp"
+
+namespace coup {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t MIN_TABLE = 2;
+
+double parseMs(std::string_view text) {
+    double value = 0;
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (ec != std::errc() || end != text.data() + text.size() || value < 0) {
+        throw std::invalid_argument("Invalid think time: " + std::string(text));
+    }
+    return value;
+}
+
+// Uniform double in [0, 1)
+double unit(SplitMix64& rng) {
+    return static_cast<double>(rng.next() >> 11) * 0x1.0p-53;
+}
+
+int openConnection(const LoadOptions& options) {
+    const bool local = !options.unixPath.empty();
+    const int fd = ::socket(local ? AF_UNIX : AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot create a socket.");
+    }
+    int result;
+    if (local) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        std::strncpy(address.sun_path, options.unixPath.c_str(), sizeof(address.sun_path) - 1);
+        result = ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    } else {
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(options.port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        result = ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        const int yes = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+    }
+    if (result != 0) {
+        ::close(fd);
+        throw std::runtime_error("Cannot connect to the server.");
+    }
+    return fd;
+}
+
+struct Group;
+
+// One connection: a player seat when it belongs to a table
+struct Member {
+    enum class Expect : uint8_t { Create, Join, Act, Leave };
+
+    struct Request {
+        Expect expect;
+        Clock::time_point sent;
+    };
+
+    int fd = -1;
+    std::string in;
+    Group* group = nullptr;
+    std::deque<Request> requests;     // Commands sent and not answered yet, in order
+};
+
+// A table being assembled, played or left
+struct Group {
+    uint32_t table = 0;
+    std::vector<Member*> members;
+    std::vector<Member*> bySeat;
+    std::vector<Role> roles;
+    size_t joined = 0;
+    size_t left = 0;
+    bool leaving = false;             // Answers to joins and actions are ignored from now on
+    bool greedy = false;
+    std::unique_ptr<Table> game;
+    SplitMix64 rng{0};
+    size_t plies = 0;
+    Action pending;
+    Clock::time_point created;
+};
+
+// An action waiting for the think time of its bot
+struct Timer {
+    Clock::time_point due;
+    Group* group;
+
+    bool operator>(const Timer& other) const { return due > other.due; }
+};
+
+/**
+ * @brief One event loop of a load run, with its share of the connections.
+ */
+class Worker {
+public:
+    Worker(const LoadOptions& options, size_t connections, uint64_t seed) : options(options), rng(seed) {
+        for (const double weight : options.playerMix) totalWeight += weight;
+        members.resize(connections);
+        epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+        if (epollFd < 0) {
+            throw std::runtime_error("Cannot create the epoll instance.");
+        }
+    }
+
+    ~Worker() {
+        for (Member& member : members) {
+            if (member.fd >= 0) ::close(member.fd);
+        }
+        ::close(epollFd);
+    }
+
+    Worker(const Worker&) = delete;
+    Worker& operator=(const Worker&) = delete;
+
+    void connect() {
+        for (Member& member : members) {
+            member.fd = openConnection(options);
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.ptr = &member;
+            ::epoll_ctl(epollFd, EPOLL_CTL_ADD, member.fd, &event);
+            idle.push_back(&member);
+        }
+    }
+
+    void run(Clock::time_point deadline, const std::atomic<bool>* stop, std::atomic<uint64_t>& finished) {
+        nextSize = drawSize();
+        formTables();
+        epoll_event events[256];
+        char buffer[1 << 14];
+        while (Clock::now() < deadline && !(stop && stop->load()) &&
+               !(options.gamesLimit && finished.load(std::memory_order_relaxed) >= options.gamesLimit)) {
+            int timeoutMs = 10;
+            if (!timers.empty()) {
+                const auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(timers.top().due - Clock::now());
+                timeoutMs = static_cast<int>(std::clamp<int64_t>(wait.count(), 0, timeoutMs));
+            }
+            const int ready = ::epoll_wait(epollFd, events, 256, timeoutMs);
+            if (ready < 0 && errno != EINTR) {
+                throw std::runtime_error("epoll_wait failed.");
+            }
+            for (int i = 0; i < ready; ++i) {
+                Member& member = *static_cast<Member*>(events[i].data.ptr);
+                const ssize_t received = ::recv(member.fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+                if (received == 0 || (received < 0 && errno != EAGAIN && errno != EINTR)) {
+                    throw std::runtime_error("The server closed a connection.");
+                }
+                if (received < 0) continue;
+                member.in.append(buffer, static_cast<size_t>(received));
+                size_t begin = 0;
+                for (size_t end; (end = member.in.find('\n', begin)) != std::string::npos; begin = end + 1) {
+                    onReply(member, std::string_view(member.in).substr(begin, end - begin), finished);
+                }
+                member.in.erase(0, begin);
+            }
+            const auto now = Clock::now();
+            while (!timers.empty() && timers.top().due <= now) {
+                Group* group = timers.top().group;
+                timers.pop();
+                sendAction(*group);
+            }
+            formTables();
+        }
+        report.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    LoadReport report;
+    Clock::time_point start = Clock::now();
+
+private:
+    size_t drawSize() {
+        double pick = unit(rng) * totalWeight;
+        size_t size = MIN_TABLE;
+        for (size_t i = 0; i < options.playerMix.size(); ++i) {
+            if (options.playerMix[i] <= 0) continue;
+            size = MIN_TABLE + i;
+            if ((pick -= options.playerMix[i]) < 0) break;
+        }
+        return size;
+    }
+
+    void send(Member& member, Member::Expect expect, const std::string& line) {
+        member.requests.push_back(Member::Request{expect, Clock::now()});
+        for (size_t at = 0; at < line.size();) {
+            const ssize_t sent = ::send(member.fd, line.data() + at, line.size() - at, MSG_NOSIGNAL);
+            if (sent < 0 && errno == EINTR) continue;
+            if (sent <= 0) {
+                throw std::runtime_error("The server closed a connection.");
+            }
+            at += static_cast<size_t>(sent);
+        }
+    }
+
+    // Groups idle connections into new tables while there are enough of them
+    void formTables() {
+        while (idle.size() >= nextSize) {
+            std::unique_ptr<Group> group = std::make_unique<Group>();
+            group->rng = SplitMix64(rng.next());
+            group->greedy = options.policy == BotPolicy::Greedy || (options.policy == BotPolicy::Mixed && rng.below(2));
+            group->members.assign(idle.end() - static_cast<std::ptrdiff_t>(nextSize), idle.end());
+            idle.resize(idle.size() - nextSize);
+            group->bySeat.resize(nextSize);
+            group->roles.resize(nextSize);
+            group->created = Clock::now();
+            for (Member* member : group->members) member->group = group.get();
+            send(*group->members[0], Member::Expect::Create,
+                 "CREATE " + std::to_string(nextSize) + ' ' + std::to_string((group->rng.next() >> 1) | 1) + '\n');
+            groups.push_back(std::move(group));
+            nextSize = drawSize();
+        }
+    }
+
+    void onReply(Member& member, std::string_view line, std::atomic<uint64_t>& finished) {
+        if (member.requests.empty() || !member.group) {
+            return;
+        }
+        const Member::Request request = member.requests.front();
+        member.requests.pop_front();
+        Group& group = *member.group;
+        const bool ok = line.compare(0, 2, "OK") == 0;
+        if (!ok && request.expect == Member::Expect::Create && line.find("overloaded") != std::string_view::npos) {
+            report.refused++;
+        } else if (!ok) {
+            report.errors++;
+        }
+        if (group.leaving && request.expect != Member::Expect::Leave) {
+            return;
+        }
+        switch (request.expect) {
+            case Member::Expect::Create:
+                if (!ok) {
+                    drop(group);
+                    return;
+                }
+                group.table = static_cast<uint32_t>(std::strtoul(std::string(line.substr(3)).c_str(), nullptr, 10));
+                for (size_t i = 0; i < group.members.size(); ++i) {
+                    send(*group.members[i], Member::Expect::Join,
+                         "JOIN " + std::to_string(group.table) + " P" + std::to_string(i) + '\n');
+                }
+                break;
+            case Member::Expect::Join: {
+                if (!ok) {
+                    leaveAll(group);
+                    return;
+                }
+                // "OK <seat> <role>"
+                const std::string reply(line);
+                const size_t seat = std::strtoul(reply.c_str() + 3, nullptr, 10);
+                group.bySeat[seat] = &member;
+                group.roles[seat] = parseRole(reply.substr(reply.rfind(' ') + 1));
+                if (++group.joined < group.members.size()) {
+                    return;
+                }
+                report.setupLatency.record(static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - group.created).count()));
+                std::vector<std::string> names;
+                for (size_t i = 0; i < group.roles.size(); ++i) names.push_back("P" + std::to_string(i));
+                group.game = std::make_unique<Table>(names, group.roles);
+                next(group, finished);
+                break;
+            }
+            case Member::Expect::Act:
+                report.actLatency.record(static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - request.sent).count()));
+                if (!ok) {
+                    leaveAll(group);
+                    return;
+                }
+                applyAction(group.game->getGame(), group.pending);
+                group.plies++;
+                report.actions++;
+                next(group, finished);
+                break;
+            case Member::Expect::Leave:
+                member.group = nullptr;
+                idle.push_back(&member);
+                if (++group.left == group.members.size()) drop(group);
+                break;
+        }
+    }
+
+    // Schedules the next action of a table, or leaves it once the game is over
+    void next(Group& group, std::atomic<uint64_t>& finished) {
+        Game& game = group.game->getGame();
+        const bool chosen = group.plies < options.maxPlies && captureOutcome(game, group.plies).winner == NO_SEAT &&
+                            (group.greedy ? chooseGreedyAction(game, group.rng, group.pending)
+                                          : chooseBotAction(game, group.rng, group.pending));
+        if (!chosen) {
+            report.games++;
+            report.gamesBySize[group.members.size() - MIN_TABLE]++;
+            finished.fetch_add(1, std::memory_order_relaxed);
+            leaveAll(group);
+            return;
+        }
+        const uint64_t think = options.think.sample(group.rng);
+        if (think == 0) {
+            sendAction(group);
+            return;
+        }
+        timers.push(Timer{Clock::now() + std::chrono::microseconds(think), &group});
+    }
+
+    void sendAction(Group& group) {
+        const Action& action = group.pending;
+        std::string line = "ACT " + std::to_string(group.table) + ' ' + std::to_string(action.actor) + ' ' +
+                           actionName(action.kind);
+        if (actionHasTarget(action.kind)) line += ' ' + std::to_string(action.target);
+        line += '\n';
+        send(*group.bySeat[action.actor], Member::Expect::Act, line);
+    }
+
+    void leaveAll(Group& group) {
+        group.leaving = true;
+        for (Member* member : group.members) {
+            send(*member, Member::Expect::Leave, "LEAVE " + std::to_string(group.table) + '\n');
+        }
+    }
+
+    // Frees a table whose members are all idle again (or were never seated)
+    void drop(Group& group) {
+        for (Member* member : group.members) {
+            if (member->group == &group) {
+                member->group = nullptr;
+                idle.push_back(member);
+            }
+        }
+        auto it = std::find_if(groups.begin(), groups.end(),
+                               [&](const std::unique_ptr<Group>& entry) { return entry.get() == &group; });
+        std::swap(*it, groups.back());
+        groups.pop_back();
+    }
+
+    const LoadOptions& options;
+    SplitMix64 rng;
+    double totalWeight = 0;
+    size_t nextSize = MIN_TABLE;
+    int epollFd = -1;
+    std::vector<Member> members;
+    std::vector<Member*> idle;
+    std::vector<std::unique_ptr<Group>> groups;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+};
+
+} // namespace
+
+/**
+ * @brief Draws one think time.
+ *
+ * @param rng The bot's random generator.
+ * @return uint64_t The think time in microseconds.
+ */
+uint64_t ThinkTime::sample(SplitMix64& rng) const {
+    double ms = 0;
+    switch (kind) {
+        case Kind::None:
+            return 0;
+        case Kind::Constant:
+            ms = meanMs;
+            break;
+        case Kind::Uniform:
+            ms = minMs + (maxMs - minMs) * unit(rng);
+            break;
+        case Kind::Exponential:
+            ms = std::min(maxMs, -meanMs * std::log1p(-unit(rng)));
+            break;
+    }
+    return static_cast<uint64_t>(ms * 1000);
+}
+
+/**
+ * @brief Parses a think time: "none", "const:<ms>", "uniform:<min>-<max>" or "exp:<mean>[:<max>]".
+ *
+ * @param text The think time.
+ * @return ThinkTime The distribution.
+ * @throws std::invalid_argument if the text is not one of these forms.
+ */
+ThinkTime parseThinkTime(const std::string& text) {
+    ThinkTime think;
+    const size_t colon = text.find(':');
+    const std::string kind = text.substr(0, colon);
+    const std::string_view value = colon == std::string::npos ? std::string_view() : std::string_view(text).substr(colon + 1);
+    if (kind == "none" && colon == std::string::npos) {
+        return think;
+    }
+    if (kind == "const" && colon != std::string::npos) {
+        think.kind = ThinkTime::Kind::Constant;
+        think.meanMs = think.minMs = think.maxMs = parseMs(value);
+    } else if (kind == "uniform" && value.find('-') != std::string_view::npos) {
+        think.kind = ThinkTime::Kind::Uniform;
+        think.minMs = parseMs(value.substr(0, value.find('-')));
+        think.maxMs = parseMs(value.substr(value.find('-') + 1));
+        if (think.maxMs < think.minMs) {
+            throw std::invalid_argument("Invalid think time: " + text);
+        }
+        think.meanMs = (think.minMs + think.maxMs) / 2;
+    } else if (kind == "exp" && colon != std::string::npos) {
+        think.kind = ThinkTime::Kind::Exponential;
+        const size_t cap = value.find(':');
+        think.meanMs = parseMs(value.substr(0, cap));
+        think.maxMs = cap == std::string_view::npos ? 20 * think.meanMs : parseMs(value.substr(cap + 1));
+    } else {
+        throw std::invalid_argument("Invalid think time: " + text);
+    }
+    return think;
+}
+
+/**
+ * @brief Parses a bot policy name: "random", "greedy" or "mixed".
+ *
+ * @throws std::invalid_argument if the name is unknown.
+ */
+BotPolicy parseBotPolicy(const std::string& name) {
+    if (name == "random") return BotPolicy::Random;
+    if (name == "greedy") return BotPolicy::Greedy;
+    if (name == "mixed") return BotPolicy::Mixed;
+    throw std::invalid_argument("Unknown bot policy: " + name);
+}
+
+/**
+ * @brief Picks the greedy bot's action: the move of the current player that gains the most.
+ *
+ * A coup on the richest opponent comes first, then invest, tax, gather or
+ * arrest; reactions and blocks are never used.
+ *
+ * @param game The game.
+ * @param rng Breaks ties between equally good moves.
+ * @param action Receives the chosen action.
+ * @return true if an action was chosen, false if there is no legal action.
+ */
+bool chooseGreedyAction(const Game& game, SplitMix64& rng, Action& action) {
+    Action legal[MAX_LEGAL_ACTIONS];
+    const size_t count = legalActions(game, legal);
+    const size_t current = game.currentSeat();
+    int best = -1000;
+    size_t ties = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const Action& candidate = legal[i];
+        if (candidate.actor != current) {
+            continue;
+        }
+        int score = -1;
+        switch (candidate.kind) {
+            case ActionKind::Coup: score = 100 + game.coinsAt(candidate.target); break;
+            case ActionKind::Invest: score = 4; break;
+            case ActionKind::Tax: score = 3; break;
+            case ActionKind::Gather:
+            case ActionKind::Arrest: score = 1; break;
+            case ActionKind::Bribe:
+            case ActionKind::Sanction: score = 0; break;
+            default: break;
+        }
+        if (score > best) {
+            best = score;
+            ties = 0;
+        }
+        // Reservoir sampling among the best moves
+        if (score == best && rng.below(++ties) == 0) {
+            action = candidate;
+        }
+    }
+    if (ties > 0) {
+        return true;
+    }
+    return chooseBotAction(game, rng, action);     // Only reactions are legal
+}
+
+/**
+ * @brief Parses a mix of table sizes: "<players>:<weight>,..." (e.g. "2:3,4:1"), or a single size.
+ *
+ * @param text The mix.
+ * @return PlayerMix Weight of each size from 2 to 6.
+ * @throws std::invalid_argument if a size is outside 2-6, a weight is negative, or every weight is 0.
+ */
+PlayerMix parsePlayerMix(const std::string& text) {
+    PlayerMix mix{};
+    std::string_view rest = text;
+    double total = 0;
+    while (!rest.empty()) {
+        const size_t comma = rest.find(',');
+        const std::string_view entry = rest.substr(0, comma);
+        rest = comma == std::string_view::npos ? std::string_view() : rest.substr(comma + 1);
+        const size_t colon = entry.find(':');
+        const std::string_view sizeText = entry.substr(0, colon);
+        size_t size = 0;
+        auto [end, ec] = std::from_chars(sizeText.data(), sizeText.data() + sizeText.size(), size);
+        if (ec != std::errc() || end != sizeText.data() + sizeText.size() || size < MIN_TABLE || size >= MIN_TABLE + PlayerMix().size()) {
+            throw std::invalid_argument("Invalid table size in player mix: " + std::string(entry));
+        }
+        double weight = 1;
+        if (colon != std::string_view::npos) {
+            const std::string_view weightText = entry.substr(colon + 1);
+            auto [weightEnd, weightEc] = std::from_chars(weightText.data(), weightText.data() + weightText.size(), weight);
+            if (weightEc != std::errc() || weightEnd != weightText.data() + weightText.size() || weight < 0) {
+                throw std::invalid_argument("Invalid weight in player mix: " + std::string(entry));
+            }
+        }
+        mix[size - MIN_TABLE] += weight;
+        total += weight;
+    }
+    if (total <= 0) {
+        throw std::invalid_argument("The player mix has no table size.");
+    }
+    return mix;
+}
+
+/**
+ * @brief Plays complete games against a running server until the time or the game limit is reached.
+ *
+ * @param options The run.
+ * @param stop If not null, the run ends early once it is true.
+ * @return LoadReport Counters and latency histograms of all threads.
+ * @throws std::invalid_argument if there are fewer connections than the largest table of the mix.
+ * @throws std::runtime_error if a connection cannot be opened or the server closes one.
+ */
+LoadReport runLoad(const LoadOptions& options, const std::atomic<bool>* stop) {
+    const size_t threads = std::max<size_t>(1, options.threads);
+    size_t largest = 0;
+    for (size_t i = 0; i < options.playerMix.size(); ++i) {
+        if (options.playerMix[i] > 0) largest = MIN_TABLE + i;
+    }
+    if (largest == 0) {
+        throw std::invalid_argument("The player mix has no table size.");
+    }
+    if (options.connections / threads < largest) {
+        throw std::invalid_argument("Each thread needs at least as many connections as the largest table.");
+    }
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        const size_t share = options.connections / threads + (t < options.connections % threads ? 1 : 0);
+        workers.push_back(std::make_unique<Worker>(options, share, gameSeed(options.seed, t)));
+        workers.back()->connect();
+    }
+
+    const auto deadline =
+        Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.seconds));
+    std::atomic<uint64_t> finished{0};
+    std::vector<std::exception_ptr> errors(threads);
+    std::vector<std::thread> running;
+    for (size_t t = 0; t < threads; ++t) {
+        running.emplace_back([&, t] {
+            try {
+                workers[t]->start = Clock::now();
+                workers[t]->run(deadline, stop, finished);
+            } catch (...) {
+                errors[t] = std::current_exception();
+            }
+        });
+    }
+    for (std::thread& thread : running) {
+        thread.join();
+    }
+    for (const std::exception_ptr& error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+
+    LoadReport total;
+    for (const auto& worker : workers) {
+        const LoadReport& report = worker->report;
+        total.games += report.games;
+        total.actions += report.actions;
+        total.errors += report.errors;
+        total.refused += report.refused;
+        for (size_t i = 0; i < total.gamesBySize.size(); ++i) total.gamesBySize[i] += report.gamesBySize[i];
+        total.actLatency.merge(report.actLatency);
+        total.setupLatency.merge(report.setupLatency);
+        total.seconds = std::max(total.seconds, report.seconds);
+    }
+    return total;
+}
+
+} // namespace coup
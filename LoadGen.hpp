@@ -0,0 +1,133 @@
+// email: shiraba01@gmail.com
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "LatencyHistogram.hpp"
+#include "Simulator.hpp"
+
+namespace coup {
+
+/**
+ * @brief How long a bot thinks before sending its action.
+ */
+struct ThinkTime {
+    enum class Kind : uint8_t {
+        None,           // Act as soon as the previous action is answered
+        Constant,       // Always meanMs
+        Uniform,        // Uniform in [minMs, maxMs]
+        Exponential     // Exponential with mean meanMs, capped at maxMs
+    };
+
+    Kind kind = Kind::None;
+    double meanMs = 0;
+    double minMs = 0;
+    double maxMs = 0;
+
+    /**
+     * @brief Draws one think time.
+     *
+     * @return uint64_t The think time in microseconds.
+     */
+    uint64_t sample(SplitMix64& rng) const;
+};
+
+/**
+ * @brief Parses a think time: "none", "const:<ms>", "uniform:<min>-<max>" or "exp:<mean>[:<max>]".
+ *
+ * The exponential distribution is capped at 20 times its mean unless a maximum is given.
+ *
+ * @throws std::invalid_argument if the text is not one of these forms.
+ */
+ThinkTime parseThinkTime(const std::string& text);
+
+/**
+ * @brief How the bots of a table pick their actions.
+ */
+enum class BotPolicy : uint8_t {
+    Random,     // chooseBotAction(): random legal moves, reactions now and then
+    Greedy,     // The current player's richest move: a coup when affordable, else tax, invest...
+    Mixed       // Each table draws one of the two
+};
+
+/**
+ * @brief Parses a bot policy name: "random", "greedy" or "mixed".
+ *
+ * @throws std::invalid_argument if the name is unknown.
+ */
+BotPolicy parseBotPolicy(const std::string& name);
+
+/**
+ * @brief Picks the greedy bot's action: the move of the current player that gains the most.
+ *
+ * @param game The game.
+ * @param rng Breaks ties between equally good moves.
+ * @param action Receives the chosen action.
+ * @return true if an action was chosen, false if there is no legal action.
+ */
+bool chooseGreedyAction(const Game& game, SplitMix64& rng, Action& action);
+
+// Weight of each table size, from 2 to 6 players
+using PlayerMix = std::array<double, 5>;
+
+/**
+ * @brief Parses a mix of table sizes: "<players>:<weight>,..." (e.g. "2:3,4:1"), or a single size.
+ *
+ * @throws std::invalid_argument if a size is outside 2-6, a weight is negative, or every weight is 0.
+ */
+PlayerMix parsePlayerMix(const std::string& text);
+
+/**
+ * @brief Settings of a load run against a game server on this machine.
+ */
+struct LoadOptions {
+    uint16_t port = 7777;             // Server on 127.0.0.1:port...
+    std::string unixPath;             // ...or on this Unix socket when not empty
+    size_t connections = 1000;        // One per seat; a table takes as many as it has players
+    size_t threads = 1;               // Event loops sharing the connections
+    double seconds = 10;              // Length of the run
+    uint64_t gamesLimit = 0;          // Stop once this many games are finished (0 for no limit)
+    PlayerMix playerMix{1, 1, 1, 1, 1};
+    ThinkTime think;
+    BotPolicy policy = BotPolicy::Random;
+    size_t maxPlies = 1000;           // Games are abandoned after this many actions
+    uint64_t seed = 1;
+};
+
+/**
+ * @brief What a load run measured.
+ */
+struct LoadReport {
+    uint64_t games = 0;               // Games played to the end
+    uint64_t actions = 0;             // ACTs answered OK
+    uint64_t errors = 0;              // ERR answers
+    uint64_t refused = 0;             // CREATEs an overloaded server refused (not errors; the players wait for another table)
+    std::array<uint64_t, 5> gamesBySize{};
+    LatencyHistogram actLatency;      // ACT round trips (think time excluded)
+    LatencyHistogram setupLatency;    // From CREATE to the last JOIN answer of a table
+    double seconds = 0;
+};
+
+/**
+ * @brief Plays complete games against a running server until the time or the game limit is reached.
+ *
+ * Each thread opens its share of the connections and runs an epoll loop.
+ * Idle connections are grouped into tables whose size is drawn from the
+ * player mix: the first creates the table, every member joins it and plays
+ * its own seat. The loop keeps a copy of each game to choose legal actions
+ * with the bot policy and sends each action from the connection of its
+ * actor, after the think time. A finished game is left by all its members,
+ * which then wait for the next table.
+ *
+ * @param options The run.
+ * @param stop If not null, the run ends early once it is true.
+ * @return LoadReport Counters and latency histograms of all threads.
+ * @throws std::invalid_argument if there are fewer connections than the largest table of the mix.
+ * @throws std::runtime_error if a connection cannot be opened or the server closes one.
+ */
+LoadReport runLoad(const LoadOptions& options, const std::atomic<bool>* stop = nullptr);
+
+} // namespace coup
@@ -0,0 +1,102 @@
+// email: shiraba01@gmail.com
+#include "Matchmaker.hpp"
+
+#include <chrono>
+#include <stdexcept>
+#include <string>
+
+namespace coup {
+
+namespace {
+
+uint64_t steadyNs() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+} // namespace
+
+/**
+ * @brief Creates the queues.
+ *
+ * @param capacity Players that may wait for each table size (rounded up to a power of two).
+ * @throws std::invalid_argument if capacity is smaller than MAX_PLAYERS.
+ */
+Matchmaker::Matchmaker(size_t capacity) {
+    if (capacity < MAX_PLAYERS) {
+        throw std::invalid_argument("Matchmaker capacity must hold a full table.");
+    }
+    for (auto& queue : queues) {
+        queue = std::make_unique<MpmcQueue<MatchTicket>>(capacity);
+    }
+}
+
+/**
+ * @brief Queues a player for a table of the given size (any thread).
+ *
+ * @param tableSize Players of the table, MIN_TABLE_SIZE to MAX_PLAYERS.
+ * @param player Id of the player.
+ * @return false if the queue of that size is full.
+ * @throws std::invalid_argument if the table size is out of range.
+ */
+bool Matchmaker::enqueue(size_t tableSize, uint64_t player) {
+    MatchTicket ticket;
+    ticket.player = player;
+    ticket.enqueuedNs = steadyNs();
+    return queueFor(tableSize).push(std::move(ticket));
+}
+
+/**
+ * @brief Forms tables from the queued players, taking the sizes in turn (any thread).
+ *
+ * Each round tries one table of every size, so a busy size does not starve
+ * the others; the call ends when a round forms nothing or maxTables is
+ * reached. The clock is read once per round for the waits.
+ *
+ * @param out Receives the new tables (appended).
+ * @param maxTables Most tables formed by this call.
+ * @param waits Receives the queue wait of every matched player, in microseconds.
+ * @return size_t Number of tables formed.
+ */
+size_t Matchmaker::assemble(std::vector<Match>& out, size_t maxTables, LatencyHistogram& waits) {
+    MatchTicket tickets[MAX_PLAYERS];
+    size_t formed = 0;
+    bool progress = true;
+    while (progress && formed < maxTables) {
+        progress = false;
+        const uint64_t now = steadyNs();
+        for (size_t size = MIN_TABLE_SIZE; size <= MAX_PLAYERS && formed < maxTables; ++size) {
+            if (!queues[size - MIN_TABLE_SIZE]->popBatch(tickets, size)) {
+                continue;
+            }
+            Match match;
+            match.numPlayers = static_cast<uint8_t>(size);
+            for (size_t seat = 0; seat < size; ++seat) {
+                match.players[seat] = tickets[seat].player;
+                waits.record(now > tickets[seat].enqueuedNs ? (now - tickets[seat].enqueuedNs) / 1000 : 0);
+            }
+            out.push_back(match);
+            formed++;
+            progress = true;
+        }
+    }
+    return formed;
+}
+
+/**
+ * @brief Returns the players waiting for a table size (approximate while other threads run).
+ *
+ * @throws std::invalid_argument if the table size is out of range.
+ */
+size_t Matchmaker::waiting(size_t tableSize) const {
+    return queueFor(tableSize).sizeApprox();
+}
+
+MpmcQueue<MatchTicket>& Matchmaker::queueFor(size_t tableSize) const {
+    if (tableSize < MIN_TABLE_SIZE || tableSize > MAX_PLAYERS) {
+        throw std::invalid_argument("Table size must be between 2 and 6, not " + std::to_string(tableSize) + ".");
+    }
+    return *queues[tableSize - MIN_TABLE_SIZE];
+}
+
+} // namespace coup
@@ -0,0 +1,87 @@
+// email: shiraba01@gmail.com
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Game.hpp"
+#include "LatencyHistogram.hpp"
+#include "MpmcQueue.hpp"
+
+namespace coup {
+
+// Smallest table the matchmaker assembles (the largest is MAX_PLAYERS)
+constexpr size_t MIN_TABLE_SIZE = 2;
+
+/**
+ * @brief A player waiting in a Matchmaker queue.
+ */
+struct MatchTicket {
+    uint64_t player = 0;
+    uint64_t enqueuedNs = 0;          // Steady clock when the player was enqueued
+};
+
+/**
+ * @brief Players the matchmaker put at one new table, in queue order.
+ */
+struct Match {
+    uint8_t numPlayers = 0;
+    uint64_t players[MAX_PLAYERS] = {};
+};
+
+/**
+ * @brief Lock-free matchmaking: players queue for a table size and leave in full tables.
+ *
+ * One MpmcQueue per table size (MIN_TABLE_SIZE to MAX_PLAYERS). Any
+ * thread may enqueue, and any thread may assemble: each table is one
+ * popBatch() of exactly its size, so players are never split between
+ * consumers and a table is formed as soon as its last player is queued.
+ * The time every player waited goes to the caller's LatencyHistogram, one
+ * per thread, to be merged at the end.
+ */
+class Matchmaker {
+public:
+    /**
+     * @brief Creates the queues.
+     *
+     * @param capacity Players that may wait for each table size (rounded up to a power of two).
+     * @throws std::invalid_argument if capacity is smaller than MAX_PLAYERS.
+     */
+    explicit Matchmaker(size_t capacity = 1 << 16);
+
+    /**
+     * @brief Queues a player for a table of the given size (any thread).
+     *
+     * @param tableSize Players of the table, MIN_TABLE_SIZE to MAX_PLAYERS.
+     * @param player Id of the player.
+     * @return false if the queue of that size is full.
+     * @throws std::invalid_argument if the table size is out of range.
+     */
+    bool enqueue(size_t tableSize, uint64_t player);
+
+    /**
+     * @brief Forms tables from the queued players, taking the sizes in turn (any thread).
+     *
+     * @param out Receives the new tables (appended).
+     * @param maxTables Most tables formed by this call.
+     * @param waits Receives the queue wait of every matched player, in microseconds.
+     * @return size_t Number of tables formed.
+     */
+    size_t assemble(std::vector<Match>& out, size_t maxTables, LatencyHistogram& waits);
+
+    /**
+     * @brief Returns the players waiting for a table size (approximate while other threads run).
+     *
+     * @throws std::invalid_argument if the table size is out of range.
+     */
+    size_t waiting(size_t tableSize) const;
+
+private:
+    MpmcQueue<MatchTicket>& queueFor(size_t tableSize) const;
+
+    std::array<std::unique_ptr<MpmcQueue<MatchTicket>>, MAX_PLAYERS - MIN_TABLE_SIZE + 1> queues;
+};
+
+} // namespace coup
@@ -0,0 +1,132 @@
+// email: shiraba01@gmail.com
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace coup {
+
+/**
+ * @brief Bounded lock-free queue for any number of producer and consumer threads.
+ *
+ * A ring of preallocated slots, each with a sequence number telling whose
+ * turn the slot is: a producer may fill slot i when its sequence is i, a
+ * consumer may empty it when it is i + 1, after which it becomes i +
+ * capacity for the producer of the next lap. Producers claim positions with
+ * a compare-and-swap on tail, consumers on head, so a thread stalled in the
+ * middle of an operation only delays the slot it claimed.
+ *
+ * popBatch() claims several consecutive positions with one compare-and-swap,
+ * and only when all of them are filled, so a consumer never holds a partial
+ * batch that it would have to put back.
+ */
+template <typename T>
+class MpmcQueue {
+public:
+    /**
+     * @brief Creates a queue holding at least capacity elements (rounded up to a power of two).
+     */
+    explicit MpmcQueue(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        slots = std::make_unique<Slot[]>(size);
+        for (size_t i = 0; i < size; ++i) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        mask = size - 1;
+    }
+
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+    /**
+     * @brief Moves a value into the queue (any thread).
+     *
+     * @return false if the queue is full; the value is then left untouched.
+     */
+    bool push(T&& value) {
+        size_t position = tail.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = slots[position & mask];
+            const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            if (sequence == position) {
+                if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    slot.value = std::move(value);
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (sequence < position) {
+                return false;                       // Not emptied since the last lap: full
+            } else {
+                position = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @brief Moves the oldest value out of the queue (any thread).
+     *
+     * @return false if the queue is empty.
+     */
+    bool pop(T& value) {
+        return popBatch(&value, 1);
+    }
+
+    /**
+     * @brief Moves the count oldest values out of the queue, or none of them (any thread).
+     *
+     * @param out Receives the values, oldest first.
+     * @param count Values wanted, at most capacity().
+     * @return false if fewer than count values are ready; the queue is then left untouched.
+     */
+    bool popBatch(T* out, size_t count) {
+        size_t position = head.load(std::memory_order_relaxed);
+        for (;;) {
+            size_t ready = 0;
+            while (ready < count &&
+                   slots[(position + ready) & mask].sequence.load(std::memory_order_acquire) == position + ready + 1) {
+                ready++;
+            }
+            if (ready == count) {
+                // The slots stay filled until head passes them, so the check holds if the claim succeeds
+                if (head.compare_exchange_weak(position, position + count, std::memory_order_relaxed)) {
+                    for (size_t i = 0; i < count; ++i) {
+                        Slot& slot = slots[(position + i) & mask];
+                        out[i] = std::move(slot.value);
+                        slot.sequence.store(position + i + mask + 1, std::memory_order_release);
+                    }
+                    return true;
+                }
+                continue;                           // position was reloaded by the failed exchange
+            }
+            const size_t sequence = slots[(position + ready) & mask].sequence.load(std::memory_order_acquire);
+            if (sequence <= position + ready) {
+                return false;                       // Not filled yet: too few values
+            }
+            position = head.load(std::memory_order_relaxed);      // Another consumer took it
+        }
+    }
+
+    // Values in the queue, possibly stale by the time it returns
+    size_t sizeApprox() const {
+        const size_t h = head.load(std::memory_order_relaxed);
+        const size_t t = tail.load(std::memory_order_relaxed);
+        return t > h ? t - h : 0;
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence{0};
+        T value{};
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask = 0;
+    alignas(64) std::atomic<size_t> head{0};      // Next position to pop
+    alignas(64) std::atomic<size_t> tail{0};      // Next position to push
+};
+
+} // namespace coup
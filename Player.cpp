@@ -19,9 +19,7 @@ namespace coup {
  */
 
 Player::Player(Game& game, const std::string& name)
-    : name(name), coins(0), game(game) {
-   
-    game.add_player(this);
+    : game(game), seat(game.add_player(this)), name(name) {
 }
 
 /**
@@ -51,7 +49,7 @@ std::string Player::getRole() const {
  */
 
 int Player::getCoins() const {
-    return coins;
+    return game.coinsAt(seat);
 }
 
 /**
@@ -68,7 +66,7 @@ void Player::addCoins(int amount) {
      if (game.getBankCoins()  < amount) {
         throw std::invalid_argument("there are not enough coins in the bank.");
     }
-    coins += amount;
+    game.setCoinsAt(seat, getCoins() + amount);
     game.takeCoins(amount);
 
 }
@@ -87,7 +85,7 @@ void Player::onlyAddCoinsToPlayer(int amount) {
         throw std::invalid_argument("Cannot add negative amount of coins.");
     }
      
-    coins += amount;
+    game.setCoinsAt(seat, getCoins() + amount);
    
 }
 
@@ -103,10 +101,10 @@ void Player::onlyAddCoinsToPlayer(int amount) {
  */
 
 void Player::removeCoins(int amount) {
-    if (amount > coins) {
+    if (amount > getCoins()) {
         throw std::runtime_error("Not enough coins.");
     }
-    coins -= amount;
+    game.setCoinsAt(seat, getCoins() - amount);
     game.returnCoins(amount);
 }
 
@@ -121,10 +119,10 @@ void Player::removeCoins(int amount) {
  */
 
 void Player::onlyRemoveCoinsFromPlayer(int amount) {
-    if (amount > coins) {
+    if (amount > getCoins()) {
         throw std::runtime_error("Not enough coins.");
     }
-    coins -= amount;
+    game.setCoinsAt(seat, getCoins() - amount);
    
 }
 
@@ -150,10 +148,10 @@ void Player::gather() {
     if(game.turn() != getName()) {
         throw std::runtime_error("It's not " + getName() + "'s turn.");
     }
-    if (coins >= 10) {
+    if (getCoins() >= 10) {
         throw std::runtime_error(getName() + " has 10 or more coins and must perform a coup.");
     }
-     if (is_sanctioned == true) {
+     if (isSanctioned()) {
         throw std::runtime_error(getName() + " has been sanctioned and therefore can't use the gather action.");
     }
     addCoins(1);
@@ -185,10 +183,10 @@ void Player::tax() {
     if(game.turn() != getName()) {
         throw std::runtime_error("It's not " + getName() + "'s turn.");
     }
-    if (coins >= 10) {
+    if (getCoins() >= 10) {
         throw std::runtime_error(getName() + " has 10 or more coins and must perform a coup.");
     }
-    if (is_sanctioned == true) {
+    if (isSanctioned()) {
         throw std::runtime_error(getName() + " has been sanctioned and therefore can't use the tax action.");
     }
      int cost = (getRole() == "Governor") ? 3 : 2;
@@ -223,10 +221,10 @@ void Player::bribe() {
     if(game.turn() != getName()) {
         throw std::runtime_error("It's not " + getName() + "'s turn.");
     }
-    if (coins >= 10) {
+    if (getCoins() >= 10) {
         throw std::runtime_error(getName() + " has 10 or more coins and must perform a coup.");
     }
-    if (coins < 4) {
+    if (getCoins() < 4) {
         throw std::runtime_error("Not enough coins to bribe.");
     }
     removeCoins(4);
@@ -265,13 +263,13 @@ void Player::arrest(Player& target) {
     if(game.turn() != getName()) {
         throw std::runtime_error("It's not " + getName() + "'s turn.");
     }
-    if (coins >= 10) {
+    if (getCoins() >= 10) {
         throw std::runtime_error(getName() + " has 10 or more coins and must perform a coup.");
     }
     if (&target == this) {
         throw std::runtime_error("Cannot arrest yourself.");
     }
-    if (last_arrested == &target) {
+    if (game.lastArrestedAt(seat) == static_cast<int>(target.seat)) {
         throw std::runtime_error("Cannot arrest the same player twice in a row.");
     }
     if (!target.isAlive()) {
@@ -301,7 +299,7 @@ void Player::arrest(Player& target) {
             }
 
       }
-    last_arrested = &target;
+    game.setLastArrestedAt(seat, static_cast<int>(target.seat));
     setLastAction("arrest");
     
     game.advanceTurn();
@@ -338,7 +336,7 @@ void Player::sanction(Player& target) {
     if(game.turn() != getName()) {
         throw std::runtime_error("It's not " + getName() + "'s turn.");
     }
-    if (coins >= 10) {
+    if (getCoins() >= 10) {
         throw std::runtime_error(getName() + " has 10 or more coins and must perform a coup.");
     }
   
@@ -349,7 +347,7 @@ void Player::sanction(Player& target) {
         throw std::runtime_error("Cannot sanction an eliminated player.");
     }
      int cost = (target.getRole() == "Judge") ? 4 : 3;
-     if (coins < cost) {
+     if (getCoins() < cost) {
         throw std::runtime_error("Not enough coins to apply sanction.");
     }
 
@@ -392,7 +390,7 @@ void Player::coup(Player& target) {
     if (!target.isAlive()) {
         throw std::runtime_error("Target already eliminated.");
     }
-    if (coins < 7) {
+    if (getCoins() < 7) {
         throw std::runtime_error("Not enough coins to perform a coup.");
     }
     removeCoins(7);
@@ -411,7 +409,7 @@ void Player::coup(Player& target) {
  * @return true if the player has not been eliminated; false otherwise.
  */
 bool Player::isAlive() const {
-    return alive;
+    return game.hasFlag(seat, FLAG_ALIVE);
 }
 
 /**
@@ -420,7 +418,7 @@ bool Player::isAlive() const {
  * Sets the player's alive status to false, indicating they are no longer active in the game.
  */
 void Player::eliminate() {
-    alive = false;
+    game.setFlag(seat, FLAG_ALIVE, false);
 }
 
 /**
@@ -429,7 +427,7 @@ void Player::eliminate() {
  * Sets the player's alive status to true, indicating they are active again in the game.
  */
 void Player::enliven() {
-    alive = false;
+    game.setFlag(seat, FLAG_ALIVE, false);
 }
 
 /**
@@ -440,7 +438,7 @@ void Player::enliven() {
  * @return true if the player is sanctioned, false otherwise.
  */
 bool Player::isSanctioned() const {
-    return is_sanctioned;
+    return game.hasFlag(seat, FLAG_SANCTIONED);
 }
 
 /**
@@ -452,10 +450,69 @@ bool Player::isSanctioned() const {
  * @param value True to apply sanction, false to remove it.
  */
 void Player::setSanction(bool value) {
-    is_sanctioned = value;
+    game.setFlag(seat, FLAG_SANCTIONED, value);
+}
+
+/**
+ * @brief Checks whether the player has an extra turn that was not used yet.
+ *
+ * @return true if an extra turn is pending, false otherwise.
+ */
+bool Player::hasPendingExtraTurn() const {
+    return game.hasFlag(seat, FLAG_EXTRA_TURN);
+}
+
+/**
+ * @brief Grants the player an extra turn (used by bribe and by the Spy).
+ */
+void Player::grantExtraTurn() {
+    game.setFlag(seat, FLAG_EXTRA_TURN, true);
+}
+
+/**
+ * @brief Consumes the player's pending extra turn.
+ */
+void Player::useExtraTurn() {
+    game.setFlag(seat, FLAG_EXTRA_TURN, false);
+}
+
+/**
+ * @brief Disables the player's ability to use arrest (used by Spy).
+ */
+void Player::disableArrest() {
+    game.setFlag(seat, FLAG_ARREST_ENABLED, false);
 }
 
+/**
+ * @brief Enables the player's ability to use arrest (used at the start of their turn).
+ */
+void Player::enableArrest() {
+    game.setFlag(seat, FLAG_ARREST_ENABLED, true);
+}
 
+/**
+ * @brief Checks whether the player is currently allowed to use arrest.
+ *
+ * @return true if arrest is enabled, false otherwise.
+ */
+bool Player::isArrestEnabled() const {
+    return game.hasFlag(seat, FLAG_ARREST_ENABLED);
+}
 
+/**
+ * @brief Reports the memory used by this player.
+ *
+ * Counts the Player object itself (roles add no data members) and the heap
+ * blocks owned by the name, role and lastAction strings. The hot state of the
+ * player is stored in the Game and is counted there.
+ *
+ * @return MemoryFootprint Object and heap bytes of the player.
+ */
+MemoryFootprint Player::memoryFootprint() const {
+    MemoryFootprint fp;
+    fp.objectBytes = sizeof(Player);
+    fp.heapBytes = stringHeapBytes(name) + stringHeapBytes(role) + stringHeapBytes(lastAction);
+    return fp;
+}
 
 } // namespace coup
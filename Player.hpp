@@ -2,23 +2,22 @@
 #pragma once
 #include <string>
 #include <stdexcept>
+#include "Footprint.hpp"
 
 namespace coup {
 
 class Game;
 
+// A player keeps only its cold data (name, role, last action). The hot state
+// read on every turn (coins, alive, sanction, extra turn, arrest permission,
+// last arrested player) lives in the Game's packed per-seat arrays.
 class Player {
 protected:
+    Game& game;                        // Reference to the game this player belongs to
+    size_t seat;                       // Index of the player's hot state inside the game
     std::string name;                  
     std::string role;                 
-    int coins;                         // Number of coins the player has
-    Game& game;                        // Reference to the game this player belongs to
-    Player* last_arrested = nullptr;  // Pointer to the last player arrested by this player
-    bool alive = true;                // Is the player still in the game
-    bool is_sanctioned = false;       // Is the player blocked from economic actions
     std::string lastAction = "";      // The last action performed by the player
-    bool hasExtraTurn = false;        // Does the player have an extra turn this round
-    bool canUseArrest = true;         // True if the player is allowed to use arrest this turn
 
 public:
     // Constructor
@@ -31,6 +30,7 @@ public:
     std::string getName() const;      // Returns the player's name
     std::string getRole() const;      // Returns the player's role
     int getCoins() const;             // Returns the number of coins the player has
+    size_t getSeat() const { return seat; } // Returns the player's seat index in the game
 
     // Coin operations
     void addCoins(int amount);        // Adds coins to the player and removes from the bank
@@ -61,16 +61,19 @@ public:
    
 
     // Extra turn control
-    bool hasPendingExtraTurn() const { return hasExtraTurn; } // Check if the player has an extra turn that they haven't used yet
-    void grantExtraTurn() { hasExtraTurn = true; }            // Grant extra turn
-    void useExtraTurn() { hasExtraTurn = false; }             // Consume extra turn
-    void disableArrest() { canUseArrest = false; }            // Disables the player's ability to use arrest (used by Spy)
-    void enableArrest() { canUseArrest = true; }               // Enables the player's ability to use arrest (used at the start of their turn)
-    bool isArrestEnabled() const { return canUseArrest; }     // Checks if the player is currently allowed to use arrest
+    bool hasPendingExtraTurn() const;  // Check if the player has an extra turn that they haven't used yet
+    void grantExtraTurn();             // Grant extra turn
+    void useExtraTurn();               // Consume extra turn
+    void disableArrest();              // Disables the player's ability to use arrest (used by Spy)
+    void enableArrest();               // Enables the player's ability to use arrest (used at the start of their turn)
+    bool isArrestEnabled() const;      // Checks if the player is currently allowed to use arrest
 
     // Called at the start of a player's turn — default does nothing
     virtual void onTurnStart() {}
 
+    // Memory accounting: object size plus heap blocks of name, role and lastAction
+    MemoryFootprint memoryFootprint() const;
+
 
 };
 
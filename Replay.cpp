@@ -0,0 +1,259 @@
+// email: shiraba01@gmail.com
+#include "Replay.hpp"
+#include "Table.hpp"
+
+#include <stdexcept>
+
+namespace coup {
+
+namespace {
+
+constexpr uint8_t MAGIC_0 = 'C';
+constexpr uint8_t MAGIC_1 = 'R';
+constexpr uint8_t EXPLICIT_ACTOR_BIT = 0x80;
+
+/**
+ * @brief Returns the seat whose turn it is, or NO_SEAT if nobody is alive.
+ */
+int turnSeat(const Game& game) {
+    for (size_t s = 0; s < game.numPlayers(); ++s) {
+        if (game.hasFlag(s, FLAG_ALIVE)) {
+            return static_cast<int>(game.currentSeat());
+        }
+    }
+    return NO_SEAT;
+}
+
+} // namespace
+
+/**
+ * @brief Compares two outcomes field by field (unused seats are ignored).
+ */
+bool GameOutcome::operator==(const GameOutcome& other) const {
+    if (plies != other.plies || winner != other.winner || numPlayers != other.numPlayers ||
+        bank != other.bank || aliveMask != other.aliveMask) {
+        return false;
+    }
+    for (size_t s = 0; s < numPlayers && s < MAX_PLAYERS; ++s) {
+        if (coins[s] != other.coins[s]) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Captures the outcome of a game in its current state.
+ *
+ * @param game The game.
+ * @param plies Number of actions applied so far.
+ * @return GameOutcome Coins, bank, alive seats and winner.
+ */
+GameOutcome captureOutcome(const Game& game, size_t plies) {
+    GameOutcome outcome;
+    outcome.plies = plies;
+    outcome.numPlayers = game.numPlayers();
+    outcome.bank = game.getBankCoins();
+    size_t alive = 0;
+    for (size_t s = 0; s < outcome.numPlayers; ++s) {
+        outcome.coins[s] = game.coinsAt(s);
+        if (game.hasFlag(s, FLAG_ALIVE)) {
+            outcome.aliveMask |= static_cast<uint8_t>(1u << s);
+            outcome.winner = static_cast<int>(s);
+            alive++;
+        }
+    }
+    if (alive != 1) {
+        outcome.winner = NO_SEAT;
+    }
+    return outcome;
+}
+
+/**
+ * @brief Resolves the record into an Action against the game it is replayed on.
+ *
+ * @param game The game in the position where the action is applied.
+ * @return Action The action with an explicit actor seat.
+ */
+Action ActionRecord::resolve(const Game& game) const {
+    Action action;
+    action.kind = kind;
+    action.target = target;
+    action.actor = actor != IMPLICIT_ACTOR ? actor : static_cast<uint8_t>(game.currentSeat());
+    return action;
+}
+
+/**
+ * @brief Starts a new replay with the given header.
+ *
+ * @param header Seed, names and roles of the game.
+ */
+ReplayRecorder::ReplayRecorder(const ReplayHeader& header) {
+    reset(header);
+}
+
+/**
+ * @brief Clears the replay and writes a new header.
+ *
+ * @param header Seed, names and roles of the game.
+ * @throws std::invalid_argument if the player count or a name length is out of range.
+ */
+void ReplayRecorder::reset(const ReplayHeader& header) {
+    const size_t n = header.names.size();
+    if (n == 0 || n > MAX_PLAYERS || header.roles.size() != n) {
+        throw std::invalid_argument("Replay header needs 1 to 6 players with one role each.");
+    }
+
+    buffer.clear();
+    actions = 0;
+    buffer.push_back(MAGIC_0);
+    buffer.push_back(MAGIC_1);
+    buffer.push_back(REPLAY_VERSION);
+    for (int i = 0; i < 8; ++i) {
+        buffer.push_back(static_cast<uint8_t>(header.seed >> (8 * i)));
+    }
+    buffer.push_back(static_cast<uint8_t>(n));
+    for (size_t i = 0; i < n; ++i) {
+        if (header.names[i].size() > 255) {
+            throw std::invalid_argument("Player names in a replay are limited to 255 bytes.");
+        }
+        buffer.push_back(static_cast<uint8_t>(header.roles[i]));
+        buffer.push_back(static_cast<uint8_t>(header.names[i].size()));
+        buffer.insert(buffer.end(), header.names[i].begin(), header.names[i].end());
+    }
+}
+
+/**
+ * @brief Applies an action and appends it to the replay.
+ *
+ * The actor byte is omitted when the actor is the player whose turn it is.
+ *
+ * @param game The game to play on.
+ * @param action The action to apply.
+ */
+void ReplayRecorder::apply(Game& game, const Action& action) {
+    const bool implicitActor = turnSeat(game) == static_cast<int>(action.actor);
+
+    applyAction(game, action);
+
+    uint8_t target = actionHasTarget(action.kind) ? action.target : NO_TARGET;
+    uint8_t byte = static_cast<uint8_t>(static_cast<uint8_t>(action.kind) | (target << 4));
+    if (implicitActor) {
+        buffer.push_back(byte);
+    } else {
+        buffer.push_back(byte | EXPLICIT_ACTOR_BIT);
+        buffer.push_back(action.actor);
+    }
+    actions++;
+}
+
+/**
+ * @brief Parses the replay header.
+ *
+ * @param data Pointer to the replay bytes.
+ * @param size Number of bytes.
+ * @throws std::runtime_error if the header is malformed.
+ */
+ReplayReader::ReplayReader(const uint8_t* data, size_t size)
+    : data(data), size(size) {
+    if (size < 12 || data[0] != MAGIC_0 || data[1] != MAGIC_1) {
+        throw std::runtime_error("Not a replay.");
+    }
+    if (data[2] != REPLAY_VERSION) {
+        throw std::runtime_error("Unsupported replay version.");
+    }
+    for (int i = 0; i < 8; ++i) {
+        seedValue |= static_cast<uint64_t>(data[3 + i]) << (8 * i);
+    }
+    players = data[11];
+    if (players == 0 || players > MAX_PLAYERS) {
+        throw std::runtime_error("Invalid player count in replay.");
+    }
+
+    size_t p = 12;
+    for (size_t i = 0; i < players; ++i) {
+        if (p + 2 > size || data[p] >= NUM_ROLES) {
+            throw std::runtime_error("Truncated or invalid replay header.");
+        }
+        roles[i] = static_cast<Role>(data[p]);
+        nameLength[i] = data[p + 1];
+        nameOffset[i] = static_cast<uint16_t>(p + 2);
+        p += 2 + nameLength[i];
+        if (p > size) {
+            throw std::runtime_error("Truncated replay header.");
+        }
+    }
+    bodyStart = pos = p;
+}
+
+/**
+ * @brief Returns the name of the player at a seat as a view into the replay.
+ *
+ * @param seat Seat index.
+ * @return std::string_view The player's name.
+ */
+std::string_view ReplayReader::name(size_t seat) const {
+    return std::string_view(reinterpret_cast<const char*>(data + nameOffset[seat]), nameLength[seat]);
+}
+
+/**
+ * @brief Reads the next action.
+ *
+ * @param out Receives the decoded action.
+ * @return true if an action was read, false at the end of the replay.
+ * @throws std::runtime_error if the action bytes are malformed.
+ */
+bool ReplayReader::next(ActionRecord& out) {
+    if (pos >= size) {
+        return false;
+    }
+    uint8_t byte = data[pos++];
+    uint8_t kind = byte & 0x0F;
+    if (kind >= NUM_ACTION_KINDS) {
+        throw std::runtime_error("Invalid action in replay.");
+    }
+    out.kind = static_cast<ActionKind>(kind);
+    out.target = (byte >> 4) & 0x07;
+    out.actor = IMPLICIT_ACTOR;
+    if (byte & EXPLICIT_ACTOR_BIT) {
+        if (pos >= size) {
+            throw std::runtime_error("Truncated action in replay.");
+        }
+        out.actor = data[pos++];
+    }
+    return true;
+}
+
+/**
+ * @brief Copies the header into a ReplayHeader.
+ *
+ * @return ReplayHeader Seed, names and roles.
+ */
+ReplayHeader ReplayReader::header() const {
+    ReplayHeader header;
+    header.seed = seedValue;
+    for (size_t i = 0; i < players; ++i) {
+        header.names.emplace_back(name(i));
+        header.roles.push_back(roles[i]);
+    }
+    return header;
+}
+
+/**
+ * @brief Reconstructs a recorded game by applying every action through the Game/Player APIs.
+ *
+ * @param data Pointer to the replay bytes.
+ * @param size Number of bytes.
+ * @return std::unique_ptr<Table> The table in its final state.
+ */
+std::unique_ptr<Table> replayGame(const uint8_t* data, size_t size) {
+    ReplayReader reader(data, size);
+    ReplayHeader header = reader.header();
+    auto table = std::make_unique<Table>(header.names, header.roles);
+
+    ActionRecord record;
+    while (reader.next(record)) {
+        applyAction(table->getGame(), record.resolve(table->getGame()));
+    }
+    return table;
+}
+
+} // namespace coup
@@ -0,0 +1,182 @@
+// email: shiraba01@gmail.com
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Action.hpp"
+#include "Game.hpp"
+#include "Roles.hpp"
+
+namespace coup {
+
+class Table;
+
+/**
+ * Compact binary replay format (all integers little-endian):
+ *
+ *   header:  "CR" magic, version (1 byte), seed (8 bytes), player count (1 byte),
+ *            then per player: role code (1 byte), name length (1 byte), name bytes
+ *   actions: one byte per action  [E | target:3 | kind:4]
+ *            target is a seat index or NO_TARGET (7); when E (bit 7) is set a
+ *            second byte holds the actor seat, otherwise the actor is the
+ *            player whose turn it is when the action is applied.
+ *
+ * The action list runs to the end of the replay; the replay length is known
+ * from the container (file size, archive index).
+ */
+constexpr uint8_t REPLAY_VERSION = 1;
+
+// Actor value of an ActionRecord whose actor is the player whose turn it is
+constexpr uint8_t IMPLICIT_ACTOR = 0xFF;
+
+/**
+ * @brief Setup of a recorded game.
+ */
+struct ReplayHeader {
+    uint64_t seed = 0;                 // Seed the game was generated from (0 for human games)
+    std::vector<std::string> names;    // Player names in seat order
+    std::vector<Role> roles;           // Player roles in seat order
+};
+
+/**
+ * @brief One decoded action as stored in the replay (actor may be implicit).
+ */
+struct ActionRecord {
+    ActionKind kind = ActionKind::Pass;
+    uint8_t target = NO_TARGET;
+    uint8_t actor = IMPLICIT_ACTOR;
+
+    /**
+     * @brief Resolves the record into an Action against the game it is replayed on.
+     */
+    Action resolve(const Game& game) const;
+};
+
+/**
+ * @brief Final state of a game: what a replay must reproduce.
+ */
+struct GameOutcome {
+    size_t plies = 0;                  // Number of actions applied
+    int winner = NO_SEAT;              // Seat of the only alive player, NO_SEAT if undecided
+    size_t numPlayers = 0;
+    int bank = 0;                      // Coins left in the bank
+    uint8_t aliveMask = 0;             // Bit s set if seat s is alive
+    int coins[MAX_PLAYERS] = {};       // Coins of every seat
+
+    bool operator==(const GameOutcome& other) const;
+    bool operator!=(const GameOutcome& other) const { return !(*this == other); }
+};
+
+/**
+ * @brief Captures the outcome of a game in its current state.
+ *
+ * @param game The game.
+ * @param plies Number of actions applied so far.
+ */
+GameOutcome captureOutcome(const Game& game, size_t plies);
+
+/**
+ * @brief Applies actions to a game and appends each successful one to a replay.
+ */
+class ReplayRecorder {
+public:
+    /**
+     * @brief Starts a new replay with the given header.
+     *
+     * @throws std::invalid_argument if the header is invalid (player count, name length).
+     */
+    explicit ReplayRecorder(const ReplayHeader& header);
+
+    /**
+     * @brief Clears the replay and starts a new one, keeping the buffer capacity.
+     */
+    void reset(const ReplayHeader& header);
+
+    /**
+     * @brief Applies an action through applyAction() and records it.
+     *
+     * Nothing is recorded if the action throws (the exception propagates).
+     *
+     * @param game The game to play on.
+     * @param action The action to apply.
+     */
+    void apply(Game& game, const Action& action);
+
+    // Encoded replay bytes (header followed by the recorded actions)
+    const std::vector<uint8_t>& bytes() const { return buffer; }
+
+    // Number of actions recorded so far
+    size_t actionCount() const { return actions; }
+
+private:
+    std::vector<uint8_t> buffer;
+    size_t actions = 0;
+};
+
+/**
+ * @brief Allocation-free reader over an encoded replay.
+ *
+ * Names are returned as views into the replay bytes, which must outlive the reader.
+ */
+class ReplayReader {
+public:
+    /**
+     * @brief Parses the replay header.
+     *
+     * @param data Pointer to the replay bytes.
+     * @param size Number of bytes.
+     * @throws std::runtime_error if the header is malformed.
+     */
+    ReplayReader(const uint8_t* data, size_t size);
+
+    uint64_t seed() const { return seedValue; }
+    size_t numPlayers() const { return players; }
+    std::string_view name(size_t seat) const;
+    Role role(size_t seat) const { return roles[seat]; }
+
+    /**
+     * @brief Reads the next action.
+     *
+     * @param out Receives the decoded action.
+     * @return true if an action was read, false at the end of the replay.
+     * @throws std::runtime_error if the action bytes are malformed.
+     */
+    bool next(ActionRecord& out);
+
+    /**
+     * @brief Restarts reading from the first action.
+     */
+    void rewind() { pos = bodyStart; }
+
+    /**
+     * @brief Copies the header into a ReplayHeader (allocates).
+     */
+    ReplayHeader header() const;
+
+private:
+    const uint8_t* data;
+    size_t size;
+    size_t pos = 0;
+    size_t bodyStart = 0;
+    uint64_t seedValue = 0;
+    size_t players = 0;
+    uint16_t nameOffset[MAX_PLAYERS] = {};
+    uint8_t nameLength[MAX_PLAYERS] = {};
+    Role roles[MAX_PLAYERS] = {};
+};
+
+/**
+ * @brief Reconstructs a recorded game by applying every action through the Game/Player APIs.
+ *
+ * @param data Pointer to the replay bytes.
+ * @param size Number of bytes.
+ * @return std::unique_ptr<Table> The table in its final state.
+ * @throws std::runtime_error if the replay is malformed or an action breaks a rule.
+ */
+std::unique_ptr<Table> replayGame(const uint8_t* data, size_t size);
+
+} // namespace coup
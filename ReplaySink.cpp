@@ -0,0 +1,354 @@
+// email: shiraba01@gmail.com
+#include "ReplaySink.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+// Block headers are written and read as raw structs
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "The replay stream format is little-endian"
+#endif
+
+namespace coup {
+
+namespace {
+
+const char STREAM_MAGIC[8] = {'C', 'O', 'U', 'P', 'S', 'T', 'R', 'M'};
+constexpr size_t MAX_VARINT = 10;
+
+double nowSeconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+/**
+ * @brief Creates a producer bound to a sink.
+ *
+ * @param sink The sink that receives the blocks.
+ */
+ReplaySink::Producer::Producer(ReplaySink& sink) : sink(sink), block(sink.takeBuffer()) {}
+
+/**
+ * @brief Hands the remaining replays over to the sink (errors are ignored).
+ */
+ReplaySink::Producer::~Producer() {
+    try {
+        flush();
+    } catch (const std::exception&) {
+        // Destructors must not throw; call flush() explicitly to see errors
+    }
+}
+
+/**
+ * @brief Appends one replay, handing the block over when it is full.
+ *
+ * @param replay Pointer to the encoded replay.
+ * @param size Replay length in bytes.
+ * @throws std::runtime_error if the sink is closed or failed to write.
+ */
+void ReplaySink::Producer::add(const uint8_t* replay, size_t size) {
+    if (!block.empty() && block.size() + MAX_VARINT + size > sink.options.blockSize) {
+        flush();
+    }
+    putVarint(block, size);
+    block.insert(block.end(), replay, replay + size);
+    games++;
+}
+
+/**
+ * @brief Hands the current block over to the sink and starts a new one.
+ *
+ * @throws std::runtime_error if the sink is closed or failed to write.
+ */
+void ReplaySink::Producer::flush() {
+    if (games == 0) {
+        return;
+    }
+    sink.submit(block, games);
+    games = 0;
+}
+
+/**
+ * @brief Creates (or truncates) the stream file and starts the writer thread.
+ *
+ * @param path Path of the stream file.
+ * @param options Block size, queue bound and codec.
+ * @throws std::runtime_error if the file cannot be opened.
+ * @throws std::invalid_argument if the codec is not available in this build.
+ */
+ReplaySink::ReplaySink(const std::string& path, const SinkOptions& options) : options(options) {
+    if (options.blockSize == 0 || options.maxQueuedBlocks == 0) {
+        throw std::invalid_argument("Block size and queue bound must be positive.");
+    }
+    std::vector<uint8_t> probe;
+    try {
+        compressBlock(options.codec, nullptr, 0, probe);
+    } catch (const std::runtime_error& e) {
+        throw std::invalid_argument(e.what());
+    }
+
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        throw std::runtime_error("Cannot create replay stream: " + path);
+    }
+    std::setvbuf(file, nullptr, _IOFBF, 1 << 20);
+
+    StreamHeader header;
+    std::memcpy(header.magic, STREAM_MAGIC, sizeof(header.magic));
+    header.version = STREAM_VERSION;
+    header.reserved = 0;
+    if (std::fwrite(&header, sizeof(header), 1, file) != 1) {
+        std::fclose(file);
+        throw std::runtime_error("Failed to write replay stream: " + path);
+    }
+    counters.storedBytes = sizeof(header);
+
+    openedAt = nowSeconds();
+    writer = std::thread(&ReplaySink::run, this);
+}
+
+/**
+ * @brief Closes the sink if close() was not called (errors are ignored).
+ */
+ReplaySink::~ReplaySink() {
+    try {
+        close();
+    } catch (const std::exception&) {
+        // Destructors must not throw; call close() explicitly to see errors
+    }
+}
+
+/**
+ * @brief Writes every queued block, stops the writer thread and closes the file.
+ *
+ * @throws std::runtime_error if a block could not be compressed or written.
+ */
+void ReplaySink::close() {
+    if (!writer.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closing = true;
+    }
+    notEmpty.notify_one();
+    writer.join();
+
+    bool ok = std::fclose(file) == 0;
+    file = nullptr;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    counters.seconds = nowSeconds() - openedAt;
+    if (!ok && error.empty()) {
+        error = "Failed to write replay stream.";
+    }
+    if (!error.empty()) {
+        throw std::runtime_error(error);
+    }
+}
+
+/**
+ * @brief Returns a snapshot of the counters.
+ *
+ * @return SinkStats Games, bytes, stalls and timings so far.
+ */
+SinkStats ReplaySink::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    SinkStats snapshot = counters;
+    if (writer.joinable()) {
+        snapshot.seconds = nowSeconds() - openedAt;
+    }
+    return snapshot;
+}
+
+/**
+ * @brief Queues a full block, waiting while the queue is at its bound.
+ *
+ * The block's buffer is swapped for an empty recycled one.
+ *
+ * @param data The raw block (replaced by an empty buffer).
+ * @param games Number of replays in the block.
+ * @throws std::runtime_error if the sink is closed or failed to write.
+ */
+void ReplaySink::submit(std::vector<uint8_t>& data, uint32_t games) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (queue.size() >= options.maxQueuedBlocks && error.empty()) {
+        counters.stalls++;
+        notFull.wait(lock, [this] { return queue.size() < options.maxQueuedBlocks || !error.empty(); });
+    }
+    if (!error.empty()) {
+        throw std::runtime_error(error);
+    }
+    if (closing) {
+        throw std::runtime_error("Replay sink is closed.");
+    }
+
+    Block block;
+    block.data.swap(data);
+    block.games = games;
+    counters.games += games;
+    counters.rawBytes += block.data.size();
+    queue.push_back(std::move(block));
+
+    if (!freeBuffers.empty()) {
+        data.swap(freeBuffers.back());
+        freeBuffers.pop_back();
+    } else {
+        data.reserve(options.blockSize + MAX_VARINT);
+    }
+    lock.unlock();
+    notEmpty.notify_one();
+}
+
+/**
+ * @brief Returns an empty raw block buffer, recycled if possible.
+ */
+std::vector<uint8_t> ReplaySink::takeBuffer() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<uint8_t> buffer;
+    if (!freeBuffers.empty()) {
+        buffer.swap(freeBuffers.back());
+        freeBuffers.pop_back();
+    } else {
+        buffer.reserve(options.blockSize + MAX_VARINT);
+    }
+    return buffer;
+}
+
+/**
+ * @brief Writer thread: compresses and writes queued blocks in order until closed.
+ */
+void ReplaySink::run() {
+    std::vector<uint8_t> compressed;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        notEmpty.wait(lock, [this] { return !queue.empty() || closing; });
+        if (queue.empty()) {
+            break;
+        }
+        Block block = std::move(queue.front());
+        queue.pop_front();
+        const bool failed = !error.empty();
+        lock.unlock();
+
+        double start = nowSeconds();
+        size_t written = 0;
+        std::string failure;
+        if (!failed) {
+            try {
+                compressBlock(options.codec, block.data.data(), block.data.size(), compressed);
+                BlockHeader header;
+                std::memset(&header, 0, sizeof(header));
+                header.rawSize = static_cast<uint32_t>(block.data.size());
+                header.storedSize = static_cast<uint32_t>(compressed.size());
+                header.gameCount = block.games;
+                header.codec = static_cast<uint8_t>(options.codec);
+                if (std::fwrite(&header, sizeof(header), 1, file) != 1 ||
+                    std::fwrite(compressed.data(), 1, compressed.size(), file) != compressed.size()) {
+                    throw std::runtime_error("Failed to write replay stream.");
+                }
+                written = sizeof(header) + compressed.size();
+            } catch (const std::exception& e) {
+                failure = e.what();
+            }
+        }
+        double busy = nowSeconds() - start;
+
+        block.data.clear();
+        lock.lock();
+        freeBuffers.push_back(std::move(block.data));
+        if (!failure.empty() && error.empty()) {
+            error = failure;
+        }
+        counters.blocks += written ? 1 : 0;
+        counters.storedBytes += written;
+        counters.busySeconds += busy;
+        // Wake every producer on failure so that none waits forever
+        if (error.empty()) {
+            notFull.notify_one();
+        } else {
+            notFull.notify_all();
+        }
+    }
+}
+
+/**
+ * @brief Opens a stream file and checks its header.
+ *
+ * @param path Path of the stream file.
+ * @throws std::runtime_error if the file cannot be opened or is not a replay stream.
+ */
+ReplayStreamReader::ReplayStreamReader(const std::string& path) {
+    file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        throw std::runtime_error("Cannot open replay stream: " + path);
+    }
+    StreamHeader header;
+    if (std::fread(&header, sizeof(header), 1, file) != 1 ||
+        std::memcmp(header.magic, STREAM_MAGIC, sizeof(header.magic)) != 0 || header.version != STREAM_VERSION) {
+        std::fclose(file);
+        throw std::runtime_error("Not a replay stream: " + path);
+    }
+}
+
+/**
+ * @brief Closes the file.
+ */
+ReplayStreamReader::~ReplayStreamReader() {
+    if (file) {
+        std::fclose(file);
+    }
+}
+
+/**
+ * @brief Returns the next replay (valid until the next call).
+ *
+ * @param data Receives a pointer to the replay bytes.
+ * @param size Receives the replay length.
+ * @return true if a replay was read, false at the end of the stream.
+ * @throws std::runtime_error if a block is truncated or corrupted.
+ */
+bool ReplayStreamReader::next(const uint8_t*& data, size_t& size) {
+    while (pos >= raw.size()) {
+        if (!readBlock()) {
+            return false;
+        }
+    }
+    const uint8_t* p = raw.data() + pos;
+    const uint8_t* end = raw.data() + raw.size();
+    uint64_t length;
+    if (!getVarint(p, end, length) || length > static_cast<size_t>(end - p)) {
+        throw std::runtime_error("Corrupted replay stream.");
+    }
+    data = p;
+    size = length;
+    pos = (p - raw.data()) + length;
+    return true;
+}
+
+/**
+ * @brief Reads and decompresses the next block.
+ *
+ * @return true if a block was read, false at the end of the file.
+ */
+bool ReplayStreamReader::readBlock() {
+    BlockHeader header;
+    size_t n = std::fread(&header, 1, sizeof(header), file);
+    if (n == 0) {
+        return false;
+    }
+    if (n != sizeof(header)) {
+        throw std::runtime_error("Truncated replay stream.");
+    }
+    stored.resize(header.storedSize);
+    if (std::fread(stored.data(), 1, stored.size(), file) != stored.size()) {
+        throw std::runtime_error("Truncated replay stream.");
+    }
+    decompressBlock(static_cast<BlockCodec>(header.codec), stored.data(), stored.size(), header.rawSize, raw);
+    pos = 0;
+    return true;
+}
+
+} // namespace coup
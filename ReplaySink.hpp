@@ -0,0 +1,212 @@
+// email: shiraba01@gmail.com
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BlockCodec.hpp"
+#include "Replay.hpp"
+
+namespace coup {
+
+/**
+ * Replay stream file:
+ *
+ *   [StreamHeader][BlockHeader][compressed block] [BlockHeader][compressed block] ...
+ *
+ * A raw block is a sequence of [varint length][replay bytes] records. Blocks
+ * are independent, so a stream cut short by a crash is readable up to its
+ * last complete block.
+ */
+constexpr uint32_t STREAM_VERSION = 1;
+
+struct StreamHeader {
+    char magic[8];                    // "COUPSTRM"
+    uint32_t version;                 // STREAM_VERSION
+    uint32_t reserved;
+};
+static_assert(sizeof(StreamHeader) == 16, "StreamHeader must keep its on-disk layout");
+
+struct BlockHeader {
+    uint32_t rawSize;                 // Size of the raw block
+    uint32_t storedSize;              // Size of the compressed block that follows
+    uint32_t gameCount;               // Number of replays in the block
+    uint8_t codec;                    // BlockCodec
+    uint8_t reserved[3];
+};
+static_assert(sizeof(BlockHeader) == 16, "BlockHeader must keep its on-disk layout");
+
+/**
+ * @brief Settings of a ReplaySink.
+ */
+struct SinkOptions {
+    size_t blockSize = 1 << 20;                 // A producer hands its block over when it reaches this size
+    size_t maxQueuedBlocks = 8;                 // Producers wait when this many blocks are not yet written
+    BlockCodec codec = defaultBlockCodec();
+};
+
+/**
+ * @brief Counters of a ReplaySink.
+ */
+struct SinkStats {
+    uint64_t games = 0;
+    uint64_t blocks = 0;
+    uint64_t rawBytes = 0;            // Replay bytes handed over by the producers
+    uint64_t storedBytes = 0;         // Bytes written to the file (headers included)
+    uint64_t stalls = 0;              // Times a producer had to wait for the writer (backpressure)
+    double seconds = 0;               // Time since the sink was opened (or until it was closed)
+    double busySeconds = 0;           // Time the writer thread spent compressing and writing
+
+    // Raw bytes per stored byte
+    double ratio() const { return storedBytes ? static_cast<double>(rawBytes) / storedBytes : 0; }
+
+    // Raw replay throughput in MB/s
+    double rawMBps() const { return seconds > 0 ? rawBytes / 1e6 / seconds : 0; }
+
+    // Disk write throughput in MB/s
+    double storedMBps() const { return seconds > 0 ? storedBytes / 1e6 / seconds : 0; }
+};
+
+/**
+ * @brief Writes replays to a stream file from many threads without blocking them on disk.
+ *
+ * Every simulation thread owns a Producer that appends replays to a private
+ * block. Full blocks are queued to a background thread that compresses them
+ * and writes them in order of arrival. The queue is bounded: when the disk
+ * falls behind, producers wait in add() instead of growing memory without limit.
+ */
+class ReplaySink {
+public:
+    /**
+     * @brief Per-thread buffer of a sink. Not thread-safe: use one per thread.
+     */
+    class Producer {
+    public:
+        explicit Producer(ReplaySink& sink);
+
+        /**
+         * @brief Hands the remaining replays over to the sink.
+         */
+        ~Producer();
+
+        Producer(const Producer&) = delete;
+        Producer& operator=(const Producer&) = delete;
+
+        /**
+         * @brief Appends one replay, handing the block over when it is full.
+         *
+         * @throws std::runtime_error if the sink is closed or failed to write.
+         */
+        void add(const uint8_t* replay, size_t size);
+        void add(const ReplayRecorder& recorder) { add(recorder.bytes().data(), recorder.bytes().size()); }
+
+        /**
+         * @brief Hands the current (partial) block over to the sink.
+         */
+        void flush();
+
+    private:
+        ReplaySink& sink;
+        std::vector<uint8_t> block;
+        uint32_t games = 0;
+    };
+
+    /**
+     * @brief Creates (or truncates) the stream file and starts the writer thread.
+     *
+     * @throws std::runtime_error if the file cannot be opened.
+     * @throws std::invalid_argument if the codec is not available in this build.
+     */
+    explicit ReplaySink(const std::string& path, const SinkOptions& options = SinkOptions());
+
+    /**
+     * @brief Closes the sink if close() was not called.
+     */
+    ~ReplaySink();
+
+    ReplaySink(const ReplaySink&) = delete;
+    ReplaySink& operator=(const ReplaySink&) = delete;
+
+    /**
+     * @brief Writes every queued block, stops the writer thread and closes the file.
+     *
+     * Producers must be flushed (or destroyed) first.
+     *
+     * @throws std::runtime_error if a block could not be compressed or written.
+     */
+    void close();
+
+    /**
+     * @brief Returns a snapshot of the counters.
+     */
+    SinkStats stats() const;
+
+private:
+    struct Block {
+        std::vector<uint8_t> data;
+        uint32_t games = 0;
+    };
+
+    void submit(std::vector<uint8_t>& data, uint32_t games);
+    std::vector<uint8_t> takeBuffer();
+    void run();
+
+    std::FILE* file = nullptr;
+    SinkOptions options;
+
+    mutable std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::deque<Block> queue;
+    std::vector<std::vector<uint8_t>> freeBuffers;   // Raw blocks recycled by the writer
+    bool closing = false;
+    std::string error;                               // First write error, reported to producers and close()
+    SinkStats counters;
+    double openedAt = 0;
+
+    std::thread writer;
+};
+
+/**
+ * @brief Reads the replays of a stream file block by block.
+ */
+class ReplayStreamReader {
+public:
+    /**
+     * @brief Opens a stream file and checks its header.
+     *
+     * @throws std::runtime_error if the file cannot be opened or is not a replay stream.
+     */
+    explicit ReplayStreamReader(const std::string& path);
+
+    ~ReplayStreamReader();
+
+    ReplayStreamReader(const ReplayStreamReader&) = delete;
+    ReplayStreamReader& operator=(const ReplayStreamReader&) = delete;
+
+    /**
+     * @brief Returns the next replay (valid until the next call).
+     *
+     * @param data Receives a pointer to the replay bytes.
+     * @param size Receives the replay length.
+     * @return true if a replay was read, false at the end of the stream.
+     * @throws std::runtime_error if a block is truncated or corrupted.
+     */
+    bool next(const uint8_t*& data, size_t& size);
+
+private:
+    bool readBlock();
+
+    std::FILE* file = nullptr;
+    std::vector<uint8_t> stored;
+    std::vector<uint8_t> raw;
+    size_t pos = 0;
+};
+
+} // namespace coup
@@ -0,0 +1,491 @@
+// email: shiraba01@gmail.com
+#include "ResultsStore.hpp"
+#include "Table.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Columns are read in place from the mapping
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "The results format is little-endian"
+#endif
+
+namespace coup {
+
+namespace {
+
+const char RESULTS_MAGIC[8] = {'C', 'O', 'U', 'P', 'C', 'O', 'L', 'S'};
+constexpr size_t COLUMN_ALIGN = 64;
+
+// Width in bytes of every column, in file order
+constexpr size_t COLUMN_WIDTHS[] = {8, 4, 1, 1, 1, 1, 4, 2, 2, 1, 1, 1};
+constexpr size_t NUM_COLUMNS = sizeof(COLUMN_WIDTHS) / sizeof(COLUMN_WIDTHS[0]);
+
+struct ResultsFooter {
+    char magic[8];
+    uint32_t version;
+    uint32_t columnCount;
+    uint64_t groupCount;
+    uint64_t rowCount;
+};
+static_assert(sizeof(ResultsFooter) == 32, "ResultsFooter must keep its on-disk layout");
+
+struct GroupEntry {
+    uint64_t offset;
+    uint64_t rows;
+};
+
+size_t aligned(size_t bytes) {
+    return (bytes + COLUMN_ALIGN - 1) / COLUMN_ALIGN * COLUMN_ALIGN;
+}
+
+/**
+ * @brief Writes one field of every pending row as a contiguous column, padded to COLUMN_ALIGN.
+ */
+template <typename T>
+bool writeColumn(std::FILE* file, const std::vector<GameResult>& rows, T GameResult::*field, std::vector<T>& column) {
+    column.clear();
+    for (const GameResult& row : rows) {
+        column.push_back(row.*field);
+    }
+    static const uint8_t zeros[COLUMN_ALIGN] = {};
+    const size_t bytes = column.size() * sizeof(T);
+    const size_t padding = aligned(bytes) - bytes;
+    return std::fwrite(column.data(), 1, bytes, file) == bytes &&
+           std::fwrite(zeros, 1, padding, file) == padding;
+}
+
+/**
+ * @brief Number of selected rows, as a sum of 0/1 selection bytes.
+ */
+uint64_t countSelected(const uint8_t* sel, size_t rows) {
+    uint64_t count = 0;
+    for (size_t i = 0; i < rows; ++i) count += sel[i];
+    return count;
+}
+
+/**
+ * @brief Sum of a column over the selected rows.
+ */
+template <typename T>
+uint64_t sumSelected(const uint8_t* sel, const T* column, size_t rows) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < rows; ++i) sum += static_cast<uint64_t>(sel[i]) * column[i];
+    return sum;
+}
+
+} // namespace
+
+/**
+ * @brief Starts a new game result from the seated players.
+ *
+ * @param table The table of the game.
+ */
+void ResultCollector::onStart(const Table& table) {
+    current = GameResult();
+    current.numPlayers = static_cast<uint8_t>(table.size());
+    current.seatRoles = 0xFFFFFFFFu;
+    for (size_t seat = 0; seat < table.size(); ++seat) {
+        const uint32_t role = static_cast<uint32_t>(table.roleAt(seat));
+        current.rolesPresent |= static_cast<uint8_t>(1u << role);
+        current.seatRoles &= ~(0xFu << (4 * seat));
+        current.seatRoles |= role << (4 * seat);
+    }
+}
+
+/**
+ * @brief Counts coups and blocks and tracks the peak coins.
+ *
+ * @param table The table of the game.
+ * @param action The action that was just applied.
+ * @param ply Index of the action.
+ */
+void ResultCollector::onAction(const Table& table, const Action& action, size_t ply) {
+    switch (action.kind) {
+        case ActionKind::Coup:
+            current.coups++;
+            break;
+        case ActionKind::BlockTax:
+        case ActionKind::BlockBribe:
+        case ActionKind::BlockArrest:
+        case ActionKind::BlockCoup:
+            current.blocks++;
+            break;
+        default:
+            break;
+    }
+    const Game& game = table.getGame();
+    for (size_t seat = 0; seat < current.numPlayers; ++seat) {
+        current.peakCoins = static_cast<uint8_t>(std::max<int>(current.peakCoins, game.coinsAt(seat)));
+    }
+}
+
+/**
+ * @brief Records the final state of the game.
+ *
+ * @param table The table of the game.
+ * @param outcome The final outcome.
+ */
+void ResultCollector::onEnd(const Table& table, const GameOutcome& outcome) {
+    current.plies = static_cast<uint32_t>(outcome.plies);
+    current.finalBank = static_cast<uint8_t>(outcome.bank);
+    if (outcome.winner != NO_SEAT) {
+        current.winnerSeat = static_cast<uint8_t>(outcome.winner);
+        current.winnerRole = static_cast<uint8_t>(table.roleAt(outcome.winner));
+        current.winnerCoins = static_cast<uint8_t>(outcome.coins[outcome.winner]);
+    }
+}
+
+/**
+ * @brief Creates (or truncates) the results file.
+ *
+ * @param path Path of the file.
+ * @param rowsPerGroup Number of rows per group of columns.
+ * @throws std::runtime_error if the file cannot be opened.
+ * @throws std::invalid_argument if rowsPerGroup is 0.
+ */
+ResultsWriter::ResultsWriter(const std::string& path, size_t rowsPerGroup) : rowsPerGroup(rowsPerGroup) {
+    if (rowsPerGroup == 0) {
+        throw std::invalid_argument("A group needs at least one row.");
+    }
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        throw std::runtime_error("Cannot create results file: " + path);
+    }
+    std::setvbuf(file, nullptr, _IOFBF, 1 << 20);
+    pending.reserve(rowsPerGroup);
+}
+
+/**
+ * @brief Finishes the file if finish() was not called (errors are ignored).
+ */
+ResultsWriter::~ResultsWriter() {
+    if (file) {
+        try {
+            finish();
+        } catch (const std::exception&) {
+            // Destructors must not throw; call finish() explicitly to see errors
+        }
+    }
+}
+
+/**
+ * @brief Appends one row.
+ *
+ * @param result The row.
+ * @throws std::runtime_error on a write error.
+ */
+void ResultsWriter::add(const GameResult& result) {
+    if (!file) {
+        throw std::runtime_error("Results file is already finished.");
+    }
+    pending.push_back(result);
+    rows++;
+    if (pending.size() == rowsPerGroup) {
+        writeGroup();
+    }
+}
+
+/**
+ * @brief Writes the pending rows as one group of columns.
+ *
+ * @throws std::runtime_error on a write error.
+ */
+void ResultsWriter::writeGroup() {
+    if (pending.empty()) {
+        return;
+    }
+    std::vector<uint64_t> u64;
+    std::vector<uint32_t> u32;
+    std::vector<uint16_t> u16;
+    std::vector<uint8_t> u8;
+    bool ok = writeColumn(file, pending, &GameResult::seed, u64) &&
+              writeColumn(file, pending, &GameResult::plies, u32) &&
+              writeColumn(file, pending, &GameResult::numPlayers, u8) &&
+              writeColumn(file, pending, &GameResult::winnerSeat, u8) &&
+              writeColumn(file, pending, &GameResult::winnerRole, u8) &&
+              writeColumn(file, pending, &GameResult::rolesPresent, u8) &&
+              writeColumn(file, pending, &GameResult::seatRoles, u32) &&
+              writeColumn(file, pending, &GameResult::coups, u16) &&
+              writeColumn(file, pending, &GameResult::blocks, u16) &&
+              writeColumn(file, pending, &GameResult::peakCoins, u8) &&
+              writeColumn(file, pending, &GameResult::winnerCoins, u8) &&
+              writeColumn(file, pending, &GameResult::finalBank, u8);
+    if (!ok) {
+        throw std::runtime_error("Failed to write results file.");
+    }
+
+    groupOffsets.push_back(offset);
+    groupRows.push_back(pending.size());
+    for (size_t width : COLUMN_WIDTHS) {
+        offset += aligned(pending.size() * width);
+    }
+    pending.clear();
+}
+
+/**
+ * @brief Writes the last group, the group index and the footer, and closes the file.
+ *
+ * @throws std::runtime_error on a write error.
+ */
+void ResultsWriter::finish() {
+    if (!file) {
+        return;
+    }
+    bool ok = true;
+    try {
+        writeGroup();
+    } catch (const std::runtime_error&) {
+        ok = false;
+    }
+    std::FILE* f = file;
+    file = nullptr;
+
+    for (size_t g = 0; ok && g < groupOffsets.size(); ++g) {
+        GroupEntry entry{groupOffsets[g], groupRows[g]};
+        ok = std::fwrite(&entry, sizeof(entry), 1, f) == 1;
+    }
+    ResultsFooter footer;
+    std::memcpy(footer.magic, RESULTS_MAGIC, sizeof(footer.magic));
+    footer.version = RESULTS_VERSION;
+    footer.columnCount = NUM_COLUMNS;
+    footer.groupCount = groupOffsets.size();
+    footer.rowCount = rows;
+    ok = ok && std::fwrite(&footer, sizeof(footer), 1, f) == 1;
+    ok = (std::fclose(f) == 0) && ok;
+    if (!ok) {
+        throw std::runtime_error("Failed to write results file.");
+    }
+}
+
+/**
+ * @brief Maps the file and validates its footer and group index.
+ *
+ * @param path Path of the file.
+ * @throws std::runtime_error if the file cannot be mapped or is not a valid results file.
+ */
+ResultsReader::ResultsReader(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open results file: " + path);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(ResultsFooter))) {
+        ::close(fd);
+        throw std::runtime_error("Not a results file: " + path);
+    }
+    mappedSize = static_cast<size_t>(st.st_size);
+    void* map = ::mmap(nullptr, mappedSize, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        throw std::runtime_error("Cannot map results file: " + path);
+    }
+    base = static_cast<const uint8_t*>(map);
+
+    ResultsFooter footer;
+    std::memcpy(&footer, base + mappedSize - sizeof(footer), sizeof(footer));
+    const size_t available = mappedSize - sizeof(footer);
+    bool valid = std::memcmp(footer.magic, RESULTS_MAGIC, sizeof(footer.magic)) == 0 &&
+                 footer.version == RESULTS_VERSION && footer.columnCount == NUM_COLUMNS &&
+                 footer.groupCount <= available / sizeof(GroupEntry);
+    const size_t indexOffset = valid ? available - footer.groupCount * sizeof(GroupEntry) : 0;
+
+    uint64_t total = 0;
+    for (size_t g = 0; valid && g < footer.groupCount; ++g) {
+        GroupEntry entry;
+        std::memcpy(&entry, base + indexOffset + g * sizeof(GroupEntry), sizeof(entry));
+        size_t bytes = 0;
+        for (size_t width : COLUMN_WIDTHS) {
+            bytes += aligned(entry.rows * width);
+        }
+        if (entry.offset % COLUMN_ALIGN != 0 || entry.rows > indexOffset || bytes > indexOffset ||
+            entry.offset > indexOffset - bytes) {
+            valid = false;
+            break;
+        }
+
+        ResultsGroup group;
+        group.rows = entry.rows;
+        const uint8_t* p = base + entry.offset;
+        auto take = [&p, &entry](size_t width) {
+            const uint8_t* column = p;
+            p += aligned(entry.rows * width);
+            return column;
+        };
+        group.seed = reinterpret_cast<const uint64_t*>(take(8));
+        group.plies = reinterpret_cast<const uint32_t*>(take(4));
+        group.numPlayers = take(1);
+        group.winnerSeat = take(1);
+        group.winnerRole = take(1);
+        group.rolesPresent = take(1);
+        group.seatRoles = reinterpret_cast<const uint32_t*>(take(4));
+        group.coups = reinterpret_cast<const uint16_t*>(take(2));
+        group.blocks = reinterpret_cast<const uint16_t*>(take(2));
+        group.peakCoins = take(1);
+        group.winnerCoins = take(1);
+        group.finalBank = take(1);
+        groups.push_back(group);
+        total += entry.rows;
+    }
+    if (!valid || total != footer.rowCount) {
+        ::munmap(const_cast<uint8_t*>(base), mappedSize);
+        throw std::runtime_error("Corrupted or unsupported results file: " + path);
+    }
+    rows = total;
+}
+
+/**
+ * @brief Unmaps the file.
+ */
+ResultsReader::~ResultsReader() {
+    if (base) {
+        ::munmap(const_cast<uint8_t*>(base), mappedSize);
+    }
+}
+
+/**
+ * @brief Copies one row out of the columns.
+ *
+ * @param row Row index (row < rowCount()).
+ * @return GameResult The row.
+ * @throws std::out_of_range if the row does not exist.
+ */
+GameResult ResultsReader::row(uint64_t row) const {
+    for (const ResultsGroup& group : groups) {
+        if (row >= group.rows) {
+            row -= group.rows;
+            continue;
+        }
+        GameResult result;
+        result.seed = group.seed[row];
+        result.plies = group.plies[row];
+        result.numPlayers = group.numPlayers[row];
+        result.winnerSeat = group.winnerSeat[row];
+        result.winnerRole = group.winnerRole[row];
+        result.rolesPresent = group.rolesPresent[row];
+        result.seatRoles = group.seatRoles[row];
+        result.coups = group.coups[row];
+        result.blocks = group.blocks[row];
+        result.peakCoins = group.peakCoins[row];
+        result.winnerCoins = group.winnerCoins[row];
+        result.finalBank = group.finalBank[row];
+        return result;
+    }
+    throw std::out_of_range("No such row in the results file.");
+}
+
+/**
+ * @brief Counts one more game.
+ *
+ * @param result The result of the game.
+ */
+void ResultsSummary::add(const GameResult& result) {
+    games++;
+    plies += result.plies;
+    coups += result.coups;
+    blocks += result.blocks;
+    for (size_t r = 0; r < NUM_ROLES; ++r) {
+        if (result.rolesPresent & (1u << r)) gamesWithRole[r]++;
+    }
+    if (result.winnerSeat != NO_CODE) {
+        decided++;
+        winsBySeat[result.winnerSeat]++;
+        winsByRole[result.winnerRole]++;
+    }
+}
+
+/**
+ * @brief Adds the counts of another summary.
+ *
+ * @param other Summary of other games.
+ */
+void ResultsSummary::merge(const ResultsSummary& other) {
+    games += other.games;
+    decided += other.decided;
+    plies += other.plies;
+    coups += other.coups;
+    blocks += other.blocks;
+    for (size_t r = 0; r < NUM_ROLES; ++r) {
+        gamesWithRole[r] += other.gamesWithRole[r];
+        winsByRole[r] += other.winsByRole[r];
+    }
+    for (size_t s = 0; s < MAX_PLAYERS; ++s) {
+        winsBySeat[s] += other.winsBySeat[s];
+    }
+}
+
+/**
+ * @brief Runs a filter and the standard aggregates over a results file.
+ *
+ * Each condition narrows a 0/1 selection byte per row, one column at a time,
+ * then the aggregates are sums of selection × column.
+ *
+ * @param results The results file.
+ * @param filter The rows to select.
+ * @return ResultsSummary Aggregates of the selected rows.
+ */
+ResultsSummary queryResults(const ResultsReader& results, const ResultsFilter& filter) {
+    ResultsSummary summary;
+    std::vector<uint8_t> selection;
+
+    for (size_t g = 0; g < results.groupCount(); ++g) {
+        const ResultsGroup& group = results.group(g);
+        const size_t n = group.rows;
+        selection.assign(n, 1);
+        uint8_t* sel = selection.data();
+
+        if (filter.numPlayers) {
+            const uint8_t players = filter.numPlayers;
+            for (size_t i = 0; i < n; ++i) sel[i] &= group.numPlayers[i] == players;
+        }
+        if (filter.requiredRoles) {
+            const uint8_t required = filter.requiredRoles;
+            for (size_t i = 0; i < n; ++i) sel[i] &= (group.rolesPresent[i] & required) == required;
+        }
+        if (filter.excludedRoles) {
+            const uint8_t excluded = filter.excludedRoles;
+            for (size_t i = 0; i < n; ++i) sel[i] &= (group.rolesPresent[i] & excluded) == 0;
+        }
+        if (filter.decidedOnly) {
+            for (size_t i = 0; i < n; ++i) sel[i] &= group.winnerSeat[i] != NO_CODE;
+        }
+        if (filter.minPlies > 0 || filter.maxPlies < UINT32_MAX) {
+            const uint32_t lo = filter.minPlies;
+            const uint32_t hi = filter.maxPlies;
+            for (size_t i = 0; i < n; ++i) sel[i] &= group.plies[i] >= lo && group.plies[i] <= hi;
+        }
+
+        summary.games += countSelected(sel, n);
+        summary.plies += sumSelected(sel, group.plies, n);
+        summary.coups += sumSelected(sel, group.coups, n);
+        summary.blocks += sumSelected(sel, group.blocks, n);
+        // Histograms of the role sets and winners of the selected rows
+        uint64_t roleSets[1u << NUM_ROLES] = {};
+        uint64_t roleWins[256] = {};
+        uint64_t seatWins[256] = {};
+        for (size_t i = 0; i < n; ++i) {
+            roleSets[group.rolesPresent[i] & ((1u << NUM_ROLES) - 1)] += sel[i];
+            roleWins[group.winnerRole[i]] += sel[i];
+            seatWins[group.winnerSeat[i]] += sel[i];
+        }
+        for (size_t set = 0; set < (1u << NUM_ROLES); ++set) {
+            for (size_t r = 0; r < NUM_ROLES; ++r) {
+                if (set & (1u << r)) summary.gamesWithRole[r] += roleSets[set];
+            }
+        }
+        for (size_t r = 0; r < NUM_ROLES; ++r) summary.winsByRole[r] += roleWins[r];
+        for (size_t s = 0; s < MAX_PLAYERS; ++s) summary.winsBySeat[s] += seatWins[s];
+    }
+    for (uint64_t wins : summary.winsBySeat) {
+        summary.decided += wins;
+    }
+    return summary;
+}
+
+} // namespace coup
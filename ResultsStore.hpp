@@ -0,0 +1,226 @@
+// email: shiraba01@gmail.com
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "Roles.hpp"
+#include "Simulator.hpp"
+
+namespace coup {
+
+/**
+ * Columnar results file:
+ *
+ *   [group 0: column 0][column 1]...[column 11]  [group 1: ...]  ...  [group index][footer]
+ *
+ * Rows are written in groups (65536 rows by default). Inside a group every
+ * column is a contiguous array of fixed-width little-endian values, aligned
+ * to 64 bytes, so a query reads only the columns it uses and runs simple
+ * loops over them that the compiler vectorizes. The file is read in place
+ * through a read-only memory mapping.
+ */
+constexpr uint32_t RESULTS_VERSION = 1;
+
+/**
+ * @brief Summary of one game: one row of the results store.
+ */
+struct GameResult {
+    uint64_t seed = 0;                // Seed of the game (set by the caller)
+    uint32_t plies = 0;
+    uint8_t numPlayers = 0;
+    uint8_t winnerSeat = NO_CODE;     // NO_CODE if undecided
+    uint8_t winnerRole = NO_CODE;     // Role code, NO_CODE if undecided
+    uint8_t rolesPresent = 0;         // Bit r set if a player had role r
+    uint32_t seatRoles = 0;           // Role code of seat s in bits 4s..4s+3 (0xF for an empty seat)
+    uint16_t coups = 0;
+    uint16_t blocks = 0;              // blockTax, blockBribe, blockArrest and blockCoup
+    uint8_t peakCoins = 0;            // Most coins any player held during the game
+    uint8_t winnerCoins = 0;          // Final coins of the winner (0 if undecided)
+    uint8_t finalBank = 0;
+
+    // Role of a seat (seat < numPlayers)
+    Role roleAt(size_t seat) const { return static_cast<Role>((seatRoles >> (4 * seat)) & 0xF); }
+};
+
+/**
+ * @brief Builds the GameResult of a simulated game (pass it as the simulateGame() observer).
+ *
+ * The seed is not known to the observer; the caller fills it in.
+ */
+class ResultCollector : public SimObserver {
+public:
+    void onStart(const Table& table) override;
+    void onAction(const Table& table, const Action& action, size_t ply) override;
+    void onEnd(const Table& table, const GameOutcome& outcome) override;
+
+    // Result of the last finished game
+    const GameResult& result() const { return current; }
+
+private:
+    GameResult current;
+};
+
+/**
+ * @brief Appends results row by row and writes them a group of columns at a time.
+ */
+class ResultsWriter {
+public:
+    /**
+     * @brief Creates (or truncates) the results file.
+     *
+     * @throws std::runtime_error if the file cannot be opened.
+     * @throws std::invalid_argument if rowsPerGroup is 0.
+     */
+    explicit ResultsWriter(const std::string& path, size_t rowsPerGroup = 1 << 16);
+
+    /**
+     * @brief Finishes the file if finish() was not called.
+     */
+    ~ResultsWriter();
+
+    ResultsWriter(const ResultsWriter&) = delete;
+    ResultsWriter& operator=(const ResultsWriter&) = delete;
+
+    /**
+     * @brief Appends one row.
+     *
+     * @throws std::runtime_error on a write error.
+     */
+    void add(const GameResult& result);
+
+    /**
+     * @brief Writes the last group, the group index and the footer, and closes the file.
+     *
+     * @throws std::runtime_error on a write error.
+     */
+    void finish();
+
+    uint64_t rowCount() const { return rows; }
+
+private:
+    void writeGroup();
+
+    std::FILE* file = nullptr;
+    size_t rowsPerGroup;
+    uint64_t rows = 0;
+    uint64_t offset = 0;
+    std::vector<GameResult> pending;
+    std::vector<uint64_t> groupOffsets;
+    std::vector<uint64_t> groupRows;
+};
+
+/**
+ * @brief The columns of one group, pointing into the mapping.
+ */
+struct ResultsGroup {
+    size_t rows = 0;
+    const uint64_t* seed = nullptr;
+    const uint32_t* plies = nullptr;
+    const uint8_t* numPlayers = nullptr;
+    const uint8_t* winnerSeat = nullptr;
+    const uint8_t* winnerRole = nullptr;
+    const uint8_t* rolesPresent = nullptr;
+    const uint32_t* seatRoles = nullptr;
+    const uint16_t* coups = nullptr;
+    const uint16_t* blocks = nullptr;
+    const uint8_t* peakCoins = nullptr;
+    const uint8_t* winnerCoins = nullptr;
+    const uint8_t* finalBank = nullptr;
+};
+
+/**
+ * @brief Read-only, memory-mapped view of a results file.
+ */
+class ResultsReader {
+public:
+    /**
+     * @brief Maps the file and validates its footer and group index.
+     *
+     * @throws std::runtime_error if the file cannot be mapped or is not a valid results file.
+     */
+    explicit ResultsReader(const std::string& path);
+
+    ~ResultsReader();
+
+    ResultsReader(const ResultsReader&) = delete;
+    ResultsReader& operator=(const ResultsReader&) = delete;
+
+    uint64_t rowCount() const { return rows; }
+    size_t groupCount() const { return groups.size(); }
+    const ResultsGroup& group(size_t index) const { return groups[index]; }
+
+    /**
+     * @brief Copies one row out of the columns (row < rowCount()).
+     */
+    GameResult row(uint64_t row) const;
+
+private:
+    const uint8_t* base = nullptr;
+    size_t mappedSize = 0;
+    uint64_t rows = 0;
+    std::vector<ResultsGroup> groups;
+};
+
+/**
+ * @brief Row filter of a query. Every condition that is set must hold.
+ */
+struct ResultsFilter {
+    uint8_t numPlayers = 0;           // 0 for any player count
+    uint8_t requiredRoles = 0;        // Bit r set: role r must be at the table
+    uint8_t excludedRoles = 0;        // Bit r set: role r must not be at the table
+    bool decidedOnly = false;         // Skip games that stopped without a winner
+    uint32_t minPlies = 0;
+    uint32_t maxPlies = UINT32_MAX;
+
+    ResultsFilter& players(uint8_t n) { numPlayers = n; return *this; }
+    ResultsFilter& with(Role role) { requiredRoles |= static_cast<uint8_t>(1u << static_cast<int>(role)); return *this; }
+    ResultsFilter& without(Role role) { excludedRoles |= static_cast<uint8_t>(1u << static_cast<int>(role)); return *this; }
+    ResultsFilter& decided() { decidedOnly = true; return *this; }
+};
+
+/**
+ * @brief Aggregates over the rows selected by a filter.
+ */
+struct ResultsSummary {
+    uint64_t games = 0;
+    uint64_t decided = 0;
+    uint64_t gamesWithRole[NUM_ROLES] = {};
+    uint64_t winsByRole[NUM_ROLES] = {};
+    uint64_t winsBySeat[MAX_PLAYERS] = {};
+    uint64_t plies = 0;
+    uint64_t coups = 0;
+    uint64_t blocks = 0;
+
+    // Share of the selected games with this role at the table that this role won
+    double winRate(Role role) const {
+        const size_t r = static_cast<size_t>(role);
+        return gamesWithRole[r] ? static_cast<double>(winsByRole[r]) / gamesWithRole[r] : 0;
+    }
+    double meanPlies() const { return games ? static_cast<double>(plies) / games : 0; }
+    double meanCoups() const { return games ? static_cast<double>(coups) / games : 0; }
+    double meanBlocks() const { return games ? static_cast<double>(blocks) / games : 0; }
+
+    /**
+     * @brief Counts one more game.
+     */
+    void add(const GameResult& result);
+
+    /**
+     * @brief Adds the counts of another summary (of other games).
+     */
+    void merge(const ResultsSummary& other);
+};
+
+/**
+ * @brief Runs a filter and the standard aggregates over a results file, one column at a time.
+ *
+ * @param results The results file.
+ * @param filter The rows to select.
+ * @return ResultsSummary Counts, wins by role and by seat, and totals of the selected rows.
+ */
+ResultsSummary queryResults(const ResultsReader& results, const ResultsFilter& filter);
+
+} // namespace coup
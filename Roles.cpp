@@ -0,0 +1,70 @@
+// email: shiraba01@gmail.com
+#include "Roles.hpp"
+#include "Governor.hpp"
+#include "Spy.hpp"
+#include "Baron.hpp"
+#include "General.hpp"
+#include "Judge.hpp"
+#include "Merchant.hpp"
+
+#include <stdexcept>
+
+namespace coup {
+
+/**
+ * @brief Returns the role name as used by Player::getRole().
+ *
+ * @param role The role code.
+ * @return const char* The role name.
+ */
+const char* roleName(Role role) {
+    switch (role) {
+        case Role::Governor: return "Governor";
+        case Role::Spy:      return "Spy";
+        case Role::Baron:    return "Baron";
+        case Role::General:  return "General";
+        case Role::Judge:    return "Judge";
+        case Role::Merchant: return "Merchant";
+    }
+    return "Unknown";
+}
+
+/**
+ * @brief Parses a role name.
+ *
+ * @param name The role name (e.g., "Spy").
+ * @return Role The matching role code.
+ * @throws std::invalid_argument if the name is not a known role.
+ */
+Role parseRole(const std::string& name) {
+    for (size_t i = 0; i < NUM_ROLES; ++i) {
+        Role role = static_cast<Role>(i);
+        if (name == roleName(role)) {
+            return role;
+        }
+    }
+    throw std::invalid_argument("Unknown role: " + name);
+}
+
+/**
+ * @brief Creates a player of the given role and registers them in the game.
+ *
+ * @param game The game the player joins.
+ * @param role The role of the new player.
+ * @param name The name of the player.
+ * @return std::unique_ptr<Player> The new player.
+ * @throws std::invalid_argument if the role code is invalid.
+ */
+std::unique_ptr<Player> makePlayer(Game& game, Role role, const std::string& name) {
+    switch (role) {
+        case Role::Governor: return std::make_unique<Governor>(game, name);
+        case Role::Spy:      return std::make_unique<Spy>(game, name);
+        case Role::Baron:    return std::make_unique<Baron>(game, name);
+        case Role::General:  return std::make_unique<General>(game, name);
+        case Role::Judge:    return std::make_unique<Judge>(game, name);
+        case Role::Merchant: return std::make_unique<Merchant>(game, name);
+    }
+    throw std::invalid_argument("Invalid role code.");
+}
+
+} // namespace coup
@@ -0,0 +1,52 @@
+// email: shiraba01@gmail.com
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace coup {
+
+class Game;
+class Player;
+
+// Number of distinct roles
+constexpr size_t NUM_ROLES = 6;
+
+/**
+ * @brief Compact code of a player role (used by replays and result files).
+ */
+enum class Role : uint8_t {
+    Governor = 0,
+    Spy = 1,
+    Baron = 2,
+    General = 3,
+    Judge = 4,
+    Merchant = 5
+};
+
+/**
+ * @brief Returns the role name as used by Player::getRole() (e.g., "Governor").
+ */
+const char* roleName(Role role);
+
+/**
+ * @brief Parses a role name as returned by Player::getRole().
+ *
+ * @param name The role name.
+ * @return Role The matching role code.
+ * @throws std::invalid_argument if the name is not a known role.
+ */
+Role parseRole(const std::string& name);
+
+/**
+ * @brief Creates a player of the given role and registers them in the game.
+ *
+ * @param game The game the player joins.
+ * @param role The role of the new player.
+ * @param name The name of the player.
+ * @return std::unique_ptr<Player> The new player (must not outlive the game).
+ */
+std::unique_ptr<Player> makePlayer(Game& game, Role role, const std::string& name);
+
+} // namespace coup
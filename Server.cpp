@@ -0,0 +1,275 @@
+// email: shiraba01@gmail.com
+#include "Server.hpp"
+#include "ServerShard.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace coup {
+
+/**
+ * @brief Opens the listening socket and creates the shards.
+ *
+ * @param options Address, limits and shard count.
+ * @throws std::invalid_argument if the shard count is out of range or the output watermarks
+ *         are not ordered (low <= high <= limit).
+ * @throws std::runtime_error if the socket cannot be created, bound or listened on,
+ *         the standby cannot be reached, or the write-ahead logs cannot be opened or replayed.
+ */
+GameServer::GameServer(const ServerOptions& options) : options(options) {
+    if (options.shards < 1 || options.shards > 64) {
+        throw std::invalid_argument("A server needs between 1 and 64 shards.");
+    }
+    if (options.outputLowWater > options.outputHighWater || options.outputHighWater > options.outputLimit) {
+        throw std::invalid_argument("Output watermarks must satisfy low <= high <= limit.");
+    }
+    const bool local = !options.unixPath.empty();
+    listenFd = ::socket(local ? AF_UNIX : AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd < 0) {
+        throw std::runtime_error("Cannot create the server socket.");
+    }
+    int bound;
+    if (local) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (options.unixPath.size() >= sizeof(address.sun_path)) {
+            ::close(listenFd);
+            throw std::runtime_error("Unix socket path too long: " + options.unixPath);
+        }
+        std::memcpy(address.sun_path, options.unixPath.c_str(), options.unixPath.size() + 1);
+        ::unlink(options.unixPath.c_str());
+        bound = ::bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    } else {
+        const int yes = 1;
+        ::setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(options.port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bound = ::bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        socklen_t length = sizeof(address);
+        if (bound == 0 && ::getsockname(listenFd, reinterpret_cast<sockaddr*>(&address), &length) == 0) {
+            boundPort = ntohs(address.sin_port);
+        }
+    }
+    if (bound != 0 || ::listen(listenFd, SOMAXCONN) != 0) {
+        ::close(listenFd);
+        throw std::runtime_error("Cannot listen on " + (local ? options.unixPath : "port " + std::to_string(options.port)));
+    }
+
+    try {
+        std::vector<ServerShard*> links;
+        for (size_t shard = 0; shard < options.shards; ++shard) {
+            shards.push_back(std::make_unique<ServerShard>(options, shard, options.shards, shard == 0 ? listenFd : -1));
+            links.push_back(shards.back().get());
+        }
+        for (auto& shard : shards) {
+            shard->link(links);
+            if (!options.standbyPath.empty()) shard->connectStandby(options.standbyPath);
+            if (!options.walDirectory.empty()) shard->openLog();
+        }
+    } catch (...) {
+        for (auto& shard : shards) {
+            shard->closeLog();
+        }
+        shards.clear();
+        ::close(listenFd);
+        throw;
+    }
+}
+
+namespace {
+
+// The options of a server taking over the tables of a standby
+ServerOptions takeoverOptions(ServerOptions options, size_t shards) {
+    if (shards == 0) {
+        throw std::invalid_argument("Nothing to take over.");
+    }
+    if (!options.standbyPath.empty()) {
+        throw std::invalid_argument("A server taking over tables cannot feed a standby.");
+    }
+    if (!options.walDirectory.empty()) {
+        throw std::invalid_argument("A server taking over tables cannot start a write-ahead log.");
+    }
+    options.shards = shards;
+    return options;
+}
+
+} // namespace
+
+/**
+ * @brief Opens a server that takes over the tables a Standby followed, one registry per shard.
+ *
+ * @param options Address and limits (the shard count is that of the registries).
+ * @param tables Tables of each shard, from Standby::takeTables().
+ * @throws std::invalid_argument if there are no registries, the options name a standby or a
+ *         walDirectory, or as above.
+ * @throws std::runtime_error as above.
+ */
+GameServer::GameServer(const ServerOptions& options, std::vector<TableRegistry> tables)
+    : GameServer(takeoverOptions(options, tables.size())) {
+    for (size_t shard = 0; shard < shards.size(); ++shard) {
+        shards[shard]->restore(std::move(tables[shard]));
+    }
+}
+
+/**
+ * @brief Closes every connection and the listening socket.
+ */
+GameServer::~GameServer() {
+    for (auto& shard : shards) {
+        shard->closeLog();      // Their threads wake every shard
+    }
+    shards.clear();
+    ::close(listenFd);
+    if (!options.unixPath.empty()) {
+        ::unlink(options.unixPath.c_str());
+    }
+}
+
+/**
+ * @brief Runs one round of the event loop of every shard from the calling thread.
+ *
+ * @param timeoutMs Longest wait for an event of shard 0 (-1 waits forever).
+ * @return size_t Number of events handled.
+ * @throws std::runtime_error if epoll fails, or a write-ahead log cannot be written.
+ */
+size_t GameServer::poll(int timeoutMs) {
+    size_t handled = 0;
+    for (size_t shard = 0; shard < shards.size(); ++shard) {
+        handled += shards[shard]->poll(shard == 0 ? timeoutMs : 0);
+    }
+    return handled;
+}
+
+/**
+ * @brief Runs every shard on its own thread (shard 0 on the calling one) until stop becomes true.
+ *
+ * A shard whose loop fails stops the others; once every thread is joined,
+ * the first error is rethrown.
+ *
+ * @param stop Checked by every shard at least every 100 ms.
+ * @throws std::runtime_error if epoll fails, or a write-ahead log cannot be written.
+ */
+void GameServer::run(const std::atomic<bool>& stop) {
+    std::atomic<bool> failed{false};
+    std::vector<std::exception_ptr> errors(shards.size());
+    auto loop = [this, &stop, &failed, &errors](size_t shard) {
+        try {
+            while (!stop.load(std::memory_order_relaxed) && !failed.load(std::memory_order_relaxed)) {
+                shards[shard]->poll(100);
+            }
+        } catch (...) {
+            errors[shard] = std::current_exception();
+            failed.store(true, std::memory_order_relaxed);
+        }
+    };
+    std::vector<std::thread> threads;
+    try {
+        for (size_t shard = 1; shard < shards.size(); ++shard) {
+            threads.emplace_back(loop, shard);
+        }
+    } catch (...) {
+        errors[0] = std::current_exception();
+        failed.store(true, std::memory_order_relaxed);
+    }
+    loop(0);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    for (const std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+/**
+ * @brief Returns the counters of all shards added up.
+ */
+ServerStats GameServer::stats() const {
+    ServerStats total;
+    for (const auto& shard : shards) {
+        const ServerStats& counters = shard->stats();
+        total.connections += counters.connections;
+        total.accepted += counters.accepted;
+        total.rejected += counters.rejected;
+        total.commands += counters.commands;
+        total.errors += counters.errors;
+        total.frames += counters.frames;
+        total.deltas += counters.deltas;
+        total.spectators += counters.spectators;
+        total.spectatorFrames += counters.spectatorFrames;
+        total.keyframes += counters.keyframes;
+        total.bytesIn += counters.bytesIn;
+        total.bytesOut += counters.bytesOut;
+        total.writes += counters.writes;
+        total.queuedSlices += counters.queuedSlices;
+        total.bytesInFlight += counters.bytesInFlight;
+        total.pausedConnections += counters.pausedConnections;
+        total.pauses += counters.pauses;
+        total.overflows += counters.overflows;
+        total.deadlines += counters.deadlines;
+        total.turnTimeouts += counters.turnTimeouts;
+        total.windowTimeouts += counters.windowTimeouts;
+        total.logBytes += counters.logBytes;
+        total.logPending += counters.logPending;
+        total.standbyLost += counters.standbyLost;
+        total.queueDepth += counters.queueDepth;
+        total.roundMicros = std::max(total.roundMicros, counters.roundMicros);
+        total.shedCreates += counters.shedCreates;
+        total.shedWatches += counters.shedWatches;
+        total.shedStreams += counters.shedStreams;
+        total.shedForDepth += counters.shedForDepth;
+        total.shedForLatency += counters.shedForLatency;
+        total.walBytes += counters.walBytes;
+        total.walCommits += counters.walCommits;
+        total.walCompactions += counters.walCompactions;
+        total.walHeld += counters.walHeld;
+        total.recoveredTables += counters.recoveredTables;
+    }
+    return total;
+}
+
+/**
+ * @brief Returns up to n of the tables that cost their shard the most CPU, hottest first.
+ *
+ * Reads the list each shard last published (every usagePublishMs), so it
+ * may be called from any thread while the shards run, without pausing them.
+ *
+ * @param n Tables wanted (at most HOT_TABLES per shard are known).
+ */
+std::vector<TableUsage> GameServer::hottest(size_t n) const {
+    std::vector<ServerShard*> all;
+    for (const auto& shard : shards) {
+        all.push_back(shard.get());
+    }
+    return ServerShard::hottest(all, n);
+}
+
+size_t GameServer::shardOf(uint32_t table) const {
+    return ServerShard::ownerOf(table, shards.size());
+}
+
+const TableRegistry& GameServer::tables(size_t shard) const {
+    return shards.at(shard)->tables();
+}
+
+size_t GameServer::tableCount() const {
+    size_t total = 0;
+    for (const auto& shard : shards) {
+        total += shard->tables().size();
+    }
+    return total;
+}
+
+} // namespace coup
@@ -0,0 +1,264 @@
+// email: shiraba01@gmail.com
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Simulator.hpp"
+#include "TableRegistry.hpp"
+#include "Wire.hpp"
+
+namespace coup {
+
+/**
+ * Text protocol: one command per line, one reply line per command.
+ *
+ *   CREATE <players> [seed] [react]      -> OK <table>
+ *   JOIN <table> <name>                  -> OK <seat> <role>
+ *   ACT <table> <seat> <action> [target] -> OK <plies>
+ *   STATE <table>                        -> STATE <table> <waiting|playing|reacting|over> <joined>/<players>
+ *                                           turn=<seat> bank=<coins> coins=<c0,c1,...> alive=<0/1 per seat>
+ *                                           [react=<0/1 per seat>] winner=<seat or -1> plies=<n>
+ *   LEAVE <table>                        -> OK
+ *   PING                                 -> PONG
+ *   TOP [n]                              -> TOP <k> followed by k entries <table>:<actions>:<cpu-ns>:
+ *                                           <max-action-ns>:<mean-latency-ns>:<max-latency-ns>
+ *
+ * Actions use the names of actionName() ("gather", "blockCoup"...). A command
+ * that fails is answered with "ERR <reason>" and leaves the connection open.
+ * A table created with "react" holds reaction windows (see TurnFlow): after
+ * a tax, bribe or coup, the seats listed by react= answer with the matching
+ * block or with "pass" before anyone else may act.
+ *
+ * With ServerOptions::turnTimeoutMs set, a player who has not moved in time
+ * gathers (or makes the first legal move that ends the turn, see
+ * TableRegistry::expire), whether or not their client is still connected;
+ * with reactionWindowMs set, a reaction window closes as if the seats still
+ * listed by react= had passed. These moves reach seated binary clients and
+ * spectators as Deltas, like any other.
+ *
+ * TOP lists the tables that cost their shard the most CPU, hottest first
+ * (n defaults to 10, at most HOT_TABLES), as GameServer::hottest() does.
+ *
+ * A connection whose first byte is FRAME_MAGIC speaks the binary protocol of
+ * Wire.hpp instead, and receives a Delta after every action at its tables.
+ * Binary clients may also watch tables as spectators.
+ */
+
+// Most tables each shard publishes for TOP and GameServer::hottest()
+constexpr size_t HOT_TABLES = 64;
+
+/**
+ * @brief What the actions of one table cost its shard.
+ *
+ * CPU time counts the execution of each action with its reply and the
+ * broadcast of its Delta; latency runs from the start of the shard's round
+ * (when the command was read, or reached the shard) to the end of the
+ * action, so it includes the commands served before it in that round.
+ */
+struct TableUsage {
+    uint32_t table = 0;
+    uint64_t actions = 0;                 // Actions applied, by clients and by deadlines
+    uint64_t cpuNs = 0;
+    uint64_t maxActionNs = 0;             // CPU time of the most expensive action
+    uint64_t latencyNs = 0;               // Summed over the actions
+    uint64_t maxLatencyNs = 0;
+};
+
+/**
+ * @brief Settings of a GameServer.
+ */
+struct ServerOptions {
+    uint16_t port = 0;                    // TCP port on 127.0.0.1 (0 picks a free port)
+    std::string unixPath;                 // Listen on this Unix socket instead of TCP when set
+    size_t maxConnections = 1 << 16;      // Connections over the limit are closed at once
+    size_t maxLineLength = 4096;          // A longer command closes the connection
+    uint64_t seed = 1;                    // Seeds the tables created without a seed
+    uint32_t keyframeInterval = 32;       // Spectators get a Keyframe every this many plies (0: never)
+    size_t shards = 1;                    // Event loops, one thread each (1 to 64)
+    size_t outputHighWater = 256 << 10;   // Unsent bytes above which a connection is no longer read...
+    size_t outputLowWater = 64 << 10;     // ...until they are back under this
+    size_t outputLimit = 8 << 20;         // Unsent bytes that close the connection (slow spectators)
+    int socketSendBuffer = 0;             // SO_SNDBUF of accepted sockets (0 keeps the system's autotuning)
+    uint32_t turnTimeoutMs = 0;           // A player who has not moved by then gathers (0: no limit)
+    uint32_t reactionWindowMs = 0;        // Open reaction windows close with passes after this (0: no limit)
+    std::string standbyPath;              // Unix socket of a Standby fed every shard's action log (empty: none)
+    uint32_t overloadDepth = 0;           // Smoothed commands per round over which a shard refuses CREATE (0: no limit)
+    uint32_t overloadLatencyUs = 0;       // Smoothed busy time per round over which it does too (0: no limit)
+    uint32_t spectatorShedPercent = 50;   // Share of those limits from which a shard drops and refuses spectators
+    uint32_t usagePublishMs = 100;        // A shard publishes its hottest tables this often (0: every round)
+    std::string walDirectory;             // Each shard keeps a WriteAheadLog of its tables here (empty: none)
+    uint32_t walCommitMs = 2;             // Group commit: a shard's log syncs at most this often, for every action since
+    uint64_t walCompactBytes = 64 << 20;  // Log a shard appends before it compacts its snapshot (0: never)
+};
+
+/**
+ * @brief Counters of a GameServer.
+ */
+struct ServerStats {
+    uint64_t connections = 0;             // Open connections
+    uint64_t accepted = 0;
+    uint64_t rejected = 0;                // Closed at once because of maxConnections
+    uint64_t commands = 0;                // Text commands and binary messages
+    uint64_t errors = 0;                  // Commands answered with ERR or an error code
+    uint64_t frames = 0;                  // Binary frames received
+    uint64_t deltas = 0;                  // Delta messages pushed to seated binary clients
+    uint64_t spectators = 0;              // Open Watch subscriptions
+    uint64_t spectatorFrames = 0;         // Shared delta frames queued to spectators
+    uint64_t keyframes = 0;               // Keyframes encoded (once per action, whatever the audience)
+    uint64_t bytesIn = 0;
+    uint64_t bytesOut = 0;
+    uint64_t writes = 0;                  // sendmsg calls
+    uint64_t queuedSlices = 0;            // Output slices waiting for their socket (queue depth)
+    uint64_t bytesInFlight = 0;           // Unsent output bytes of every connection
+    uint64_t pausedConnections = 0;       // Not read until their output drains below outputLowWater
+    uint64_t pauses = 0;                  // Times a connection went over outputHighWater
+    uint64_t overflows = 0;               // Connections closed for going over outputLimit
+    uint64_t deadlines = 0;               // Armed turn and reaction deadlines
+    uint64_t turnTimeouts = 0;            // Moves played for a player who ran out of time
+    uint64_t windowTimeouts = 0;          // Reaction windows closed by their deadline
+    uint64_t logBytes = 0;                // Action log handed to the standby's socket
+    uint64_t logPending = 0;              // Action log the standby's socket did not take yet
+    uint64_t standbyLost = 0;             // Shards that stopped shipping (the standby closed or fell behind)
+    uint64_t queueDepth = 0;              // Smoothed commands per round, added up over the shards
+    uint64_t roundMicros = 0;             // Smoothed busy time per round, of the busiest shard
+    uint64_t shedCreates = 0;             // CREATE refused by an overloaded shard
+    uint64_t shedWatches = 0;             // Watch refused by a shard shedding spectators
+    uint64_t shedStreams = 0;             // Spectator subscriptions dropped to shed load
+    uint64_t shedForDepth = 0;            // Sheds above because of the queue depth...
+    uint64_t shedForLatency = 0;          // ...and because of the busy time
+    uint64_t walBytes = 0;                // Action log written to the write-ahead logs
+    uint64_t walCommits = 0;              // Batches synced (fdatasync calls)
+    uint64_t walCompactions = 0;          // Snapshots rewritten
+    uint64_t walHeld = 0;                 // Connections whose output waits for a commit
+    uint64_t recoveredTables = 0;         // Tables rebuilt from the write-ahead logs at startup
+};
+
+class ServerShard;
+
+/**
+ * @brief Game server: many tables, many clients, one epoll loop per shard.
+ *
+ * Sockets are non-blocking. Each readable connection is drained and every
+ * complete line or frame is executed against the tables. Replies and deltas
+ * accumulate in the output of each connection during a round of events and
+ * are written at the end of the round in one sendmsg per connection, which
+ * gathers the queued slices (the reply buffer and frames shared with other
+ * connections); what does not fit in the socket buffer waits for EPOLLOUT.
+ * A connection whose unsent output goes over outputHighWater is not read
+ * any more, so a client cannot queue replies faster than it reads them,
+ * until the output drains under outputLowWater; one over outputLimit (a
+ * spectator that stopped reading) is closed. A client leaves its tables
+ * when it disconnects.
+ *
+ * With a standbyPath, every shard streams the action log of its tables to
+ * a Standby (see there) at the end of each round, before the replies; a
+ * new server built from the standby's tables takes over after a crash.
+ *
+ * Admission control: a shard whose smoothed queue depth or busy time per
+ * round reaches spectatorShedPercent of overloadDepth or overloadLatencyUs
+ * drops its spectator streams and refuses new Watches; at the limit itself
+ * it refuses CREATE too (text "ERR Server overloaded", binary Overloaded),
+ * so the tables already running keep their turn latency.
+ *
+ * With a walDirectory, the tables survive a crash of the server: every
+ * shard appends the action log of each round to its WriteAheadLog, whose
+ * thread syncs it in groups at most every walCommitMs, and a reply (or Delta)
+ * reaches its client only once the actions before it are on disk. A server
+ * started on the same directory, with the same shard count, rebuilds the
+ * tables from each shard's snapshot and log tail, every seat empty, and the
+ * players rejoin under their names as after a takeover.
+ *
+ * With several shards, tables and connections are partitioned among them
+ * (see ServerShard): shard 0 accepts connections and deals them out in turn,
+ * and a command for a table of another shard is forwarded to it.
+ */
+class GameServer {
+public:
+    /**
+     * @brief Opens the listening socket and creates the shards.
+     *
+     * @throws std::invalid_argument if the shard count is out of range or the output watermarks
+     *         are not ordered (low <= high <= limit).
+     * @throws std::runtime_error if the socket cannot be created, bound or listened on,
+     *         the standby cannot be reached, or the write-ahead logs cannot be opened or replayed.
+     */
+    explicit GameServer(const ServerOptions& options = ServerOptions());
+
+    /**
+     * @brief Opens a server that takes over the tables a Standby followed, one registry per shard.
+     *
+     * Every seat starts empty; players get theirs back by joining under their
+     * names. The shard count of the options is replaced by the number of registries.
+     *
+     * @throws std::invalid_argument as above, if there are no registries, or if the options
+     *         name a standby or a walDirectory (the new log would miss the tables taken over).
+     * @throws std::runtime_error as above.
+     */
+    GameServer(const ServerOptions& options, std::vector<TableRegistry> tables);
+
+    /**
+     * @brief Closes every connection and the listening socket.
+     */
+    ~GameServer();
+
+    GameServer(const GameServer&) = delete;
+    GameServer& operator=(const GameServer&) = delete;
+
+    // TCP port the server listens on (0 for a Unix socket)
+    uint16_t port() const { return boundPort; }
+
+    /**
+     * @brief Runs one round of the event loop of every shard from the calling thread.
+     *
+     * @param timeoutMs Longest wait for an event of shard 0 (-1 waits forever);
+     *        the other shards do not wait.
+     * @return size_t Number of events handled.
+     * @throws std::runtime_error if epoll fails, or a write-ahead log cannot be written.
+     */
+    size_t poll(int timeoutMs);
+
+    /**
+     * @brief Runs every shard on its own thread (shard 0 on the calling one) until stop becomes true.
+     *
+     * @throws std::runtime_error if a shard fails as poll() does (after stopping every shard).
+     */
+    void run(const std::atomic<bool>& stop);
+
+    /**
+     * @brief Returns the counters of all shards added up (call it while the shards are not running).
+     */
+    ServerStats stats() const;
+
+    size_t shardCount() const { return shards.size(); }
+
+    // Index of the shard that owns a table
+    size_t shardOf(uint32_t table) const;
+
+    // Tables of one shard (all of them with a single shard)
+    const TableRegistry& tables(size_t shard = 0) const;
+
+    /**
+     * @brief Returns up to n of the tables that cost their shard the most CPU, hottest first.
+     *
+     * Reads the list each shard last published (every usagePublishMs), so it
+     * may be called from any thread while the shards run, without pausing them.
+     *
+     * @param n Tables wanted (at most HOT_TABLES per shard are known).
+     */
+    std::vector<TableUsage> hottest(size_t n) const;
+
+    // Number of tables open on all shards
+    size_t tableCount() const;
+
+private:
+    ServerOptions options;
+    int listenFd = -1;
+    uint16_t boundPort = 0;
+    std::vector<std::unique_ptr<ServerShard>> shards;
+};
+
+} // namespace coup
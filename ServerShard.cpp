@@ -0,0 +1,1820 @@
+// email: shiraba01@gmail.com
+#include "ServerShard.hpp"
+#include "CycleClock.hpp"
+#include "Standby.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace coup {
+
+namespace {
+
+// Events fetched per epoll_wait
+constexpr int MAX_EVENTS = 256;
+
+// Bytes read per recv
+constexpr size_t READ_CHUNK = 1 << 16;
+
+// Output slices gathered by one sendmsg
+constexpr size_t MAX_WRITE_SLICES = 64;
+
+// Messages each shard can queue for another before they wait in its outbox
+constexpr size_t SHARD_QUEUE_CAPACITY = 1024;
+
+// Wall time over which the load signals of a shard are smoothed
+constexpr double LOAD_WINDOW_MS = 50;
+
+// Load, in percent of the overload limits, at which a shard refuses new tables
+constexpr uint32_t OVERLOADED_PERCENT = 100;
+
+// Tables listed by TOP without a count
+constexpr size_t DEFAULT_TOP = 10;
+
+/**
+ * @brief Splits the next space-separated token off the front of a line.
+ *
+ * @return true if a token was found.
+ */
+bool nextToken(std::string_view& rest, std::string_view& token) {
+    size_t begin = rest.find_first_not_of(' ');
+    if (begin == std::string_view::npos) {
+        rest = std::string_view();
+        return false;
+    }
+    size_t end = rest.find(' ', begin);
+    if (end == std::string_view::npos) end = rest.size();
+    token = rest.substr(begin, end - begin);
+    rest.remove_prefix(end);
+    return true;
+}
+
+/**
+ * @brief Parses the next token as an unsigned number.
+ *
+ * @throws std::invalid_argument if the token is missing or not a number.
+ */
+template <typename T>
+T nextNumber(std::string_view& rest, const char* what) {
+    std::string_view token;
+    T value = 0;
+    if (!nextToken(rest, token)) {
+        throw std::invalid_argument(std::string("Missing ") + what + ".");
+    }
+    auto [end, ec] = std::from_chars(token.data(), token.data() + token.size(), value);
+    if (ec != std::errc() || end != token.data() + token.size()) {
+        throw std::invalid_argument(std::string("Invalid ") + what + ".");
+    }
+    return value;
+}
+
+/**
+ * @brief Returns the table a text command is about, or 0 for CREATE, PING and unparsable lines.
+ */
+uint32_t tableOfLine(std::string_view line) {
+    std::string_view rest = line;
+    std::string_view command;
+    std::string_view token;
+    if (!nextToken(rest, command) || !(command == "ACT" || command == "JOIN" || command == "STATE" || command == "LEAVE") ||
+        !nextToken(rest, token)) {
+        return 0;
+    }
+    uint32_t table = 0;
+    auto [end, ec] = std::from_chars(token.data(), token.data() + token.size(), table);
+    return ec == std::errc() && end == token.data() + token.size() ? table : 0;
+}
+
+/**
+ * @brief Appends a zeroed binary message of type T to a byte string and returns it.
+ */
+template <typename T>
+T& addMessage(std::string& bytes) {
+    const size_t at = bytes.size();
+    bytes.append(sizeof(T), '\0');
+    return *reinterpret_cast<T*>(&bytes[at]);
+}
+
+void appendStatus(std::string& out, const TableStatus& status) {
+    out += "STATE ";
+    out += std::to_string(status.id);
+    out += status.over ? " over " : status.reacting ? " reacting " : status.started ? " playing " : " waiting ";
+    out += std::to_string(status.joined);
+    out += '/';
+    out += std::to_string(status.numPlayers);
+    out += " turn=";
+    out += std::to_string(status.turn);
+    out += " bank=";
+    out += std::to_string(status.bank);
+    out += " coins=";
+    for (size_t seat = 0; seat < status.numPlayers; ++seat) {
+        if (seat) out += ',';
+        out += std::to_string(status.coins[seat]);
+    }
+    out += " alive=";
+    for (size_t seat = 0; seat < status.numPlayers; ++seat) {
+        out += (status.aliveMask >> seat) & 1 ? '1' : '0';
+    }
+    if (status.reacting) {
+        out += " react=";
+        for (size_t seat = 0; seat < status.numPlayers; ++seat) {
+            out += (status.reactors >> seat) & 1 ? '1' : '0';
+        }
+    }
+    out += " winner=";
+    out += std::to_string(status.winner);
+    out += " plies=";
+    out += std::to_string(status.plies);
+    out += '\n';
+}
+
+} // namespace
+
+/**
+ * @brief Creates the epoll instance and the wake-up eventfd of the shard.
+ *
+ * @param options Options of the server.
+ * @param index Index of the shard.
+ * @param count Number of shards.
+ * @param listenFd Listening socket to accept from (shard 0 only), or -1.
+ * @throws std::runtime_error if epoll or the eventfd cannot be created.
+ */
+ServerShard::ServerShard(const ServerOptions& options, size_t index, size_t count, int listenFd)
+    : options(options),
+      index(index),
+      count(count),
+      maxConnections(std::max<size_t>(1, options.maxConnections / count)),
+      listenFd(listenFd),
+      nextClient(index + 1),
+      seeds(options.seed + index),
+      registry(static_cast<uint32_t>(index + 1), static_cast<uint32_t>(count)),
+      outbox(count),
+      wake(count, false) {
+    epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.ptr = this;          // The eventfd
+    bool ok = epollFd >= 0 && wakeFd >= 0 && ::epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event) == 0;
+    if (ok && listenFd >= 0) {
+        event.data.ptr = nullptr;   // The listening socket
+        ok = ::epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event) == 0;
+    }
+    if (!ok) {
+        if (epollFd >= 0) ::close(epollFd);
+        if (wakeFd >= 0) ::close(wakeFd);
+        throw std::runtime_error("Cannot create the epoll instance.");
+    }
+    epoch = std::chrono::steady_clock::now();
+    lastRound = epoch;
+    cyclesPerNs();      // Calibrated once, before the first round
+    published.store(std::make_shared<const std::vector<TableUsage>>());
+    inbox.resize(count);
+    for (size_t shard = 0; shard < count; ++shard) {
+        if (shard != index) inbox[shard] = std::make_unique<SpscQueue<ShardMessage>>(SHARD_QUEUE_CAPACITY);
+    }
+}
+
+/**
+ * @brief Closes the connections of the shard and those still waiting in its queues.
+ */
+ServerShard::~ServerShard() {
+    closeLog();
+    shipLog();
+    if (standbyFd >= 0) ::close(standbyFd);
+    for (auto& entry : connections) {
+        ::close(entry.first);
+    }
+    ShardMessage message;
+    for (auto& queue : inbox) {
+        while (queue && queue->pop(message)) {
+            if (message.kind == ShardMessage::Kind::Connect) ::close(message.fd);
+        }
+    }
+    for (auto& pending : outbox) {
+        for (ShardMessage& queued : pending) {
+            if (queued.kind == ShardMessage::Kind::Connect) ::close(queued.fd);
+        }
+    }
+    ::close(wakeFd);
+    ::close(epollFd);
+}
+
+/**
+ * @brief Gives the shard the other shards of its server (before the first poll).
+ *
+ * @param shards Every shard of the server, by index.
+ */
+void ServerShard::link(const std::vector<ServerShard*>& shards) {
+    peers = shards;
+}
+
+/**
+ * @brief Runs one round of events and of messages from other shards.
+ *
+ * @param timeoutMs Longest wait for an event (-1 waits forever).
+ * @return size_t Number of events and messages handled.
+ * @throws std::runtime_error if epoll fails, or the write-ahead log cannot be written.
+ */
+size_t ServerShard::poll(int timeoutMs) {
+    if (wal && wal->failed()) {
+        throw std::runtime_error("Cannot write the write-ahead log.");
+    }
+    const auto roundStart = std::chrono::steady_clock::now();
+    const uint64_t commandsBefore = counters.commands;
+    roundCycles = cycleCount();
+    nowMs = clockMs();
+    size_t handled = receive();
+    for (const uint64_t client : std::exchange(resumed, {})) {
+        auto it = clients.find(client);
+        if (it != clients.end() && !it->second->closing) {
+            readInput(*it->second);
+            handled++;
+        }
+    }
+    bool backlog = standbyFd >= 0 && !journal.empty();
+    for (const auto& pending : outbox) backlog = backlog || !pending.empty();
+    if (handled > 0) {
+        timeoutMs = 0;
+    } else if (backlog && (timeoutMs < 0 || timeoutMs > 1)) {
+        timeoutMs = 1;      // Retry the outboxes soon
+    }
+    const uint64_t next = timers.nextEvent();
+    if (next != TimerWheel::NO_EVENT && timeoutMs != 0) {
+        const uint64_t wait = next > nowMs ? next - nowMs : 0;
+        if (timeoutMs < 0 || wait < static_cast<uint64_t>(timeoutMs)) timeoutMs = static_cast<int>(wait);
+    }
+
+    epoll_event events[MAX_EVENTS];
+    const auto waitStart = std::chrono::steady_clock::now();
+    const int ready = ::epoll_wait(epollFd, events, MAX_EVENTS, timeoutMs);
+    if (ready < 0 && errno != EINTR) {
+        throw std::runtime_error("epoll_wait failed.");
+    }
+    const auto waitEnd = std::chrono::steady_clock::now();
+    roundCycles = cycleCount();
+    nowMs = clockMs();
+    shedSpectators();
+    for (int i = 0; i < ready; ++i) {
+        if (events[i].data.ptr == this) {
+            uint64_t wakeups;
+            while (::read(wakeFd, &wakeups, sizeof(wakeups)) > 0) {
+            }
+            handled += receive();
+            continue;
+        }
+        Connection* connection = static_cast<Connection*>(events[i].data.ptr);
+        if (!connection) {
+            acceptAll();
+            continue;
+        }
+        if (connection->closing) {
+            continue;
+        }
+        if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+            onReadable(*connection);
+        }
+        if (!connection->closing && (events[i].events & EPOLLOUT)) {
+            flush(*connection);
+        }
+    }
+    expireDeadlines();
+    commitLog();        // Before the replies: an acknowledged action is already on its way to the standby
+    releaseHeld();
+    for (Connection* connection : dirty) {
+        connection->dirty = false;
+        if (!connection->closing) {
+            connection->frames.finish();
+            flush(*connection);
+        }
+    }
+    dirty.clear();
+    sendOutboxes();
+    closed.clear();
+    if (usageChanged && (options.usagePublishMs == 0 || nowMs - usagePublishedMs >= options.usagePublishMs)) {
+        publishUsage();
+    }
+    const auto roundEnd = std::chrono::steady_clock::now();
+    measureLoad(counters.commands - commandsBefore, (waitStart - roundStart) + (roundEnd - waitEnd), roundEnd);
+    return handled + static_cast<size_t>(std::max(ready, 0));
+}
+
+/**
+ * @brief Accepts every pending connection and deals them out to the shards in turn.
+ */
+void ServerShard::acceptAll() {
+    for (;;) {
+        const int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return;     // EAGAIN, or out of descriptors until a connection closes
+        }
+        if (options.unixPath.empty()) {
+            const int yes = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+        }
+        if (options.socketSendBuffer > 0) {
+            ::setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &options.socketSendBuffer, sizeof(options.socketSendBuffer));
+        }
+        const size_t shard = nextShard;
+        nextShard = (nextShard + 1) % count;
+        if (shard == index) {
+            adopt(fd);
+            continue;
+        }
+        ShardMessage message;
+        message.kind = ShardMessage::Kind::Connect;
+        message.fd = fd;
+        send(shard, std::move(message));
+    }
+}
+
+/**
+ * @brief Starts serving an accepted connection, or closes it if the shard is full.
+ */
+void ServerShard::adopt(int fd) {
+    if (connections.size() >= maxConnections) {
+        ::close(fd);
+        counters.rejected++;
+        return;
+    }
+    auto connection = std::make_unique<Connection>();
+    connection->fd = fd;
+    connection->id = nextClient;
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.ptr = connection.get();
+    connection->events = EPOLLIN;
+    if (::epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+        ::close(fd);
+        counters.rejected++;
+        return;
+    }
+    nextClient += count;
+    clients.emplace(connection->id, connection.get());
+    connections.emplace(fd, std::move(connection));
+    counters.accepted++;
+    counters.connections++;
+}
+
+/**
+ * @brief Drains a readable connection and executes every complete line or frame.
+ *
+ * Reading stops early once the unsent output of the connection is over the
+ * high watermark; flush() then pauses the connection.
+ */
+void ServerShard::onReadable(Connection& connection) {
+    char buffer[READ_CHUNK];
+    for (;;) {
+        const ssize_t received = ::recv(connection.fd, buffer, sizeof(buffer), 0);
+        if (received > 0) {
+            counters.bytesIn += static_cast<uint64_t>(received);
+            connection.in.append(buffer, static_cast<size_t>(received));
+            readInput(connection);
+            if (connection.closing || static_cast<size_t>(received) < sizeof(buffer) ||
+                backlogOf(connection) > options.outputHighWater) {
+                return;
+            }
+            continue;
+        }
+        if (received < 0 && errno == EINTR) continue;
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        close(connection);      // Orderly shutdown or error
+        return;
+    }
+}
+
+/**
+ * @brief Executes every complete line or frame received on a connection.
+ */
+void ServerShard::readInput(Connection& connection) {
+    if (connection.protocol == Protocol::Unknown) {
+        connection.protocol = static_cast<uint8_t>(connection.in[0]) == FRAME_MAGIC ? Protocol::Binary : Protocol::Text;
+    }
+    if (connection.protocol == Protocol::Binary) {
+        readFrames(connection);
+    } else {
+        readLines(connection);
+    }
+}
+
+/**
+ * @brief Executes or forwards every complete line of a text connection.
+ *
+ * Stops at the high watermark of the output; the lines left wait until the connection resumes.
+ */
+void ServerShard::readLines(Connection& connection) {
+    size_t begin = 0;
+    bool full = false;
+    for (size_t end; (end = connection.in.find('\n', begin)) != std::string::npos; begin = end + 1) {
+        if (backlogOf(connection) > options.outputHighWater) {
+            full = true;
+            connection.stalled = true;
+            break;
+        }
+        std::string_view line(connection.in.data() + begin, end - begin);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        route(connection, tableOfLine(line), line);
+    }
+    connection.in.erase(0, begin);
+    if (!full && connection.in.size() > options.maxLineLength) {
+        close(connection);
+        return;
+    }
+    markDirty(connection);
+}
+
+/**
+ * @brief Executes or forwards every complete frame of a binary connection, in place in the receive buffer.
+ *
+ * Stops at the high watermark of the output, as readLines() does.
+ * A malformed frame, or a message type a client may not send, closes the connection.
+ */
+void ServerShard::readFrames(Connection& connection) {
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(connection.in.data());
+    size_t offset = 0;
+    for (;;) {
+        FrameView frame;
+        size_t size;
+        try {
+            size = FrameView::parse(data + offset, connection.in.size() - offset, frame);
+        } catch (const std::runtime_error&) {
+            counters.errors++;
+            close(connection);
+            return;
+        }
+        if (size == 0) {
+            break;
+        }
+        if (backlogOf(connection) > options.outputHighWater) {
+            connection.stalled = true;
+            break;
+        }
+        counters.frames++;
+        for (const FrameView::Message& message : frame) {
+            uint32_t table = 0;
+            switch (message.type) {
+                case MessageType::Create: break;
+                case MessageType::Join: table = message.as<JoinMessage>().table; break;
+                case MessageType::Act: table = message.as<ActMessage>().table; break;
+                case MessageType::State: table = message.as<TableMessage>().table; break;
+                case MessageType::Leave:
+                    table = message.as<TableMessage>().table;
+                    unwatch(connection, table);
+                    break;
+                case MessageType::Watch:
+                    table = message.as<TableMessage>().table;
+                    if (shed(options.spectatorShedPercent, counters.shedWatches)) {
+                        refuseWatch(connection, table, message.as<TableMessage>().tag);
+                        continue;       // Answered here: the owner of the table never hears of it
+                    }
+                    break;          // Spectating once the owner answers Ok (see watch())
+                default:
+                    counters.errors++;
+                    close(connection);
+                    return;
+            }
+            route(connection, table,
+                  std::string_view(reinterpret_cast<const char*>(message.data), messageSize(*message.data)));
+        }
+        offset += size;
+    }
+    connection.in.erase(0, offset);
+    markDirty(connection);
+}
+
+/**
+ * @brief Sends the queued slices and the pending replies with one sendmsg per batch of slices.
+ *
+ * Then applies the watermarks: a connection whose unsent output is over
+ * outputLimit is closed, one over outputHighWater is no longer read until
+ * it is back under outputLowWater. Waits for EPOLLOUT while output remains,
+ * unless the output is held for the write-ahead log (see hold()).
+ */
+void ServerShard::flush(Connection& connection) {
+    const bool holding = connection.holdShards != 0 && heldBack(connection);
+    while (!holding) {
+        iovec slices[MAX_WRITE_SLICES];
+        size_t count = 0;
+        size_t total = 0;
+        for (const Slice& slice : connection.queued) {
+            if (count == MAX_WRITE_SLICES) break;
+            const std::string& bytes = slice.bytes();
+            slices[count].iov_base = const_cast<char*>(bytes.data() + slice.offset);
+            slices[count].iov_len = bytes.size() - slice.offset;
+            total += slices[count++].iov_len;
+        }
+        if (count < MAX_WRITE_SLICES && connection.outOffset < connection.out.size()) {
+            slices[count].iov_base = connection.out.data() + connection.outOffset;
+            slices[count].iov_len = connection.out.size() - connection.outOffset;
+            total += slices[count++].iov_len;
+        }
+        if (count == 0) {
+            break;
+        }
+        msghdr message{};
+        message.msg_iov = slices;
+        message.msg_iovlen = count;
+        const ssize_t sent = ::sendmsg(connection.fd, &message, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (sent < 0) {
+            close(connection);
+            return;
+        }
+        counters.writes++;
+        counters.bytesOut += static_cast<uint64_t>(sent);
+        consume(connection, static_cast<size_t>(sent));
+        if (static_cast<size_t>(sent) < total) {
+            break;      // The socket is full
+        }
+    }
+    if (connection.outOffset == connection.out.size()) {
+        connection.out.clear();
+        connection.outOffset = 0;
+    }
+
+    const size_t backlog = backlogOf(connection);
+    if (backlog > options.outputLimit) {
+        counters.overflows++;
+        close(connection);
+        return;
+    }
+    if (!connection.paused && backlog > options.outputHighWater) {
+        connection.paused = true;
+        counters.pauses++;
+        counters.pausedConnections++;
+    } else if (connection.paused && backlog <= options.outputLowWater) {
+        connection.paused = false;
+        counters.pausedConnections--;
+    }
+    if (connection.stalled && !connection.paused) {
+        connection.stalled = false;
+        resumed.push_back(connection.id);          // Run the commands left in its input next round
+    }
+    account(connection);
+    const uint32_t events = (connection.paused ? 0 : EPOLLIN) | (backlog > 0 && !holding ? EPOLLOUT : 0);
+    if (events != connection.events) {
+        epoll_event event{};
+        event.events = events;
+        event.data.ptr = &connection;
+        ::epoll_ctl(epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+        connection.events = events;
+    }
+}
+
+/**
+ * @brief Drops the bytes a sendmsg took off the front of the output of a connection.
+ */
+void ServerShard::consume(Connection& connection, size_t sent) {
+    while (sent > 0 && !connection.queued.empty()) {
+        Slice& slice = connection.queued.front();
+        const size_t left = slice.bytes().size() - slice.offset;
+        if (sent < left) {
+            slice.offset += sent;
+            connection.queuedBytes -= sent;
+            return;
+        }
+        sent -= left;
+        connection.queuedBytes -= left;
+        connection.queued.pop_front();
+    }
+    connection.outOffset += sent;
+}
+
+/**
+ * @brief Holds the output of a connection until the write-ahead log of a shard is durable up to a position.
+ *
+ * @param connection The client that just received an answer or a Delta.
+ * @param shard Shard that produced it.
+ * @param position Log position of that shard when it did (0 without a log).
+ */
+void ServerShard::hold(Connection& connection, size_t shard, uint64_t position) {
+    if (position == 0 || peers[shard]->committed() >= position) {
+        return;
+    }
+    if (connection.holdUntil.empty()) {
+        connection.holdUntil.resize(count, 0);
+    }
+    connection.holdUntil[shard] = std::max(connection.holdUntil[shard], position);
+    connection.holdShards |= uint64_t{1} << shard;
+}
+
+/**
+ * @brief Releases the holds of a connection whose log positions are durable, and lists it if one remains.
+ *
+ * @return true if its output must still wait.
+ */
+bool ServerShard::heldBack(Connection& connection) {
+    for (uint64_t shards = connection.holdShards; shards != 0; shards &= shards - 1) {
+        const size_t shard = static_cast<size_t>(std::countr_zero(shards));
+        if (peers[shard]->committed() >= connection.holdUntil[shard]) {
+            connection.holdShards &= ~(uint64_t{1} << shard);
+        }
+    }
+    if (connection.holdShards != 0 && !connection.held) {
+        connection.held = true;
+        held.push_back(connection.id);
+        counters.walHeld++;
+    }
+    return connection.holdShards != 0;
+}
+
+/**
+ * @brief Flushes, at the end of the round, the held connections whose logs caught up.
+ */
+void ServerShard::releaseHeld() {
+    if (held.empty()) {
+        return;
+    }
+    std::vector<uint64_t> waiting;
+    waiting.swap(held);
+    for (const uint64_t client : waiting) {
+        auto it = clients.find(client);
+        if (it == clients.end() || !it->second->held) {
+            continue;
+        }
+        Connection& connection = *it->second;
+        connection.held = false;
+        counters.walHeld--;
+        if (!connection.closing && !heldBack(connection)) {
+            markDirty(connection);
+        }
+    }
+}
+
+/**
+ * @brief Brings the queue depth and bytes-in-flight counters up to date with a connection.
+ */
+void ServerShard::account(Connection& connection) {
+    const size_t bytes = backlogOf(connection);
+    const size_t slices = connection.queued.size() + (connection.outOffset < connection.out.size() ? 1 : 0);
+    counters.bytesInFlight += bytes - connection.countedBytes;      // Modular: the difference may be negative
+    counters.queuedSlices += slices - connection.countedSlices;
+    connection.countedBytes = bytes;
+    connection.countedSlices = slices;
+}
+
+/**
+ * @brief Executes a command here if this shard owns its table, or forwards it to the owner.
+ *
+ * A forwarded command takes the next slot of the connection, so that its
+ * answer is sent after the answers of the commands before it.
+ *
+ * @param connection The client.
+ * @param table The table of the command, or 0 if it has none.
+ * @param command A text line or a binary message.
+ */
+void ServerShard::route(Connection& connection, uint32_t table, std::string_view command) {
+    const bool binary = connection.protocol == Protocol::Binary;
+    const uint32_t watched = binary && static_cast<MessageType>(command[0]) == MessageType::Watch ? table : 0;
+    const size_t owner = table == 0 ? index : ownerOf(table, count);
+    if (owner == index) {
+        serve(connection.id, 0, binary, command);
+        if (watched != 0) {
+            watch(connection, watched, reply);
+        }
+        return;
+    }
+    ShardMessage message;
+    message.kind = ShardMessage::Kind::Request;
+    message.binary = binary;
+    message.client = connection.id;
+    message.slot = connection.firstSlot + connection.waiting.size();
+    message.bytes.assign(command.data(), command.size());
+    connection.waiting.emplace_back();
+    connection.waiting.back().watch = watched;
+    connection.remoteShards |= uint64_t{1} << owner;
+    send(owner, std::move(message));
+}
+
+/**
+ * @brief Executes a command of a client and delivers the answer, then the Delta of its action if any.
+ *
+ * @param client The client.
+ * @param slot Slot of the answer in the client's connection, or 0 for the next answer.
+ * @param binary The command is a binary message, not a text line.
+ * @param command The command.
+ */
+void ServerShard::serve(uint64_t client, uint64_t slot, bool binary, std::string_view command) {
+    const uint64_t start = cycleCount();
+    reply.clear();
+    announcement.pending = false;
+    actedTable = 0;
+    if (binary) {
+        executeMessage(client, FrameView::Message{static_cast<MessageType>(command[0]),
+                                                  reinterpret_cast<const uint8_t*>(command.data())});
+    } else {
+        executeLine(client, command);
+    }
+    deliver(client, slot, reply);
+    if (announcement.pending) {
+        broadcast(announcement.table, announcement.action, announcement.before);
+    }
+    if (actedTable != 0) {
+        charge(actedTable, start, 1);
+    }
+}
+
+/**
+ * @brief Executes one command line and writes its reply.
+ */
+void ServerShard::executeLine(uint64_t client, std::string_view line) {
+    counters.commands++;
+    std::string& out = reply;
+    try {
+        std::string_view rest = line;
+        std::string_view command;
+        if (!nextToken(rest, command)) {
+            throw std::invalid_argument("Empty command.");
+        }
+        if (command == "ACT") {
+            const uint32_t table = nextNumber<uint32_t>(rest, "table");
+            Action action;
+            action.actor = nextNumber<uint8_t>(rest, "seat");
+            std::string_view name;
+            if (!nextToken(rest, name)) {
+                throw std::invalid_argument("Missing action.");
+            }
+            action.kind = parseActionName(std::string(name));
+            if (actionHasTarget(action.kind)) {
+                action.target = nextNumber<uint8_t>(rest, "target");
+            }
+            const bool watched = watchers.count(table) != 0 || audience.count(table) != 0;
+            const TableStatus before = watched ? registry.status(table) : TableStatus();
+            registry.act(table, client, action);
+            actedTable = table;
+            arm(table);
+            out += "OK ";
+            out += std::to_string(registry.status(table).plies);
+            out += '\n';
+            if (watched) announcement = Announcement{true, table, action, before};
+        } else if (command == "STATE") {
+            appendStatus(out, registry.status(nextNumber<uint32_t>(rest, "table")));
+        } else if (command == "CREATE") {
+            if (shed(OVERLOADED_PERCENT, counters.shedCreates)) {
+                out += "ERR Server overloaded, try again later.\n";     // Not a client error
+                return;
+            }
+            const size_t players = nextNumber<size_t>(rest, "player count");
+            std::string_view token;
+            uint64_t seed = 0;
+            bool reactions = false;
+            while (nextToken(rest, token)) {
+                if (token == "react") {
+                    reactions = true;
+                } else {
+                    seed = nextNumber<uint64_t>(token, "seed");
+                }
+            }
+            const uint32_t table = registry.create(players, seed ? seed : seeds.next(), reactions);
+            out += "OK ";
+            out += std::to_string(table);
+            out += '\n';
+        } else if (command == "JOIN") {
+            const uint32_t table = nextNumber<uint32_t>(rest, "table");
+            std::string_view name;
+            if (!nextToken(rest, name)) {
+                throw std::invalid_argument("Missing name.");
+            }
+            const size_t seat = registry.join(table, client, std::string(name));
+            joined(client, table, false);
+            arm(table);
+            out += "OK ";
+            out += std::to_string(seat);
+            out += ' ';
+            out += roleName(registry.roleAt(table, seat));
+            out += '\n';
+        } else if (command == "LEAVE") {
+            const uint32_t table = nextNumber<uint32_t>(rest, "table");
+            left(client, table);
+            out += "OK\n";
+        } else if (command == "PING") {
+            out += "PONG\n";
+        } else if (command == "TOP") {
+            std::string_view token;
+            const size_t wanted = nextToken(rest, token) ? nextNumber<size_t>(token, "table count") : DEFAULT_TOP;
+            const std::vector<TableUsage> hot = hottest(peers, wanted);
+            out += "TOP ";
+            out += std::to_string(hot.size());
+            for (const TableUsage& table : hot) {
+                out += ' ';
+                out += std::to_string(table.table);
+                for (const uint64_t value : {table.actions, table.cpuNs, table.maxActionNs,
+                                             table.actions ? table.latencyNs / table.actions : 0, table.maxLatencyNs}) {
+                    out += ':';
+                    out += std::to_string(value);
+                }
+            }
+            out += '\n';
+        } else {
+            throw std::invalid_argument("Unknown command: " + std::string(command));
+        }
+    } catch (const std::exception& e) {
+        counters.errors++;
+        out.clear();
+        out += "ERR ";
+        out += e.what();
+        out += '\n';
+    }
+}
+
+/**
+ * @brief Executes one binary request message and writes its Reply or Status.
+ */
+void ServerShard::executeMessage(uint64_t client, const FrameView::Message& message) {
+    counters.commands++;
+    WireCode code = WireCode::Ok;
+    uint32_t value = 0;
+    uint8_t extra = 0;
+    uint32_t tag = 0;
+    try {
+        switch (message.type) {
+            case MessageType::Create: {
+                const CreateMessage create = message.as<CreateMessage>();
+                tag = create.tag;
+                if (shed(OVERLOADED_PERCENT, counters.shedCreates)) {
+                    code = WireCode::Overloaded;
+                    break;
+                }
+                value = registry.create(create.players, create.seed ? create.seed : seeds.next(),
+                                        (create.flags & CREATE_REACTIONS) != 0);
+                break;
+            }
+            case MessageType::Join: {
+                const JoinMessage join = message.as<JoinMessage>();
+                tag = join.tag;
+                if (join.nameLength > sizeof(join.name)) {
+                    throw std::invalid_argument("Name too long.");
+                }
+                value = static_cast<uint32_t>(registry.join(join.table, client, std::string(join.name, join.nameLength)));
+                extra = static_cast<uint8_t>(registry.roleAt(join.table, value));
+                joined(client, join.table, true);
+                arm(join.table);
+                break;
+            }
+            case MessageType::Act: {
+                const ActMessage act = message.as<ActMessage>();
+                tag = act.tag;
+                if (act.kind >= NUM_ACTION_KINDS) {
+                    throw std::invalid_argument("Unknown action.");
+                }
+                const Action action{static_cast<ActionKind>(act.kind), act.seat, act.target};
+                const bool watched = watchers.count(act.table) != 0 || audience.count(act.table) != 0;
+                const TableStatus before = watched ? registry.status(act.table) : TableStatus();
+                registry.act(act.table, client, action);
+                actedTable = act.table;
+                arm(act.table);
+                value = registry.status(act.table).plies;
+                if (watched) announcement = Announcement{true, act.table, action, before};
+                break;
+            }
+            case MessageType::State: {
+                const TableMessage state = message.as<TableMessage>();
+                tag = state.tag;
+                const TableStatus status = registry.status(state.table);
+                StatusMessage& answer = addMessage<StatusMessage>(reply);
+                answer.type = static_cast<uint8_t>(MessageType::Status);
+                answer.tag = tag;
+                fillStatus(answer, status);
+                return;
+            }
+            case MessageType::Leave: {
+                const TableMessage leave = message.as<TableMessage>();
+                tag = leave.tag;
+                left(client, leave.table);
+                break;
+            }
+            case MessageType::Watch: {
+                const TableMessage watch = message.as<TableMessage>();
+                tag = watch.tag;
+                const TableStatus status = registry.status(watch.table);
+                viewed(client, watch.table);
+                StatusMessage& answer = addMessage<StatusMessage>(reply);
+                answer.type = static_cast<uint8_t>(MessageType::Status);
+                answer.tag = tag;
+                fillStatus(answer, status);
+                return;
+            }
+            default:
+                break;      // Filtered out by readFrames()
+        }
+    } catch (const std::invalid_argument&) {
+        code = WireCode::Invalid;
+    } catch (const std::exception&) {
+        code = WireCode::Rejected;
+    }
+    if (code != WireCode::Ok) {
+        if (code != WireCode::Overloaded) counters.errors++;
+        value = 0;
+    }
+    if (message.type == MessageType::State || message.type == MessageType::Watch) {
+        StatusMessage& answer = addMessage<StatusMessage>(reply);
+        answer.type = static_cast<uint8_t>(MessageType::Status);
+        answer.code = static_cast<uint8_t>(code);
+        answer.tag = tag;
+        return;
+    }
+    ReplyMessage& answer = addMessage<ReplyMessage>(reply);
+    answer.type = static_cast<uint8_t>(MessageType::Reply);
+    answer.code = static_cast<uint8_t>(code);
+    answer.extra = extra;
+    answer.tag = tag;
+    answer.value = value;
+}
+
+/**
+ * @brief Hands an answer or a Delta to the connection of a client, here or on its shard.
+ *
+ * @param client The client (gone clients are skipped).
+ * @param slot Slot of the answer, or 0 to send it after everything before.
+ * @param bytes Text lines or binary messages.
+ */
+void ServerShard::deliver(uint64_t client, uint64_t slot, std::string_view bytes) {
+    const size_t home = homeOf(client);
+    if (home == index) {
+        auto it = clients.find(client);
+        if (it != clients.end() && !it->second->closing) {
+            complete(*it->second, slot, bytes);
+            hold(*it->second, index, logPosition());
+        }
+        return;
+    }
+    ShardMessage message;
+    message.kind = slot == 0 ? ShardMessage::Kind::Delta : ShardMessage::Kind::Reply;
+    message.client = client;
+    message.slot = slot;
+    message.bytes.assign(bytes.data(), bytes.size());
+    message.durableAt = logPosition();
+    send(home, std::move(message));
+}
+
+/**
+ * @brief Fills a slot of a connection and sends every answer that is no longer waiting for another.
+ *
+ * @param connection The client.
+ * @param slot Slot of the answer, or 0 to send it after everything before.
+ * @param bytes Text lines or binary messages.
+ */
+void ServerShard::complete(Connection& connection, uint64_t slot, std::string_view bytes) {
+    if (slot == 0) {
+        if (connection.waiting.empty()) {
+            append(connection, bytes);
+        } else {
+            connection.waiting.push_back(Slot{true, std::string(bytes)});
+        }
+    } else {
+        Slot& filled = connection.waiting[slot - connection.firstSlot];
+        if (filled.watch != 0) {
+            watch(connection, filled.watch, bytes);
+        }
+        filled.done = true;
+        filled.bytes.assign(bytes.data(), bytes.size());
+        while (!connection.waiting.empty() && connection.waiting.front().done) {
+            append(connection, connection.waiting.front().bytes);
+            connection.waiting.pop_front();
+            connection.firstSlot++;
+        }
+    }
+    markDirty(connection);
+}
+
+/**
+ * @brief Appends answers to the output of a connection (binary messages go into its open frame).
+ */
+void ServerShard::append(Connection& connection, std::string_view bytes) {
+    if (connection.protocol != Protocol::Binary) {
+        connection.out.append(bytes.data(), bytes.size());
+        return;
+    }
+    for (size_t at = 0; at < bytes.size();) {
+        const size_t size = messageSize(static_cast<uint8_t>(bytes[at]));
+        std::memcpy(connection.frames.addMessage(size), bytes.data() + at, size);
+        at += size;
+    }
+}
+
+/**
+ * @brief Records that a client sits at a table of this shard (binary clients start receiving its deltas).
+ */
+void ServerShard::joined(uint64_t client, uint32_t table, bool binary) {
+    std::vector<uint32_t>& tables = seated[client];
+    if (std::find(tables.begin(), tables.end(), table) != tables.end()) {
+        return;
+    }
+    tables.push_back(table);
+    if (binary) {
+        watchers[table].push_back(client);
+    }
+}
+
+/**
+ * @brief Releases the seats of a client at a table of this shard, and stops its spectating there.
+ */
+void ServerShard::left(uint64_t client, uint32_t table) {
+    auto tables = seated.find(client);
+    const bool seatedHere = tables != seated.end() &&
+                            std::find(tables->second.begin(), tables->second.end(), table) != tables->second.end();
+    if (unviewed(client, table) && !seatedHere) {
+        return;     // A spectator: leaving must not close a table nobody joined yet
+    }
+    registry.leave(table, client);
+    if (!registry.hosts(table)) {
+        arm(table);         // Drops the deadline of a table nobody is left at
+        usageChanged = usage.erase(table) != 0 || usageChanged;
+    }
+    if (tables != seated.end()) {
+        std::vector<uint32_t>& list = tables->second;
+        list.erase(std::remove(list.begin(), list.end(), table), list.end());
+        if (list.empty()) seated.erase(tables);
+    }
+    auto it = watchers.find(table);
+    if (it != watchers.end()) {
+        std::vector<uint64_t>& list = it->second;
+        list.erase(std::remove(list.begin(), list.end(), client), list.end());
+        if (list.empty()) watchers.erase(it);
+    }
+}
+
+/**
+ * @brief Releases every seat of a client at the tables of this shard.
+ */
+void ServerShard::release(uint64_t client) {
+    auto views = viewing.find(client);
+    if (views != viewing.end()) {
+        const std::vector<uint32_t> tables = views->second;
+        for (uint32_t table : tables) {
+            unviewed(client, table);
+        }
+    }
+    auto it = seated.find(client);
+    if (it == seated.end()) {
+        return;
+    }
+    const std::vector<uint32_t> tables = it->second;
+    for (uint32_t table : tables) {
+        left(client, table);
+    }
+}
+
+/**
+ * @brief Makes a connection of this shard a spectator of a table, wherever the table is, once its owner accepted.
+ *
+ * The owner of the table answers the Watch with the Status the spectator
+ * starts from, before any frame of the table, so the connection is
+ * registered when that answer arrives and only if it is Ok: a Watch of a
+ * table that does not exist leaves nothing behind.
+ *
+ * @param connection The spectator.
+ * @param table Id of the table.
+ * @param answer The owner's answer to the Watch.
+ */
+void ServerShard::watch(Connection& connection, uint32_t table, std::string_view answer) {
+    StatusMessage status{};
+    if (connection.closing || answer.size() < sizeof(status)) {
+        return;
+    }
+    std::memcpy(&status, answer.data(), sizeof(status));
+    if (status.type != static_cast<uint8_t>(MessageType::Status) ||
+        status.code != static_cast<uint8_t>(WireCode::Ok)) {
+        return;
+    }
+    if (std::find(connection.watching.begin(), connection.watching.end(), table) != connection.watching.end()) {
+        return;
+    }
+    connection.watching.push_back(table);
+    spectators[table].push_back(&connection);
+}
+
+/**
+ * @brief Stops feeding a table's frames to a connection of this shard.
+ */
+void ServerShard::unwatch(Connection& connection, uint32_t table) {
+    std::vector<uint32_t>& tables = connection.watching;
+    auto at = std::find(tables.begin(), tables.end(), table);
+    if (at == tables.end()) {
+        return;
+    }
+    tables.erase(at);
+    auto it = spectators.find(table);
+    std::vector<Connection*>& list = it->second;
+    list.erase(std::remove(list.begin(), list.end(), &connection), list.end());
+    if (list.empty()) spectators.erase(it);
+}
+
+/**
+ * @brief Records that a client watches a table of this shard, so its shard gets the table's frames.
+ */
+void ServerShard::viewed(uint64_t client, uint32_t table) {
+    std::vector<uint32_t>& tables = viewing[client];
+    if (std::find(tables.begin(), tables.end(), table) != tables.end()) {
+        return;
+    }
+    tables.push_back(table);
+    std::vector<uint32_t>& shards = audience[table];
+    shards.resize(count);
+    shards[homeOf(client)]++;
+    counters.spectators++;
+}
+
+/**
+ * @brief Forgets that a client watches a table of this shard.
+ *
+ * @return bool true if the client was watching it.
+ */
+bool ServerShard::unviewed(uint64_t client, uint32_t table) {
+    auto it = viewing.find(client);
+    if (it == viewing.end()) {
+        return false;
+    }
+    std::vector<uint32_t>& tables = it->second;
+    auto at = std::find(tables.begin(), tables.end(), table);
+    if (at == tables.end()) {
+        return false;
+    }
+    tables.erase(at);
+    if (tables.empty()) viewing.erase(it);
+    auto shards = audience.find(table);
+    shards->second[homeOf(client)]--;
+    if (std::all_of(shards->second.begin(), shards->second.end(), [](uint32_t n) { return n == 0; })) {
+        audience.erase(shards);
+    }
+    counters.spectators--;
+    return true;
+}
+
+/**
+ * @brief Pushes the Delta of an action to every binary client seated at the table, and to its spectators.
+ *
+ * The spectators' frame (the Delta, plus a Keyframe every keyframeInterval
+ * plies) is encoded once and shared by every shard and connection it goes to.
+ *
+ * @param table The table.
+ * @param action The action that was just applied.
+ * @param before Status of the table before the action.
+ */
+void ServerShard::broadcast(uint32_t table, const Action& action, const TableStatus& before) {
+    auto players = watchers.find(table);
+    auto viewers = audience.find(table);
+    if (players == watchers.end() && viewers == audience.end()) {
+        return;
+    }
+    const TableStatus after = registry.status(table);
+    DeltaMessage delta{};
+    delta.type = static_cast<uint8_t>(MessageType::Delta);
+    delta.kind = static_cast<uint8_t>(action.kind);
+    delta.actor = action.actor;
+    delta.target = action.target;
+    delta.table = table;
+    delta.plies = after.plies;
+    delta.bank = after.bank;
+    delta.flags = static_cast<uint8_t>(STATUS_STARTED | (after.over ? STATUS_OVER : 0) | (after.reacting ? STATUS_REACTING : 0));
+    delta.turn = after.turn;
+    delta.aliveMask = after.aliveMask;
+    for (size_t seat = 0; seat < after.numPlayers; ++seat) {
+        delta.coins[seat] = static_cast<int16_t>(after.coins[seat]);
+        if (after.coins[seat] != before.coins[seat]) delta.changedMask |= static_cast<uint8_t>(1u << seat);
+    }
+    if (players != watchers.end()) {
+        const std::string_view bytes(reinterpret_cast<const char*>(&delta), sizeof(delta));
+        for (uint64_t watcher : players->second) {
+            deliver(watcher, 0, bytes);
+            counters.deltas++;
+        }
+    }
+    if (viewers == audience.end()) {
+        return;
+    }
+
+    std::string bytes;
+    FrameBuilder builder(bytes);
+    builder.add<DeltaMessage>() = delta;
+    if (options.keyframeInterval != 0 && after.plies % options.keyframeInterval == 0) {
+        StatusMessage& keyframe = builder.add<StatusMessage>();
+        keyframe.type = static_cast<uint8_t>(MessageType::Keyframe);
+        fillStatus(keyframe, after);
+        counters.keyframes++;
+    }
+    builder.finish();
+    const auto frame = std::make_shared<const std::string>(std::move(bytes));
+    const std::vector<uint32_t>& shards = viewers->second;
+    for (size_t shard = 0; shard < count; ++shard) {
+        if (shards[shard] == 0) {
+            continue;
+        }
+        if (shard == index) {
+            fanOut(table, frame);
+            continue;
+        }
+        ShardMessage message;
+        message.kind = ShardMessage::Kind::Spectate;
+        message.table = table;
+        message.frame = frame;
+        send(shard, std::move(message));
+    }
+}
+
+/**
+ * @brief Charges the actions just applied at a table with their CPU time and latency.
+ *
+ * @param table The table.
+ * @param start cycleCount() when the shard started on the actions.
+ * @param actions Plies they applied.
+ */
+void ServerShard::charge(uint32_t table, uint64_t start, uint64_t actions) {
+    const uint64_t end = cycleCount();
+    const uint64_t cpu = end > start ? end - start : 0;
+    const uint64_t latency = end > roundCycles ? end - roundCycles : 0;
+    TableUsage& cost = usage[table];
+    cost.table = table;
+    cost.actions += actions;
+    cost.cpuNs += cpu;
+    cost.maxActionNs = std::max(cost.maxActionNs, cpu);
+    cost.latencyNs += latency * actions;
+    cost.maxLatencyNs = std::max(cost.maxLatencyNs, latency);
+    usageChanged = true;
+}
+
+/**
+ * @brief Publishes the HOT_TABLES tables of the shard with the most CPU time, converted to nanoseconds.
+ *
+ * A bounded heap keeps the selection in one pass over the tables without
+ * copying them; readers keep the previous list as long as they hold it.
+ */
+void ServerShard::publishUsage() {
+    auto hotter = [](const TableUsage* a, const TableUsage* b) { return a->cpuNs > b->cpuNs; };
+    std::vector<const TableUsage*> top;
+    top.reserve(HOT_TABLES);
+    for (const auto& entry : usage) {
+        if (top.size() < HOT_TABLES) {
+            top.push_back(&entry.second);
+            std::push_heap(top.begin(), top.end(), hotter);
+        } else if (entry.second.cpuNs > top.front()->cpuNs) {
+            std::pop_heap(top.begin(), top.end(), hotter);
+            top.back() = &entry.second;
+            std::push_heap(top.begin(), top.end(), hotter);
+        }
+    }
+    std::sort_heap(top.begin(), top.end(), hotter);
+    const double perNs = cyclesPerNs();
+    auto toNs = [perNs](uint64_t cycles) { return static_cast<uint64_t>(static_cast<double>(cycles) / perNs); };
+    auto list = std::make_shared<std::vector<TableUsage>>();
+    list->reserve(top.size());
+    for (const TableUsage* cost : top) {
+        TableUsage entry = *cost;
+        entry.cpuNs = toNs(cost->cpuNs);
+        entry.maxActionNs = toNs(cost->maxActionNs);
+        entry.latencyNs = toNs(cost->latencyNs);
+        entry.maxLatencyNs = toNs(cost->maxLatencyNs);
+        list->push_back(entry);
+    }
+    published.store(std::move(list));
+    usageChanged = false;
+    usagePublishedMs = nowMs;
+}
+
+/**
+ * @brief Merges the published lists of several shards into their n hottest tables (any thread).
+ */
+std::vector<TableUsage> ServerShard::hottest(const std::vector<ServerShard*>& shards, size_t n) {
+    std::vector<TableUsage> all;
+    for (const ServerShard* shard : shards) {
+        const std::shared_ptr<const std::vector<TableUsage>> list = shard->hotTables();
+        all.insert(all.end(), list->begin(), list->end());
+    }
+    const size_t wanted = std::min(n, all.size());
+    std::partial_sort(all.begin(), all.begin() + static_cast<std::ptrdiff_t>(wanted), all.end(),
+                      [](const TableUsage& a, const TableUsage& b) { return a.cpuNs > b.cpuNs; });
+    all.resize(wanted);
+    return all;
+}
+
+/**
+ * @brief Returns the load of the shard in percent of the overload limits (0 without limits).
+ *
+ * @param byLatency Set to true if the busy time is further over its limit than the queue depth.
+ */
+uint32_t ServerShard::loadPercent(bool& byLatency) const {
+    const double depth = options.overloadDepth ? loadDepth * 100 / options.overloadDepth : 0;
+    const double latency = options.overloadLatencyUs ? loadMicros * 100 / options.overloadLatencyUs : 0;
+    byLatency = latency > depth;
+    return static_cast<uint32_t>(std::min(std::max(depth, latency), 1e9));
+}
+
+/**
+ * @brief Decides whether the shard sheds a request, and counts it with its reason if so.
+ *
+ * @param percent Load, in percent of the overload limits, from which this kind of request is shed.
+ * @param counter Counter of this kind of request.
+ * @return bool true if the request is refused.
+ */
+bool ServerShard::shed(uint32_t percent, uint64_t& counter) {
+    bool byLatency = false;
+    const uint32_t load = loadPercent(byLatency);
+    if (load == 0 || load < percent) {
+        return false;
+    }
+    counter++;
+    (byLatency ? counters.shedForLatency : counters.shedForDepth)++;
+    return true;
+}
+
+/**
+ * @brief Drops every spectator stream of this shard's connections while the shard sheds spectators.
+ *
+ * Each spectator gets a Status with the Overloaded code and the table, and
+ * the owner of the table stops sending its frames here.
+ */
+void ServerShard::shedSpectators() {
+    bool byLatency = false;
+    const uint32_t load = spectators.empty() ? 0 : loadPercent(byLatency);
+    if (load == 0 || load < options.spectatorShedPercent) {
+        return;
+    }
+    for (auto& [table, list] : std::exchange(spectators, {})) {
+        const size_t owner = ownerOf(table, count);
+        for (Connection* connection : list) {
+            counters.shedStreams++;
+            (byLatency ? counters.shedForLatency : counters.shedForDepth)++;
+            std::vector<uint32_t>& tables = connection->watching;
+            tables.erase(std::remove(tables.begin(), tables.end(), table), tables.end());
+            if (owner == index) {
+                unviewed(connection->id, table);
+            } else {
+                ShardMessage message;
+                message.kind = ShardMessage::Kind::Unwatch;
+                message.client = connection->id;
+                message.table = table;
+                send(owner, std::move(message));
+            }
+            StatusMessage notice{};
+            notice.type = static_cast<uint8_t>(MessageType::Status);
+            notice.code = static_cast<uint8_t>(WireCode::Overloaded);
+            notice.table = table;
+            complete(*connection, 0, std::string_view(reinterpret_cast<const char*>(&notice), sizeof(notice)));
+        }
+    }
+}
+
+/**
+ * @brief Answers a Watch with an Overloaded Status, in the order of the connection's answers.
+ */
+void ServerShard::refuseWatch(Connection& connection, uint32_t table, uint32_t tag) {
+    counters.commands++;
+    StatusMessage refusal{};
+    refusal.type = static_cast<uint8_t>(MessageType::Status);
+    refusal.code = static_cast<uint8_t>(WireCode::Overloaded);
+    refusal.tag = tag;
+    refusal.table = table;
+    complete(connection, 0, std::string_view(reinterpret_cast<const char*>(&refusal), sizeof(refusal)));
+}
+
+/**
+ * @brief Folds the commands and busy time of a round into the smoothed load of the shard.
+ *
+ * The weight of the round grows with the wall time since the previous one,
+ * so the averages cover about LOAD_WINDOW_MS whatever the length of the
+ * rounds, and a round after an idle wait replaces them.
+ *
+ * @param commands Commands executed in the round.
+ * @param busy Time the round spent outside epoll_wait.
+ * @param end End of the round.
+ */
+void ServerShard::measureLoad(uint64_t commands, std::chrono::steady_clock::duration busy,
+                              std::chrono::steady_clock::time_point end) {
+    const double elapsedMs = std::chrono::duration<double, std::milli>(end - lastRound).count();
+    lastRound = end;
+    const double weight = 1 - std::exp(-elapsedMs / LOAD_WINDOW_MS);
+    loadDepth += (static_cast<double>(commands) - loadDepth) * weight;
+    loadMicros += (std::chrono::duration<double, std::micro>(busy).count() - loadMicros) * weight;
+    counters.queueDepth = static_cast<uint64_t>(std::llround(loadDepth));
+    counters.roundMicros = static_cast<uint64_t>(std::llround(loadMicros));
+}
+
+/**
+ * @brief Streams the action log of the shard's tables to a Standby from now on.
+ *
+ * @param path Unix socket of the standby.
+ * @throws std::runtime_error if the standby cannot be reached.
+ */
+void ServerShard::connectStandby(const std::string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    StandbyHello hello;
+    hello.shard = static_cast<uint16_t>(index);
+    hello.shards = static_cast<uint16_t>(count);
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    bool ok = fd >= 0 && path.size() < sizeof(address.sun_path);
+    if (ok) {
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        ok = ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0 &&
+             ::send(fd, &hello, sizeof(hello), MSG_NOSIGNAL) == static_cast<ssize_t>(sizeof(hello));
+    }
+    if (!ok) {
+        if (fd >= 0) ::close(fd);
+        throw std::runtime_error("Cannot reach the standby at " + path);
+    }
+    standbyFd = fd;
+    registry.setJournal(&journal);
+}
+
+/**
+ * @brief Takes over tables a standby followed (before the first poll), with every seat empty.
+ *
+ * The running tables get their deadlines from now.
+ */
+void ServerShard::restore(TableRegistry&& tables) {
+    registry = std::move(tables);
+    resumeTables();
+}
+
+/**
+ * @brief Recovers the shard's tables from its write-ahead log, with every seat empty, and logs
+ *        every change from now on (after link(), before the first poll).
+ *
+ * The seats are vacated through the journal, so that the next recovery
+ * frees them at the same point of the log.
+ *
+ * @throws std::runtime_error if the log cannot be opened or does not apply.
+ */
+void ServerShard::openLog() {
+    wal = std::make_unique<WriteAheadLog>(options.walDirectory, index, count, options.walCommitMs, registry, [this] {
+        const uint64_t one = 1;
+        for (ServerShard* peer : peers) {
+            if (::write(peer->wakeFd, &one, sizeof(one)) < 0) {
+                // The counter is already non-zero: the peer is awake
+            }
+        }
+    });
+    logged = journal.size();        // The replay, journaled for a standby, is in the log already
+    registry.setJournal(&journal);
+    counters.recoveredTables = registry.size();
+    if (registry.size() > 0) {
+        resumeTables();
+    }
+}
+
+/**
+ * @brief Commits what the shard logged and stops its write-ahead log (before the shards are destroyed).
+ *
+ * Its thread no longer wakes the other shards, which may then go away.
+ */
+void ServerShard::closeLog() {
+    if (!wal) {
+        return;
+    }
+    commitLog();
+    wal.reset();
+    if (standbyFd < 0) {
+        registry.setJournal(nullptr);
+    }
+}
+
+/**
+ * @brief Empties every seat of the tables the shard starts with, and gives the running ones their deadlines from now.
+ */
+void ServerShard::resumeTables() {
+    registry.vacate();
+    nowMs = clockMs();
+    for (const uint32_t table : registry.ids()) {
+        arm(table);
+    }
+}
+
+/**
+ * @brief Hands the journal of the round to the write-ahead log and to the standby.
+ *
+ * Once the log has grown by walCompactBytes, starts a compaction with the
+ * tables open now.
+ */
+void ServerShard::commitLog() {
+    if (wal) {
+        if (journal.size() > logged) {
+            wal->append(journal.data() + logged, journal.size() - logged);
+        }
+        if (options.walCompactBytes > 0 && wal->sinceCompaction() >= options.walCompactBytes) {
+            wal->compact(registry);
+        }
+        const WalStats log = wal->stats();
+        counters.walBytes = log.bytes;
+        counters.walCommits = log.commits;
+        counters.walCompactions = log.compactions;
+    }
+    shipLog();
+    if (standbyFd < 0) {
+        journal.clear();
+    }
+    logged = journal.size();
+}
+
+/**
+ * @brief Returns the position the write-ahead log will reach once the journal so far is committed (0 without a log).
+ */
+uint64_t ServerShard::logPosition() const {
+    return wal ? wal->appended() + (journal.size() - logged) : 0;
+}
+
+/**
+ * @brief Hands the journal to the standby's socket without blocking; the rest waits for the next round.
+ *
+ * A standby that closed its end, or whose backlog goes over outputLimit, is
+ * dropped: the shard stops journaling rather than slow down or grow.
+ */
+void ServerShard::shipLog() {
+    if (standbyFd < 0 || journal.empty()) {
+        return;
+    }
+    size_t sent = 0;
+    while (sent < journal.size()) {
+        const ssize_t n = ::send(standbyFd, journal.data() + sent, journal.size() - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n <= 0) {
+            dropStandby();
+            return;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    counters.logBytes += sent;
+    journal.erase(0, sent);
+    counters.logPending = journal.size();
+    if (journal.size() > options.outputLimit) {
+        dropStandby();
+    }
+}
+
+/**
+ * @brief Stops journaling and closes the connection to the standby.
+ */
+void ServerShard::dropStandby() {
+    ::close(standbyFd);
+    standbyFd = -1;
+    if (!wal) {
+        registry.setJournal(nullptr);
+    }
+    std::string().swap(journal);
+    counters.logPending = 0;
+    counters.standbyLost++;
+}
+
+/**
+ * @brief Replaces the deadline of a table of this shard after a change of its state.
+ *
+ * A running table gets turnTimeoutMs for its next move, or reactionWindowMs
+ * while a reaction window is open; a table that is waiting for players,
+ * over or gone gets none. The clock counts whole milliseconds, so the
+ * deadline is one tick later: it never fires before the full time.
+ */
+void ServerShard::arm(uint32_t table) {
+    if (options.turnTimeoutMs == 0 && options.reactionWindowMs == 0) {
+        return;
+    }
+    auto it = deadlines.find(table);
+    if (it != deadlines.end()) {
+        timers.cancel(it->second);
+        deadlines.erase(it);
+        counters.deadlines--;
+    }
+    if (!registry.hosts(table)) {
+        return;
+    }
+    const TableStatus status = registry.status(table);
+    const uint32_t limit = status.reacting ? options.reactionWindowMs : options.turnTimeoutMs;
+    if (!status.started || status.over || limit == 0) {
+        return;
+    }
+    deadlines.emplace(table, timers.schedule(nowMs + limit + 1, table));
+    counters.deadlines++;
+}
+
+/**
+ * @brief Plays the default decision of every table whose deadline passed, and arms their next one.
+ */
+void ServerShard::expireDeadlines() {
+    if (timers.size() == 0) {
+        return;
+    }
+    expired.clear();
+    timers.advance(nowMs, expired);
+    for (const uint64_t key : expired) {
+        const uint64_t start = cycleCount();
+        const uint32_t table = static_cast<uint32_t>(key);
+        deadlines.erase(table);
+        counters.deadlines--;
+        const bool watched = watchers.count(table) != 0 || audience.count(table) != 0;
+        const TableStatus before = registry.status(table);
+        const Action action = registry.expire(table);
+        if (before.reacting) {
+            counters.windowTimeouts++;
+        } else {
+            counters.turnTimeouts++;
+        }
+        if (watched) {
+            broadcast(table, action, before);
+        }
+        arm(table);
+        charge(table, start, registry.status(table).plies - before.plies);
+    }
+}
+
+/**
+ * @brief Returns the milliseconds elapsed since the shard was created (the tick of its timers).
+ */
+uint64_t ServerShard::clockMs() const {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - epoch).count());
+}
+
+/**
+ * @brief Queues a frame of a table on every connection of this shard watching it.
+ *
+ * A connection still waiting for answers from other shards gets a copy of
+ * the messages behind them instead, so the frame cannot overtake its own
+ * Status; a spectator drops the deltas that are not newer than that Status.
+ */
+void ServerShard::fanOut(uint32_t table, const std::shared_ptr<const std::string>& frame) {
+    auto it = spectators.find(table);
+    if (it == spectators.end()) {
+        return;
+    }
+    for (Connection* connection : it->second) {
+        if (connection->closing) {
+            continue;
+        }
+        if (connection->waiting.empty()) {
+            appendShared(*connection, frame);
+            markDirty(*connection);
+        } else {
+            complete(*connection, 0, std::string_view(*frame).substr(sizeof(FrameHeader)));
+        }
+        counters.spectatorFrames++;
+    }
+}
+
+/**
+ * @brief Queues a shared frame after the output of a connection, closing its open frame first.
+ */
+void ServerShard::appendShared(Connection& connection, const std::shared_ptr<const std::string>& frame) {
+    connection.frames.finish();
+    if (connection.outOffset < connection.out.size()) {
+        Slice owned;
+        owned.owned = std::move(connection.out);
+        owned.offset = connection.outOffset;
+        connection.queuedBytes += owned.owned.size() - owned.offset;
+        connection.queued.push_back(std::move(owned));
+    }
+    connection.out.clear();
+    connection.outOffset = 0;
+    Slice shared;
+    shared.shared = frame;
+    connection.queuedBytes += frame->size();
+    connection.queued.push_back(std::move(shared));
+}
+
+/**
+ * @brief Queues a connection to be flushed at the end of the current round.
+ */
+void ServerShard::markDirty(Connection& connection) {
+    if (!connection.dirty) {
+        connection.dirty = true;
+        dirty.push_back(&connection);
+    }
+}
+
+/**
+ * @brief Closes a connection and releases its seats on every shard; it is freed after the current round.
+ */
+void ServerShard::close(Connection& connection) {
+    if (connection.closing) {
+        return;
+    }
+    connection.closing = true;
+    counters.bytesInFlight -= connection.countedBytes;
+    counters.queuedSlices -= connection.countedSlices;
+    if (connection.paused) counters.pausedConnections--;
+    if (connection.held) counters.walHeld--;
+    ::epoll_ctl(epollFd, EPOLL_CTL_DEL, connection.fd, nullptr);
+    ::close(connection.fd);
+    release(connection.id);
+    const std::vector<uint32_t> tables = connection.watching;
+    for (uint32_t table : tables) {
+        unwatch(connection, table);
+    }
+    for (size_t shard = 0; shard < count; ++shard) {
+        if ((connection.remoteShards >> shard) & 1) {
+            ShardMessage message;
+            message.kind = ShardMessage::Kind::Closed;
+            message.client = connection.id;
+            send(shard, std::move(message));
+        }
+    }
+    clients.erase(connection.id);
+    auto it = connections.find(connection.fd);
+    closed.push_back(std::move(it->second));
+    connections.erase(it);
+    counters.connections--;
+}
+
+/**
+ * @brief Queues a message for another shard; it waits in the outbox while that shard's queue is full.
+ */
+void ServerShard::send(size_t shard, ShardMessage&& message) {
+    if (outbox[shard].empty() && peers[shard]->inbox[index]->push(std::move(message))) {
+        wake[shard] = true;
+        return;
+    }
+    outbox[shard].push_back(std::move(message));
+}
+
+/**
+ * @brief Handles every message the other shards queued for this one.
+ *
+ * @return size_t Number of messages handled.
+ */
+size_t ServerShard::receive() {
+    size_t handled = 0;
+    ShardMessage message;
+    for (size_t shard = 0; shard < count; ++shard) {
+        if (shard == index) continue;
+        while (inbox[shard]->pop(message)) {
+            handle(message, shard);
+            handled++;
+        }
+    }
+    return handled;
+}
+
+/**
+ * @brief Handles one message from another shard.
+ *
+ * @param message The message.
+ * @param from Index of the shard that sent it.
+ */
+void ServerShard::handle(ShardMessage& message, size_t from) {
+    switch (message.kind) {
+        case ShardMessage::Kind::Connect:
+            adopt(message.fd);
+            break;
+        case ShardMessage::Kind::Request:
+            serve(message.client, message.slot, message.binary, message.bytes);
+            break;
+        case ShardMessage::Kind::Reply:
+        case ShardMessage::Kind::Delta: {
+            auto it = clients.find(message.client);
+            if (it != clients.end() && !it->second->closing) {
+                complete(*it->second, message.slot, message.bytes);
+                hold(*it->second, from, message.durableAt);
+            }
+            break;
+        }
+        case ShardMessage::Kind::Spectate:
+            fanOut(message.table, message.frame);
+            message.frame.reset();
+            break;
+        case ShardMessage::Kind::Unwatch:
+            unviewed(message.client, message.table);
+            break;
+        case ShardMessage::Kind::Closed:
+            release(message.client);
+            break;
+    }
+}
+
+/**
+ * @brief Moves what the outboxes can into the peers' queues, and wakes every peer that got messages.
+ */
+void ServerShard::sendOutboxes() {
+    for (size_t shard = 0; shard < count; ++shard) {
+        std::vector<ShardMessage>& pending = outbox[shard];
+        size_t sent = 0;
+        while (sent < pending.size() && peers[shard]->inbox[index]->push(std::move(pending[sent]))) {
+            sent++;
+        }
+        if (sent > 0) {
+            pending.erase(pending.begin(), pending.begin() + static_cast<std::ptrdiff_t>(sent));
+            wake[shard] = true;
+        }
+        if (wake[shard]) {
+            const uint64_t one = 1;
+            if (::write(peers[shard]->wakeFd, &one, sizeof(one)) < 0) {
+                // The counter is already non-zero: the peer is awake
+            }
+            wake[shard] = false;
+        }
+    }
+}
+
+} // namespace coup
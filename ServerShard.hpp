@@ -0,0 +1,336 @@
+// email: shiraba01@gmail.com
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "Server.hpp"
+#include "SpscQueue.hpp"
+#include "TimerWheel.hpp"
+#include "WriteAheadLog.hpp"
+
+namespace coup {
+
+/**
+ * @brief A message from one shard of a GameServer to another.
+ */
+struct ShardMessage {
+    enum class Kind : uint8_t {
+        Connect,      // fd was accepted by shard 0; the receiver adopts the connection
+        Request,      // A command of a client for a table of the receiver (a text line or a binary message)
+        Reply,        // The answer to a Request, for one slot of the client's connection
+        Delta,        // A Delta message for a binary client of the receiver
+        Spectate,     // A frame for every spectator of a table on the receiver
+        Unwatch,      // The client's shard shed its spectator stream of a table of the receiver
+        Closed        // The client disconnected: release its seats at the receiver's tables
+    };
+
+    Kind kind = Kind::Request;
+    bool binary = false;
+    int fd = -1;
+    uint64_t client = 0;
+    uint64_t slot = 0;
+    uint32_t table = 0;
+    std::string bytes;
+    std::shared_ptr<const std::string> frame;     // Shared by every shard the frame is sent to
+    uint64_t durableAt = 0;                       // Reply, Delta: the sender's log position the client must not see before
+};
+
+/**
+ * @brief One shard of a GameServer: an epoll loop that owns its connections and its tables.
+ *
+ * Tables are partitioned by id: shard s of n creates the ids s+1, s+1+n...
+ * and is the only one to touch them, so no game is ever locked. A client
+ * belongs to the shard its connection was handed to, and its commands for
+ * tables of another shard travel to the owner over an SpscQueue; the answer
+ * travels back the same way. Each connection numbers the answers it waits
+ * for, so replies are sent in the order of the commands even when they come
+ * back from several shards. Deltas of an action are produced by the owner of
+ * the table and sent to the shards of the binary clients seated at it.
+ *
+ * Spectators are fed differently, since a table may have hundreds: the
+ * owner encodes the Delta of an action (and every keyframeInterval plies a
+ * Keyframe) once into a refcounted frame and hands it to each shard with
+ * spectators of the table, once per shard. That shard queues the same frame
+ * on the output of each of its spectators, without copying it.
+ *
+ * Turn and reaction deadlines of the tables a shard owns sit in its
+ * TimerWheel, in milliseconds since the shard was created: each action
+ * cancels the table's deadline and arms the next one, both in O(1), and
+ * epoll_wait sleeps no longer than the wheel's next event.
+ *
+ * Each round measures the commands it executed, which queued up while the
+ * round before ran, and its busy time, which delays every reply of the
+ * round; both are smoothed over LOAD_WINDOW_MS of wall time, so an idle
+ * shard recovers with its next round. Above spectatorShedPercent of
+ * overloadDepth or overloadLatencyUs the shard sheds the spectators of its
+ * connections (each gets an Overloaded Status for the table) and refuses
+ * their Watches; at 100% it also refuses CREATE.
+ *
+ * Every action is charged to its table: cycleCount() ticks from the start
+ * of its serve() or deadline (CPU) and from the start of the round
+ * (latency). Every usagePublishMs the shard publishes its HOT_TABLES
+ * costliest tables as an immutable list behind an atomic shared_ptr, which
+ * any thread may read while the shard runs.
+ *
+ * With a standby, the registry journals every change of its tables; the
+ * journal is written to the standby's socket at the end of each round,
+ * before the replies of the round, and whatever the socket did not take
+ * waits for the next round.
+ *
+ * With a walDirectory, the journal of each round also goes to the shard's
+ * WriteAheadLog, and every answer and Delta is tagged with the log
+ * position of its shard when it was produced: the connection that receives
+ * it is held, sending nothing, until that shard's log is durable there.
+ * The log's thread wakes every shard after each commit. Spectator frames
+ * are not held.
+ *
+ * A shard is driven by one thread at a time. Messages for another shard are
+ * queued during a round of events and the owner is woken by an eventfd at
+ * the end of the round; when its queue is full, they wait in an outbox.
+ */
+class ServerShard {
+public:
+    /**
+     * @brief Creates the epoll instance and the wake-up eventfd of the shard.
+     *
+     * @param options Options of the server.
+     * @param index Index of the shard.
+     * @param count Number of shards.
+     * @param listenFd Listening socket to accept from (shard 0 only), or -1.
+     * @throws std::runtime_error if epoll or the eventfd cannot be created.
+     */
+    ServerShard(const ServerOptions& options, size_t index, size_t count, int listenFd);
+
+    /**
+     * @brief Closes the connections of the shard and those still waiting in its queues.
+     */
+    ~ServerShard();
+
+    ServerShard(const ServerShard&) = delete;
+    ServerShard& operator=(const ServerShard&) = delete;
+
+    /**
+     * @brief Gives the shard the other shards of its server (before the first poll).
+     */
+    void link(const std::vector<ServerShard*>& shards);
+
+    /**
+     * @brief Runs one round of events and of messages from other shards.
+     *
+     * @param timeoutMs Longest wait for an event (-1 waits forever).
+     * @return size_t Number of events and messages handled.
+     * @throws std::runtime_error if epoll fails, or the write-ahead log cannot be written.
+     */
+    size_t poll(int timeoutMs);
+
+    /**
+     * @brief Streams the action log of the shard's tables to a Standby from now on.
+     *
+     * @param path Unix socket of the standby.
+     * @throws std::runtime_error if the standby cannot be reached.
+     */
+    void connectStandby(const std::string& path);
+
+    /**
+     * @brief Takes over tables a standby followed (before the first poll), with every seat empty.
+     */
+    void restore(TableRegistry&& tables);
+
+    /**
+     * @brief Recovers the shard's tables from its write-ahead log, with every seat empty, and logs
+     *        every change from now on (after link(), before the first poll).
+     *
+     * @throws std::runtime_error if the log cannot be opened or does not apply.
+     */
+    void openLog();
+
+    /**
+     * @brief Commits what the shard logged and stops its write-ahead log (before the shards are destroyed).
+     */
+    void closeLog();
+
+    // Position up to which the shard's write-ahead log is on disk (any thread)
+    uint64_t committed() const { return wal ? wal->durable() : 0; }
+
+    const ServerStats& stats() const { return counters; }
+    const TableRegistry& tables() const { return registry; }
+
+    // The costliest tables of the shard as last published, hottest first (any thread)
+    std::shared_ptr<const std::vector<TableUsage>> hotTables() const { return published.load(); }
+
+    /**
+     * @brief Merges the published lists of several shards into their n hottest tables (any thread).
+     */
+    static std::vector<TableUsage> hottest(const std::vector<ServerShard*>& shards, size_t n);
+
+    // Index of the shard that owns a table
+    static size_t ownerOf(uint32_t table, size_t count) { return (table - 1) % count; }
+
+private:
+    enum class Protocol : uint8_t { Unknown, Text, Binary };
+
+    // An answer waiting for the answers of the commands sent before it
+    struct Slot {
+        bool done = false;
+        std::string bytes;
+        uint32_t watch = 0;           // Table a Watch answered in this slot is for (0: not a Watch)
+    };
+
+    // A slice of output: an owned buffer, or a frame whose buffer is shared with other connections
+    struct Slice {
+        std::string owned;
+        std::shared_ptr<const std::string> shared;
+        size_t offset = 0;                // Bytes already sent
+
+        const std::string& bytes() const { return shared ? *shared : owned; }
+    };
+
+    struct Connection {
+        int fd = -1;
+        uint64_t id = 0;
+        Protocol protocol = Protocol::Unknown;
+        std::string in;                   // Received bytes not yet executed
+        std::deque<Slice> queued;         // Output to send before out
+        size_t queuedBytes = 0;           // Unsent bytes of queued
+        std::string out;                  // Replies not yet sent
+        FrameBuilder frames{out};         // Groups binary messages into frames
+        size_t outOffset = 0;             // Bytes of out already sent
+        uint32_t events = 0;              // Events the connection is registered for
+        bool paused = false;              // Not read while its output is over the high watermark
+        bool stalled = false;             // Commands left in `in` at the high watermark
+        size_t countedBytes = 0;          // Unsent bytes and slices included in the counters
+        size_t countedSlices = 0;
+        bool dirty = false;               // Has output to send at the end of the round
+        bool closing = false;
+        std::deque<Slot> waiting;         // Answers held back until the ones before them arrive
+        uint64_t firstSlot = 1;           // Number of waiting.front()
+        uint64_t remoteShards = 0;        // Bit s set once a command was sent to shard s
+        std::vector<uint32_t> watching;   // Tables the client watches as a spectator
+        uint64_t holdShards = 0;          // Bit s set while the output waits for the log of shard s...
+        std::vector<uint64_t> holdUntil;  // ...to be durable up to holdUntil[s]
+        bool held = false;                // Listed in held
+    };
+
+    // An action whose Delta is broadcast once the reply of the actor is delivered
+    struct Announcement {
+        bool pending = false;
+        uint32_t table = 0;
+        Action action;
+        TableStatus before;
+    };
+
+    void acceptAll();
+    void adopt(int fd);
+    void onReadable(Connection& connection);
+    void readLines(Connection& connection);
+    void readFrames(Connection& connection);
+    void readInput(Connection& connection);
+    void flush(Connection& connection);
+    void hold(Connection& connection, size_t shard, uint64_t position);
+    bool heldBack(Connection& connection);
+    void releaseHeld();
+    void consume(Connection& connection, size_t sent);
+    void account(Connection& connection);
+    static size_t backlogOf(const Connection& connection) {
+        return connection.queuedBytes + connection.out.size() - connection.outOffset;
+    }
+    void route(Connection& connection, uint32_t table, std::string_view command);
+    void serve(uint64_t client, uint64_t slot, bool binary, std::string_view command);
+    void executeLine(uint64_t client, std::string_view line);
+    void executeMessage(uint64_t client, const FrameView::Message& message);
+    void deliver(uint64_t client, uint64_t slot, std::string_view bytes);
+    void complete(Connection& connection, uint64_t slot, std::string_view bytes);
+    void append(Connection& connection, std::string_view bytes);
+    void joined(uint64_t client, uint32_t table, bool binary);
+    void left(uint64_t client, uint32_t table);
+    void release(uint64_t client);
+    void watch(Connection& connection, uint32_t table, std::string_view answer);
+    void unwatch(Connection& connection, uint32_t table);
+    void viewed(uint64_t client, uint32_t table);
+    bool unviewed(uint64_t client, uint32_t table);
+    void broadcast(uint32_t table, const Action& action, const TableStatus& before);
+    void charge(uint32_t table, uint64_t start, uint64_t actions);
+    void publishUsage();
+    uint32_t loadPercent(bool& byLatency) const;
+    bool shed(uint32_t percent, uint64_t& counter);
+    void shedSpectators();
+    void refuseWatch(Connection& connection, uint32_t table, uint32_t tag);
+    void measureLoad(uint64_t commands, std::chrono::steady_clock::duration busy,
+                     std::chrono::steady_clock::time_point end);
+    void resumeTables();
+    void commitLog();
+    uint64_t logPosition() const;
+    void shipLog();
+    void dropStandby();
+    void arm(uint32_t table);
+    void expireDeadlines();
+    uint64_t clockMs() const;
+    void fanOut(uint32_t table, const std::shared_ptr<const std::string>& frame);
+    void appendShared(Connection& connection, const std::shared_ptr<const std::string>& frame);
+    void markDirty(Connection& connection);
+    void close(Connection& connection);
+    void send(size_t shard, ShardMessage&& message);
+    size_t receive();
+    void handle(ShardMessage& message, size_t from);
+    void sendOutboxes();
+
+    size_t homeOf(uint64_t client) const { return static_cast<size_t>((client - 1) % count); }
+
+    ServerOptions options;
+    size_t index;
+    size_t count;
+    size_t maxConnections;            // This shard's part of options.maxConnections
+    int listenFd;
+    int epollFd = -1;
+    int wakeFd = -1;
+    uint64_t nextClient;
+    size_t nextShard = 0;             // Shard receiving the next accepted connection
+    SplitMix64 seeds;
+    TableRegistry registry;
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;
+    std::unordered_map<uint64_t, Connection*> clients;
+    std::vector<std::unique_ptr<Connection>> closed;   // Freed after the current round of events
+    std::vector<Connection*> dirty;                     // Flushed at the end of the current round
+    std::vector<uint64_t> resumed;                      // Clients whose buffered commands run next round
+    std::unordered_map<uint32_t, std::vector<uint64_t>> watchers;   // Binary clients seated at each table
+    std::unordered_map<uint64_t, std::vector<uint32_t>> seated;     // Tables of this shard each client joined
+    std::unordered_map<uint32_t, std::vector<Connection*>> spectators;  // Connections of this shard watching each table
+    std::unordered_map<uint32_t, std::vector<uint32_t>> audience;       // Spectators per shard of each table of this shard
+    std::unordered_map<uint64_t, std::vector<uint32_t>> viewing;        // Tables of this shard each client watches
+    std::chrono::steady_clock::time_point epoch;       // Tick 0 of the timers
+    uint64_t nowMs = 0;                                 // Clock of the current round, in timer ticks
+    TimerWheel timers;                                  // Turn and reaction deadlines, keyed by table
+    std::unordered_map<uint32_t, TimerWheel::TimerId> deadlines;    // Armed deadline of each table
+    std::vector<uint64_t> expired;                      // Tables whose deadline passed this round
+    int standbyFd = -1;                                 // Connection to the standby, or -1
+    double loadDepth = 0;                               // Smoothed commands per round
+    double loadMicros = 0;                              // Smoothed busy time per round
+    std::chrono::steady_clock::time_point lastRound;    // End of the previous round
+    uint64_t roundCycles = 0;                           // cycleCount() when the current round started
+    uint32_t actedTable = 0;                            // Table of the action the command being served applied
+    std::unordered_map<uint32_t, TableUsage> usage;     // Cost of each table, in cycleCount() ticks
+    bool usageChanged = false;                          // Charged since the last publishUsage()
+    uint64_t usagePublishedMs = 0;
+    std::atomic<std::shared_ptr<const std::vector<TableUsage>>> published;   // Hottest tables, in nanoseconds
+    std::string journal;                                // Action log not yet taken by the standby's socket
+    size_t logged = 0;                                  // Bytes at the front of journal already in the write-ahead log
+    std::unique_ptr<WriteAheadLog> wal;
+    std::vector<uint64_t> held;                         // Clients whose output waits for a commit
+    std::vector<ServerShard*> peers;
+    std::vector<std::unique_ptr<SpscQueue<ShardMessage>>> inbox;   // One queue per sending shard
+    std::vector<std::vector<ShardMessage>> outbox;                 // Messages that did not fit in a peer's queue
+    std::vector<bool> wake;                                         // Peers to wake at the end of the round
+    std::string reply;                // Answer of the command being served
+    Announcement announcement;
+    ServerStats counters;
+};
+
+} // namespace coup
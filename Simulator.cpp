@@ -0,0 +1,187 @@
+// email: shiraba01@gmail.com
+#include "Simulator.hpp"
+#include "Replay.hpp"
+#include "Table.hpp"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace coup {
+
+namespace {
+
+/**
+ * @brief Returns true for the moves bots play only occasionally: reactions,
+ * blocks and sanctions (a sanction is never lifted, so sanctioning freely
+ * starves the whole table).
+ */
+bool isSecondary(ActionKind kind) {
+    return kind == ActionKind::BlockTax || kind == ActionKind::BlockBribe ||
+           kind == ActionKind::BlockArrest || kind == ActionKind::BlockCoup ||
+           kind == ActionKind::Sanction;
+}
+
+size_t aliveCount(const Game& game) {
+    size_t alive = 0;
+    for (size_t s = 0; s < game.numPlayers(); ++s) {
+        if (game.hasFlag(s, FLAG_ALIVE)) alive++;
+    }
+    return alive;
+}
+
+} // namespace
+
+/**
+ * @brief Derives the seed of one game of a run.
+ *
+ * @param runSeed Seed of the whole run.
+ * @param gameIndex Index of the game in the run.
+ * @return uint64_t The game seed.
+ */
+uint64_t gameSeed(uint64_t runSeed, uint64_t gameIndex) {
+    SplitMix64 mix(runSeed ^ (gameIndex * 0xD1B54A32D192ED03ULL));
+    return mix.next();
+}
+
+/**
+ * @brief Draws distinct roles for the seats of a game (partial Fisher-Yates shuffle).
+ *
+ * @param rng The game's random generator.
+ * @param numPlayers Number of seats (at most NUM_ROLES).
+ * @return std::vector<Role> Role of each seat.
+ */
+std::vector<Role> drawRoles(SplitMix64& rng, size_t numPlayers) {
+    Role pool[NUM_ROLES];
+    for (size_t i = 0; i < NUM_ROLES; ++i) pool[i] = static_cast<Role>(i);
+    std::vector<Role> roles;
+    roles.reserve(numPlayers);
+    for (size_t i = 0; i < numPlayers; ++i) {
+        size_t pick = i + rng.below(NUM_ROLES - i);
+        std::swap(pool[i], pool[pick]);
+        roles.push_back(pool[i]);
+    }
+    return roles;
+}
+
+/**
+ * @brief Picks the random bot's next action among the legal ones.
+ *
+ * @param game The game.
+ * @param rng The game's random generator.
+ * @param action Receives the chosen action.
+ * @return true if an action was chosen, false if there is no legal action.
+ */
+bool chooseBotAction(const Game& game, SplitMix64& rng, Action& action) {
+    Action legal[MAX_LEGAL_ACTIONS];
+    Action primary[MAX_LEGAL_ACTIONS];
+    Action secondary[MAX_LEGAL_ACTIONS];
+
+    size_t count = legalActions(game, legal);
+    size_t numPrimary = 0;
+    size_t numSecondary = 0;
+    size_t numCoups = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (isSecondary(legal[i].kind)) {
+            secondary[numSecondary++] = legal[i];
+        } else if (legal[i].kind == ActionKind::Coup) {
+            // Coups are kept at the front of primary
+            primary[numPrimary++] = primary[numCoups];
+            primary[numCoups++] = legal[i];
+        } else {
+            primary[numPrimary++] = legal[i];
+        }
+    }
+    if (numPrimary == 0 && numSecondary == 0) {
+        return false;
+    }
+
+    // Bots react, block or sanction about one ply in ten, and
+    // launch a coup most of the time they can afford one
+    const bool react = numSecondary > 0 && (numPrimary == 0 || rng.below(10) == 0);
+    const bool coup = !react && numCoups > 0 && rng.below(4) != 0;
+    action = react ? secondary[rng.below(numSecondary)]
+           : coup ? primary[rng.below(numCoups)]
+           : primary[rng.below(numPrimary)];
+    return true;
+}
+
+/**
+ * @brief Plays one complete game between random bots.
+ *
+ * @param options Seed, player count and ply limit.
+ * @param recorder Optional replay recorder.
+ * @param observer Optional observer of the game events.
+ * @return GameOutcome Final state of the game.
+ */
+GameOutcome simulateGame(const SimOptions& options, ReplayRecorder* recorder, SimObserver* observer) {
+    SplitMix64 rng(options.seed);
+
+    const size_t n = options.numPlayers ? options.numPlayers : 2 + rng.below(MAX_PLAYERS - 1);
+    ReplayHeader header;
+    header.seed = options.seed;
+    header.roles = drawRoles(rng, n);
+    for (size_t i = 0; i < n; ++i) {
+        header.names.push_back("P" + std::to_string(i + 1));
+    }
+
+    Table table(header.names, header.roles);
+    Game& game = table.getGame();
+    if (recorder) {
+        recorder->reset(header);
+    }
+    if (observer) {
+        observer->onStart(table);
+    }
+
+    size_t plies = 0;
+    Action action;
+    while (plies < options.maxPlies && aliveCount(game) > 1 && chooseBotAction(game, rng, action)) {
+        if (recorder) {
+            recorder->apply(game, action);
+        } else {
+            applyAction(game, action);
+        }
+        if (observer) {
+            observer->onAction(table, action, plies);
+        }
+        plies++;
+    }
+
+    GameOutcome outcome = captureOutcome(game, plies);
+    if (observer) {
+        observer->onEnd(table, outcome);
+    }
+    return outcome;
+}
+
+/**
+ * @brief Replays a recorded game and reports its events to an observer.
+ *
+ * @param data Pointer to the replay bytes.
+ * @param size Number of bytes.
+ * @param observer Notified of the start, every action and the end of the game.
+ * @return GameOutcome Final state of the game.
+ */
+GameOutcome observeReplay(const uint8_t* data, size_t size, SimObserver& observer) {
+    ReplayReader reader(data, size);
+    ReplayHeader header = reader.header();
+    Table table(header.names, header.roles);
+    Game& game = table.getGame();
+    observer.onStart(table);
+
+    size_t plies = 0;
+    ActionRecord record;
+    while (reader.next(record)) {
+        const Action action = record.resolve(game);
+        applyAction(game, action);
+        observer.onAction(table, action, plies);
+        plies++;
+    }
+
+    GameOutcome outcome = captureOutcome(game, plies);
+    observer.onEnd(table, outcome);
+    return outcome;
+}
+
+} // namespace coup
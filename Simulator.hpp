@@ -0,0 +1,123 @@
+// email: shiraba01@gmail.com
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Action.hpp"
+#include "Game.hpp"
+#include "Replay.hpp"
+
+namespace coup {
+
+class Table;
+
+/**
+ * @brief Small, fast and portable PRNG (SplitMix64).
+ *
+ * Used instead of the <random> distributions so that a seed produces the same
+ * game on every platform and standard library.
+ */
+class SplitMix64 {
+public:
+    explicit SplitMix64(uint64_t seed) : state(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    // Uniform value in [0, n) (n > 0)
+    size_t below(size_t n) { return static_cast<size_t>(next() % n); }
+
+private:
+    uint64_t state;
+};
+
+/**
+ * @brief Derives the seed of one game of a run from the run seed and the game index.
+ *
+ * Keying every game by its index keeps runs reproducible whatever the order
+ * in which games are played (threads, resumed runs).
+ */
+uint64_t gameSeed(uint64_t runSeed, uint64_t gameIndex);
+
+/**
+ * @brief Draws distinct roles for the seats of a game.
+ *
+ * @param rng The game's random generator.
+ * @param numPlayers Number of seats (at most NUM_ROLES).
+ * @return std::vector<Role> Role of each seat.
+ */
+std::vector<Role> drawRoles(SplitMix64& rng, size_t numPlayers);
+
+/**
+ * @brief Picks the random bot's next action among the legalActions() of the game.
+ *
+ * Usually a move of the player whose turn it is (a coup most of the time one
+ * is affordable), sometimes a reaction, a block or a sanction.
+ *
+ * @param game The game.
+ * @param rng The game's random generator.
+ * @param action Receives the chosen action.
+ * @return true if an action was chosen, false if there is no legal action.
+ */
+bool chooseBotAction(const Game& game, SplitMix64& rng, Action& action);
+
+/**
+ * @brief Settings of one simulated game.
+ */
+struct SimOptions {
+    uint64_t seed = 0;          // Seed of the game (roles, seating and every bot decision)
+    size_t numPlayers = 0;      // 2 to 6, or 0 to draw the player count from the seed
+    size_t maxPlies = 1000;     // The game stops undecided after this many actions
+};
+
+/**
+ * @brief Receives the events of a simulated game (statistics, exporters).
+ *
+ * Every callback has an empty default implementation.
+ */
+class SimObserver {
+public:
+    virtual ~SimObserver() = default;
+
+    // Called once the players are seated, before the first action
+    virtual void onStart(const Table& table) {}
+
+    // Called after each action was applied; ply counts from 0
+    virtual void onAction(const Table& table, const Action& action, size_t ply) {}
+
+    // Called once the game is decided or reached the ply limit
+    virtual void onEnd(const Table& table, const GameOutcome& outcome) {}
+};
+
+/**
+ * @brief Plays one complete game between random bots.
+ *
+ * Roles are drawn without repetition, then every ply a bot picks one of the
+ * legalActions(): usually a move of the player whose turn it is, sometimes a
+ * reaction or a blocking ability.
+ *
+ * @param options Seed, player count and ply limit.
+ * @param recorder If not null, reset with the game header and used to record every action.
+ * @param observer If not null, notified of the start, every action and the end of the game.
+ * @return GameOutcome Number of plies, winner and final coins of the game.
+ */
+GameOutcome simulateGame(const SimOptions& options, ReplayRecorder* recorder = nullptr,
+                         SimObserver* observer = nullptr);
+
+/**
+ * @brief Replays a recorded game and reports its events to an observer, as simulateGame() does.
+ *
+ * @param data Pointer to the replay bytes.
+ * @param size Number of bytes.
+ * @param observer Notified of the start, every action and the end of the game.
+ * @return GameOutcome Final state of the game.
+ * @throws std::runtime_error if the replay is malformed or an action breaks a rule.
+ */
+GameOutcome observeReplay(const uint8_t* data, size_t size, SimObserver& observer);
+
+} // namespace coup
@@ -0,0 +1,77 @@
+// email: shiraba01@gmail.com
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace coup {
+
+/**
+ * @brief Bounded wait-free queue between exactly one producer thread and one consumer thread.
+ *
+ * A ring of preallocated slots indexed by two counters: the producer only
+ * writes tail, the consumer only writes head. Each side keeps a cached copy
+ * of the other's counter and reloads it only when the ring looks full (or
+ * empty), so most operations touch no shared cache line.
+ */
+template <typename T>
+class SpscQueue {
+public:
+    /**
+     * @brief Creates a queue holding at least capacity elements (rounded up to a power of two).
+     */
+    explicit SpscQueue(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        slots.resize(size);
+        mask = size - 1;
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    /**
+     * @brief Moves a value into the queue (producer side).
+     *
+     * @return false if the queue is full; the value is then left untouched.
+     */
+    bool push(T&& value) {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        if (t - cachedHead > mask) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (t - cachedHead > mask) return false;
+        }
+        slots[t & mask] = std::move(value);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Moves the oldest value out of the queue (consumer side).
+     *
+     * @return false if the queue is empty.
+     */
+    bool pop(T& value) {
+        const size_t h = head.load(std::memory_order_relaxed);
+        if (h == cachedTail) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (h == cachedTail) return false;
+        }
+        value = std::move(slots[h & mask]);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+private:
+    std::vector<T> slots;
+    size_t mask = 0;
+    alignas(64) std::atomic<size_t> head{0};      // Written by the consumer
+    size_t cachedTail = 0;                        // Consumer's copy of tail
+    alignas(64) std::atomic<size_t> tail{0};      // Written by the producer
+    size_t cachedHead = 0;                        // Producer's copy of head
+};
+
+} // namespace coup
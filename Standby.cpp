@@ -0,0 +1,183 @@
+// email: shiraba01@gmail.com
+#include "Standby.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace coup {
+
+namespace {
+
+// Bytes read from a shard per recv() call
+constexpr size_t READ_CHUNK = 64 << 10;
+
+// Events fetched per epoll_wait
+constexpr int MAX_EVENTS = 64;
+
+} // namespace
+
+/**
+ * @brief Listens on a Unix socket for the shards of a server.
+ *
+ * @param path Path of the socket (an existing file there is replaced).
+ * @throws std::runtime_error if the socket cannot be created, bound or listened on.
+ */
+Standby::Standby(const std::string& path) : path(path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Unix socket path too long: " + path);
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    listenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+    ::unlink(path.c_str());
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;       // The listening socket
+    if (listenFd < 0 || epollFd < 0 || ::bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(listenFd, SOMAXCONN) != 0 || ::epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event) != 0) {
+        if (listenFd >= 0) ::close(listenFd);
+        if (epollFd >= 0) ::close(epollFd);
+        throw std::runtime_error("Cannot listen on " + path);
+    }
+}
+
+/**
+ * @brief Closes the connections and removes the socket file.
+ */
+Standby::~Standby() {
+    for (auto& follower : followers) {
+        if (follower->fd >= 0) ::close(follower->fd);
+    }
+    ::close(listenFd);
+    ::close(epollFd);
+    ::unlink(path.c_str());
+}
+
+/**
+ * @brief Accepts shards and replays what they sent.
+ *
+ * @param timeoutMs Longest wait for an event (-1 waits forever).
+ * @return size_t Number of events handled.
+ * @throws std::runtime_error if epoll fails, or a log does not apply to the standby's tables.
+ */
+size_t Standby::poll(int timeoutMs) {
+    epoll_event events[MAX_EVENTS];
+    const int ready = ::epoll_wait(epollFd, events, MAX_EVENTS, timeoutMs);
+    if (ready < 0 && errno != EINTR) {
+        throw std::runtime_error("epoll_wait failed.");
+    }
+    for (int i = 0; i < ready; ++i) {
+        Follower* follower = static_cast<Follower*>(events[i].data.ptr);
+        if (!follower) {
+            acceptAll();
+        } else if (follower->fd >= 0) {
+            onReadable(*follower);
+        }
+    }
+    followers.erase(std::remove_if(followers.begin(), followers.end(),
+                                   [](const std::unique_ptr<Follower>& follower) { return follower->fd < 0; }),
+                    followers.end());
+    return static_cast<size_t>(std::max(ready, 0));
+}
+
+/**
+ * @brief Hands the tables of every shard to a server taking over (the standby keeps none).
+ */
+std::vector<TableRegistry> Standby::takeTables() {
+    return std::exchange(shardTables, {});
+}
+
+void Standby::acceptAll() {
+    for (;;) {
+        const int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        auto follower = std::make_unique<Follower>();
+        follower->fd = fd;
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.ptr = follower.get();
+        if (::epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            ::close(fd);
+            continue;
+        }
+        followers.push_back(std::move(follower));
+    }
+}
+
+/**
+ * @brief Reads what a shard sent: its hello first, then log records, replayed as soon as they are complete.
+ *
+ * @throws std::runtime_error if the log does not apply to the tables of the shard.
+ */
+void Standby::onReadable(Follower& follower) {
+    char buffer[READ_CHUNK];
+    bool gone = false;          // The shard stopped, or its server died: replay what it sent, then close
+    for (;;) {
+        const ssize_t received = ::recv(follower.fd, buffer, sizeof(buffer), 0);
+        if (received < 0 && errno == EINTR) continue;
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (received <= 0) {
+            gone = true;
+            break;
+        }
+        follower.in.append(buffer, static_cast<size_t>(received));
+        if (static_cast<size_t>(received) < sizeof(buffer)) break;
+    }
+
+    size_t offset = 0;
+    if (follower.shard < 0) {
+        if (follower.in.size() < sizeof(StandbyHello)) {
+            if (gone) close(follower);
+            return;
+        }
+        StandbyHello hello;
+        std::memcpy(&hello, follower.in.data(), sizeof(hello));
+        if (hello.magic == STANDBY_MAGIC && shardTables.empty() && hello.shards > 0) {
+            for (uint32_t shard = 0; shard < hello.shards; ++shard) {
+                shardTables.emplace_back(shard + 1, hello.shards);
+            }
+            seen.assign(hello.shards, false);
+        }
+        if (hello.magic != STANDBY_MAGIC || hello.shards != shardTables.size() || hello.shard >= hello.shards ||
+            seen[hello.shard]) {
+            counters.rejected++;
+            close(follower);
+            return;
+        }
+        follower.shard = hello.shard;
+        seen[hello.shard] = true;
+        greeted++;
+        counters.connected++;
+        offset = sizeof(hello);
+    }
+    const size_t applied = shardTables[static_cast<size_t>(follower.shard)].replay(follower.in.data() + offset,
+                                                                                 follower.in.size() - offset);
+    counters.bytes += applied;
+    follower.in.erase(0, offset + applied);
+    if (gone) {
+        close(follower);
+    }
+}
+
+void Standby::close(Follower& follower) {
+    ::epoll_ctl(epollFd, EPOLL_CTL_DEL, follower.fd, nullptr);
+    ::close(follower.fd);
+    follower.fd = -1;
+    if (follower.shard >= 0) {
+        counters.connected--;
+    }
+}
+
+} // namespace coup
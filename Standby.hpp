@@ -0,0 +1,113 @@
+// email: shiraba01@gmail.com
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "TableRegistry.hpp"
+
+namespace coup {
+
+// First bytes of every shard's stream to a standby ("CPLG")
+constexpr uint32_t STANDBY_MAGIC = 0x474C5043;
+
+/**
+ * @brief What a server shard sends first on its connection to a standby.
+ */
+struct StandbyHello {
+    uint32_t magic = STANDBY_MAGIC;
+    uint16_t shard = 0;
+    uint16_t shards = 0;              // Shards of the server
+};
+static_assert(sizeof(StandbyHello) == 8, "StandbyHello must stay 8 bytes");
+
+/**
+ * @brief Counters of a Standby.
+ */
+struct StandbyStats {
+    uint64_t bytes = 0;               // Log bytes replayed
+    size_t connected = 0;             // Shards streaming right now
+    uint64_t rejected = 0;            // Connections closed for a bad hello
+};
+
+/**
+ * @brief Hot standby of a GameServer: follows the action log of every shard and can take over its tables.
+ *
+ * Listens on a Unix socket. Each shard of a server started with
+ * ServerOptions::standbyPath connects, says which shard it is, and streams
+ * the LogRecords of its TableRegistry; the standby replays them into a
+ * registry of its own per shard, so it holds the same tables in the same
+ * state, a round of events behind at most. A shard writes its log before
+ * the replies of the round, so every action a client saw acknowledged is
+ * already in the standby's socket when the server dies.
+ *
+ * Once every shard has disconnected (leaderGone()), takeTables() hands the
+ * registries to a new GameServer, whose players rejoin under their names.
+ */
+class Standby {
+public:
+    /**
+     * @brief Listens on a Unix socket for the shards of a server.
+     *
+     * @param path Path of the socket (an existing file there is replaced).
+     * @throws std::runtime_error if the socket cannot be created, bound or listened on.
+     */
+    explicit Standby(const std::string& path);
+
+    /**
+     * @brief Closes the connections and removes the socket file.
+     */
+    ~Standby();
+
+    Standby(const Standby&) = delete;
+    Standby& operator=(const Standby&) = delete;
+
+    /**
+     * @brief Accepts shards and replays what they sent.
+     *
+     * @param timeoutMs Longest wait for an event (-1 waits forever).
+     * @return size_t Number of events handled.
+     * @throws std::runtime_error if epoll fails, or a log does not apply to the standby's tables.
+     */
+    size_t poll(int timeoutMs);
+
+    // Every shard of the server connected once and is gone again
+    bool leaderGone() const { return shardTables.size() > 0 && greeted == shardTables.size() && counters.connected == 0; }
+
+    // Shards of the server followed (0 before the first hello)
+    size_t shardCount() const { return shardTables.size(); }
+
+    // Tables of one shard, as replayed so far
+    const TableRegistry& tables(size_t shard) const { return shardTables.at(shard); }
+
+    /**
+     * @brief Hands the tables of every shard to a server taking over (the standby keeps none).
+     */
+    std::vector<TableRegistry> takeTables();
+
+    const StandbyStats& stats() const { return counters; }
+
+private:
+    struct Follower {
+        int fd = -1;
+        int shard = -1;               // Set by its hello
+        std::string in;               // Received bytes not yet replayed
+    };
+
+    void acceptAll();
+    void onReadable(Follower& follower);
+    void close(Follower& follower);
+
+    std::string path;
+    int listenFd = -1;
+    int epollFd = -1;
+    std::vector<std::unique_ptr<Follower>> followers;
+    std::vector<TableRegistry> shardTables;
+    std::vector<bool> seen;           // Shards that sent their hello
+    size_t greeted = 0;
+    StandbyStats counters;
+};
+
+} // namespace coup
@@ -0,0 +1,29 @@
+// email: shiraba01@gmail.com
+#include "Table.hpp"
+
+#include <stdexcept>
+
+namespace coup {
+
+/**
+ * @brief Creates a game and seats one player per name, in order.
+ *
+ * @param names Player names (2 to 6).
+ * @param roles Role of each player (same size as names).
+ * @throws std::invalid_argument if the sizes differ or are out of range.
+ */
+Table::Table(const std::vector<std::string>& names, const std::vector<Role>& roles)
+    : roles(roles) {
+    if (names.size() != roles.size()) {
+        throw std::invalid_argument("Every player needs exactly one role.");
+    }
+    if (names.size() < 2 || names.size() > MAX_PLAYERS) {
+        throw std::invalid_argument("A table needs between 2 and 6 players.");
+    }
+    players.reserve(names.size());
+    for (size_t i = 0; i < names.size(); ++i) {
+        players.push_back(makePlayer(game, roles[i], names[i]));
+    }
+}
+
+} // namespace coup
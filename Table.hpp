@@ -0,0 +1,50 @@
+// email: shiraba01@gmail.com
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Game.hpp"
+#include "Player.hpp"
+#include "Roles.hpp"
+
+namespace coup {
+
+/**
+ * @brief A game together with the players that sit at it.
+ *
+ * Players hold a reference to their Game and the Game holds pointers to its
+ * players, so both are owned here and the Table itself is neither copyable
+ * nor movable (allocate it with std::make_unique when it has to move around).
+ */
+class Table {
+public:
+    /**
+     * @brief Creates a game and seats one player per name, in order.
+     *
+     * @param names Player names (2 to 6).
+     * @param roles Role of each player (same size as names).
+     * @throws std::invalid_argument if the sizes differ or are out of range.
+     */
+    Table(const std::vector<std::string>& names, const std::vector<Role>& roles);
+
+    Table(const Table&) = delete;
+    Table& operator=(const Table&) = delete;
+
+    Game& getGame() { return game; }
+    const Game& getGame() const { return game; }
+
+    // Player at a seat (seats are assigned in construction order)
+    Player& player(size_t seat) { return *players.at(seat); }
+    const Player& player(size_t seat) const { return *players.at(seat); }
+
+    Role roleAt(size_t seat) const { return roles.at(seat); }
+    size_t size() const { return players.size(); }
+
+private:
+    Game game;                                     // Declared first: destroyed after the players
+    std::vector<std::unique_ptr<Player>> players;
+    std::vector<Role> roles;
+};
+
+} // namespace coup
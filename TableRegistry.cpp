@@ -0,0 +1,370 @@
+// email: shiraba01@gmail.com
+#include "TableRegistry.hpp"
+#include "Simulator.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace coup {
+
+namespace {
+
+// Longest player name, so that its length fits in a LogRecord
+constexpr size_t MAX_NAME_LENGTH = 255;
+
+} // namespace
+
+/**
+ * @brief Creates an empty table.
+ *
+ * @param numPlayers Number of seats (2 to 6).
+ * @param seed Seed of the role draw.
+ * @param reactions Open reaction windows after tax, bribe and coup.
+ * @return uint32_t Id of the new table.
+ * @throws std::invalid_argument if the player count is out of range.
+ */
+uint32_t TableRegistry::create(size_t numPlayers, uint64_t seed, bool reactions) {
+    if (numPlayers < 2 || numPlayers > MAX_PLAYERS) {
+        throw std::invalid_argument("A table needs between 2 and 6 players.");
+    }
+    const uint32_t id = nextId;
+    nextId += idStep;
+    HostedTable& hosted = tables[id];
+    hosted.id = id;
+    hosted.reactions = reactions;
+    SplitMix64 rng(seed);
+    hosted.roles = drawRoles(rng, numPlayers);
+    hosted.names.reserve(numPlayers);
+    hosted.clients.reserve(numPlayers);
+    record(LogKind::Create, id, seed, static_cast<uint8_t>(numPlayers), reactions ? 1 : 0);
+    return id;
+}
+
+/**
+ * @brief Seats a client at the next free seat; the game starts when the last seat is taken.
+ *
+ * A client joining under the name of a player who left takes that seat back.
+ *
+ * @param tableId Id of the table.
+ * @param client Id of the client.
+ * @param name Name of the player.
+ * @return size_t The seat.
+ * @throws std::runtime_error if there is no such table or it is full.
+ * @throws std::invalid_argument if the name is empty, longer than 255 bytes or already used at the table.
+ */
+size_t TableRegistry::join(uint32_t tableId, uint64_t client, const std::string& name) {
+    HostedTable& hosted = find(tableId);
+    if (name.empty()) {
+        throw std::invalid_argument("A player needs a name.");
+    }
+    if (name.size() > MAX_NAME_LENGTH) {
+        throw std::invalid_argument("A player name is at most 255 bytes.");
+    }
+    auto named = std::find(hosted.names.begin(), hosted.names.end(), name);
+    if (named != hosted.names.end()) {
+        const size_t seat = static_cast<size_t>(named - hosted.names.begin());
+        if (hosted.present[seat]) {
+            throw std::invalid_argument("Name already taken at this table: " + name);
+        }
+        hosted.clients[seat] = client;
+        hosted.present[seat] = true;
+        record(LogKind::Join, tableId, client, static_cast<uint8_t>(name.size()));
+        if (journal) journal->append(name);
+        return seat;
+    }
+    if (hosted.names.size() == hosted.roles.size()) {
+        throw std::runtime_error("The table is full.");
+    }
+    record(LogKind::Join, tableId, client, static_cast<uint8_t>(name.size()));
+    if (journal) journal->append(name);
+    hosted.names.push_back(name);
+    hosted.clients.push_back(client);
+    hosted.present.push_back(true);
+    if (hosted.names.size() == hosted.roles.size()) {
+        hosted.table = std::make_unique<Table>(hosted.names, hosted.roles);
+        hosted.flow = std::make_unique<TurnFlow>(*hosted.table, hosted.reactions);
+    }
+    return hosted.names.size() - 1;
+}
+
+/**
+ * @brief Applies an action played by a client from one of its seats.
+ *
+ * @param tableId Id of the table.
+ * @param client Id of the client.
+ * @param action The action (the actor is the seat it is played from).
+ * @throws std::runtime_error if there is no such table, it has not started or is over,
+ *         the seat is not the client's, a reaction window does not allow the
+ *         action or the action breaks a rule.
+ * @throws std::invalid_argument if the target is out of range or the seat does not have the role.
+ */
+void TableRegistry::act(uint32_t tableId, uint64_t client, const Action& action) {
+    HostedTable& hosted = find(tableId);
+    if (!hosted.table) {
+        throw std::runtime_error("The game has not started yet.");
+    }
+    if (action.actor >= hosted.clients.size() || hosted.clients[action.actor] != client ||
+        !hosted.present[action.actor]) {
+        throw std::runtime_error("This seat is not yours.");
+    }
+    Game& game = hosted.table->getGame();
+    if (captureOutcome(game, hosted.plies).winner != NO_SEAT) {
+        throw std::runtime_error("The game is over.");
+    }
+    play(hosted, action);
+}
+
+/**
+ * @brief Plays the default decision of a table whose player ran out of time.
+ *
+ * In a reaction window every seat still allowed to react passes, which
+ * closes it. Otherwise the player whose turn it is gathers, or, when
+ * gathering is not allowed, plays the first legal move that ends the turn
+ * (a coup at 10 coins, or pass).
+ *
+ * @param tableId Id of the table.
+ * @return Action The move applied, or the last pass of the reaction window.
+ * @throws std::runtime_error if there is no such table, or it has not started or is over.
+ */
+Action TableRegistry::expire(uint32_t tableId) {
+    HostedTable& hosted = find(tableId);
+    if (!hosted.table) {
+        throw std::runtime_error("The game has not started yet.");
+    }
+    Game& game = hosted.table->getGame();
+    if (captureOutcome(game, hosted.plies).winner != NO_SEAT) {
+        throw std::runtime_error("The game is over.");
+    }
+    Action action;
+    if (hosted.flow->reacting()) {
+        for (uint8_t seat = 0; seat < hosted.roles.size(); ++seat) {
+            if ((hosted.flow->waitingFor() >> seat) & 1) {
+                action = Action{ActionKind::Pass, seat, NO_TARGET};
+                play(hosted, action);
+            }
+        }
+        return action;
+    }
+    Action legal[MAX_LEGAL_ACTIONS];
+    const size_t count = legalActions(game, legal);
+    const size_t seat = game.currentSeat();
+    const Action* chosen = nullptr;
+    for (size_t i = 0; i < count; ++i) {
+        const ActionKind kind = legal[i].kind;
+        if (legal[i].actor != seat || kind == ActionKind::Bribe || kind == ActionKind::BlockArrest ||
+            kind == ActionKind::BlockCoup) {
+            continue;
+        }
+        if (kind == ActionKind::Gather) {
+            chosen = &legal[i];
+            break;
+        }
+        if (!chosen) chosen = &legal[i];
+    }
+    if (!chosen) {
+        throw std::runtime_error("No move ends the turn.");
+    }
+    action = *chosen;
+    play(hosted, action);
+    return action;
+}
+
+/**
+ * @brief Returns the current status of a table.
+ *
+ * @param tableId Id of the table.
+ * @return TableStatus Seats, turn, coins, bank and winner.
+ * @throws std::runtime_error if there is no such table.
+ */
+TableStatus TableRegistry::status(uint32_t tableId) const {
+    const HostedTable& hosted = find(tableId);
+    TableStatus status;
+    status.id = hosted.id;
+    status.numPlayers = static_cast<uint8_t>(hosted.roles.size());
+    status.joined = static_cast<uint8_t>(hosted.names.size());
+    status.plies = hosted.plies;
+    if (!hosted.table) {
+        return status;
+    }
+    const Game& game = hosted.table->getGame();
+    const GameOutcome outcome = captureOutcome(game, hosted.plies);
+    status.started = true;
+    status.over = outcome.winner != NO_SEAT;
+    status.reacting = hosted.flow->reacting();
+    status.reactors = hosted.flow->waitingFor();
+    status.turn = static_cast<uint8_t>(game.currentSeat());
+    status.winner = static_cast<int8_t>(outcome.winner);
+    status.aliveMask = outcome.aliveMask;
+    status.bank = outcome.bank;
+    std::copy(outcome.coins, outcome.coins + outcome.numPlayers, status.coins);
+    return status;
+}
+
+/**
+ * @brief Returns the role of a seat of a table.
+ *
+ * @param tableId Id of the table.
+ * @param seat The seat.
+ * @return Role The role drawn for the seat.
+ * @throws std::runtime_error if there is no such table.
+ * @throws std::out_of_range if the seat is out of range.
+ */
+Role TableRegistry::roleAt(uint32_t tableId, size_t seat) const {
+    return find(tableId).roles.at(seat);
+}
+
+/**
+ * @brief Releases the seats of a client at a table, and drops the table if nobody is left.
+ *
+ * A game in progress keeps its seats: the players stay in the game but can no
+ * longer act.
+ *
+ * @param tableId Id of the table.
+ * @param client Id of the client.
+ */
+void TableRegistry::leave(uint32_t tableId, uint64_t client) {
+    auto it = tables.find(tableId);
+    if (it == tables.end()) {
+        return;
+    }
+    record(LogKind::Leave, tableId, client);
+    HostedTable& hosted = it->second;
+    bool anyone = false;
+    for (size_t seat = 0; seat < hosted.clients.size(); ++seat) {
+        if (hosted.clients[seat] == client) hosted.present[seat] = false;
+        anyone = anyone || hosted.present[seat];
+    }
+    if (!anyone) {
+        tables.erase(it);
+    }
+}
+
+/**
+ * @brief Applies the complete records at the front of an action log.
+ *
+ * @param data The log.
+ * @param size Bytes available.
+ * @return size_t Bytes of the records applied; an incomplete record at the end is left.
+ * @throws std::runtime_error if a record is corrupt or does not apply to these tables.
+ */
+size_t TableRegistry::replay(const char* data, size_t size) {
+    size_t offset = 0;
+    while (size - offset >= sizeof(LogRecord)) {
+        LogRecord entry;
+        std::memcpy(&entry, data + offset, sizeof(entry));
+        size_t length = sizeof(entry);
+        try {
+            switch (static_cast<LogKind>(entry.kind)) {
+                case LogKind::Create: {
+                    if (tables.count(entry.table) != 0) {
+                        throw std::runtime_error("Table created twice.");
+                    }
+                    nextId = entry.table;
+                    create(entry.action, entry.value, entry.actor != 0);
+                    break;
+                }
+                case LogKind::Join: {
+                    length += entry.action;
+                    if (size - offset < length) {
+                        return offset;
+                    }
+                    join(entry.table, entry.value, std::string(data + offset + sizeof(entry), entry.action));
+                    break;
+                }
+                case LogKind::Act: {
+                    HostedTable& hosted = find(entry.table);
+                    if (!hosted.flow || entry.action >= NUM_ACTION_KINDS) {
+                        throw std::runtime_error("No such move.");
+                    }
+                    play(hosted, Action{static_cast<ActionKind>(entry.action), entry.actor, entry.target});
+                    break;
+                }
+                case LogKind::Leave:
+                    leave(entry.table, entry.value);
+                    break;
+                case LogKind::Vacate:
+                    vacate();
+                    break;
+                default:
+                    throw std::runtime_error("Unknown record.");
+            }
+        } catch (const std::exception& e) {
+            throw std::runtime_error(std::string("Action log does not apply: ") + e.what());
+        }
+        offset += length;
+    }
+    return offset;
+}
+
+/**
+ * @brief Marks every seat as left, without dropping any table, for a server taking over the tables.
+ *
+ * Journaled, so that a registry replaying the log frees the seats at the same point.
+ */
+void TableRegistry::vacate() {
+    record(LogKind::Vacate, 0, 0);
+    for (auto& entry : tables) {
+        HostedTable& hosted = entry.second;
+        std::fill(hosted.present.begin(), hosted.present.end(), false);
+        std::fill(hosted.clients.begin(), hosted.clients.end(), 0);
+    }
+}
+
+/**
+ * @brief Returns the ids of the tables, in no particular order.
+ */
+std::vector<uint32_t> TableRegistry::ids() const {
+    std::vector<uint32_t> list;
+    list.reserve(tables.size());
+    for (const auto& entry : tables) {
+        list.push_back(entry.first);
+    }
+    return list;
+}
+
+/**
+ * @brief Hands a decision to the turn flow of a running table and logs it.
+ */
+void TableRegistry::play(HostedTable& hosted, const Action& action) {
+    if (hosted.flow->offer(action)) {
+        hosted.plies++;
+    }
+    record(LogKind::Act, hosted.id, 0, static_cast<uint8_t>(action.kind), action.actor, action.target);
+}
+
+/**
+ * @brief Appends one record to the journal, if there is one.
+ */
+void TableRegistry::record(LogKind kind, uint32_t tableId, uint64_t value, uint8_t action, uint8_t actor,
+                           uint8_t target) {
+    if (!journal) {
+        return;
+    }
+    LogRecord entry;
+    entry.kind = static_cast<uint8_t>(kind);
+    entry.action = action;
+    entry.actor = actor;
+    entry.target = target;
+    entry.table = tableId;
+    entry.value = value;
+    journal->append(reinterpret_cast<const char*>(&entry), sizeof(entry));
+}
+
+TableRegistry::HostedTable& TableRegistry::find(uint32_t tableId) {
+    auto it = tables.find(tableId);
+    if (it == tables.end()) {
+        throw std::runtime_error("No such table: " + std::to_string(tableId));
+    }
+    return it->second;
+}
+
+const TableRegistry::HostedTable& TableRegistry::find(uint32_t tableId) const {
+    auto it = tables.find(tableId);
+    if (it == tables.end()) {
+        throw std::runtime_error("No such table: " + std::to_string(tableId));
+    }
+    return it->second;
+}
+
+} // namespace coup
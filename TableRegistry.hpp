@@ -0,0 +1,218 @@
+// email: shiraba01@gmail.com
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Action.hpp"
+#include "Roles.hpp"
+#include "Table.hpp"
+#include "TurnFlow.hpp"
+
+namespace coup {
+
+/**
+ * @brief Snapshot of one hosted table, as reported to clients.
+ */
+struct TableStatus {
+    uint32_t id = 0;
+    uint8_t numPlayers = 0;           // Seats of the table
+    uint8_t joined = 0;               // Seats taken so far
+    bool started = false;             // All seats are taken and the game is running
+    bool over = false;                // One player is left
+    bool reacting = false;            // A reaction window is open (see TurnFlow)
+    uint8_t reactors = 0;             // Bit s set if seat s may still react
+    uint8_t turn = 0;                 // Seat whose turn it is (once started)
+    int8_t winner = NO_SEAT;          // Seat of the winner once over
+    uint8_t aliveMask = 0;            // Bit s set if seat s is alive
+    int bank = 0;
+    int coins[MAX_PLAYERS] = {};
+    uint32_t plies = 0;               // Actions applied so far
+};
+
+/**
+ * @brief What a change to the tables of a registry is, in its action log.
+ */
+enum class LogKind : uint8_t {
+    Create = 1,
+    Join = 2,         // Followed by the name of the player
+    Act = 3,          // A decision handed to the table's turn flow (client actions and default moves)
+    Leave = 4,
+    Vacate = 5        // Every seat of every table left (a server restarted with the tables)
+};
+
+/**
+ * @brief One fixed-size record of the action log of a registry (see TableRegistry::setJournal).
+ */
+struct LogRecord {
+    uint8_t kind = 0;                 // LogKind
+    uint8_t action = 0;               // Act: ActionKind; Create: player count; Join: length of the name
+    uint8_t actor = 0;                // Act: seat; Create: 1 with reaction windows
+    uint8_t target = 0;               // Act: target seat
+    uint32_t table = 0;
+    uint64_t value = 0;               // Create: seed; Join, Leave: client
+};
+static_assert(sizeof(LogRecord) == 16, "LogRecord must stay 16 bytes");
+
+/**
+ * @brief The tables hosted by a server: creation, seating and actions of clients.
+ *
+ * Clients are identified by an opaque id chosen by the server. A table is
+ * created with a player count, its roles are drawn from its seed, and the
+ * game starts once every seat is taken. Actions go through the table's
+ * TurnFlow coroutine, which may hold the game in a reaction window; rules are
+ * enforced by the game itself, so a rejected action throws the engine's
+ * exception. A table is dropped once every client seated at it has left.
+ *
+ * A registry may keep a journal: every change is appended to it as one
+ * LogRecord (plus the name, for a join), and replay() applies such a log to
+ * another registry, which then holds the same tables in the same state.
+ * This is how a hot standby follows a server (see Standby).
+ */
+class TableRegistry {
+public:
+    /**
+     * @brief Creates an empty registry.
+     *
+     * @param firstId Id of the first table created.
+     * @param idStep Gap between consecutive ids, so that several registries
+     *        (one per server shard) hand out disjoint ids.
+     */
+    explicit TableRegistry(uint32_t firstId = 1, uint32_t idStep = 1) : nextId(firstId), idStep(idStep) {}
+
+    /**
+     * @brief Creates an empty table.
+     *
+     * @param numPlayers Number of seats (2 to 6).
+     * @param seed Seed of the role draw.
+     * @param reactions Open reaction windows after tax, bribe and coup.
+     * @return uint32_t Id of the new table.
+     * @throws std::invalid_argument if the player count is out of range.
+     */
+    uint32_t create(size_t numPlayers, uint64_t seed, bool reactions = false);
+
+    /**
+     * @brief Seats a client at the next free seat (a client may take several seats).
+     *
+     * @return size_t The seat.
+     * @throws std::runtime_error if there is no such table or it is full.
+     * @throws std::invalid_argument if the name is empty, longer than 255 bytes or already used at the table.
+     */
+    size_t join(uint32_t tableId, uint64_t client, const std::string& name);
+
+    /**
+     * @brief Applies an action played by a client from one of its seats.
+     *
+     * @throws std::runtime_error if there is no such table, it has not started,
+     *         the seat is not the client's, a reaction window does not allow
+     *         the action or the action breaks a rule.
+     * @throws std::invalid_argument if the target is out of range or the seat does not have the role.
+     */
+    void act(uint32_t tableId, uint64_t client, const Action& action);
+
+    /**
+     * @brief Plays the default decision of a table whose player ran out of time.
+     *
+     * In a reaction window every seat still allowed to react passes, which
+     * closes it. Otherwise the player whose turn it is gathers, or, when
+     * gathering is not allowed, plays the first legal move that ends the turn
+     * (a coup at 10 coins, or pass).
+     *
+     * @param tableId Id of the table.
+     * @return Action The move applied, or the last pass of the reaction window.
+     * @throws std::runtime_error if there is no such table, or it has not started or is over.
+     */
+    Action expire(uint32_t tableId);
+
+    /**
+     * @brief Returns the current status of a table.
+     *
+     * @throws std::runtime_error if there is no such table.
+     */
+    TableStatus status(uint32_t tableId) const;
+
+    /**
+     * @brief Returns the role of a seat of a table.
+     *
+     * @throws std::runtime_error if there is no such table.
+     * @throws std::out_of_range if the seat is out of range.
+     */
+    Role roleAt(uint32_t tableId, size_t seat) const;
+
+    /**
+     * @brief Releases the seats of a client at a table, and drops the table if nobody is left.
+     */
+    void leave(uint32_t tableId, uint64_t client);
+
+    /**
+     * @brief Appends a LogRecord for every later change of the registry to a buffer (nullptr stops).
+     *
+     * @param log The buffer; the caller drains it and keeps it alive while it is set.
+     */
+    void setJournal(std::string* log) { journal = log; }
+
+    /**
+     * @brief Applies the complete records at the front of an action log.
+     *
+     * @param data The log.
+     * @param size Bytes available.
+     * @return size_t Bytes of the records applied; an incomplete record at the end is left.
+     * @throws std::runtime_error if a record is corrupt or does not apply to these tables.
+     */
+    size_t replay(const char* data, size_t size);
+
+    /**
+     * @brief Marks every seat as left, without dropping any table, for a server taking over the tables.
+     *
+     * A player gets their seat back by joining again under the same name.
+     */
+    void vacate();
+
+    // Ids of the tables, in no particular order
+    std::vector<uint32_t> ids() const;
+
+    // Id the next table created gets
+    uint32_t nextTableId() const { return nextId; }
+
+    /**
+     * @brief Makes the next table created get the id next, unless it would get a later one already.
+     *
+     * For a registry rebuilt from a log that no longer holds the tables created last.
+     */
+    void resumeIds(uint32_t next) { nextId = std::max(nextId, next); }
+
+    // The table exists (it is dropped once everyone left)
+    bool hosts(uint32_t tableId) const { return tables.count(tableId) != 0; }
+
+    size_t size() const { return tables.size(); }
+
+private:
+    struct HostedTable {
+        uint32_t id = 0;
+        std::vector<std::string> names;
+        std::vector<Role> roles;
+        std::vector<uint64_t> clients;       // Client of each taken seat
+        std::vector<bool> present;           // The client of the seat has not left
+        bool reactions = false;
+        std::unique_ptr<Table> table;        // Created once every seat is taken
+        std::unique_ptr<TurnFlow> flow;      // Turn flow of the table, destroyed before it
+        uint32_t plies = 0;
+    };
+
+    HostedTable& find(uint32_t tableId);
+    const HostedTable& find(uint32_t tableId) const;
+    void play(HostedTable& hosted, const Action& action);
+    void record(LogKind kind, uint32_t tableId, uint64_t value, uint8_t action = 0, uint8_t actor = 0,
+                uint8_t target = 0);
+
+    std::unordered_map<uint32_t, HostedTable> tables;
+    uint32_t nextId;
+    uint32_t idStep;
+    std::string* journal = nullptr;
+};
+
+} // namespace coup
@@ -0,0 +1,197 @@
+// email: shiraba01@gmail.com
+#include "TimerWheel.hpp"
+
+#include <algorithm>
+
+namespace coup {
+
+namespace {
+
+constexpr uint64_t SLOT_MASK = TimerWheel::SLOTS - 1;
+
+// Ticks covered by the levels; deadlines further away wait in the overflow list
+constexpr unsigned SPAN_BITS = TimerWheel::LEVELS * TimerWheel::SLOT_BITS;
+constexpr uint64_t SPAN = uint64_t(1) << SPAN_BITS;
+
+} // namespace
+
+/**
+ * @brief Arms a timer.
+ *
+ * @param deadline Tick at which it expires; a deadline before now() expires at now().
+ * @param key Value handed back when it expires.
+ * @return TimerId Id to cancel it with (never 0).
+ */
+TimerWheel::TimerId TimerWheel::schedule(uint64_t deadline, uint64_t key) {
+    uint32_t node = freeList;
+    if (node != NONE) {
+        freeList = nodes[node].next;
+    } else {
+        node = static_cast<uint32_t>(nodes.size());
+        nodes.emplace_back();
+        nodes[node].generation = 1;
+    }
+    Node& timer = nodes[node];
+    timer.deadline = deadline;
+    timer.key = key;
+    timer.armed = true;
+    place(node);
+    armed++;
+    return (static_cast<uint64_t>(timer.generation) << 32) | node;
+}
+
+/**
+ * @brief Disarms a timer.
+ *
+ * @param id Id returned by schedule().
+ * @return bool true if it was armed, false if it already expired or was cancelled.
+ */
+bool TimerWheel::cancel(TimerId id) {
+    const uint32_t node = static_cast<uint32_t>(id);
+    if (node >= nodes.size() || nodes[node].generation != static_cast<uint32_t>(id >> 32) || !nodes[node].armed) {
+        return false;
+    }
+    unlink(node);
+    Node& timer = nodes[node];
+    timer.armed = false;
+    timer.generation++;
+    timer.next = freeList;
+    freeList = node;
+    armed--;
+    return true;
+}
+
+/**
+ * @brief Moves the clock to a tick and collects the keys of the timers whose deadline is at or before it.
+ *
+ * Visits only the ticks where a slot is due: an expiry on level 0, or the
+ * cascade of an upper slot (from the top level down, so that the timers
+ * cascaded from one level are moved again at once if their slot is due too).
+ *
+ * @param now The tick (an earlier tick than the clock changes nothing).
+ * @param expired Receives the keys, by deadline.
+ * @return size_t Number of keys appended.
+ */
+size_t TimerWheel::advance(uint64_t now, std::vector<uint64_t>& expired) {
+    const size_t before = expired.size();
+    for (uint64_t tick; armed > 0 && (tick = nextEvent()) <= now;) {
+        current = tick;
+        if ((tick & (SPAN - 1)) == 0 && heads[FAR] != NONE) {
+            cascade(FAR);
+        }
+        for (size_t level = LEVELS - 1; level > 0; --level) {
+            const size_t slot = static_cast<size_t>(tick >> (level * SLOT_BITS)) & SLOT_MASK;
+            if ((occupied[level] >> slot) & 1) {
+                cascade(static_cast<uint16_t>(level * SLOTS + slot));
+            }
+        }
+        const size_t slot = static_cast<size_t>(tick & SLOT_MASK);
+        uint32_t node = heads[slot];
+        heads[slot] = NONE;
+        occupied[0] &= ~(uint64_t(1) << slot);
+        while (node != NONE) {
+            Node& timer = nodes[node];
+            const uint32_t next = timer.next;
+            expired.push_back(timer.key);
+            timer.armed = false;
+            timer.generation++;
+            timer.next = freeList;
+            freeList = node;
+            armed--;
+            node = next;
+        }
+        current = tick + 1;
+    }
+    if (now >= current && now != UINT64_MAX) {
+        current = now + 1;
+    }
+    return expired.size() - before;
+}
+
+/**
+ * @brief Returns the next tick at which advance() has work to do (an expiry or a cascade).
+ *
+ * @return uint64_t The tick, or NO_EVENT if no timer is armed.
+ */
+uint64_t TimerWheel::nextEvent() const {
+    if (armed == 0) {
+        return NO_EVENT;
+    }
+    uint64_t next = NO_EVENT;
+    const uint64_t near = occupied[0] & (~uint64_t(0) << (current & SLOT_MASK));
+    if (near != 0) {
+        next = (current & ~SLOT_MASK) + static_cast<uint64_t>(__builtin_ctzll(near));
+    }
+    for (size_t level = 1; level < LEVELS; ++level) {
+        const unsigned shift = static_cast<unsigned>(level * SLOT_BITS);
+        const uint64_t slot = (current >> shift) & SLOT_MASK;
+        const uint64_t later = occupied[level] & (~uint64_t(0) << slot);
+        if (later == 0) {
+            continue;
+        }
+        const uint64_t first = static_cast<uint64_t>(__builtin_ctzll(later));
+        const uint64_t block = current >> (shift + SLOT_BITS) << (shift + SLOT_BITS);
+        next = std::min(next, first == slot ? current : block + (first << shift));
+    }
+    if (heads[FAR] != NONE) {
+        next = std::min(next, (current + SPAN - 1) & ~(SPAN - 1));
+    }
+    return next;
+}
+
+/**
+ * @brief Links a node into the slot of its deadline, seen from the current tick.
+ *
+ * A deadline that shares its bits above level l with the clock, but not
+ * those of level l, goes to level l, in the slot given by its level-l bits.
+ */
+void TimerWheel::place(uint32_t node) {
+    const uint64_t deadline = std::max(nodes[node].deadline, current);
+    const uint64_t diff = deadline ^ current;
+    if (diff >= SPAN) {
+        link(node, FAR);
+        return;
+    }
+    const size_t level = diff < SLOTS ? 0 : static_cast<size_t>(63 - __builtin_clzll(diff)) / SLOT_BITS;
+    const size_t slot = static_cast<size_t>(deadline >> (level * SLOT_BITS)) & SLOT_MASK;
+    link(node, static_cast<uint16_t>(level * SLOTS + slot));
+}
+
+void TimerWheel::link(uint32_t node, uint16_t where) {
+    Node& timer = nodes[node];
+    timer.where = where;
+    timer.prev = NONE;
+    timer.next = heads[where];
+    if (timer.next != NONE) nodes[timer.next].prev = node;
+    heads[where] = node;
+    if (where != FAR) occupied[where / SLOTS] |= uint64_t(1) << (where % SLOTS);
+}
+
+void TimerWheel::unlink(uint32_t node) {
+    const Node& timer = nodes[node];
+    if (timer.prev != NONE) {
+        nodes[timer.prev].next = timer.next;
+    } else {
+        heads[timer.where] = timer.next;
+    }
+    if (timer.next != NONE) nodes[timer.next].prev = timer.prev;
+    if (heads[timer.where] == NONE && timer.where != FAR) {
+        occupied[timer.where / SLOTS] &= ~(uint64_t(1) << (timer.where % SLOTS));
+    }
+}
+
+/**
+ * @brief Moves the timers of an upper slot (or of the overflow list) down to the slots of their deadlines.
+ */
+void TimerWheel::cascade(uint16_t where) {
+    uint32_t node = heads[where];
+    heads[where] = NONE;
+    if (where != FAR) occupied[where / SLOTS] &= ~(uint64_t(1) << (where % SLOTS));
+    while (node != NONE) {
+        const uint32_t next = nodes[node].next;
+        place(node);
+        node = next;
+    }
+}
+
+} // namespace coup
@@ -0,0 +1,112 @@
+// email: shiraba01@gmail.com
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace coup {
+
+/**
+ * @brief Hierarchical timing wheel: O(1) schedule, cancel and expiry of deadlines counted in ticks.
+ *
+ * Four levels of 64 slots each. Level 0 holds the deadlines of the current
+ * block of 64 ticks, one slot per tick; a slot of level l covers 64^l ticks
+ * and is moved down ("cascaded") when the wheel reaches it, so a timer moves
+ * at most 3 times in its life. Deadlines more than 64^4 ticks away wait in an
+ * overflow list, cascaded every 64^4 ticks. Timers live in a pool of nodes
+ * linked into the slots, and a 64-bit mask per level tells which slots are
+ * occupied, so advancing skips empty ticks instead of visiting them.
+ *
+ * A timer carries a 64-bit key (a table id, for the server) that is handed
+ * back when it expires. Ids stay unique: cancelling a timer that already
+ * expired, or whose node was reused, does nothing.
+ */
+class TimerWheel {
+public:
+    using TimerId = uint64_t;
+
+    static constexpr size_t LEVELS = 4;
+    static constexpr size_t SLOT_BITS = 6;
+    static constexpr size_t SLOTS = size_t(1) << SLOT_BITS;
+    static constexpr uint64_t NO_EVENT = UINT64_MAX;
+
+    /**
+     * @brief Creates an empty wheel whose clock is at the given tick.
+     */
+    explicit TimerWheel(uint64_t now = 0) : current(now) {}
+
+    /**
+     * @brief Arms a timer.
+     *
+     * @param deadline Tick at which it expires; a deadline before now() expires at now().
+     * @param key Value handed back when it expires.
+     * @return TimerId Id to cancel it with (never 0).
+     */
+    TimerId schedule(uint64_t deadline, uint64_t key);
+
+    /**
+     * @brief Disarms a timer.
+     *
+     * @return bool true if it was armed, false if it already expired or was cancelled.
+     */
+    bool cancel(TimerId id);
+
+    /**
+     * @brief Moves the clock to a tick and collects the keys of the timers whose deadline is at or before it.
+     *
+     * @param now The tick (an earlier tick than the clock changes nothing).
+     * @param expired Receives the keys, by deadline.
+     * @return size_t Number of keys appended.
+     */
+    size_t advance(uint64_t now, std::vector<uint64_t>& expired);
+
+    /**
+     * @brief Returns the next tick at which advance() has work to do (an expiry or a cascade).
+     *
+     * No timer expires before it, so a caller may sleep until then.
+     *
+     * @return uint64_t The tick, or NO_EVENT if no timer is armed.
+     */
+    uint64_t nextEvent() const;
+
+    // Timers armed
+    size_t size() const { return armed; }
+
+    // First tick that advance() has not reached yet
+    uint64_t now() const { return current; }
+
+private:
+    static constexpr uint32_t NONE = UINT32_MAX;
+    static constexpr uint16_t FAR = LEVELS * SLOTS;      // The overflow list
+
+    struct Node {
+        uint64_t deadline = 0;
+        uint64_t key = 0;
+        uint32_t prev = NONE;
+        uint32_t next = NONE;         // Next node of the slot, or of the free list
+        uint32_t generation = 0;      // Bumped when the node is freed
+        uint16_t where = 0;           // Slot (level * SLOTS + index) or FAR
+        bool armed = false;
+    };
+
+    void place(uint32_t node);
+    void link(uint32_t node, uint16_t where);
+    void unlink(uint32_t node);
+    void cascade(uint16_t where);
+
+    std::vector<Node> nodes;
+    uint32_t freeList = NONE;
+    std::array<uint32_t, LEVELS * SLOTS + 1> heads = filledHeads();
+    std::array<uint64_t, LEVELS> occupied{};     // Bit s of level l set if its slot s holds timers
+    uint64_t current;
+    size_t armed = 0;
+
+    static std::array<uint32_t, LEVELS * SLOTS + 1> filledHeads() {
+        std::array<uint32_t, LEVELS * SLOTS + 1> empty;
+        empty.fill(NONE);
+        return empty;
+    }
+};
+
+} // namespace coup
@@ -0,0 +1,326 @@
+// email: shiraba01@gmail.com
+#include "Tournament.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// The checkpoint is written and read as a raw struct
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "The checkpoint format is little-endian"
+#endif
+
+namespace coup {
+
+namespace {
+
+const char CHECKPOINT_MAGIC[8] = {'C', 'O', 'U', 'P', 'C', 'K', 'P', 'T'};
+
+// Games per chunk handed to a thread
+constexpr uint64_t CHUNK = 256;
+
+struct CheckpointBlob {
+    char magic[8];
+    uint32_t version;
+    uint32_t numPlayers;
+    uint64_t runSeed;
+    uint64_t games;
+    uint64_t maxPlies;
+    uint64_t nextGame;
+    uint64_t digest;
+    uint64_t counts[5];                     // games, decided, plies, coups, blocks
+    uint64_t gamesWithRole[NUM_ROLES];
+    uint64_t winsByRole[NUM_ROLES];
+    uint64_t winsBySeat[MAX_PLAYERS];
+    uint64_t checksum;                      // FNV-1a of every byte above
+};
+static_assert(sizeof(CheckpointBlob) == 248, "CheckpointBlob must keep its on-disk layout");
+
+uint64_t fnv1a(const void* data, size_t size) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ p[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+/**
+ * @brief Hash of one game result, summed into the run digest.
+ */
+uint64_t resultHash(uint64_t index, const GameResult& result) {
+    uint64_t hash = SplitMix64(index).next();
+    hash = SplitMix64(hash ^ result.plies ^ (static_cast<uint64_t>(result.seatRoles) << 32)).next();
+    hash = SplitMix64(hash ^ result.winnerSeat ^ (static_cast<uint64_t>(result.coups) << 8) ^
+                      (static_cast<uint64_t>(result.blocks) << 24) ^ (static_cast<uint64_t>(result.peakCoins) << 40) ^
+                      (static_cast<uint64_t>(result.finalBank) << 48)).next();
+    return hash;
+}
+
+/**
+ * @brief Statistics of one chunk of games, waiting until every earlier chunk is merged.
+ */
+struct ChunkResult {
+    uint64_t end = 0;
+    ResultsSummary summary;
+    uint64_t digest = 0;
+};
+
+/**
+ * @brief Writes the whole buffer to a file descriptor.
+ */
+bool writeAll(int fd, const void* data, size_t size) {
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+        const ssize_t written = ::write(fd, p, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+/**
+ * @brief Syncs the directory of a path so that a rename in it survives a crash.
+ */
+void syncDirectory(const std::string& path) {
+    const size_t slash = path.find_last_of('/');
+    const std::string dir = slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+    const int fd = ::open(dir.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+}
+
+} // namespace
+
+/**
+ * @brief Compares two progress records field by field.
+ *
+ * @param other The other progress.
+ * @return true if both count the same games with the same statistics.
+ */
+bool TournamentProgress::operator==(const TournamentProgress& other) const {
+    const ResultsSummary& a = summary;
+    const ResultsSummary& b = other.summary;
+    return nextGame == other.nextGame && digest == other.digest && a.games == b.games &&
+           a.decided == b.decided && a.plies == b.plies && a.coups == b.coups && a.blocks == b.blocks &&
+           std::equal(a.gamesWithRole, a.gamesWithRole + NUM_ROLES, b.gamesWithRole) &&
+           std::equal(a.winsByRole, a.winsByRole + NUM_ROLES, b.winsByRole) &&
+           std::equal(a.winsBySeat, a.winsBySeat + MAX_PLAYERS, b.winsBySeat);
+}
+
+/**
+ * @brief Atomically replaces the checkpoint of a run (write to a temporary file, sync, rename).
+ *
+ * @param path Path of the checkpoint.
+ * @param options The run the checkpoint belongs to.
+ * @param progress The progress to save.
+ * @throws std::runtime_error if the checkpoint cannot be written.
+ */
+void saveCheckpoint(const std::string& path, const TournamentOptions& options, const TournamentProgress& progress) {
+    CheckpointBlob blob;
+    std::memset(&blob, 0, sizeof(blob));
+    std::memcpy(blob.magic, CHECKPOINT_MAGIC, sizeof(blob.magic));
+    blob.version = CHECKPOINT_VERSION;
+    blob.numPlayers = static_cast<uint32_t>(options.numPlayers);
+    blob.runSeed = options.runSeed;
+    blob.games = options.games;
+    blob.maxPlies = options.maxPlies;
+    blob.nextGame = progress.nextGame;
+    blob.digest = progress.digest;
+    const ResultsSummary& s = progress.summary;
+    blob.counts[0] = s.games;
+    blob.counts[1] = s.decided;
+    blob.counts[2] = s.plies;
+    blob.counts[3] = s.coups;
+    blob.counts[4] = s.blocks;
+    std::memcpy(blob.gamesWithRole, s.gamesWithRole, sizeof(blob.gamesWithRole));
+    std::memcpy(blob.winsByRole, s.winsByRole, sizeof(blob.winsByRole));
+    std::memcpy(blob.winsBySeat, s.winsBySeat, sizeof(blob.winsBySeat));
+    blob.checksum = fnv1a(&blob, offsetof(CheckpointBlob, checksum));
+
+    const std::string temp = path + ".tmp";
+    const int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot create checkpoint: " + temp);
+    }
+    const bool written = writeAll(fd, &blob, sizeof(blob)) && ::fsync(fd) == 0;
+    if (::close(fd) != 0 || !written) {
+        ::unlink(temp.c_str());
+        throw std::runtime_error("Failed to write checkpoint: " + temp);
+    }
+    if (::rename(temp.c_str(), path.c_str()) != 0) {
+        ::unlink(temp.c_str());
+        throw std::runtime_error("Cannot replace checkpoint: " + path);
+    }
+    syncDirectory(path);
+}
+
+/**
+ * @brief Reads the checkpoint of a run.
+ *
+ * @param path Path of the checkpoint.
+ * @param options The run being resumed (must match the saved one).
+ * @param progress Receives the saved progress.
+ * @return true if a checkpoint was read, false if there is none.
+ * @throws std::runtime_error if the file is corrupt or belongs to a run with other options.
+ */
+bool loadCheckpoint(const std::string& path, const TournamentOptions& options, TournamentProgress& progress) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        if (errno == ENOENT) {
+            return false;
+        }
+        throw std::runtime_error("Cannot open checkpoint: " + path);
+    }
+    CheckpointBlob blob;
+    const ssize_t size = ::read(fd, &blob, sizeof(blob));
+    char extra;
+    const bool trailing = size == static_cast<ssize_t>(sizeof(blob)) && ::read(fd, &extra, 1) != 0;
+    ::close(fd);
+    if (size != static_cast<ssize_t>(sizeof(blob)) || trailing ||
+        std::memcmp(blob.magic, CHECKPOINT_MAGIC, sizeof(blob.magic)) != 0 ||
+        blob.checksum != fnv1a(&blob, offsetof(CheckpointBlob, checksum))) {
+        throw std::runtime_error("Corrupt checkpoint: " + path);
+    }
+    if (blob.version != CHECKPOINT_VERSION) {
+        throw std::runtime_error("Unsupported checkpoint version.");
+    }
+    if (blob.runSeed != options.runSeed || blob.games != options.games ||
+        blob.numPlayers != options.numPlayers || blob.maxPlies != options.maxPlies || blob.nextGame > blob.games) {
+        throw std::runtime_error("Checkpoint belongs to another run: " + path);
+    }
+
+    progress = TournamentProgress();
+    progress.nextGame = blob.nextGame;
+    progress.digest = blob.digest;
+    ResultsSummary& s = progress.summary;
+    s.games = blob.counts[0];
+    s.decided = blob.counts[1];
+    s.plies = blob.counts[2];
+    s.coups = blob.counts[3];
+    s.blocks = blob.counts[4];
+    std::memcpy(s.gamesWithRole, blob.gamesWithRole, sizeof(blob.gamesWithRole));
+    std::memcpy(s.winsByRole, blob.winsByRole, sizeof(blob.winsByRole));
+    std::memcpy(s.winsBySeat, blob.winsBySeat, sizeof(blob.winsBySeat));
+    return true;
+}
+
+/**
+ * @brief Plays (or resumes) a tournament on several threads.
+ *
+ * @param options The run.
+ * @param stop If not null, no new chunk is started once it is true.
+ * @return TournamentReport Statistics of the run so far.
+ */
+TournamentReport runTournament(const TournamentOptions& options, const std::atomic<bool>* stop) {
+    if (options.numPlayers == 1 || options.numPlayers > MAX_PLAYERS) {
+        throw std::invalid_argument("A tournament game needs 2 to 6 players.");
+    }
+    const auto start = std::chrono::steady_clock::now();
+    TournamentReport report;
+    if (!options.checkpointPath.empty()) {
+        loadCheckpoint(options.checkpointPath, options, report.progress);
+    }
+    report.resumedFrom = report.progress.nextGame;
+    const uint64_t end = options.gamesLimit
+        ? std::min(options.games, report.resumedFrom + options.gamesLimit)
+        : options.games;
+
+    std::mutex mutex;
+    std::map<uint64_t, ChunkResult> pending;         // Finished chunks by first game, not merged yet
+    auto lastCheckpoint = start;
+    std::exception_ptr error;
+    std::atomic<uint64_t> nextChunk{report.resumedFrom};
+
+    auto commit = [&](uint64_t begin, ChunkResult& chunk) {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.emplace(begin, std::move(chunk));
+        bool advanced = false;
+        TournamentProgress& progress = report.progress;
+        for (auto it = pending.begin(); it != pending.end() && it->first == progress.nextGame;
+             it = pending.erase(it)) {
+            progress.summary.merge(it->second.summary);
+            progress.digest += it->second.digest;
+            progress.nextGame = it->second.end;
+            advanced = true;
+        }
+        const auto now = std::chrono::steady_clock::now();
+        if (advanced && !options.checkpointPath.empty() && !error &&
+            std::chrono::duration<double>(now - lastCheckpoint).count() >= options.checkpointSeconds) {
+            try {
+                saveCheckpoint(options.checkpointPath, options, progress);
+                report.checkpoints++;
+            } catch (...) {
+                error = std::current_exception();
+            }
+            lastCheckpoint = now;
+        }
+    };
+
+    auto worker = [&]() {
+        ResultCollector collector;
+        for (;;) {
+            if (stop && stop->load(std::memory_order_relaxed)) break;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (error) break;
+            }
+            const uint64_t begin = nextChunk.fetch_add(CHUNK);
+            if (begin >= end) break;
+            ChunkResult chunk;
+            chunk.end = std::min(end, begin + CHUNK);
+            for (uint64_t i = begin; i < chunk.end; ++i) {
+                SimOptions sim;
+                sim.seed = gameSeed(options.runSeed, i);
+                sim.numPlayers = options.numPlayers;
+                sim.maxPlies = options.maxPlies;
+                simulateGame(sim, nullptr, &collector);
+                chunk.summary.add(collector.result());
+                chunk.digest += resultHash(i, collector.result());
+            }
+            commit(begin, chunk);
+        }
+    };
+
+    size_t numThreads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < numThreads; ++t) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    if (!options.checkpointPath.empty() && report.progress.nextGame > report.resumedFrom) {
+        saveCheckpoint(options.checkpointPath, options, report.progress);
+        report.checkpoints++;
+    }
+    report.played = report.progress.nextGame - report.resumedFrom;
+    report.finished = report.progress.nextGame == options.games;
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return report;
+}
+
+} // namespace coup
@@ -0,0 +1,93 @@
+// email: shiraba01@gmail.com
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "ResultsStore.hpp"
+
+namespace coup {
+
+/**
+ * Checkpoint file (one fixed-size little-endian record, 248 bytes):
+ *
+ *   magic "COUPCKPT" | version u32 | numPlayers u32 | runSeed u64 | games u64 | maxPlies u64
+ *   | nextGame u64 | digest u64 | summary counters | FNV-1a checksum u64
+ *
+ * A checkpoint is written to "<path>.tmp", synced, then renamed over <path>,
+ * so a crash at any point leaves either the previous or the new checkpoint.
+ */
+constexpr uint32_t CHECKPOINT_VERSION = 1;
+
+/**
+ * @brief Settings of a tournament: a long run of simulated games.
+ */
+struct TournamentOptions {
+    uint64_t runSeed = 1;             // Game i is played with gameSeed(runSeed, i)
+    uint64_t games = 0;               // Total number of games of the run
+    size_t numPlayers = 0;            // 2 to 6, or 0 to draw it per game
+    size_t maxPlies = 1000;
+    size_t threads = 0;               // 0 for one per core
+    std::string checkpointPath;       // Empty to run without checkpoints
+    double checkpointSeconds = 60;    // Minimum time between two checkpoints (0 after every chunk)
+    uint64_t gamesLimit = 0;          // Stop after this many games in this process (0 for no limit)
+};
+
+/**
+ * @brief What a checkpoint saves: the statistics of games [0, nextGame).
+ */
+struct TournamentProgress {
+    uint64_t nextGame = 0;
+    ResultsSummary summary;
+    uint64_t digest = 0;              // Order-independent hash of every counted game result
+
+    bool operator==(const TournamentProgress& other) const;
+};
+
+/**
+ * @brief Result of runTournament().
+ */
+struct TournamentReport {
+    TournamentProgress progress;
+    uint64_t resumedFrom = 0;         // First game played by this process
+    uint64_t played = 0;              // Games played by this process
+    size_t checkpoints = 0;           // Checkpoints written by this process
+    bool finished = false;            // All games of the run are counted
+    double seconds = 0;
+};
+
+/**
+ * @brief Plays (or resumes) a tournament on several threads.
+ *
+ * Threads take chunks of consecutive games; a chunk's statistics are merged
+ * once every earlier chunk is merged, so progress is always a prefix of the
+ * run. When a checkpoint path is set, an existing checkpoint is resumed and
+ * new ones are written at most every checkpointSeconds and at the end.
+ * Every game is seeded by its index, so a resumed run ends with exactly the
+ * statistics of an uninterrupted one.
+ *
+ * @param options The run.
+ * @param stop If not null, no new chunk is started once it is true (signal handlers, preemption).
+ * @return TournamentReport Statistics of the run so far.
+ * @throws std::runtime_error if the checkpoint is corrupt, belongs to another run or cannot be written.
+ * @throws std::invalid_argument if the player count is out of range.
+ */
+TournamentReport runTournament(const TournamentOptions& options, const std::atomic<bool>* stop = nullptr);
+
+/**
+ * @brief Atomically replaces the checkpoint of a run.
+ *
+ * @throws std::runtime_error if the checkpoint cannot be written.
+ */
+void saveCheckpoint(const std::string& path, const TournamentOptions& options, const TournamentProgress& progress);
+
+/**
+ * @brief Reads the checkpoint of a run.
+ *
+ * @return true if a checkpoint was read, false if there is none.
+ * @throws std::runtime_error if the file is corrupt or belongs to a run with other options.
+ */
+bool loadCheckpoint(const std::string& path, const TournamentOptions& options, TournamentProgress& progress);
+
+} // namespace coup
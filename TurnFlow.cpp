@@ -0,0 +1,230 @@
+// email: shiraba01@gmail.com
+#include "TurnFlow.hpp"
+
+#include <new>
+#include <stdexcept>
+#include <string>
+
+namespace coup {
+
+namespace {
+
+constexpr size_t NUM_SIZE_CLASSES = FramePool::MAX_POOLED_FRAME / FramePool::GRANULE;
+
+struct FreeFrame {
+    FreeFrame* next;
+};
+
+// Free lists and counters of one thread
+struct ThreadFrames {
+    FreeFrame* lists[NUM_SIZE_CLASSES] = {};
+    FramePool::Stats stats;
+
+    ~ThreadFrames() {
+        for (FreeFrame*& list : lists) {
+            while (list) {
+                FreeFrame* next = list->next;
+                ::operator delete(list);
+                list = next;
+            }
+        }
+    }
+};
+
+thread_local ThreadFrames frames;
+
+size_t sizeClass(size_t size) {
+    return (size + FramePool::GRANULE - 1) / FramePool::GRANULE - 1;
+}
+
+} // namespace
+
+/**
+ * @brief Returns a frame of at least size bytes, from the free list of its size class if possible.
+ *
+ * @param size Size requested by the coroutine.
+ * @return void* The frame.
+ * @throws std::bad_alloc if the system allocator fails.
+ */
+void* FramePool::allocate(size_t size) {
+    frames.stats.liveFrames++;
+    if (size > MAX_POOLED_FRAME) {
+        frames.stats.liveBytes += size;
+        frames.stats.systemAllocations++;
+        return ::operator new(size);
+    }
+    const size_t index = sizeClass(size);
+    frames.stats.liveBytes += (index + 1) * GRANULE;
+    if (FreeFrame* frame = frames.lists[index]) {
+        frames.lists[index] = frame->next;
+        frames.stats.pooledFrames--;
+        return frame;
+    }
+    frames.stats.systemAllocations++;
+    return ::operator new((index + 1) * GRANULE);
+}
+
+/**
+ * @brief Puts a frame back on the free list of its size class.
+ *
+ * @param frame The frame.
+ * @param size Size it was allocated with.
+ */
+void FramePool::release(void* frame, size_t size) noexcept {
+    frames.stats.liveFrames--;
+    if (size > MAX_POOLED_FRAME) {
+        frames.stats.liveBytes -= size;
+        ::operator delete(frame);
+        return;
+    }
+    const size_t index = sizeClass(size);
+    frames.stats.liveBytes -= (index + 1) * GRANULE;
+    FreeFrame* freed = static_cast<FreeFrame*>(frame);
+    freed->next = frames.lists[index];
+    frames.lists[index] = freed;
+    frames.stats.pooledFrames++;
+}
+
+/**
+ * @brief Returns the counters of the calling thread.
+ */
+FramePool::Stats FramePool::stats() {
+    return frames.stats;
+}
+
+FlowTask& FlowTask::operator=(FlowTask&& other) noexcept {
+    if (this != &other) {
+        if (handle) handle.destroy();
+        handle = other.handle;
+        other.handle = nullptr;
+    }
+    return *this;
+}
+
+FlowTask::~FlowTask() {
+    if (handle) {
+        handle.destroy();
+    }
+}
+
+/**
+ * @brief Starts the flow of a table; the coroutine suspends waiting for the first move.
+ *
+ * @param table The table (must outlive the flow).
+ * @param reactions Open reaction windows after tax, bribe and coup.
+ */
+TurnFlow::TurnFlow(Table& table, bool reactions) : table(table), reactions(reactions) {
+    task = run();
+}
+
+/**
+ * @brief Hands a player's decision to the flow and runs it until it waits again.
+ *
+ * @param action The decision.
+ * @return bool true if the action was applied to the game, false for a declined reaction.
+ * @throws std::runtime_error if the flow is waiting for reactions from other seats,
+ *         or the action breaks a game rule.
+ * @throws std::invalid_argument if a seat is out of range or the actor does not have the role.
+ */
+bool TurnFlow::offer(const Action& action) {
+    Decision decision;
+    decision.action = action;
+    current = &decision;
+    resumePoint.resume();
+    current = nullptr;
+    if (decision.error) {
+        std::rethrow_exception(decision.error);
+    }
+    return decision.applied;
+}
+
+/**
+ * @brief The turn loop: a move, then the reactions to it.
+ */
+FlowTask TurnFlow::run() {
+    for (;;) {
+        Decision& move = co_await decision();
+        apply(move);
+        if (!move.applied) {
+            continue;
+        }
+        // The decision lives in the caller of offer(): keep the move past the next co_await
+        const Action moved = move.action;
+        reactors = reactorsTo(moved);
+        while (reactors != 0) {
+            Decision& answer = co_await decision();
+            const Action& reaction = answer.action;
+            const bool mayReact = reaction.actor < table.size() && ((reactors >> reaction.actor) & 1);
+            if (mayReact && reaction.kind == ActionKind::Pass) {
+                reactors &= static_cast<uint8_t>(~(1u << reaction.actor));      // Declined
+                continue;
+            }
+            const bool block = (moved.kind == ActionKind::Tax && reaction.kind == ActionKind::BlockTax &&
+                                reaction.target == moved.actor) ||
+                               (moved.kind == ActionKind::Bribe && reaction.kind == ActionKind::BlockBribe &&
+                                reaction.target == moved.actor) ||
+                               (moved.kind == ActionKind::Coup && reaction.kind == ActionKind::BlockCoup &&
+                                reaction.target == moved.target);
+            if (!mayReact || !block) {
+                answer.error = std::make_exception_ptr(
+                    std::runtime_error(std::string("Waiting for reactions to ") + actionName(moved.kind) + "."));
+                continue;
+            }
+            apply(answer);
+            if (answer.applied) {
+                reactors = 0;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Applies a decision to the game, keeping the engine's exception in the decision.
+ */
+void TurnFlow::apply(Decision& decision) {
+    try {
+        applyAction(table.getGame(), decision.action);
+        decision.applied = true;
+    } catch (...) {
+        decision.error = std::current_exception();
+    }
+}
+
+/**
+ * @brief Returns the seats that may answer an action that was just applied.
+ *
+ * @param action The action.
+ * @return uint8_t Bit s set if seat s may react (0 without reaction windows).
+ */
+uint8_t TurnFlow::reactorsTo(const Action& action) const {
+    if (!reactions) {
+        return 0;
+    }
+    const Game& game = table.getGame();
+    uint8_t seats = 0;
+    for (size_t seat = 0; seat < table.size(); ++seat) {
+        if (!game.hasFlag(seat, FLAG_ALIVE)) {
+            continue;
+        }
+        const Role role = table.roleAt(seat);
+        bool may = false;
+        switch (action.kind) {
+            case ActionKind::Tax:
+                may = role == Role::Governor && seat != action.actor;
+                break;
+            case ActionKind::Bribe:
+                may = role == Role::Judge && seat != action.actor;
+                break;
+            case ActionKind::Coup:
+                // General::blockCoup is only allowed on the General's turn
+                may = role == Role::General && game.coinsAt(seat) >= 5 && seat == game.currentSeat();
+                break;
+            default:
+                break;
+        }
+        if (may) seats |= static_cast<uint8_t>(1u << seat);
+    }
+    return seats;
+}
+
+} // namespace coup
@@ -0,0 +1,149 @@
+// email: shiraba01@gmail.com
+#pragma once
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+
+#include "Action.hpp"
+#include "Table.hpp"
+
+namespace coup {
+
+/**
+ * @brief Recycles coroutine frames of the calling thread by size class.
+ *
+ * Frames up to MAX_POOLED_FRAME bytes are rounded up to a multiple of 64
+ * and kept on a free list per size when released, so a shard that keeps
+ * creating and dropping tables stops calling the system allocator once its
+ * lists are warm. Larger frames go to operator new. Each thread has its own
+ * lists and counters, so the tables of a server shard never share them; a
+ * frame released by another thread simply joins that thread's lists.
+ */
+class FramePool {
+public:
+    static constexpr size_t GRANULE = 64;
+    static constexpr size_t MAX_POOLED_FRAME = 1024;
+
+    struct Stats {
+        size_t liveFrames = 0;        // Allocated and not released
+        size_t liveBytes = 0;         // Rounded sizes of the live frames
+        size_t pooledFrames = 0;      // Released frames kept for reuse
+        size_t systemAllocations = 0; // Calls to operator new so far
+    };
+
+    static void* allocate(size_t size);
+    static void release(void* frame, size_t size) noexcept;
+
+    // Counters of the calling thread
+    static Stats stats();
+};
+
+/**
+ * @brief Handle of a coroutine whose frame comes from the FramePool.
+ *
+ * The coroutine runs as soon as it is called, up to its first co_await, and
+ * is destroyed with its handle.
+ */
+class FlowTask {
+public:
+    struct promise_type {
+        FlowTask get_return_object() { return FlowTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+
+        static void* operator new(size_t size) { return FramePool::allocate(size); }
+        static void operator delete(void* frame, size_t size) noexcept { FramePool::release(frame, size); }
+    };
+
+    FlowTask() = default;
+    explicit FlowTask(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+    FlowTask(FlowTask&& other) noexcept : handle(other.handle) { other.handle = nullptr; }
+    FlowTask& operator=(FlowTask&& other) noexcept;
+    FlowTask(const FlowTask&) = delete;
+    FlowTask& operator=(const FlowTask&) = delete;
+    ~FlowTask();
+
+    bool done() const { return !handle || handle.done(); }
+
+private:
+    std::coroutine_handle<promise_type> handle;
+};
+
+/**
+ * @brief The turn flow of one table, written as a coroutine that awaits the decisions of its players.
+ *
+ * The coroutine waits for a move, applies it, and, when the table has
+ * reaction windows, then waits for the seats that may answer it: alive
+ * Governors after a tax (Governor::blockTax), Judges after a bribe
+ * (Judge::blockBribe), and a General with 5 coins whose turn it is after a
+ * coup (General::blockCoup). While such a window is open only those seats
+ * may act: with the matching block, which closes the window, or with Pass,
+ * which declines without touching the game (the window closes once every
+ * seat declined). Without reaction windows every move goes straight to the
+ * game, as before. Rules are enforced by the game itself.
+ *
+ * The flow is not movable: its coroutine refers to it.
+ */
+class TurnFlow {
+public:
+    /**
+     * @brief Starts the flow of a table; the coroutine suspends waiting for the first move.
+     *
+     * @param table The table (must outlive the flow).
+     * @param reactions Open reaction windows after tax, bribe and coup.
+     */
+    TurnFlow(Table& table, bool reactions);
+
+    TurnFlow(const TurnFlow&) = delete;
+    TurnFlow& operator=(const TurnFlow&) = delete;
+
+    /**
+     * @brief Hands a player's decision to the flow and runs it until it waits again.
+     *
+     * @param action The decision.
+     * @return bool true if the action was applied to the game, false for a declined reaction.
+     * @throws std::runtime_error if the flow is waiting for reactions from other seats,
+     *         or the action breaks a game rule.
+     * @throws std::invalid_argument if a seat is out of range or the actor does not have the role.
+     */
+    bool offer(const Action& action);
+
+    // A reaction window is open
+    bool reacting() const { return reactors != 0; }
+
+    // Bit s set if seat s may still react in the open window
+    uint8_t waitingFor() const { return reactors; }
+
+private:
+    // The decision being handed to the coroutine, and what became of it
+    struct Decision {
+        Action action;
+        bool applied = false;
+        std::exception_ptr error;
+    };
+
+    // co_await decision() suspends the flow until offer() hands it the next decision
+    struct DecisionAwaiter {
+        TurnFlow& flow;
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle) noexcept { flow.resumePoint = handle; }
+        Decision& await_resume() const noexcept { return *flow.current; }
+    };
+
+    DecisionAwaiter decision() { return DecisionAwaiter{*this}; }
+    FlowTask run();
+    void apply(Decision& decision);
+    uint8_t reactorsTo(const Action& action) const;
+
+    Table& table;
+    bool reactions;
+    uint8_t reactors = 0;
+    Decision* current = nullptr;
+    std::coroutine_handle<> resumePoint;
+    FlowTask task;
+};
+
+} // namespace coup
@@ -0,0 +1,171 @@
+// email: shiraba01@gmail.com
+#include "Verifier.hpp"
+#include "Table.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace coup {
+
+namespace {
+
+constexpr size_t CHUNK = 256;   // Games taken by a thread at a time
+
+/**
+ * @brief Describes the first difference between the replayed and the recorded final state.
+ */
+std::string describeMismatch(const GameOutcome& actual, const GameOutcome& expected) {
+    if (actual.plies != expected.plies) {
+        return "replay has " + std::to_string(actual.plies) + " plies, index says " + std::to_string(expected.plies);
+    }
+    if (actual.numPlayers != expected.numPlayers) {
+        return "player count differs";
+    }
+    for (size_t s = 0; s < actual.numPlayers; ++s) {
+        if (actual.coins[s] != expected.coins[s]) {
+            return "seat " + std::to_string(s) + " has " + std::to_string(actual.coins[s]) +
+                   " coins, expected " + std::to_string(expected.coins[s]);
+        }
+    }
+    if (actual.bank != expected.bank) {
+        return "bank has " + std::to_string(actual.bank) + " coins, expected " + std::to_string(expected.bank);
+    }
+    if (actual.aliveMask != expected.aliveMask) {
+        return "eliminated players differ";
+    }
+    return "winner differs";
+}
+
+/**
+ * @brief Returns the winner's name as reported by Game::winner(), or an empty string if the game is not over.
+ */
+std::string winnerName(const Game& game) {
+    try {
+        return game.winner();
+    } catch (const std::runtime_error&) {
+        return std::string();
+    }
+}
+
+} // namespace
+
+/**
+ * @brief Re-executes one archived game and compares it with its index entry.
+ *
+ * @param archive The archive.
+ * @param id Game id.
+ * @param divergence Receives the details if the game diverges.
+ * @param actions Incremented by the number of actions applied.
+ * @return true if the game reproduces its recorded outcome.
+ */
+bool verifyGame(const ArchiveReader& archive, size_t id, Divergence& divergence, uint64_t& actions) {
+    divergence.gameId = id;
+    size_t ply = 0;
+    try {
+        ReplayReader reader = archive.replay(id);
+        ReplayHeader header = reader.header();
+        Table table(header.names, header.roles);
+        Game& game = table.getGame();
+
+        ActionRecord record;
+        try {
+            while (reader.next(record)) {
+                applyAction(game, record.resolve(game));
+                ply++;
+            }
+        } catch (const std::exception& e) {
+            actions += ply;
+            divergence.ply = ply;
+            divergence.reason = e.what();
+            return false;
+        }
+        actions += ply;
+
+        const GameOutcome expected = archive.entry(id).outcome();
+        const GameOutcome actual = captureOutcome(game, ply);
+        if (expected.winner != NO_SEAT &&
+            (expected.winner < 0 || static_cast<size_t>(expected.winner) >= reader.numPlayers())) {
+            divergence.ply = ply;
+            divergence.reason = "index names seat " + std::to_string(expected.winner) + " the winner of a " +
+                                std::to_string(reader.numPlayers()) + "-player game";
+            return false;
+        }
+        const std::string expectedWinner =
+            expected.winner == NO_SEAT ? std::string() : std::string(reader.name(expected.winner));
+        if (actual == expected && winnerName(game) == expectedWinner) {
+            return true;
+        }
+        divergence.ply = ply;
+        divergence.reason = describeMismatch(actual, expected);
+        return false;
+    } catch (const std::exception& e) {
+        divergence.ply = ply;
+        divergence.reason = e.what();
+        return false;
+    }
+}
+
+/**
+ * @brief Verifies every game of an archive on several threads.
+ *
+ * @param archive The archive.
+ * @param numThreads Number of threads (0 for one per core).
+ * @param maxReported Maximum number of divergences kept in the report.
+ * @return VerifyReport Counts, timings and the first divergences (by game id).
+ */
+VerifyReport verifyArchive(const ArchiveReader& archive, size_t numThreads, size_t maxReported) {
+    if (numThreads == 0) {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    const auto start = std::chrono::steady_clock::now();
+    archive.adviseSequential();
+
+    VerifyReport report;
+    std::mutex mutex;
+    std::atomic<size_t> nextChunk{0};
+    const size_t count = archive.size();
+
+    auto worker = [&]() {
+        uint64_t actions = 0;
+        uint64_t divergent = 0;
+        std::vector<Divergence> found;
+        Divergence divergence;
+        for (size_t begin = nextChunk.fetch_add(CHUNK); begin < count; begin = nextChunk.fetch_add(CHUNK)) {
+            const size_t end = std::min(count, begin + CHUNK);
+            for (size_t id = begin; id < end; ++id) {
+                if (!verifyGame(archive, id, divergence, actions)) {
+                    divergent++;
+                    if (found.size() < maxReported) found.push_back(divergence);
+                }
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        report.actions += actions;
+        report.divergent += divergent;
+        report.divergences.insert(report.divergences.end(), found.begin(), found.end());
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < numThreads; ++t) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    std::sort(report.divergences.begin(), report.divergences.end(),
+              [](const Divergence& a, const Divergence& b) { return a.gameId < b.gameId; });
+    if (report.divergences.size() > maxReported) {
+        report.divergences.resize(maxReported);
+    }
+    report.games = count;
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return report;
+}
+
+} // namespace coup
@@ -0,0 +1,59 @@
+// email: shiraba01@gmail.com
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Archive.hpp"
+
+namespace coup {
+
+/**
+ * @brief A game of an archive whose replay does not reproduce its recorded outcome.
+ */
+struct Divergence {
+    uint64_t gameId = 0;
+    size_t ply = 0;           // First action the engine rejected, or the number of plies if only the final state differs
+    std::string reason;       // The engine's exception, or the first field that differs
+};
+
+/**
+ * @brief Result of verifying an archive.
+ */
+struct VerifyReport {
+    uint64_t games = 0;
+    uint64_t actions = 0;
+    uint64_t divergent = 0;                 // Number of divergent games (may exceed divergences.size())
+    std::vector<Divergence> divergences;    // The first ones, sorted by game id
+    double seconds = 0;
+};
+
+/**
+ * @brief Re-executes one archived game and compares it with its index entry.
+ *
+ * Checks the number of plies, every seat's coins, the bank, the eliminated
+ * seats and the winner as returned by Game::winner().
+ *
+ * @param archive The archive.
+ * @param id Game id.
+ * @param divergence Receives the details if the game diverges.
+ * @param actions Incremented by the number of actions applied.
+ * @return true if the game reproduces its recorded outcome.
+ */
+bool verifyGame(const ArchiveReader& archive, size_t id, Divergence& divergence, uint64_t& actions);
+
+/**
+ * @brief Verifies every game of an archive on several threads.
+ *
+ * Threads take games in chunks of consecutive ids, so the archive is read
+ * almost sequentially.
+ *
+ * @param archive The archive.
+ * @param numThreads Number of threads (0 for one per core).
+ * @param maxReported Maximum number of divergences kept in the report.
+ * @return VerifyReport Counts, timings and the first divergences.
+ */
+VerifyReport verifyArchive(const ArchiveReader& archive, size_t numThreads = 0, size_t maxReported = 100);
+
+} // namespace coup
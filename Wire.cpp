@@ -0,0 +1,134 @@
+// email: shiraba01@gmail.com
+#include "Wire.hpp"
+
+#include <stdexcept>
+
+// Messages are read and written in place as structs
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "The wire format is little-endian"
+#endif
+
+namespace coup {
+
+/**
+ * @brief Returns the size of a message type.
+ *
+ * @param type A MessageType code.
+ * @return size_t Size of the message, or 0 if the type is unknown.
+ */
+size_t messageSize(uint8_t type) {
+    switch (static_cast<MessageType>(type)) {
+        case MessageType::Create: return sizeof(CreateMessage);
+        case MessageType::Join: return sizeof(JoinMessage);
+        case MessageType::Act: return sizeof(ActMessage);
+        case MessageType::State:
+        case MessageType::Leave:
+        case MessageType::Watch: return sizeof(TableMessage);
+        case MessageType::Reply: return sizeof(ReplyMessage);
+        case MessageType::Status:
+        case MessageType::Keyframe: return sizeof(StatusMessage);
+        case MessageType::Delta: return sizeof(DeltaMessage);
+    }
+    return 0;
+}
+
+/**
+ * @brief Validates the frame at the start of a buffer.
+ *
+ * @param data Start of the buffer.
+ * @param size Bytes available.
+ * @param frame Receives the frame.
+ * @return size_t Size of the frame, or 0 if it is not complete yet.
+ * @throws std::runtime_error if the frame is malformed.
+ */
+size_t FrameView::parse(const uint8_t* data, size_t size, FrameView& frame) {
+    if (size < sizeof(FrameHeader)) {
+        return 0;
+    }
+    const FrameHeader& header = *reinterpret_cast<const FrameHeader*>(data);
+    if (header.magic != FRAME_MAGIC || header.version != WIRE_VERSION) {
+        throw std::runtime_error("Bad frame header.");
+    }
+    if (header.length > MAX_FRAME_LENGTH) {
+        throw std::runtime_error("Frame too long.");
+    }
+    if (size < sizeof(FrameHeader) + header.length) {
+        return 0;
+    }
+    const uint8_t* body = data + sizeof(FrameHeader);
+    size_t offset = 0;
+    for (uint32_t i = 0; i < header.count; ++i) {
+        const size_t messageLength = offset < header.length ? messageSize(body[offset]) : 0;
+        if (messageLength == 0 || offset + messageLength > header.length) {
+            throw std::runtime_error("Malformed message in frame.");
+        }
+        offset += messageLength;
+    }
+    if (offset != header.length) {
+        throw std::runtime_error("Frame length does not match its messages.");
+    }
+    frame.body = body;
+    frame.length = header.length;
+    frame.messages = header.count;
+    return sizeof(FrameHeader) + header.length;
+}
+
+/**
+ * @brief Appends a zeroed message, opening a new frame if none is open or the open one is full.
+ *
+ * @param size Size of the message.
+ * @return uint8_t* The bytes of the message (valid until the next add).
+ */
+uint8_t* FrameBuilder::addMessage(size_t size) {
+    if (!open || count == MAX_FRAME_MESSAGES || out.size() - start + size > MAX_FRAME_LENGTH + sizeof(FrameHeader)) {
+        finish();
+        start = out.size();
+        out.append(sizeof(FrameHeader), '\0');
+        open = true;
+    }
+    const size_t at = out.size();
+    out.append(size, '\0');
+    count++;
+    return reinterpret_cast<uint8_t*>(&out[at]);
+}
+
+/**
+ * @brief Writes the header of the open frame, if any.
+ */
+void FrameBuilder::finish() {
+    if (!open) {
+        return;
+    }
+    FrameHeader& header = *reinterpret_cast<FrameHeader*>(&out[start]);
+    header.magic = FRAME_MAGIC;
+    header.version = WIRE_VERSION;
+    header.count = count;
+    header.length = static_cast<uint32_t>(out.size() - start - sizeof(FrameHeader));
+    open = false;
+    count = 0;
+}
+
+/**
+ * @brief Copies the fields of a table status into a Status message.
+ *
+ * @param message The message (type, code and tag are left to the caller).
+ * @param status The table status.
+ */
+void fillStatus(StatusMessage& message, const TableStatus& status) {
+    message.numPlayers = status.numPlayers;
+    message.joined = status.joined;
+    message.table = status.id;
+    message.plies = status.plies;
+    message.bank = status.bank;
+    message.flags = static_cast<uint8_t>((status.started ? STATUS_STARTED : 0) | (status.over ? STATUS_OVER : 0) |
+                                         (status.reacting ? STATUS_REACTING : 0));
+    message.reactors = status.reactors;
+    message.turn = status.turn;
+    message.winner = status.winner;
+    message.aliveMask = status.aliveMask;
+    for (size_t seat = 0; seat < MAX_PLAYERS; ++seat) {
+        message.coins[seat] = static_cast<int16_t>(status.coins[seat]);
+    }
+}
+
+} // namespace coup
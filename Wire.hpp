@@ -0,0 +1,274 @@
+// email: shiraba01@gmail.com
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "Game.hpp"
+#include "TableRegistry.hpp"
+
+namespace coup {
+
+/**
+ * Binary wire protocol of the game server.
+ *
+ *   frame   = FrameHeader (8 bytes) + length bytes of messages
+ *   message = fixed-size struct, selected by its first byte (MessageType)
+ *
+ * A connection is binary when its first byte is FRAME_MAGIC (text commands
+ * start with a letter). Clients may put many messages in one frame; the
+ * server answers every request message with a Reply or a Status, in order,
+ * and batches the answers of a frame (and the deltas of other tables) into
+ * one frame. Every seated binary client receives a Delta after each action
+ * applied at its table. A client may also watch tables without a seat: it
+ * then gets the Status of the table, a Delta after each action and a
+ * Keyframe (a full Status) every few actions, so it can catch up on any
+ * delta it missed. Deltas carry the plies of the table; a spectator drops
+ * those not newer than its last Status or Keyframe. All fields are
+ * little-endian and every message size is a multiple of 4, so messages are
+ * parsed in place in the receive buffer; they are only 4-byte aligned
+ * there, so a message with an 8-byte field (the seed of a Create) is
+ * copied in and out rather than accessed in place.
+ */
+constexpr uint8_t FRAME_MAGIC = 0xC5;
+constexpr uint8_t WIRE_VERSION = 1;
+constexpr uint32_t MAX_FRAME_LENGTH = 1 << 20;      // Longest frame body accepted
+constexpr uint16_t MAX_FRAME_MESSAGES = 0xFFFF;
+
+enum class MessageType : uint8_t {
+    Create = 1,       // CreateMessage -> Reply(value = table)
+    Join = 2,         // JoinMessage -> Reply(value = seat, extra = role code)
+    Act = 3,          // ActMessage -> Reply(value = plies)
+    State = 4,        // TableMessage -> Status
+    Leave = 5,        // TableMessage -> Reply (also stops watching the table)
+    Watch = 6,        // TableMessage -> Status, then the deltas and keyframes of the table
+    Reply = 0x81,     // ReplyMessage
+    Status = 0x82,    // StatusMessage
+    Delta = 0x83,     // DeltaMessage, pushed after every action
+    Keyframe = 0x84   // StatusMessage, pushed to spectators every few actions
+};
+
+/**
+ * @brief Result code of a Reply.
+ */
+enum class WireCode : uint8_t {
+    Ok = 0,
+    Rejected = 1,     // A game rule or a table state refused the request (std::runtime_error)
+    Invalid = 2,      // A bad argument: player count, seat, target, name (std::invalid_argument)
+    Overloaded = 3    // The server sheds load: no new tables or spectators until it catches up
+};
+
+struct FrameHeader {
+    uint8_t magic;                    // FRAME_MAGIC
+    uint8_t version;                  // WIRE_VERSION
+    uint16_t count;                   // Number of messages
+    uint32_t length;                  // Bytes of messages after the header
+};
+static_assert(sizeof(FrameHeader) == 8, "FrameHeader must keep its wire layout");
+
+// Flags of CreateMessage
+constexpr uint8_t CREATE_REACTIONS = 1 << 0;     // Open reaction windows (see TurnFlow)
+
+struct CreateMessage {
+    uint8_t type;                     // MessageType::Create
+    uint8_t players;
+    uint8_t flags;                    // CREATE_REACTIONS
+    uint8_t reserved;
+    uint32_t tag;                     // Echoed in the reply
+    uint64_t seed;                    // 0 lets the server pick one
+};
+static_assert(sizeof(CreateMessage) == 16, "CreateMessage must keep its wire layout");
+
+struct JoinMessage {
+    uint8_t type;                     // MessageType::Join
+    uint8_t nameLength;               // At most 16
+    uint8_t reserved[2];
+    uint32_t tag;
+    uint32_t table;
+    char name[16];
+};
+static_assert(sizeof(JoinMessage) == 28, "JoinMessage must keep its wire layout");
+
+struct ActMessage {
+    uint8_t type;                     // MessageType::Act
+    uint8_t kind;                     // ActionKind code
+    uint8_t seat;                     // Seat the action is played from
+    uint8_t target;                   // Target seat, or NO_TARGET
+    uint32_t tag;
+    uint32_t table;
+};
+static_assert(sizeof(ActMessage) == 12, "ActMessage must keep its wire layout");
+
+struct TableMessage {
+    uint8_t type;                     // MessageType::State, Leave or Watch
+    uint8_t reserved[3];
+    uint32_t tag;
+    uint32_t table;
+};
+static_assert(sizeof(TableMessage) == 12, "TableMessage must keep its wire layout");
+
+struct ReplyMessage {
+    uint8_t type;                     // MessageType::Reply
+    uint8_t code;                     // WireCode
+    uint8_t extra;                    // Role code of a Join
+    uint8_t reserved;
+    uint32_t tag;                     // Tag of the request
+    uint32_t value;                   // Table, seat or plies
+};
+static_assert(sizeof(ReplyMessage) == 12, "ReplyMessage must keep its wire layout");
+
+// Flags of StatusMessage and DeltaMessage
+constexpr uint8_t STATUS_STARTED = 1 << 0;
+constexpr uint8_t STATUS_OVER = 1 << 1;
+constexpr uint8_t STATUS_REACTING = 1 << 2;      // A reaction window is open
+
+struct StatusMessage {
+    uint8_t type;                     // MessageType::Status or MessageType::Keyframe
+    uint8_t code;                     // WireCode (the rest is zero unless Ok, but for the table when Overloaded)
+    uint8_t numPlayers;
+    uint8_t joined;
+    uint32_t tag;
+    uint32_t table;
+    uint32_t plies;
+    int32_t bank;
+    uint8_t flags;                    // STATUS_STARTED, STATUS_OVER, STATUS_REACTING
+    uint8_t turn;
+    int8_t winner;                    // NO_SEAT while undecided
+    uint8_t aliveMask;
+    int16_t coins[MAX_PLAYERS];
+    uint8_t reactors;                 // Bit s set if seat s may still react
+    uint8_t reserved[3];
+};
+static_assert(sizeof(StatusMessage) == 40, "StatusMessage must keep its wire layout");
+
+struct DeltaMessage {
+    uint8_t type;                     // MessageType::Delta
+    uint8_t kind;                     // The action that was applied
+    uint8_t actor;
+    uint8_t target;
+    uint32_t table;
+    uint32_t plies;                   // Plies after the action
+    int32_t bank;
+    uint8_t flags;                    // STATUS_STARTED, STATUS_OVER, STATUS_REACTING
+    uint8_t turn;
+    uint8_t aliveMask;
+    uint8_t changedMask;              // Bit s set if the coins of seat s changed
+    int16_t coins[MAX_PLAYERS];       // Coins of every seat after the action
+};
+static_assert(sizeof(DeltaMessage) == 32, "DeltaMessage must keep its wire layout");
+
+/**
+ * @brief Returns the size of a message type, or 0 if the type is unknown.
+ */
+size_t messageSize(uint8_t type);
+
+/**
+ * @brief One frame in a receive buffer; the messages are read in place.
+ */
+class FrameView {
+public:
+    /**
+     * @brief A message of the frame (its type decides the struct to read).
+     */
+    struct Message {
+        MessageType type;
+        const uint8_t* data;
+
+        // Copies the message out of the buffer, where it may be misaligned for T
+        template <typename T>
+        T as() const {
+            T message;
+            std::memcpy(&message, data, sizeof(T));
+            return message;
+        }
+    };
+
+    class Iterator {
+    public:
+        Iterator(const uint8_t* at) : at(at) {}
+        Message operator*() const { return Message{static_cast<MessageType>(*at), at}; }
+        Iterator& operator++() { at += messageSize(*at); return *this; }
+        bool operator!=(const Iterator& other) const { return at != other.at; }
+
+    private:
+        const uint8_t* at;
+    };
+
+    uint16_t count() const { return messages; }
+    Iterator begin() const { return Iterator(body); }
+    Iterator end() const { return Iterator(body + length); }
+
+    /**
+     * @brief Validates the frame at the start of a buffer.
+     *
+     * Checks the header and that the messages exactly fill the body, so
+     * iterating needs no further checks.
+     *
+     * @param data Start of the buffer.
+     * @param size Bytes available.
+     * @param frame Receives the frame.
+     * @return size_t Size of the frame, or 0 if it is not complete yet.
+     * @throws std::runtime_error if the frame is malformed.
+     */
+    static size_t parse(const uint8_t* data, size_t size, FrameView& frame);
+
+private:
+    const uint8_t* body = nullptr;
+    uint32_t length = 0;
+    uint16_t messages = 0;
+};
+
+/**
+ * @brief Appends messages to a byte string, grouped into frames.
+ *
+ * A frame is opened by the first message and closed by finish() (or when it
+ * is full), which writes its header.
+ */
+class FrameBuilder {
+public:
+    explicit FrameBuilder(std::string& out) : out(out) {}
+
+    /**
+     * @brief Appends a zeroed message of type T and returns it (valid until the next add()).
+     *
+     * Only for messages without 8-byte fields: the others are appended with add(message).
+     */
+    template <typename T>
+    T& add() {
+        static_assert(alignof(T) <= 4, "Messages are only 4-byte aligned in a frame");
+        return *reinterpret_cast<T*>(addMessage(sizeof(T)));
+    }
+
+    /**
+     * @brief Appends a copy of a message.
+     */
+    template <typename T>
+    void add(const T& message) { std::memcpy(addMessage(sizeof(T)), &message, sizeof(T)); }
+
+    /**
+     * @brief Appends a zeroed message of the given size and returns its bytes (valid until the next add).
+     */
+    uint8_t* addMessage(size_t size);
+
+    /**
+     * @brief Writes the header of the open frame, if any.
+     */
+    void finish();
+
+    // Messages in the open frame
+    size_t pending() const { return open ? count : 0; }
+
+private:
+    std::string& out;
+    size_t start = 0;
+    uint16_t count = 0;
+    bool open = false;
+};
+
+/**
+ * @brief Copies the fields of a table status into a Status message.
+ */
+void fillStatus(StatusMessage& message, const TableStatus& status);
+
+} // namespace coup
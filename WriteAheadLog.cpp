@@ -0,0 +1,536 @@
+// email: shiraba01@gmail.com
+#include "WriteAheadLog.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <unordered_set>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// The log is written and read as raw structs
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "The write-ahead log format is little-endian"
+#endif
+
+namespace coup {
+
+namespace {
+
+const char SEGMENT_MAGIC[8] = {'C', 'O', 'U', 'P', 'W', 'A', 'L', '\0'};
+const char SNAPSHOT_MAGIC[8] = {'C', 'O', 'U', 'P', 'S', 'N', 'A', 'P'};
+
+// Most record bytes per batch of a snapshot
+constexpr size_t SNAPSHOT_BATCH = 1 << 20;
+
+struct WalHeader {
+    char magic[8];
+    uint32_t version;
+    uint16_t shard;
+    uint16_t shards;
+    uint64_t generation;
+    uint32_t nextTable;
+    uint32_t reserved;
+    uint64_t checksum;                      // FNV-1a of every byte above
+};
+static_assert(sizeof(WalHeader) == 40, "WalHeader must keep its on-disk layout");
+
+struct WalBatch {
+    uint32_t length;                        // Bytes of records after the batch header
+    uint32_t reserved;
+    uint64_t checksum;                      // FNV-1a of the records
+};
+static_assert(sizeof(WalBatch) == 16, "WalBatch must keep its on-disk layout");
+
+uint64_t fnv1a(const void* data, size_t size) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ p[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+/**
+ * @brief Writes the whole buffer to a file descriptor.
+ */
+bool writeAll(int fd, const void* data, size_t size) {
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+        const ssize_t written = ::write(fd, p, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+/**
+ * @brief Syncs a directory so that the files created or renamed in it survive a crash.
+ */
+void syncDirectory(const std::string& dir) {
+    const int fd = ::open(dir.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+}
+
+/**
+ * @brief Reads a whole file.
+ *
+ * @return false if it does not exist.
+ * @throws std::runtime_error if it exists but cannot be read.
+ */
+bool readFile(const std::string& path, std::string& bytes) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno == ENOENT) {
+            return false;
+        }
+        throw std::runtime_error("Cannot open the write-ahead log: " + path);
+    }
+    bytes.clear();
+    char chunk[1 << 16];
+    for (;;) {
+        const ssize_t n = ::read(fd, chunk, sizeof(chunk));
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            ::close(fd);
+            throw std::runtime_error("Cannot read the write-ahead log: " + path);
+        }
+        if (n == 0) break;
+        bytes.append(chunk, static_cast<size_t>(n));
+    }
+    ::close(fd);
+    return true;
+}
+
+WalHeader makeHeader(const char* magic, size_t shard, size_t shards, uint64_t generation, uint32_t nextTable) {
+    WalHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, magic, sizeof(header.magic));
+    header.version = WAL_VERSION;
+    header.shard = static_cast<uint16_t>(shard);
+    header.shards = static_cast<uint16_t>(shards);
+    header.generation = generation;
+    header.nextTable = nextTable;
+    header.checksum = fnv1a(&header, offsetof(WalHeader, checksum));
+    return header;
+}
+
+/**
+ * @brief Checks the header of a log file and returns it.
+ *
+ * @throws std::runtime_error if it is corrupt, or written by another shard or a server with another shard count.
+ */
+WalHeader checkHeader(const std::string& bytes, const char* magic, size_t shard, size_t shards,
+                      const std::string& path) {
+    WalHeader header;
+    if (bytes.size() < sizeof(header)) {
+        throw std::runtime_error("Corrupt write-ahead log: " + path);
+    }
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (std::memcmp(header.magic, magic, sizeof(header.magic)) != 0 ||
+        header.checksum != fnv1a(&header, offsetof(WalHeader, checksum))) {
+        throw std::runtime_error("Corrupt write-ahead log: " + path);
+    }
+    if (header.version != WAL_VERSION) {
+        throw std::runtime_error("Unsupported write-ahead log version.");
+    }
+    if (header.shards != shards || header.shard != shard) {
+        throw std::runtime_error("The write-ahead log " + path + " belongs to a server with " +
+                                 std::to_string(header.shards) + " shards.");
+    }
+    return header;
+}
+
+/**
+ * @brief Appends the records of the intact batches of a log file to a buffer.
+ *
+ * @param bytes The file, header included.
+ * @param records Receives the records.
+ * @return size_t Bytes of the file up to the end of the last intact batch.
+ */
+size_t readBatches(const std::string& bytes, std::string& records) {
+    size_t offset = sizeof(WalHeader);
+    while (bytes.size() - offset >= sizeof(WalBatch)) {
+        WalBatch batch;
+        std::memcpy(&batch, bytes.data() + offset, sizeof(batch));
+        const size_t end = offset + sizeof(batch) + batch.length;
+        if (end > bytes.size() || batch.checksum != fnv1a(bytes.data() + offset + sizeof(batch), batch.length)) {
+            break;
+        }
+        records.append(bytes, offset + sizeof(batch), batch.length);
+        offset = end;
+    }
+    return offset;
+}
+
+/**
+ * @brief Writes records as one batch.
+ */
+bool writeBatch(int fd, const char* records, size_t size) {
+    WalBatch batch;
+    batch.length = static_cast<uint32_t>(size);
+    batch.reserved = 0;
+    batch.checksum = fnv1a(records, size);
+    return writeAll(fd, &batch, sizeof(batch)) && writeAll(fd, records, size);
+}
+
+// Bytes of the record at the front of a log (a join carries the name of the player)
+size_t recordSize(const LogRecord& entry) {
+    return sizeof(entry) + (entry.kind == static_cast<uint8_t>(LogKind::Join) ? entry.action : 0);
+}
+
+} // namespace
+
+/**
+ * @brief Rebuilds the tables of a shard from its snapshot and segments, then opens a new segment.
+ *
+ * Segments the snapshot already covers (a compaction died before deleting
+ * them) are deleted, as is a snapshot that was never renamed into place.
+ *
+ * @param directory Directory of the log (created if missing).
+ * @param shard Index of the shard.
+ * @param shards Shards of the server, which must be those of the log.
+ * @param commitMs Shortest time between the starts of two syncs (0: sync whenever records are waiting).
+ * @param tables Empty registry of the shard; receives the recovered tables.
+ * @param onCommit Called by the log's thread after each batch is synced.
+ * @throws std::runtime_error if the directory or a file cannot be opened or written, the log
+ *         belongs to a server with another shard count, or it is corrupt.
+ */
+WriteAheadLog::WriteAheadLog(const std::string& directory, size_t shard, size_t shards, uint32_t commitMs,
+                             TableRegistry& tables, std::function<void()> onCommit)
+    : directory(directory), shard(shard), shards(shards), commitMs(commitMs), onCommit(std::move(onCommit)) {
+    if (::mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw std::runtime_error("Cannot create the write-ahead log directory: " + directory);
+    }
+    ::unlink((snapshotPath() + ".tmp").c_str());
+
+    std::string bytes;
+    std::string records;
+    uint32_t nextTable = 0;
+    if (readFile(snapshotPath(), bytes)) {
+        const WalHeader header = checkHeader(bytes, SNAPSHOT_MAGIC, shard, shards, snapshotPath());
+        if (readBatches(bytes, records) != bytes.size()) {
+            throw std::runtime_error("Corrupt write-ahead log: " + snapshotPath());
+        }
+        snapshotGeneration = header.generation;
+        nextTable = header.nextTable;
+    }
+    uint64_t last = 0;
+    for (const uint64_t segment : segments()) {
+        const std::string path = segmentPath(segment);
+        if (segment < snapshotGeneration) {
+            ::unlink(path.c_str());
+            continue;
+        }
+        last = segment;
+        if (!readFile(path, bytes)) {
+            continue;
+        }
+        if (bytes.size() < sizeof(WalHeader)) {
+            tornBytes += bytes.size();          // Died while creating it
+            ::unlink(path.c_str());
+            continue;
+        }
+        checkHeader(bytes, SEGMENT_MAGIC, shard, shards, path);
+        const size_t intact = readBatches(bytes, records);
+        if (intact < bytes.size()) {
+            tornBytes += bytes.size() - intact;
+            if (::truncate(path.c_str(), static_cast<off_t>(intact)) != 0) {
+                throw std::runtime_error("Cannot repair the write-ahead log: " + path);
+            }
+        }
+    }
+    if (tables.replay(records.data(), records.size()) != records.size()) {
+        throw std::runtime_error("Corrupt write-ahead log in " + directory);
+    }
+    // After the replay, whose Creates set the next id: tables dropped by the compaction keep theirs
+    tables.resumeIds(nextTable);
+    recoveredBytes = records.size();
+
+    openSegment(std::max(snapshotGeneration, last + 1));
+    committer = std::thread([this] { commitLoop(); });
+}
+
+/**
+ * @brief Commits what was appended, then stops the threads of the log.
+ */
+WriteAheadLog::~WriteAheadLog() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeup.notify_one();
+    committer.join();
+    if (compactor.joinable()) {
+        compactor.join();
+    }
+    ::close(segmentFd);
+}
+
+/**
+ * @brief Queues records for the next batch (the owner's thread).
+ *
+ * @param data The records.
+ * @param size Bytes of the records.
+ * @return uint64_t Position of the end of the records.
+ */
+uint64_t WriteAheadLog::append(const char* data, size_t size) {
+    appendedBytes += size;
+    bool first;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        first = pending.empty();
+        pending.append(data, size);
+        pendingEnd = appendedBytes;
+    }
+    if (first) {
+        wakeup.notify_one();
+    }
+    return appendedBytes;
+}
+
+/**
+ * @brief Starts a new segment after the records appended so far, and rewrites the snapshot in the background.
+ *
+ * The new segment starts exactly at the current position, even if the log's
+ * thread rotates only later: every table still open was created before it,
+ * so the old snapshot and segments hold all of its records, and a table
+ * created in between lives entirely in the new segment.
+ *
+ * @param tables The shard's tables as of those records: the records of the tables they no longer hold are dropped.
+ * @return false if the previous compaction is still running (then nothing is done).
+ */
+bool WriteAheadLog::compact(const TableRegistry& tables) {
+    if (compacting.exchange(true)) {
+        return false;
+    }
+    compactedAt = appendedBytes;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        rotate = true;
+        rotateAt = appendedBytes;
+        rotateLive = tables.ids();
+        rotateNextTable = tables.nextTableId();
+    }
+    wakeup.notify_one();
+    return true;
+}
+
+WalStats WriteAheadLog::stats() const {
+    WalStats stats;
+    stats.bytes = writtenBytes.load(std::memory_order_relaxed);
+    stats.commits = commits.load(std::memory_order_relaxed);
+    stats.compactions = compactions.load(std::memory_order_relaxed);
+    stats.recoveredBytes = recoveredBytes;
+    stats.tornBytes = tornBytes;
+    return stats;
+}
+
+/**
+ * @brief Thread of the log: writes and syncs what accumulated, at most once every commitMs, until stopped.
+ *
+ * Records appended while the log is idle are synced at once; those that
+ * arrive during a sync, or less than commitMs after it started, wait for the
+ * next one and share it.
+ */
+void WriteAheadLog::commitLoop() {
+    std::string batch;
+    auto lastCommit = std::chrono::steady_clock::now() - std::chrono::milliseconds(commitMs);
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        wakeup.wait(lock, [this] { return stopping || rotate || !pending.empty(); });
+        if (!stopping && !pending.empty()) {
+            wakeup.wait_until(lock, lastCommit + std::chrono::milliseconds(commitMs), [this] { return stopping; });
+        }
+        lastCommit = std::chrono::steady_clock::now();
+        batch.swap(pending);
+        const uint64_t end = pendingEnd;
+        const bool rotating = std::exchange(rotate, false);
+        // Records appended before compact() go to the old segment, the rest to the new one
+        const size_t before = rotating ? static_cast<size_t>(rotateAt - (end - batch.size())) : batch.size();
+        std::vector<uint32_t> live = std::move(rotateLive);
+        const uint32_t nextTable = rotateNextTable;
+        const bool stop = stopping;
+        lock.unlock();
+
+        auto commit = [this](const char* records, size_t size) {
+            if (size == 0 || failure.load(std::memory_order_relaxed)) {
+                return;
+            }
+            if (writeBatch(segmentFd, records, size) && ::fdatasync(segmentFd) == 0) {
+                writtenBytes.fetch_add(size, std::memory_order_relaxed);
+                commits.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                failure.store(true, std::memory_order_release);
+            }
+        };
+        commit(batch.data(), before);
+        if (rotating && !failure.load(std::memory_order_relaxed)) {
+            if (compactor.joinable()) {
+                compactor.join();
+            }
+            try {
+                ::close(segmentFd);
+                openSegment(generation + 1);
+                compactor = std::thread([this, upTo = generation, live = std::move(live), nextTable]() mutable {
+                    rewriteSnapshot(upTo, std::move(live), nextTable);
+                });
+            } catch (const std::exception&) {
+                failure.store(true, std::memory_order_release);
+                compacting.store(false);
+            }
+        } else if (rotating) {
+            compacting.store(false);
+        }
+        commit(batch.data() + before, batch.size() - before);
+        if (!batch.empty() && !failure.load(std::memory_order_relaxed)) {
+            durableBytes.store(end, std::memory_order_release);
+            if (!stop) onCommit();
+        }
+        batch.clear();
+
+        lock.lock();
+        if (stop && pending.empty()) {
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Creates segment next and makes it the one appended to.
+ *
+ * @throws std::runtime_error if it cannot be created.
+ */
+void WriteAheadLog::openSegment(uint64_t next) {
+    const std::string path = segmentPath(next);
+    segmentFd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_APPEND | O_CLOEXEC, 0644);
+    const WalHeader header = makeHeader(SEGMENT_MAGIC, shard, shards, next, 0);
+    if (segmentFd < 0 || !writeAll(segmentFd, &header, sizeof(header)) || ::fsync(segmentFd) != 0) {
+        if (segmentFd >= 0) ::close(segmentFd);
+        segmentFd = -1;
+        throw std::runtime_error("Cannot create the write-ahead log segment: " + path);
+    }
+    syncDirectory(directory);
+    generation = next;
+}
+
+/**
+ * @brief Rewrites the snapshot from the old one and the segments before upTo, then deletes those segments.
+ *
+ * Runs on its own thread while the log goes on in segment upTo. The new
+ * snapshot is written to "<snapshot>.tmp", synced, then renamed over the
+ * old one, so a crash at any point leaves a snapshot and the segments it
+ * does not cover. A failure leaves the old files for the next compaction.
+ *
+ * @param upTo First segment the new snapshot does not cover.
+ * @param live Tables whose records are kept.
+ * @param nextTable Id of the next table of the shard, for the header.
+ */
+void WriteAheadLog::rewriteSnapshot(uint64_t upTo, std::vector<uint32_t> live, uint32_t nextTable) {
+    const std::unordered_set<uint32_t> kept(live.begin(), live.end());
+    const std::string temp = snapshotPath() + ".tmp";
+    int fd = -1;
+    try {
+        std::string bytes;
+        std::string records;
+        if (readFile(snapshotPath(), bytes)) {
+            readBatches(bytes, records);
+        }
+        for (const uint64_t segment : segments()) {
+            if (segment >= snapshotGeneration && segment < upTo && readFile(segmentPath(segment), bytes)) {
+                readBatches(bytes, records);
+            }
+        }
+        std::string filtered;
+        for (size_t offset = 0; records.size() - offset >= sizeof(LogRecord);) {
+            LogRecord entry;
+            std::memcpy(&entry, records.data() + offset, sizeof(entry));
+            const size_t size = recordSize(entry);
+            if (size > records.size() - offset) {
+                break;
+            }
+            if (entry.table == 0 || kept.count(entry.table) != 0) {
+                filtered.append(records, offset, size);     // Vacate records belong to every table
+            }
+            offset += size;
+        }
+
+        fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        const WalHeader header = makeHeader(SNAPSHOT_MAGIC, shard, shards, upTo, nextTable);
+        bool written = fd >= 0 && writeAll(fd, &header, sizeof(header));
+        for (size_t offset = 0; written && offset < filtered.size();) {
+            size_t end = offset;
+            while (end < filtered.size() && end - offset < SNAPSHOT_BATCH) {
+                LogRecord entry;
+                std::memcpy(&entry, filtered.data() + end, sizeof(entry));
+                end += recordSize(entry);
+            }
+            written = writeBatch(fd, filtered.data() + offset, end - offset);
+            offset = end;
+        }
+        written = written && ::fsync(fd) == 0;
+        if (fd >= 0 && ::close(fd) != 0) written = false;
+        fd = -1;
+        if (written && ::rename(temp.c_str(), snapshotPath().c_str()) == 0) {
+            syncDirectory(directory);
+            for (const uint64_t segment : segments()) {
+                if (segment < upTo) ::unlink(segmentPath(segment).c_str());
+            }
+            snapshotGeneration = upTo;
+            compactions.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            ::unlink(temp.c_str());
+        }
+    } catch (const std::exception&) {
+        if (fd >= 0) ::close(fd);
+        ::unlink(temp.c_str());
+    }
+    compacting.store(false);
+}
+
+std::string WriteAheadLog::snapshotPath() const {
+    return directory + "/shard" + std::to_string(shard) + ".snap";
+}
+
+std::string WriteAheadLog::segmentPath(uint64_t segment) const {
+    return directory + "/shard" + std::to_string(shard) + "-" + std::to_string(segment) + ".wal";
+}
+
+/**
+ * @brief Returns the generations of the shard's segment files, in order.
+ */
+std::vector<uint64_t> WriteAheadLog::segments() const {
+    const std::string prefix = "shard" + std::to_string(shard) + "-";
+    const std::string suffix = ".wal";
+    std::vector<uint64_t> found;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+        const std::string name = entry.path().filename().string();
+        if (name.size() <= prefix.size() + suffix.size() || name.compare(0, prefix.size(), prefix) != 0 ||
+            name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) {
+            continue;
+        }
+        const std::string digits = name.substr(prefix.size(), name.size() - prefix.size() - suffix.size());
+        if (digits.find_first_not_of("0123456789") == std::string::npos) {
+            found.push_back(std::stoull(digits));
+        }
+    }
+    std::sort(found.begin(), found.end());
+    return found;
+}
+
+} // namespace coup
@@ -0,0 +1,156 @@
+// email: shiraba01@gmail.com
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "TableRegistry.hpp"
+
+namespace coup {
+
+/**
+ * Files of the write-ahead log of shard <s>, in the log's directory (little-endian):
+ *
+ *   shard<s>.snap          the LogRecords of the tables open at the last compaction
+ *   shard<s>-<gen>.wal     segments of the log after it, gen counting up
+ *
+ * Every file starts with a 40-byte header: magic "COUPWAL\0" or "COUPSNAP" |
+ * version u32 | shard u16 | shards u16 | generation u64 | nextTable u32 |
+ * reserved u32 | FNV-1a checksum u64 of the bytes before it. A segment's
+ * generation is its number; the snapshot's is the first segment it does not
+ * cover. Then come batches: length u32 | reserved u32 | FNV-1a checksum u64
+ * of the records | the records, as TableRegistry journals them.
+ */
+constexpr uint32_t WAL_VERSION = 1;
+
+/**
+ * @brief Counters of a WriteAheadLog.
+ */
+struct WalStats {
+    uint64_t bytes = 0;               // Records written to segments
+    uint64_t commits = 0;             // Batches written and synced (one fdatasync each)
+    uint64_t compactions = 0;         // Snapshots rewritten
+    uint64_t recoveredBytes = 0;      // Records replayed when the log was opened
+    uint64_t tornBytes = 0;           // Bytes of a batch a crash cut short, dropped when the log was opened
+};
+
+/**
+ * @brief Append-only log of one server shard's tables, committed to disk in groups.
+ *
+ * The shard appends the LogRecords of each round; a thread of the log
+ * writes whatever accumulated as one batch and syncs it with fdatasync, at
+ * most once every commitMs, so a busy shard pays one sync for many actions.
+ * Positions count the bytes appended since the log was opened: append()
+ * returns the end of its records, and once durable() reaches it they
+ * survive a crash. The server holds each reply until then (see GameServer).
+ *
+ * The log grows until compact() starts a new segment and, on another
+ * thread, rewrites the snapshot from the old one and the segments before
+ * the new one, keeping only the records of the tables still open, then
+ * deletes those segments. Opening the log replays the snapshot and the
+ * segments after it, so a restarted shard has the tables it had when it
+ * died. A batch cut short by the crash was never acknowledged; it is
+ * dropped and cut off its segment.
+ */
+class WriteAheadLog {
+public:
+    /**
+     * @brief Rebuilds the tables of a shard from its snapshot and segments, then opens a new segment.
+     *
+     * @param directory Directory of the log (created if missing).
+     * @param shard Index of the shard.
+     * @param shards Shards of the server, which must be those of the log.
+     * @param commitMs Shortest time between the starts of two syncs (0: sync whenever records are waiting).
+     * @param tables Empty registry of the shard; receives the recovered tables.
+     * @param onCommit Called by the log's thread after each batch is synced.
+     * @throws std::runtime_error if the directory or a file cannot be opened or written, the log
+     *         belongs to a server with another shard count, or it is corrupt.
+     */
+    WriteAheadLog(const std::string& directory, size_t shard, size_t shards, uint32_t commitMs,
+                  TableRegistry& tables, std::function<void()> onCommit);
+
+    /**
+     * @brief Commits what was appended, then stops the threads of the log.
+     */
+    ~WriteAheadLog();
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    /**
+     * @brief Queues records for the next batch (the owner's thread).
+     *
+     * @return uint64_t Position of the end of the records.
+     */
+    uint64_t append(const char* data, size_t size);
+
+    // Position of the end of everything appended (the owner's thread)
+    uint64_t appended() const { return appendedBytes; }
+
+    // Position up to which the log is on disk (any thread)
+    uint64_t durable() const { return durableBytes.load(std::memory_order_acquire); }
+
+    // A batch could not be written or synced; durable() no longer moves (any thread)
+    bool failed() const { return failure.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Starts a new segment after the records appended so far, and rewrites the snapshot in the background.
+     *
+     * @param tables The shard's tables as of those records: the records of the tables they no longer hold are dropped.
+     * @return false if the previous compaction is still running (then nothing is done).
+     */
+    bool compact(const TableRegistry& tables);
+
+    // Bytes appended since the last compaction started (the owner's thread)
+    uint64_t sinceCompaction() const { return appendedBytes - compactedAt; }
+
+    WalStats stats() const;
+
+private:
+    void commitLoop();
+    void openSegment(uint64_t next);
+    void rewriteSnapshot(uint64_t upTo, std::vector<uint32_t> live, uint32_t nextTable);
+    std::string snapshotPath() const;
+    std::string segmentPath(uint64_t generation) const;
+    std::vector<uint64_t> segments() const;
+
+    std::string directory;
+    size_t shard;
+    size_t shards;
+    uint32_t commitMs;
+    std::function<void()> onCommit;
+    int segmentFd = -1;
+    uint64_t generation = 0;                // Of the open segment
+    uint64_t snapshotGeneration = 0;        // First segment the snapshot does not cover
+    uint64_t appendedBytes = 0;
+    uint64_t compactedAt = 0;
+    std::atomic<uint64_t> durableBytes{0};
+    std::atomic<bool> failure{false};
+    std::atomic<bool> compacting{false};
+
+    std::mutex mutex;                       // Guards the fields below
+    std::condition_variable wakeup;
+    std::string pending;                    // Records of the next batch
+    uint64_t pendingEnd = 0;                // Position of the end of pending
+    bool rotate = false;                    // Start a new segment at rotateAt...
+    uint64_t rotateAt = 0;
+    std::vector<uint32_t> rotateLive;       // ...and compact the ones before with these tables
+    uint32_t rotateNextTable = 0;
+    bool stopping = false;
+
+    std::atomic<uint64_t> writtenBytes{0};
+    std::atomic<uint64_t> commits{0};
+    std::atomic<uint64_t> compactions{0};
+    uint64_t recoveredBytes = 0;
+    uint64_t tornBytes = 0;
+    std::thread compactor;                  // Joined by the commit thread before the next compaction
+    std::thread committer;
+};
+
+} // namespace coup
@@ -0,0 +1,134 @@
+// email: shiraba01@gmail.com
+/**
+ * @file bench_flow.cpp
+ * @brief Cost of the per-table turn flow coroutines: memory per waiting table and time per decision.
+ *
+ * Parks many TurnFlow coroutines waiting for their first move and reports
+ * the bytes each one holds (frame from the FramePool plus the TurnFlow
+ * object). Then plays the same seeded bot games with actions applied
+ * directly and through a TurnFlow, and with reaction windows where the bots
+ * answer every window with a block or a pass.
+ *
+ * Usage: ./bench_flow [waiting-tables] [games]
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include "Simulator.hpp"
+#include "TurnFlow.hpp"
+
+using namespace coup;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t NUM_PLAYERS = 4;
+constexpr size_t MAX_PLIES = 1000;
+
+enum class Mode { Direct, Flow, Reactions };
+
+struct PlayResult {
+    uint64_t decisions = 0;
+    uint64_t blocks = 0;
+    double seconds = 0;
+};
+
+// The block that answers a move, or Pass
+Action answerTo(const Action& move, uint8_t seat, bool block) {
+    Action answer{ActionKind::Pass, seat};
+    if (!block) return answer;
+    switch (move.kind) {
+        case ActionKind::Tax: answer = Action{ActionKind::BlockTax, seat, move.actor}; break;
+        case ActionKind::Bribe: answer = Action{ActionKind::BlockBribe, seat, move.actor}; break;
+        case ActionKind::Coup: answer = Action{ActionKind::BlockCoup, seat, move.target}; break;
+        default: break;
+    }
+    return answer;
+}
+
+PlayResult play(size_t games, Mode mode) {
+    PlayResult result;
+    const auto start = Clock::now();
+    for (size_t g = 0; g < games; ++g) {
+        SplitMix64 rng(gameSeed(41, g));
+        std::vector<std::string> names;
+        for (size_t seat = 0; seat < NUM_PLAYERS; ++seat) names.push_back(std::string(1, static_cast<char>('A' + seat)));
+        Table table(names, drawRoles(rng, NUM_PLAYERS));
+        Game& game = table.getGame();
+        std::unique_ptr<TurnFlow> flow;
+        if (mode != Mode::Direct) flow = std::make_unique<TurnFlow>(table, mode == Mode::Reactions);
+        Action move;
+        Action action;
+        for (size_t plies = 0; plies < MAX_PLIES && captureOutcome(game, plies).winner == NO_SEAT; ++plies) {
+            if (flow && flow->reacting()) {
+                const uint8_t seats = flow->waitingFor();
+                uint8_t seat = 0;
+                while (!((seats >> seat) & 1)) seat++;
+                const Action answer = answerTo(move, seat, rng.next() % 4 == 0);
+                try {
+                    if (flow->offer(answer) && answer.kind != ActionKind::Pass) result.blocks++;
+                } catch (const std::exception&) {
+                    flow->offer(Action{ActionKind::Pass, seat});      // The block was not affordable
+                }
+                result.decisions++;
+                continue;
+            }
+            if (!chooseBotAction(game, rng, action)) break;
+            if (flow) {
+                flow->offer(action);
+            } else {
+                applyAction(game, action);
+            }
+            move = action;
+            result.decisions++;
+        }
+    }
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const size_t waiting = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    const size_t games = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 20000;
+
+    {
+        Table table({"A", "B", "C", "D"}, {Role::Governor, Role::Judge, Role::General, Role::Baron});
+        const FramePool::Stats before = FramePool::stats();
+        std::vector<std::unique_ptr<TurnFlow>> flows;
+        flows.reserve(waiting);
+        const auto start = Clock::now();
+        for (size_t i = 0; i < waiting; ++i) {
+            flows.push_back(std::make_unique<TurnFlow>(table, true));
+        }
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        const FramePool::Stats parked = FramePool::stats();
+        const double frameBytes = static_cast<double>(parked.liveBytes - before.liveBytes) / waiting;
+        std::printf("%zu waiting flows: %.0f B frame + %zu B TurnFlow per table, %.0f ns to start one\n", waiting,
+                    frameBytes, sizeof(TurnFlow), seconds / waiting * 1e9);
+        flows.clear();
+        const size_t allocations = FramePool::stats().systemAllocations;
+        for (size_t i = 0; i < waiting; ++i) {
+            flows.push_back(std::make_unique<TurnFlow>(table, true));
+        }
+        std::printf("restarting them took %zu new frames from the system (%zu pooled before)\n",
+                    FramePool::stats().systemAllocations - allocations, parked.liveFrames - before.liveFrames);
+    }
+
+    const PlayResult direct = play(games, Mode::Direct);
+    const PlayResult flow = play(games, Mode::Flow);
+    const PlayResult reactions = play(games, Mode::Reactions);
+    std::printf("direct     %9llu decisions, %6.0f ns each\n", static_cast<unsigned long long>(direct.decisions),
+                direct.seconds / direct.decisions * 1e9);
+    std::printf("flow       %9llu decisions, %6.0f ns each\n", static_cast<unsigned long long>(flow.decisions),
+                flow.seconds / flow.decisions * 1e9);
+    std::printf("reactions  %9llu decisions, %6.0f ns each, %llu blocks\n",
+                static_cast<unsigned long long>(reactions.decisions), reactions.seconds / reactions.decisions * 1e9,
+                static_cast<unsigned long long>(reactions.blocks));
+    return 0;
+}
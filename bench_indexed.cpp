@@ -0,0 +1,103 @@
+// email: shiraba01@gmail.com
+/**
+ * @file bench_indexed.cpp
+ * @brief Size and decoding speed of the legal-move-indexed replay format vs. the plain binary format.
+ *
+ * Simulates games, converts every plain replay to the indexed format, then
+ * times (1) parsing the plain replays, (2) rebuilding games from the plain
+ * replays, (3) rebuilding games from the indexed replays and (4) converting
+ * indexed replays back to plain ones, which must match byte for byte.
+ *
+ * Usage: ./bench_indexed [games] [seed]
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "IndexedReplay.hpp"
+#include "Replay.hpp"
+#include "Simulator.hpp"
+#include "Table.hpp"
+
+using namespace coup;
+
+namespace {
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const size_t numGames = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20000;
+    const uint64_t runSeed = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1;
+
+    std::vector<std::vector<uint8_t>> plain;
+    std::vector<std::vector<uint8_t>> indexed;
+    std::vector<GameOutcome> results;
+    ReplayRecorder recorder(ReplayHeader{0, {"P1", "P2"}, {Role::Spy, Role::Baron}});
+    size_t actions = 0;
+    size_t headerBytes = 0;
+    for (size_t g = 0; g < numGames; ++g) {
+        SimOptions options;
+        options.seed = gameSeed(runSeed, g);
+        results.push_back(simulateGame(options, &recorder));
+        plain.push_back(recorder.bytes());
+        actions += recorder.actionCount();
+        headerBytes += ReplayReader(recorder.bytes().data(), recorder.bytes().size()).numPlayers() * 4 + 12;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    size_t plainBytes = 0;
+    size_t indexedBytes = 0;
+    for (const std::vector<uint8_t>& replay : plain) {
+        indexed.push_back(encodeIndexedReplay(replay.data(), replay.size()));
+        plainBytes += replay.size();
+        indexedBytes += indexed.back().size();
+    }
+    const double encodeSeconds = secondsSince(start);
+    // The indexed format repeats the plain header after 3 bytes of magic/version and ~3 bytes of varints
+    const size_t indexedHeaderBytes = headerBytes + numGames * 6;
+
+    std::printf("games=%zu actions=%zu (%.1f per game)\n", numGames, actions, double(actions) / numGames);
+    std::printf("plain:   %zu bytes, %.2f bits per action (body)\n",
+                plainBytes, 8.0 * (plainBytes - headerBytes) / actions);
+    std::printf("indexed: %zu bytes, %.2f bits per action (body), %.2fx smaller overall\n",
+                indexedBytes, 8.0 * (indexedBytes - indexedHeaderBytes) / actions, double(plainBytes) / indexedBytes);
+    std::printf("encode:              %6.2f M actions/s\n", actions / encodeSeconds / 1e6);
+
+    start = std::chrono::steady_clock::now();
+    size_t parsed = 0;
+    for (const std::vector<uint8_t>& replay : plain) {
+        ReplayReader reader(replay.data(), replay.size());
+        ActionRecord record;
+        while (reader.next(record)) parsed++;
+    }
+    std::printf("plain parse only:    %6.2f M actions/s\n", parsed / secondsSince(start) / 1e6);
+
+    size_t mismatches = 0;
+    start = std::chrono::steady_clock::now();
+    for (size_t g = 0; g < numGames; ++g) {
+        auto table = replayGame(plain[g].data(), plain[g].size());
+        if (captureOutcome(table->getGame(), results[g].plies) != results[g]) mismatches++;
+    }
+    std::printf("plain replay:        %6.2f M actions/s\n", actions / secondsSince(start) / 1e6);
+
+    start = std::chrono::steady_clock::now();
+    for (size_t g = 0; g < numGames; ++g) {
+        auto table = replayIndexedGame(indexed[g].data(), indexed[g].size());
+        if (captureOutcome(table->getGame(), results[g].plies) != results[g]) mismatches++;
+    }
+    std::printf("indexed replay:      %6.2f M actions/s\n", actions / secondsSince(start) / 1e6);
+
+    start = std::chrono::steady_clock::now();
+    for (size_t g = 0; g < numGames; ++g) {
+        if (decodeIndexedReplay(indexed[g].data(), indexed[g].size()) != plain[g]) mismatches++;
+    }
+    std::printf("indexed -> plain:    %6.2f M actions/s\n", actions / secondsSince(start) / 1e6);
+
+    std::printf("mismatches: %zu\n", mismatches);
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,125 @@
+// email: shiraba01@gmail.com
+/**
+ * @file bench_jsonl.cpp
+ * @brief Events/s of the JSON-lines exporter and its cost to the simulation.
+ *
+ * Records a set of games, then replays them with no observer, with an
+ * exporter writing to /dev/null, and with a sampling exporter; the gap between
+ * the first two runs is the formatting cost. Heap allocations are counted
+ * during the export to check that it does not allocate. A last run measures
+ * live simulation with and without the exporter.
+ *
+ * Usage: ./bench_jsonl [games]
+ */
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "EventExport.hpp"
+
+using namespace coup;
+
+namespace {
+
+std::atomic<uint64_t> allocations{0};
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Replays every game through the observer and returns the elapsed seconds
+double replayAll(const std::vector<std::vector<uint8_t>>& games, SimObserver& observer) {
+    auto start = std::chrono::steady_clock::now();
+    for (const std::vector<uint8_t>& game : games) {
+        observeReplay(game.data(), game.size(), observer);
+    }
+    return secondsSince(start);
+}
+
+} // namespace
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+int main(int argc, char** argv) {
+    const size_t numGames = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 50000;
+
+    std::vector<std::vector<uint8_t>> games;
+    uint64_t actions = 0;
+    ReplayRecorder recorder(ReplayHeader{0, {"P1", "P2"}, {Role::Spy, Role::Judge}});
+    for (size_t g = 0; g < numGames; ++g) {
+        SimOptions options;
+        options.seed = gameSeed(7, g);
+        simulateGame(options, &recorder);
+        games.push_back(recorder.bytes());
+        actions += recorder.actionCount();
+    }
+    std::printf("%zu games, %llu actions\n", numGames, static_cast<unsigned long long>(actions));
+
+    SimObserver none;
+    const double base = replayAll(games, none);
+
+    std::FILE* devNull = std::fopen("/dev/null", "wb");
+    if (!devNull) {
+        std::perror("/dev/null");
+        return 1;
+    }
+    JsonlExporter exporter(devNull);
+    // Count the allocations of the exporter only: replay the same games first without it
+    uint64_t before = allocations.load();
+    replayAll(games, none);
+    const uint64_t replayAllocations = allocations.load() - before;
+    before = allocations.load();
+    const double full = replayAll(games, exporter);
+    exporter.flush();
+    const uint64_t exportAllocations = allocations.load() - before - replayAllocations;
+
+    std::printf("replay only:      %.2f s (%.1f M actions/s)\n", base, actions / base / 1e6);
+    std::printf("replay + export:  %.2f s, %llu events, %.1f MB (%.1f MB/s)\n", full,
+                static_cast<unsigned long long>(exporter.eventCount()), exporter.byteCount() / 1e6,
+                exporter.byteCount() / full / 1e6);
+    std::printf("formatting alone: %.1f M events/s, %lld allocations while exporting\n",
+                full > base ? exporter.eventCount() / (full - base) / 1e6 : 0.0,
+                static_cast<long long>(exportAllocations));
+
+    ExportOptions sampling;
+    sampling.sampleEvery = 16;
+    JsonlExporter sampled(devNull, sampling);
+    const double partial = replayAll(games, sampled);
+    sampled.flush();
+    std::printf("sampling 1/16:    %.2f s, %llu events (%.1f%% of the actions)\n", partial,
+                static_cast<unsigned long long>(sampled.eventCount()), 100.0 * sampled.eventCount() / actions);
+
+    // Live simulation, as a tournament would run it
+    auto start = std::chrono::steady_clock::now();
+    for (size_t g = 0; g < numGames; ++g) {
+        SimOptions options;
+        options.seed = gameSeed(7, g);
+        simulateGame(options);
+    }
+    const double plain = secondsSince(start);
+    JsonlExporter live(devNull);
+    start = std::chrono::steady_clock::now();
+    for (size_t g = 0; g < numGames; ++g) {
+        SimOptions options;
+        options.seed = gameSeed(7, g);
+        live.setGameId(g);
+        simulateGame(options, nullptr, &live);
+    }
+    live.flush();
+    const double exported = secondsSince(start);
+    std::printf("simulation: %.2f s plain, %.2f s exporting (%+.1f%%)\n", plain, exported,
+                100 * (exported - plain) / plain);
+
+    std::fclose(devNull);
+    return exportAllocations == 0 ? 0 : 1;
+}
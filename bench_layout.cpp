@@ -0,0 +1,197 @@
+// email: shiraba01@gmail.com
+/**
+ * @file bench_layout.cpp
+ * @brief Cache-miss benchmark for the per-player data layout.
+ *
+ * Compares the old array-of-objects layout (every Player owning its coins and
+ * flags next to three std::string members and a Game reference) with the
+ * packed per-seat hot state now kept inside Game. Both variants run the same
+ * per-turn scan over many tables: find the alive players, read their coins and
+ * flags and pay one coin to the player whose turn it is.
+ *
+ * Usage: ./bench_layout [tables] [rounds]
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "Game.hpp"
+#include "Player.hpp"
+
+using namespace coup;
+
+namespace {
+
+/**
+ * @brief Replica of the Player layout before the hot/cold split.
+ */
+struct LegacyPlayer {
+    std::string name;
+    std::string role;
+    int coins = 0;
+    Game* game = nullptr;
+    LegacyPlayer* last_arrested = nullptr;
+    bool alive = true;
+    bool is_sanctioned = false;
+    std::string lastAction;
+    bool hasExtraTurn = false;
+    bool canUseArrest = true;
+};
+
+/**
+ * @brief Hardware cache-miss counter (perf_event_open); reports -1 when the
+ * kernel does not allow access to hardware counters.
+ */
+class CacheMissCounter {
+public:
+    CacheMissCounter() {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+    ~CacheMissCounter() {
+        if (fd >= 0) close(fd);
+    }
+    void start() {
+        if (fd < 0) return;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    long long stop() {
+        if (fd < 0) return -1;
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        long long value = 0;
+        if (read(fd, &value, sizeof(value)) != sizeof(value)) return -1;
+        return value;
+    }
+
+private:
+    int fd;
+};
+
+struct Result {
+    double seconds;
+    long long misses;
+    long long checksum;
+};
+
+template <typename Fn>
+Result measure(Fn&& body) {
+    CacheMissCounter counter;
+    counter.start();
+    auto begin = std::chrono::steady_clock::now();
+    long long checksum = body();
+    auto end = std::chrono::steady_clock::now();
+    long long misses = counter.stop();
+    return {std::chrono::duration<double>(end - begin).count(), misses, checksum};
+}
+
+void report(const char* label, const Result& r, size_t touches) {
+    std::printf("%-10s %8.3f ms  %7.2f ns/player", label, r.seconds * 1e3, r.seconds * 1e9 / touches);
+    if (r.misses >= 0) {
+        std::printf("  %10lld cache misses (%.3f per player)", r.misses, double(r.misses) / touches);
+    } else {
+        std::printf("  cache misses n/a");
+    }
+    std::printf("  [checksum %lld]\n", r.checksum);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const size_t tables = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+    const int rounds = argc > 2 ? std::atoi(argv[2]) : 20;
+    const size_t seats = MAX_PLAYERS;
+
+    // Legacy layout: every player is its own heap object, as main.cpp creates them.
+    std::vector<std::vector<std::unique_ptr<LegacyPlayer>>> legacy(tables);
+    // Current layout: one Game per table, players only hold cold data.
+    std::vector<std::unique_ptr<Game>> games;
+    std::vector<std::unique_ptr<Player>> players;
+    games.reserve(tables);
+    players.reserve(tables * seats);
+
+    for (size_t t = 0; t < tables; ++t) {
+        games.push_back(std::make_unique<Game>());
+        for (size_t s = 0; s < seats; ++s) {
+            std::string name = "player_" + std::to_string(t) + "_" + std::to_string(s);
+            auto lp = std::make_unique<LegacyPlayer>();
+            lp->name = name;
+            lp->role = "Governor";
+            lp->coins = static_cast<int>(s);
+            legacy[t].push_back(std::move(lp));
+            players.push_back(std::make_unique<Player>(*games.back(), name));
+            games.back()->setCoinsAt(s, static_cast<int>(s));
+        }
+    }
+
+    // Visit tables in random order, as a simulation farm interleaving games does.
+    std::vector<size_t> order(tables);
+    for (size_t t = 0; t < tables; ++t) order[t] = t;
+    std::shuffle(order.begin(), order.end(), std::mt19937(42));
+
+    Result aos = measure([&] {
+        long long sum = 0;
+        for (int r = 0; r < rounds; ++r) {
+            for (size_t t : order) {
+                auto& table = legacy[t];
+                size_t turn = static_cast<size_t>(r) % seats;
+                for (size_t s = 0; s < seats; ++s) {
+                    LegacyPlayer& p = *table[s];
+                    if (p.alive && !p.is_sanctioned && p.canUseArrest && !p.hasExtraTurn) {
+                        sum += p.coins;
+                    }
+                }
+                table[turn]->coins += 1;
+            }
+        }
+        return sum;
+    });
+
+    Result soa = measure([&] {
+        long long sum = 0;
+        for (int r = 0; r < rounds; ++r) {
+            for (size_t t : order) {
+                Game& g = *games[t];
+                size_t turn = static_cast<size_t>(r) % seats;
+                for (size_t s = 0; s < seats; ++s) {
+                    if (g.hasFlag(s, FLAG_ALIVE) && !g.hasFlag(s, FLAG_SANCTIONED) &&
+                        g.hasFlag(s, FLAG_ARREST_ENABLED) && !g.hasFlag(s, FLAG_EXTRA_TURN)) {
+                        sum += g.coinsAt(s);
+                    }
+                }
+                g.setCoinsAt(turn, g.coinsAt(turn) + 1);
+            }
+        }
+        return sum;
+    });
+
+    size_t touches = tables * seats * static_cast<size_t>(rounds);
+    std::printf("tables=%zu players/table=%zu rounds=%d\n", tables, seats, rounds);
+    std::printf("sizeof(LegacyPlayer)=%zu sizeof(Player)=%zu sizeof(Game)=%zu\n",
+                sizeof(LegacyPlayer), sizeof(Player), sizeof(Game));
+    report("legacy", aos, touches);
+    report("hot/cold", soa, touches);
+    if (aos.checksum != soa.checksum) {
+        std::fprintf(stderr, "checksum mismatch\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,139 @@
+// email: shiraba01@gmail.com
+/**
+ * @file bench_matchmaking.cpp
+ * @brief Matches per second of the lock-free Matchmaker against per-size mutex-protected deques.
+ *
+ * Producer threads queue players for tables of 2 to 6 (each round queues
+ * a full table's worth of every size), while consumer threads form tables
+ * as fast as they can. The alternative keeps the same per-size queues as
+ * std::deque behind one std::mutex each, popping a table under the lock.
+ * Both report matches per second and the queue wait of the players.
+ *
+ * Usage: ./bench_matchmaking [rounds-per-producer] [producers] [consumers]
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Matchmaker.hpp"
+
+using namespace coup;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+uint64_t steadyNs() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count());
+}
+
+// Same shape as Matchmaker, with a locked deque per table size
+class LockedMatchmaker {
+public:
+    bool enqueue(size_t tableSize, uint64_t player) {
+        Queue& queue = queues[tableSize - MIN_TABLE_SIZE];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tickets.push_back(MatchTicket{player, steadyNs()});
+        return true;
+    }
+
+    size_t assemble(std::vector<Match>& out, size_t maxTables, LatencyHistogram& waits) {
+        size_t formed = 0;
+        bool progress = true;
+        while (progress && formed < maxTables) {
+            progress = false;
+            const uint64_t now = steadyNs();
+            for (size_t size = MIN_TABLE_SIZE; size <= MAX_PLAYERS && formed < maxTables; ++size) {
+                Queue& queue = queues[size - MIN_TABLE_SIZE];
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                if (queue.tickets.size() < size) continue;
+                Match match;
+                match.numPlayers = static_cast<uint8_t>(size);
+                for (size_t seat = 0; seat < size; ++seat) {
+                    const MatchTicket& ticket = queue.tickets.front();
+                    match.players[seat] = ticket.player;
+                    waits.record(now > ticket.enqueuedNs ? (now - ticket.enqueuedNs) / 1000 : 0);
+                    queue.tickets.pop_front();
+                }
+                out.push_back(match);
+                formed++;
+                progress = true;
+            }
+        }
+        return formed;
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<MatchTicket> tickets;
+    };
+    Queue queues[MAX_PLAYERS - MIN_TABLE_SIZE + 1];
+};
+
+template <typename Maker>
+void run(const char* name, uint64_t rounds, size_t producers, size_t consumers) {
+    Maker maker;
+    const uint64_t tables = rounds * producers * (MAX_PLAYERS - MIN_TABLE_SIZE + 1);
+    std::atomic<uint64_t> formed{0};
+    std::vector<LatencyHistogram> waits(consumers);
+    std::vector<std::thread> threads;
+    const auto start = Clock::now();
+    for (size_t p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p] {
+            uint64_t player = p << 40;
+            for (uint64_t round = 0; round < rounds; ++round) {
+                for (size_t size = MIN_TABLE_SIZE; size <= MAX_PLAYERS; ++size) {
+                    for (size_t seat = 0; seat < size; ++seat) {
+                        while (!maker.enqueue(size, player)) std::this_thread::yield();     // Full: wait for consumers
+                        player++;
+                    }
+                }
+            }
+        });
+    }
+    for (size_t c = 0; c < consumers; ++c) {
+        threads.emplace_back([&, c] {
+            std::vector<Match> out;
+            while (formed.load(std::memory_order_relaxed) < tables) {
+                out.clear();
+                const size_t n = maker.assemble(out, 256, waits[c]);
+                if (n == 0) {
+                    std::this_thread::yield();
+                } else {
+                    formed.fetch_add(n, std::memory_order_relaxed);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    LatencyHistogram all;
+    for (const auto& histogram : waits) all.merge(histogram);
+    std::printf("%-8s %10.0f matches/s, %10.0f players/s, wait p50 %6llu us, p99 %7llu us, max %8llu us\n", name,
+                static_cast<double>(tables) / seconds, static_cast<double>(all.count()) / seconds,
+                static_cast<unsigned long long>(all.percentile(0.5)),
+                static_cast<unsigned long long>(all.percentile(0.99)), static_cast<unsigned long long>(all.max()));
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const uint64_t rounds = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+    const size_t hardware = std::max(2u, std::thread::hardware_concurrency());
+    const size_t producers = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : hardware / 2;
+    const size_t consumers = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : hardware - hardware / 2;
+
+    std::printf("%zu producers x %llu rounds (one table of each size 2-6 per round), %zu consumers\n", producers,
+                static_cast<unsigned long long>(rounds), consumers);
+    run<Matchmaker>("lockfree", rounds, producers, consumers);
+    run<LockedMatchmaker>("mutex", rounds, producers, consumers);
+    return 0;
+}
@@ -0,0 +1,107 @@
+// email: shiraba01@gmail.com
+/**
+ * @file bench_memory.cpp
+ * @brief Per-game memory budget benchmark.
+ *
+ * Instantiates many concurrent games (1M by default), each with a full set of
+ * role players, and reports both the accounted footprint (Game and Player
+ * memoryFootprint()) and the growth of the process resident set size.
+ * Track the "RSS per game" line over time to catch memory regressions.
+ *
+ * Usage: ./bench_memory [games] [players_per_game]
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Game.hpp"
+#include "Governor.hpp"
+#include "Spy.hpp"
+#include "Baron.hpp"
+#include "General.hpp"
+#include "Judge.hpp"
+#include "Merchant.hpp"
+
+using namespace coup;
+
+namespace {
+
+/**
+ * @brief Reads the resident set size of this process from /proc/self/status.
+ *
+ * @return size_t Resident set size in bytes (0 if unavailable).
+ */
+size_t residentBytes() {
+    std::ifstream status("/proc/self/status");
+    std::string key;
+    while (status >> key) {
+        if (key == "VmRSS:") {
+            size_t kb = 0;
+            status >> kb;
+            return kb * 1024;
+        }
+        std::getline(status, key);
+    }
+    return 0;
+}
+
+std::unique_ptr<Player> makeRolePlayer(Game& game, size_t seat, const std::string& name) {
+    switch (seat % 6) {
+        case 0: return std::make_unique<Governor>(game, name);
+        case 1: return std::make_unique<Spy>(game, name);
+        case 2: return std::make_unique<Baron>(game, name);
+        case 3: return std::make_unique<General>(game, name);
+        case 4: return std::make_unique<Judge>(game, name);
+        default: return std::make_unique<Merchant>(game, name);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const size_t numGames = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    const size_t perGame = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 4;
+    if (perGame < 2 || perGame > MAX_PLAYERS) {
+        std::fprintf(stderr, "players_per_game must be between 2 and %zu\n", MAX_PLAYERS);
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<Game>> games;
+    std::vector<std::unique_ptr<Player>> players;
+    games.reserve(numGames);
+    players.reserve(numGames * perGame);
+
+    const size_t rssBefore = residentBytes();
+
+    for (size_t g = 0; g < numGames; ++g) {
+        games.push_back(std::make_unique<Game>());
+        for (size_t s = 0; s < perGame; ++s) {
+            players.push_back(makeRolePlayer(*games.back(), s, "bot" + std::to_string(g * perGame + s)));
+        }
+    }
+
+    const size_t rssAfter = residentBytes();
+
+    MemoryFootprint gamesOnly;
+    MemoryFootprint playersOnly;
+    for (const auto& game : games) gamesOnly += game->memoryFootprint(false);
+    for (const auto& player : players) playersOnly += player->memoryFootprint();
+    MemoryFootprint all = gamesOnly;
+    all += playersOnly;
+
+    const double n = static_cast<double>(numGames);
+    const double np = static_cast<double>(players.size());
+    std::printf("games=%zu players/game=%zu\n", numGames, perGame);
+    std::printf("sizeof(Game)=%zu sizeof(Player)=%zu\n", sizeof(Game), sizeof(Player));
+    std::printf("accounted per Game:   %8.1f B (object %.1f + heap %.1f)\n",
+                gamesOnly.total() / n, gamesOnly.objectBytes / n, gamesOnly.heapBytes / n);
+    std::printf("accounted per Player: %8.1f B (object %.1f + heap %.1f)\n",
+                playersOnly.total() / np, playersOnly.objectBytes / np, playersOnly.heapBytes / np);
+    std::printf("accounted per table:  %8.1f B\n", all.total() / n);
+    std::printf("RSS growth:           %8.1f MiB (%.1f B per game, incl. allocator overhead and ownership vectors)\n",
+                (rssAfter - rssBefore) / (1024.0 * 1024.0), (rssAfter - rssBefore) / n);
+    return 0;
+}
@@ -0,0 +1,81 @@
+// email: shiraba01@gmail.com
+/**
+ * @file bench_replay.cpp
+ * @brief Size and speed of the compact binary replay format.
+ *
+ * Simulates games with random bots while recording replays, then rebuilds
+ * every game from its replay through the Game/Player APIs and checks that the
+ * final coins, bank and eliminations are identical.
+ *
+ * Usage: ./bench_replay [games] [seed]
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "Replay.hpp"
+#include "Simulator.hpp"
+#include "Table.hpp"
+
+using namespace coup;
+
+int main(int argc, char** argv) {
+    const size_t numGames = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    const uint64_t runSeed = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1;
+
+    std::vector<std::vector<uint8_t>> replays;
+    std::vector<GameOutcome> results;
+    replays.reserve(numGames);
+    results.reserve(numGames);
+
+    ReplayRecorder recorder(ReplayHeader{0, {"P1", "P2"}, {Role::Spy, Role::Baron}});
+    size_t totalActions = 0;
+    size_t headerBytes = 0;
+    size_t totalBytes = 0;
+    size_t decided = 0;
+
+    auto simStart = std::chrono::steady_clock::now();
+    for (size_t g = 0; g < numGames; ++g) {
+        SimOptions options;
+        options.seed = gameSeed(runSeed, g);
+        GameOutcome result = simulateGame(options, &recorder);
+        results.push_back(result);
+        replays.push_back(recorder.bytes());
+        totalActions += recorder.actionCount();
+        totalBytes += recorder.bytes().size();
+        headerBytes += ReplayReader(recorder.bytes().data(), recorder.bytes().size()).numPlayers() * 4 + 12;
+        if (result.winner != NO_SEAT) decided++;
+    }
+    auto simEnd = std::chrono::steady_clock::now();
+
+    size_t mismatches = 0;
+    auto replayStart = std::chrono::steady_clock::now();
+    for (size_t g = 0; g < numGames; ++g) {
+        auto table = replayGame(replays[g].data(), replays[g].size());
+        const Game& game = table->getGame();
+        int winner = NO_SEAT;
+        size_t alive = 0;
+        for (size_t s = 0; s < game.numPlayers(); ++s) {
+            if (game.hasFlag(s, FLAG_ALIVE)) {
+                alive++;
+                winner = static_cast<int>(s);
+            }
+        }
+        if (alive != 1) winner = NO_SEAT;
+        if (winner != results[g].winner) mismatches++;
+    }
+    auto replayEnd = std::chrono::steady_clock::now();
+
+    const double simSeconds = std::chrono::duration<double>(simEnd - simStart).count();
+    const double replaySeconds = std::chrono::duration<double>(replayEnd - replayStart).count();
+    std::printf("games=%zu decided=%zu actions=%zu (%.1f per game)\n",
+                numGames, decided, totalActions, double(totalActions) / numGames);
+    std::printf("replay bytes: %zu total, %.1f per game, %.3f per action (body only: %.3f)\n",
+                totalBytes, double(totalBytes) / numGames, double(totalBytes) / totalActions,
+                double(totalBytes - headerBytes) / totalActions);
+    std::printf("simulate+record: %.2f M actions/s\n", totalActions / simSeconds / 1e6);
+    std::printf("replay:          %.2f M actions/s\n", totalActions / replaySeconds / 1e6);
+    std::printf("winner mismatches: %zu\n", mismatches);
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,105 @@
+// email: shiraba01@gmail.com
+/**
+ * @file bench_results.cpp
+ * @brief Write and query speed of the columnar results store.
+ *
+ * Simulates games while collecting one GameResult per game, writes the rows
+ * (repeated to reach a larger file) to a columnar results file, then runs
+ * typical queries over the memory-mapped columns and checks the first one
+ * against a plain row-by-row computation.
+ *
+ * Usage: ./bench_results [games] [repeat] [path]
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "ResultsStore.hpp"
+
+using namespace coup;
+
+namespace {
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const size_t numGames = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    const size_t repeat = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 50;
+    const std::string path = argc > 3 ? argv[3] : "bench_results.coupcols";
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<GameResult> results;
+    ResultCollector collector;
+    for (size_t g = 0; g < numGames; ++g) {
+        SimOptions options;
+        options.seed = gameSeed(1, g);
+        simulateGame(options, nullptr, &collector);
+        results.push_back(collector.result());
+        results.back().seed = options.seed;
+    }
+    std::printf("simulated %zu games in %.2f s\n", numGames, secondsSince(start));
+
+    start = std::chrono::steady_clock::now();
+    {
+        ResultsWriter writer(path);
+        for (size_t r = 0; r < repeat; ++r) {
+            for (const GameResult& result : results) writer.add(result);
+        }
+        writer.finish();
+    }
+    const double writeSeconds = secondsSince(start);
+    ResultsReader store(path);
+    std::printf("wrote %llu rows in %.2f s (%.1f M rows/s)\n",
+                static_cast<unsigned long long>(store.rowCount()), writeSeconds, store.rowCount() / writeSeconds / 1e6);
+
+    // Win rate of the Baron in 4-player games where a General was present
+    ResultsFilter filter;
+    filter.players(4).with(Role::General);
+    start = std::chrono::steady_clock::now();
+    ResultsSummary summary = queryResults(store, filter);
+    double seconds = secondsSince(start);
+    std::printf("Baron win rate, 4 players with a General: %.2f%% of %llu games (%.0f M rows/s)\n",
+                100 * summary.winRate(Role::Baron), static_cast<unsigned long long>(summary.gamesWithRole[static_cast<int>(Role::Baron)]),
+                store.rowCount() / seconds / 1e6);
+
+    // Same query row by row over the in-memory rows
+    uint64_t games = 0;
+    uint64_t wins = 0;
+    for (const GameResult& r : results) {
+        if (r.numPlayers != 4 || !(r.rolesPresent & (1u << static_cast<int>(Role::General)))) continue;
+        if (!(r.rolesPresent & (1u << static_cast<int>(Role::Baron)))) continue;
+        games++;
+        if (r.winnerRole == static_cast<uint8_t>(Role::Baron)) wins++;
+    }
+    const bool match = games * repeat == summary.gamesWithRole[static_cast<int>(Role::Baron)] &&
+                       wins * repeat == summary.winsByRole[static_cast<int>(Role::Baron)];
+
+    start = std::chrono::steady_clock::now();
+    ResultsSummary all = queryResults(store, ResultsFilter());
+    seconds = secondsSince(start);
+    std::printf("all games: %.1f%% decided, %.1f plies, %.2f coups, %.2f blocks per game (%.0f M rows/s)\n",
+                100.0 * all.decided / all.games, all.meanPlies(), all.meanCoups(), all.meanBlocks(),
+                store.rowCount() / seconds / 1e6);
+    for (size_t r = 0; r < NUM_ROLES; ++r) {
+        std::printf("  %-8s win rate %.2f%%\n", roleName(static_cast<Role>(r)), 100 * all.winRate(static_cast<Role>(r)));
+    }
+
+    ResultsFilter longDecided;
+    longDecided.decided().without(Role::Judge);
+    longDecided.minPlies = 100;
+    start = std::chrono::steady_clock::now();
+    ResultsSummary slow = queryResults(store, longDecided);
+    seconds = secondsSince(start);
+    std::printf("decided games of 100+ plies without a Judge: %llu (%.0f M rows/s)\n",
+                static_cast<unsigned long long>(slow.games), store.rowCount() / seconds / 1e6);
+
+    std::printf("row-by-row check: %s\n", match ? "match" : "MISMATCH");
+    std::remove(path.c_str());
+    return match ? 0 : 1;
+}
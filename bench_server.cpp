@@ -0,0 +1,275 @@
+// email: shiraba01@gmail.com
+/**
+ * @file bench_server.cpp
+ * @brief Load test of the game server: action latency with thousands of open connections.
+ *
+ * Forks a GameServer on a free loopback port, then opens the connections from
+ * this process. Each active connection creates a 2-player table, takes both
+ * seats and plays random bot games back to back, one command in flight at a
+ * time, keeping a local copy of its game to pick legal actions. The other
+ * connections stay open and idle. Reports actions/s and the latency
+ * percentiles of ACT round trips (client and server share the machine).
+ *
+ * Usage: ./bench_server [connections] [active] [seconds] [shards]
+ */
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Server.hpp"
+
+using namespace coup;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Games are abandoned after this many actions, as in simulateGame()
+constexpr size_t MAX_PLIES = 1000;
+
+std::atomic<bool> serverStop{false};
+
+void stopServer(int) {
+    serverStop.store(true);
+}
+
+/**
+ * @brief One client connection playing games back to back.
+ */
+struct Client {
+    enum class Phase { Idle, Creating, Joining, Playing, Leaving };
+
+    int fd = -1;
+    Phase phase = Phase::Idle;
+    std::string in;
+    uint32_t table = 0;
+    size_t joined = 0;
+    std::vector<Role> roles;
+    std::unique_ptr<Table> game;
+    size_t plies = 0;
+    Action pending;
+    SplitMix64 rng{0};
+    Clock::time_point sent;
+};
+
+struct LoadStats {
+    uint64_t actions = 0;
+    uint64_t games = 0;
+    uint64_t errors = 0;
+    std::vector<uint32_t> latencyUs;
+};
+
+void sendLine(Client& client, const std::string& line) {
+    const char* p = line.data();
+    size_t size = line.size();
+    while (size > 0) {
+        const ssize_t sent = ::send(client.fd, p, size, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            std::perror("send");
+            std::exit(1);
+        }
+        p += sent;
+        size -= static_cast<size_t>(sent);
+    }
+}
+
+// Sends the next ACT, or leaves the table once the game is over
+void playNext(Client& client) {
+    Game& game = client.game->getGame();
+    if (client.plies >= MAX_PLIES || captureOutcome(game, 0).winner != NO_SEAT ||
+        !chooseBotAction(game, client.rng, client.pending)) {
+        client.phase = Client::Phase::Leaving;
+        sendLine(client, "LEAVE " + std::to_string(client.table) + "\n");
+        return;
+    }
+    std::string line = "ACT " + std::to_string(client.table) + ' ' + std::to_string(client.pending.actor) + ' ' +
+                       actionName(client.pending.kind);
+    if (actionHasTarget(client.pending.kind)) {
+        line += ' ' + std::to_string(client.pending.target);
+    }
+    line += '\n';
+    client.sent = Clock::now();
+    sendLine(client, line);
+}
+
+void startGame(Client& client) {
+    client.phase = Client::Phase::Creating;
+    sendLine(client, "CREATE 2 " + std::to_string(client.rng.next() >> 1) + "\n");
+}
+
+void onReply(Client& client, const std::string& reply, LoadStats& stats) {
+    const bool ok = reply.compare(0, 2, "OK") == 0;
+    if (!ok && client.phase != Client::Phase::Idle) {
+        stats.errors++;
+    }
+    switch (client.phase) {
+        case Client::Phase::Idle:
+            break;
+        case Client::Phase::Creating:
+            client.table = static_cast<uint32_t>(std::strtoul(reply.c_str() + 3, nullptr, 10));
+            client.phase = Client::Phase::Joining;
+            client.joined = 0;
+            client.roles.clear();
+            sendLine(client, "JOIN " + std::to_string(client.table) + " A\nJOIN " + std::to_string(client.table) + " B\n");
+            break;
+        case Client::Phase::Joining:
+            client.roles.push_back(parseRole(reply.substr(reply.rfind(' ') + 1)));
+            if (++client.joined == 2) {
+                client.game = std::make_unique<Table>(std::vector<std::string>{"A", "B"}, client.roles);
+                client.phase = Client::Phase::Playing;
+                client.plies = 0;
+                playNext(client);
+            }
+            break;
+        case Client::Phase::Playing: {
+            const auto micros = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - client.sent);
+            stats.latencyUs.push_back(static_cast<uint32_t>(micros.count()));
+            if (!ok) {
+                client.phase = Client::Phase::Leaving;
+                sendLine(client, "LEAVE " + std::to_string(client.table) + "\n");
+                break;
+            }
+            stats.actions++;
+            applyAction(client.game->getGame(), client.pending);
+            client.plies++;
+            playNext(client);
+            break;
+        }
+        case Client::Phase::Leaving:
+            stats.games++;
+            startGame(client);
+            break;
+    }
+}
+
+double percentile(std::vector<uint32_t>& samples, double p) {
+    if (samples.empty()) return 0;
+    const size_t k = std::min(samples.size() - 1, static_cast<size_t>(p * samples.size()));
+    std::nth_element(samples.begin(), samples.begin() + static_cast<std::ptrdiff_t>(k), samples.end());
+    return samples[k];
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const size_t numConnections = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000;
+    const size_t numActive = std::min(numConnections, argc > 2 ? std::strtoul(argv[2], nullptr, 10) : numConnections);
+    const double seconds = argc > 3 ? std::strtod(argv[3], nullptr) : 5;
+    ServerOptions options;
+    options.shards = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 1;
+
+    int portPipe[2];
+    if (::pipe(portPipe) != 0) {
+        std::perror("pipe");
+        return 1;
+    }
+    const pid_t child = ::fork();
+    if (child == 0) {
+        std::signal(SIGTERM, stopServer);
+        ::close(portPipe[0]);
+        GameServer server(options);
+        const uint16_t port = server.port();
+        if (::write(portPipe[1], &port, sizeof(port)) != sizeof(port)) return 1;
+        ::close(portPipe[1]);
+        server.run(serverStop);
+        const ServerStats stats = server.stats();
+        std::printf("server: %llu connections, %llu commands, %llu errors, %.1f MB in, %.1f MB out\n",
+                    static_cast<unsigned long long>(stats.accepted), static_cast<unsigned long long>(stats.commands),
+                    static_cast<unsigned long long>(stats.errors), stats.bytesIn / 1e6, stats.bytesOut / 1e6);
+        return 0;
+    }
+    ::close(portPipe[1]);
+    uint16_t port = 0;
+    if (::read(portPipe[0], &port, sizeof(port)) != sizeof(port)) {
+        std::fprintf(stderr, "the server did not start\n");
+        return 1;
+    }
+
+    auto start = Clock::now();
+    std::vector<Client> clients(numConnections);
+    const int epollFd = ::epoll_create1(0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    for (size_t i = 0; i < numConnections; ++i) {
+        Client& client = clients[i];
+        client.fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (client.fd < 0 || ::connect(client.fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            std::perror("connect");
+            ::kill(child, SIGTERM);
+            return 1;
+        }
+        const int yes = 1;
+        ::setsockopt(client.fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+        client.rng = SplitMix64(gameSeed(3, i));
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.ptr = &client;
+        ::epoll_ctl(epollFd, EPOLL_CTL_ADD, client.fd, &event);
+    }
+    std::printf("%zu connections open in %.2f s, %zu playing, %zu server shards\n", numConnections,
+                std::chrono::duration<double>(Clock::now() - start).count(), numActive, options.shards);
+
+    LoadStats stats;
+    stats.latencyUs.reserve(1 << 22);
+    for (size_t i = 0; i < numActive; ++i) {
+        startGame(clients[i]);
+    }
+    for (size_t i = numActive; i < numConnections; ++i) {
+        sendLine(clients[i], "PING\n");
+    }
+
+    start = Clock::now();
+    const auto deadline = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    epoll_event events[256];
+    char buffer[1 << 14];
+    while (Clock::now() < deadline) {
+        const int count = ::epoll_wait(epollFd, events, 256, 100);
+        for (int e = 0; e < count; ++e) {
+            Client& client = *static_cast<Client*>(events[e].data.ptr);
+            const ssize_t received = ::recv(client.fd, buffer, sizeof(buffer), 0);
+            if (received <= 0) {
+                std::fprintf(stderr, "connection closed by the server\n");
+                ::kill(child, SIGTERM);
+                return 1;
+            }
+            client.in.append(buffer, static_cast<size_t>(received));
+            size_t begin = 0;
+            for (size_t end; (end = client.in.find('\n', begin)) != std::string::npos; begin = end + 1) {
+                onReply(client, client.in.substr(begin, end - begin), stats);
+            }
+            client.in.erase(0, begin);
+        }
+    }
+    const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::printf("%llu actions in %.2f s (%.0f actions/s), %llu games finished, %llu errors\n",
+                static_cast<unsigned long long>(stats.actions), elapsed, stats.actions / elapsed,
+                static_cast<unsigned long long>(stats.games), static_cast<unsigned long long>(stats.errors));
+    std::printf("ACT latency: p50 %.0f us, p99 %.0f us, p99.9 %.0f us\n", percentile(stats.latencyUs, 0.50),
+                percentile(stats.latencyUs, 0.99), percentile(stats.latencyUs, 0.999));
+
+    for (Client& client : clients) {
+        ::close(client.fd);
+    }
+    ::close(epollFd);
+    std::fflush(stdout);
+    ::kill(child, SIGTERM);
+    int status = 0;
+    ::waitpid(child, &status, 0);
+    return stats.errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,124 @@
+// email: shiraba01@gmail.com
+/**
+ * @file bench_sink.cpp
+ * @brief Throughput benchmark for the background-compressed replay stream.
+ *
+ * Simulates games on several threads (1) without storing them and (2) through
+ * a ReplaySink, so that the cost the sink adds to the simulation threads is
+ * visible. Then reports the sink counters (MB/s, compression ratio, stalls),
+ * reads the stream back and re-simulates a sample of games to check the bytes.
+ *
+ * Usage: ./bench_sink [games] [threads] [path]
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ReplaySink.hpp"
+#include "Simulator.hpp"
+
+using namespace coup;
+
+namespace {
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief Simulates games [0, numGames) on several threads, passing each replay to store.
+ */
+template <typename Store>
+double simulate(size_t numGames, size_t numThreads, Store store) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < numThreads; ++t) {
+        threads.emplace_back([=, &store]() {
+            ReplayRecorder recorder(ReplayHeader{0, {"P1", "P2"}, {Role::Spy, Role::Judge}});
+            auto sinkFor = store.begin();
+            for (size_t g = t; g < numGames; g += numThreads) {
+                SimOptions options;
+                options.seed = gameSeed(1, g);
+                simulateGame(options, &recorder);
+                store.add(sinkFor, recorder);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    return secondsSince(start);
+}
+
+struct Discard {
+    std::atomic<size_t>* bytes;
+    int begin() const { return 0; }
+    void add(int, const ReplayRecorder& recorder) const { bytes->fetch_add(recorder.bytes().size(), std::memory_order_relaxed); }
+};
+
+struct ToSink {
+    ReplaySink* sink;
+    std::unique_ptr<ReplaySink::Producer> begin() const { return std::make_unique<ReplaySink::Producer>(*sink); }
+    void add(std::unique_ptr<ReplaySink::Producer>& producer, const ReplayRecorder& recorder) const { producer->add(recorder); }
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const size_t numGames = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+    const size_t numThreads = argc > 2 ? std::strtoul(argv[2], nullptr, 10)
+                                       : std::max(2u, std::thread::hardware_concurrency());
+    const std::string path = argc > 3 ? argv[3] : "bench_sink.coupstream";
+
+    std::atomic<size_t> rawBytes{0};
+    double plain = simulate(numGames, numThreads, Discard{&rawBytes});
+    std::printf("simulation only: %zu games on %zu threads in %.2f s (%.0f games/s, %.1f MB of replays)\n",
+                numGames, numThreads, plain, numGames / plain, rawBytes.load() / 1e6);
+
+    SinkOptions options;
+    ReplaySink sink(path, options);
+    double sunk = simulate(numGames, numThreads, ToSink{&sink});
+    sink.close();
+    SinkStats stats = sink.stats();
+    std::printf("with sink:       %zu games in %.2f s (%.0f games/s, %+.1f%% vs simulation only)\n",
+                numGames, sunk, numGames / sunk, 100.0 * (sunk - plain) / plain);
+    std::printf("sink [%s]: %llu blocks, %.1f MB raw -> %.1f MB stored, ratio %.2fx\n",
+                blockCodecName(options.codec), static_cast<unsigned long long>(stats.blocks),
+                stats.rawBytes / 1e6, stats.storedBytes / 1e6, stats.ratio());
+    std::printf("sink throughput: %.1f MB/s raw, %.1f MB/s to disk, writer busy %.1f%%, %llu producer stalls\n",
+                stats.rawMBps(), stats.storedMBps(), 100.0 * stats.busySeconds / stats.seconds,
+                static_cast<unsigned long long>(stats.stalls));
+
+    // Read back: count every game, re-simulate a sample from its seed and compare the bytes
+    auto start = std::chrono::steady_clock::now();
+    ReplayStreamReader reader(path);
+    ReplayRecorder recorder(ReplayHeader{0, {"P1", "P2"}, {Role::Spy, Role::Judge}});
+    const uint8_t* data;
+    size_t size;
+    size_t games = 0;
+    size_t checked = 0;
+    size_t mismatches = 0;
+    while (reader.next(data, size)) {
+        if (games++ % 64 == 0) {
+            SimOptions check;
+            check.seed = ReplayReader(data, size).seed();
+            simulateGame(check, &recorder);
+            checked++;
+            if (recorder.bytes().size() != size || std::memcmp(recorder.bytes().data(), data, size) != 0) {
+                mismatches++;
+            }
+        }
+    }
+    std::printf("read back %zu games in %.2f s, %zu re-simulated, %zu mismatches\n",
+                games, secondsSince(start), checked, mismatches);
+
+    std::remove(path.c_str());
+    return games == numGames && mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,306 @@
+// email: shiraba01@gmail.com
+/**
+ * @file bench_spectate.cpp
+ * @brief Cost of feeding a table's actions to its spectators.
+ *
+ * Forks a GameServer on a free loopback port for each audience size. One
+ * text client plays random 2-player bot games back to back, one ACT in
+ * flight at a time; the spectators are binary connections that watch the
+ * table being played (they move to the next table when a game ends) and
+ * drain their deltas and keyframes. Reports actions/s, the bytes each
+ * spectator receives per action, and the server CPU time per frame queued to
+ * a spectator (the frame of an action is encoded once whatever the
+ * audience, so this is mostly the send). Client and server share the
+ * machine, so on few cores the spectators' reads bound the action rate.
+ *
+ * Usage: ./bench_spectate [max-spectators] [seconds] [shards]
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Server.hpp"
+
+using namespace coup;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t MAX_PLIES = 1000;
+
+std::atomic<bool> serverStop{false};
+
+void stopServer(int) {
+    serverStop.store(true);
+}
+
+struct Spectator {
+    int fd = -1;
+    std::string in;
+};
+
+struct Totals {
+    uint64_t actions = 0;
+    uint64_t games = 0;
+    uint64_t deltas = 0;
+    uint64_t keyframes = 0;
+    uint64_t bytes = 0;
+    double seconds = 0;
+};
+
+void sendAll(int fd, const std::string& bytes) {
+    for (size_t at = 0; at < bytes.size();) {
+        const ssize_t sent = ::send(fd, bytes.data() + at, bytes.size() - at, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            std::perror("send");
+            std::exit(1);
+        }
+        at += static_cast<size_t>(sent);
+    }
+}
+
+int connectTo(uint16_t port) {
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        std::perror("connect");
+        std::exit(1);
+    }
+    const int yes = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+    return fd;
+}
+
+// Moves every spectator from one table to another (table 0: none)
+void retarget(std::vector<Spectator>& spectators, uint32_t from, uint32_t to) {
+    std::string out;
+    FrameBuilder frames(out);
+    if (from != 0) {
+        TableMessage& leave = frames.add<TableMessage>();
+        leave.type = static_cast<uint8_t>(MessageType::Leave);
+        leave.table = from;
+    }
+    TableMessage& watch = frames.add<TableMessage>();
+    watch.type = static_cast<uint8_t>(MessageType::Watch);
+    watch.table = to;
+    frames.finish();
+    for (const Spectator& spectator : spectators) {
+        sendAll(spectator.fd, out);
+    }
+}
+
+// Reads what a spectator received and counts its deltas and keyframes
+void drain(Spectator& spectator, Totals& totals) {
+    char buffer[1 << 14];
+    for (;;) {
+        const ssize_t received = ::recv(spectator.fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (received <= 0) break;
+        totals.bytes += static_cast<uint64_t>(received);
+        spectator.in.append(buffer, static_cast<size_t>(received));
+    }
+    size_t offset = 0;
+    FrameView frame;
+    for (size_t size; (size = FrameView::parse(reinterpret_cast<const uint8_t*>(spectator.in.data()) + offset,
+                                               spectator.in.size() - offset, frame)) != 0;
+         offset += size) {
+        for (const FrameView::Message& message : frame) {
+            if (message.type == MessageType::Delta) totals.deltas++;
+            if (message.type == MessageType::Keyframe) totals.keyframes++;
+        }
+    }
+    spectator.in.erase(0, offset);
+}
+
+/**
+ * @brief Runs a server and plays against it with the given audience for a while.
+ */
+Totals run(size_t numSpectators, double seconds, size_t shards) {
+    int portPipe[2];
+    if (::pipe(portPipe) != 0) {
+        std::perror("pipe");
+        std::exit(1);
+    }
+    std::fflush(stdout);
+    const pid_t child = ::fork();
+    if (child == 0) {
+        std::signal(SIGTERM, stopServer);
+        ::close(portPipe[0]);
+        ServerOptions options;
+        options.shards = shards;
+        GameServer server(options);
+        const uint16_t port = server.port();
+        if (::write(portPipe[1], &port, sizeof(port)) != sizeof(port)) std::_Exit(1);
+        ::close(portPipe[1]);
+        server.run(serverStop);
+        const ServerStats stats = server.stats();
+        rusage usage{};
+        ::getrusage(RUSAGE_SELF, &usage);
+        const double cpu = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+                           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+        std::printf("  server: %.2f s CPU for %llu commands and %llu shared frames queued", cpu,
+                    static_cast<unsigned long long>(stats.commands), static_cast<unsigned long long>(stats.spectatorFrames));
+        if (stats.spectatorFrames > 0) {
+            std::printf(" (%.2f us per frame, sends included)", cpu / stats.spectatorFrames * 1e6);
+        }
+        std::printf(", %llu keyframes encoded\n", static_cast<unsigned long long>(stats.keyframes));
+        std::fflush(stdout);
+        std::_Exit(0);
+    }
+    ::close(portPipe[1]);
+    uint16_t port = 0;
+    if (::read(portPipe[0], &port, sizeof(port)) != sizeof(port)) {
+        std::fprintf(stderr, "the server did not start\n");
+        std::exit(1);
+    }
+    ::close(portPipe[0]);
+
+    const int epollFd = ::epoll_create1(0);
+    const int player = connectTo(port);
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;
+    ::epoll_ctl(epollFd, EPOLL_CTL_ADD, player, &event);
+    std::vector<Spectator> spectators(numSpectators);
+    for (Spectator& spectator : spectators) {
+        spectator.fd = connectTo(port);
+        event.data.ptr = &spectator;
+        ::epoll_ctl(epollFd, EPOLL_CTL_ADD, spectator.fd, &event);
+    }
+
+    Totals totals;
+    SplitMix64 rng(42);
+    std::unique_ptr<Table> game;
+    std::vector<Role> roles;
+    uint32_t table = 0;
+    size_t plies = 0;
+    Action pending;
+    std::string in;
+    enum class Phase { Creating, Joining, Playing } phase = Phase::Creating;
+    sendAll(player, "CREATE 2 " + std::to_string(rng.next() >> 1) + "\n");
+
+    auto playNext = [&]() {
+        if (plies >= MAX_PLIES || captureOutcome(game->getGame(), 0).winner != NO_SEAT ||
+            !chooseBotAction(game->getGame(), rng, pending)) {
+            totals.games++;
+            phase = Phase::Creating;
+            sendAll(player, "LEAVE " + std::to_string(table) + "\nCREATE 2 " + std::to_string(rng.next() >> 1) + "\n");
+            return;
+        }
+        std::string line = "ACT " + std::to_string(table) + ' ' + std::to_string(pending.actor) + ' ' +
+                           actionName(pending.kind);
+        if (actionHasTarget(pending.kind)) line += ' ' + std::to_string(pending.target);
+        line += '\n';
+        sendAll(player, line);
+    };
+    auto onReply = [&](const std::string& reply) {
+        if (reply == "OK" && phase == Phase::Creating) {
+            return;     // The LEAVE of the last game
+        }
+        if (reply.compare(0, 2, "OK") != 0) {
+            std::fprintf(stderr, "server error: %s\n", reply.c_str());
+            std::exit(1);
+        }
+        switch (phase) {
+            case Phase::Creating: {
+                const uint32_t created = static_cast<uint32_t>(std::strtoul(reply.c_str() + 3, nullptr, 10));
+                retarget(spectators, table, created);
+                table = created;
+                roles.clear();
+                phase = Phase::Joining;
+                sendAll(player, "JOIN " + std::to_string(table) + " A\nJOIN " + std::to_string(table) + " B\n");
+                break;
+            }
+            case Phase::Joining:
+                roles.push_back(parseRole(reply.substr(reply.rfind(' ') + 1)));
+                if (roles.size() == 2) {
+                    game = std::make_unique<Table>(std::vector<std::string>{"A", "B"}, roles);
+                    plies = 0;
+                    phase = Phase::Playing;
+                    playNext();
+                }
+                break;
+            case Phase::Playing:
+                applyAction(game->getGame(), pending);
+                plies++;
+                totals.actions++;
+                playNext();
+                break;
+        }
+    };
+
+    const auto start = Clock::now();
+    const auto deadline = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    epoll_event events[256];
+    char buffer[1 << 14];
+    while (Clock::now() < deadline) {
+        const int ready = ::epoll_wait(epollFd, events, 256, 100);
+        for (int e = 0; e < ready; ++e) {
+            if (events[e].data.ptr) {
+                drain(*static_cast<Spectator*>(events[e].data.ptr), totals);
+                continue;
+            }
+            const ssize_t received = ::recv(player, buffer, sizeof(buffer), 0);
+            if (received <= 0) {
+                std::fprintf(stderr, "connection closed by the server\n");
+                std::exit(1);
+            }
+            in.append(buffer, static_cast<size_t>(received));
+            size_t begin = 0;
+            for (size_t end; (end = in.find('\n', begin)) != std::string::npos; begin = end + 1) {
+                onReply(in.substr(begin, end - begin));
+            }
+            in.erase(0, begin);
+        }
+    }
+    totals.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    ::close(player);
+    for (Spectator& spectator : spectators) ::close(spectator.fd);
+    ::close(epollFd);
+    ::kill(child, SIGTERM);
+    int status = 0;
+    ::waitpid(child, &status, 0);
+    return totals;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const size_t maxSpectators = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000;
+    const double seconds = argc > 2 ? std::strtod(argv[2], nullptr) : 2;
+    const size_t shards = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 1;
+    std::printf("Delta frame %zu B, Keyframe %zu B, full Status frame %zu B\n",
+                sizeof(FrameHeader) + sizeof(DeltaMessage), sizeof(StatusMessage),
+                sizeof(FrameHeader) + sizeof(StatusMessage));
+    for (size_t audience = 0;; audience = audience == 0 ? 10 : audience * 10) {
+        audience = std::min(audience, maxSpectators);
+        const Totals totals = run(audience, seconds, shards);
+        const double perSpectator = audience && totals.actions ? static_cast<double>(totals.bytes) / audience / totals.actions : 0;
+        std::printf("%5zu spectators: %8.0f actions/s, %llu games, %.1f B per action per spectator "
+                    "(%llu deltas, %llu keyframes received)\n",
+                    audience, totals.actions / totals.seconds, static_cast<unsigned long long>(totals.games),
+                    perSpectator, static_cast<unsigned long long>(totals.deltas),
+                    static_cast<unsigned long long>(totals.keyframes));
+        if (audience >= maxSpectators) break;
+    }
+    return 0;
+}
@@ -0,0 +1,126 @@
+// email: shiraba01@gmail.com
+/**
+ * @file bench_timers.cpp
+ * @brief Turn deadlines of many tables: the TimerWheel of a server shard against a binary heap.
+ *
+ * Every table holds one deadline. Each simulated millisecond a share of the
+ * tables act, which replaces their deadline (cancel and schedule, as
+ * ServerShard::arm does), and the clock advances to collect the deadlines
+ * that passed, as the shard does once per round. The heap is the usual
+ * alternative: a std::priority_queue whose cancelled entries are skipped
+ * when they surface (it cannot remove them), so it also holds the stale
+ * deadlines of every table that acted recently.
+ *
+ * Usage: ./bench_timers [ticks] [actions-per-table-per-second] [timeout-ms]
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "Simulator.hpp"
+#include "TimerWheel.hpp"
+
+using namespace coup;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Result {
+    uint64_t rearms = 0;
+    uint64_t expiries = 0;
+    size_t peakEntries = 0;
+    double seconds = 0;
+};
+
+Result runWheel(size_t tables, uint64_t ticks, size_t actsPerTick, uint64_t timeoutMs) {
+    Result result;
+    TimerWheel wheel;
+    std::vector<TimerWheel::TimerId> ids(tables);
+    std::vector<uint64_t> expired;
+    SplitMix64 rng(7);
+    const auto start = Clock::now();
+    for (size_t table = 0; table < tables; ++table) {
+        ids[table] = wheel.schedule(rng.next() % timeoutMs, table);
+    }
+    for (uint64_t now = 0; now < ticks; ++now) {
+        for (size_t i = 0; i < actsPerTick; ++i) {
+            const size_t table = static_cast<size_t>(rng.next() % tables);
+            wheel.cancel(ids[table]);
+            ids[table] = wheel.schedule(now + timeoutMs, table);
+        }
+        expired.clear();
+        wheel.advance(now, expired);
+        for (const uint64_t table : expired) {
+            ids[table] = wheel.schedule(now + timeoutMs, table);     // The default move starts the next turn
+        }
+        result.rearms += actsPerTick;
+        result.expiries += expired.size();
+        result.peakEntries = std::max(result.peakEntries, wheel.size());
+    }
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return result;
+}
+
+Result runHeap(size_t tables, uint64_t ticks, size_t actsPerTick, uint64_t timeoutMs) {
+    Result result;
+    struct Entry {
+        uint64_t deadline;
+        uint32_t table;
+        uint32_t version;
+        bool operator>(const Entry& other) const { return deadline > other.deadline; }
+    };
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+    std::vector<uint32_t> versions(tables, 0);
+    SplitMix64 rng(7);
+    const auto start = Clock::now();
+    for (size_t table = 0; table < tables; ++table) {
+        heap.push(Entry{rng.next() % timeoutMs, static_cast<uint32_t>(table), 0});
+    }
+    for (uint64_t now = 0; now < ticks; ++now) {
+        for (size_t i = 0; i < actsPerTick; ++i) {
+            const size_t table = static_cast<size_t>(rng.next() % tables);
+            heap.push(Entry{now + timeoutMs, static_cast<uint32_t>(table), ++versions[table]});
+        }
+        while (!heap.empty() && heap.top().deadline <= now) {
+            const Entry top = heap.top();
+            heap.pop();
+            if (top.version != versions[top.table]) {
+                continue;       // Cancelled
+            }
+            heap.push(Entry{now + timeoutMs, top.table, ++versions[top.table]});
+            result.expiries++;
+        }
+        result.rearms += actsPerTick;
+        result.peakEntries = std::max(result.peakEntries, heap.size());
+    }
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return result;
+}
+
+void report(const char* name, size_t tables, const Result& result) {
+    std::printf("%-6s %8zu tables: %6.1f ns per re-arm, %8llu expiries, %9zu entries at peak, %.2f s\n", name,
+                tables, result.seconds / static_cast<double>(result.rearms + result.expiries) * 1e9,
+                static_cast<unsigned long long>(result.expiries), result.peakEntries, result.seconds);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const uint64_t ticks = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000;
+    const double rate = argc > 2 ? std::strtod(argv[2], nullptr) : 10;
+    const uint64_t timeoutMs = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 500;
+
+    std::printf("%llu ms simulated, %.0f actions per table per second, %llu ms deadlines\n",
+                static_cast<unsigned long long>(ticks), rate, static_cast<unsigned long long>(timeoutMs));
+    for (const size_t tables : {size_t(10000), size_t(100000), size_t(1000000)}) {
+        const size_t actsPerTick = std::max<size_t>(1, static_cast<size_t>(static_cast<double>(tables) * rate / 1000));
+        report("wheel", tables, runWheel(tables, ticks, actsPerTick, timeoutMs));
+        report("heap", tables, runHeap(tables, ticks, actsPerTick, timeoutMs));
+    }
+    return 0;
+}
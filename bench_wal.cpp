@@ -0,0 +1,92 @@
+// email: shiraba01@gmail.com
+/**
+ * @file bench_wal.cpp
+ * @brief What durability costs the game server: actions/s and ACT latency with and without a write-ahead log.
+ *
+ * Runs a GameServer on a thread of this process and plays bot games
+ * against it with the load generator, once without a log, then with a
+ * write-ahead log that syncs whatever waits as soon as the previous sync is
+ * done, and with group commit at most every few milliseconds. Every
+ * acknowledged action is on disk in the runs with a log, so the ACT round
+ * trip includes the wait for its commit, and the throughput depends on how
+ * many actions share each sync: with one action in flight per table, at
+ * most one per table.
+ *
+ * Usage: ./bench_wal [connections] [seconds] [log-directory]
+ */
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+#include "LoadGen.hpp"
+#include "Server.hpp"
+
+using namespace coup;
+
+namespace {
+
+struct Mode {
+    const char* name;
+    bool logged;
+    uint32_t commitMs;
+};
+
+void runMode(const Mode& mode, size_t connections, double seconds, const std::string& directory) {
+    std::filesystem::remove_all(directory);
+    ServerOptions options;
+    options.shards = 1;
+    if (mode.logged) {
+        options.walDirectory = directory;
+        options.walCommitMs = mode.commitMs;
+    }
+    GameServer server(options);
+    std::atomic<bool> stop{false};
+    std::thread loop([&] { server.run(stop); });
+
+    LoadOptions load;
+    load.port = server.port();
+    load.connections = connections;
+    load.seconds = seconds;
+    load.playerMix = PlayerMix{1, 0, 0, 0, 0};
+    const LoadReport report = runLoad(load);
+    stop = true;
+    loop.join();
+
+    const ServerStats stats = server.stats();
+    const double actionsPerSecond = report.actions / report.seconds;
+    std::printf("%-22s %10.0f actions/s   ACT p50 %6llu us  p99 %6llu us", mode.name, actionsPerSecond,
+                static_cast<unsigned long long>(report.actLatency.percentile(0.50)),
+                static_cast<unsigned long long>(report.actLatency.percentile(0.99)));
+    if (mode.logged && stats.walCommits > 0) {
+        std::printf("   %7llu syncs, %5.1f actions/sync", static_cast<unsigned long long>(stats.walCommits),
+                    static_cast<double>(report.actions) / stats.walCommits);
+    }
+    std::printf("\n");
+    std::filesystem::remove_all(directory);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const size_t connections = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200;
+    const double seconds = argc > 2 ? std::strtod(argv[2], nullptr) : 3;
+    const std::string directory = argc > 3 ? argv[3] : "/tmp/coup_bench_wal_" + std::to_string(::getpid());
+
+    std::printf("%zu connections on 2-player tables, %.1f s per run, log in %s\n", connections, seconds,
+                directory.c_str());
+    const Mode modes[] = {
+        {"no log", false, 0},
+        {"group commit 0 ms", true, 0},
+        {"group commit 2 ms", true, 2},
+        {"group commit 5 ms", true, 5},
+    };
+    for (const Mode& mode : modes) {
+        runMode(mode, connections, seconds, directory);
+    }
+    return 0;
+}
@@ -0,0 +1,373 @@
+// email: shiraba01@gmail.com
+/**
+ * @file bench_wire.cpp
+ * @brief Binary vs. text protocol: in-place frame decoding and batched play over loopback.
+ *
+ * First decodes frames of ACT messages in memory. Then forks a GameServer
+ * and runs the same load with both protocols: every connection plays many
+ * 2-player tables at once and sends one batch per round (one binary frame,
+ * or one send of text lines) with a message for every table, then waits
+ * for all the replies. Binary clients also receive a Delta per action.
+ *
+ * Usage: ./bench_wire [connections] [tables-per-connection] [seconds]
+ */
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Server.hpp"
+
+using namespace coup;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t MAX_PLIES = 1000;
+
+std::atomic<bool> serverStop{false};
+
+void stopServer(int) {
+    serverStop.store(true);
+}
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * @brief One table played by a client, from creation to the end of the game.
+ */
+struct BotTable {
+    enum class Phase { Create, Join, Play, Leave };
+
+    Phase phase = Phase::Create;
+    uint32_t id = 0;
+    Role roles[2] = {};
+    size_t joined = 0;
+    std::unique_ptr<Table> game;
+    Action pending;
+    size_t plies = 0;
+};
+
+struct LoadResult {
+    uint64_t actions = 0;
+    uint64_t rounds = 0;
+    uint64_t deltas = 0;
+    uint64_t errors = 0;
+    uint64_t bytesOut = 0;
+    uint64_t bytesIn = 0;
+};
+
+/**
+ * @brief A connection playing many tables in lockstep rounds.
+ */
+class BatchClient {
+public:
+    BatchClient(uint16_t port, size_t numTables, bool binary, uint64_t seed)
+        : tables(numTables), binary(binary), rng(seed) {
+        fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            std::perror("connect");
+            std::exit(1);
+        }
+        const int yes = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+    }
+
+    ~BatchClient() { ::close(fd); }
+
+    // Sends one message per table and waits for every reply
+    void round(LoadResult& result) {
+        out.clear();
+        order.clear();
+        FrameBuilder frames(out);
+        for (size_t t = 0; t < tables.size(); ++t) {
+            BotTable& table = tables[t];
+            if (table.phase == BotTable::Phase::Play && !choose(table)) {
+                table.phase = BotTable::Phase::Leave;
+            }
+            switch (table.phase) {
+                case BotTable::Phase::Create:
+                    if (binary) {
+                        CreateMessage m{};
+                        m.type = static_cast<uint8_t>(MessageType::Create);
+                        m.players = 2;
+                        m.tag = static_cast<uint32_t>(t);
+                        m.seed = rng.next() | 1;
+                        frames.add(m);
+                    } else {
+                        out += "CREATE 2\n";
+                    }
+                    order.push_back(t);
+                    break;
+                case BotTable::Phase::Join:
+                    for (const char* name : {"A", "B"}) {
+                        if (binary) {
+                            JoinMessage& m = frames.add<JoinMessage>();
+                            m.type = static_cast<uint8_t>(MessageType::Join);
+                            m.nameLength = 1;
+                            m.tag = static_cast<uint32_t>(t);
+                            m.table = table.id;
+                            m.name[0] = name[0];
+                        } else {
+                            out += "JOIN " + std::to_string(table.id) + ' ' + name + '\n';
+                        }
+                        order.push_back(t);
+                    }
+                    break;
+                case BotTable::Phase::Play:
+                    if (binary) {
+                        ActMessage& m = frames.add<ActMessage>();
+                        m.type = static_cast<uint8_t>(MessageType::Act);
+                        m.kind = static_cast<uint8_t>(table.pending.kind);
+                        m.seat = table.pending.actor;
+                        m.target = table.pending.target;
+                        m.tag = static_cast<uint32_t>(t);
+                        m.table = table.id;
+                    } else {
+                        out += "ACT " + std::to_string(table.id) + ' ' + std::to_string(table.pending.actor) + ' ' +
+                               actionName(table.pending.kind);
+                        if (actionHasTarget(table.pending.kind)) out += ' ' + std::to_string(table.pending.target);
+                        out += '\n';
+                    }
+                    order.push_back(t);
+                    break;
+                case BotTable::Phase::Leave:
+                    if (binary) {
+                        TableMessage& m = frames.add<TableMessage>();
+                        m.type = static_cast<uint8_t>(MessageType::Leave);
+                        m.tag = static_cast<uint32_t>(t);
+                        m.table = table.id;
+                    } else {
+                        out += "LEAVE " + std::to_string(table.id) + '\n';
+                    }
+                    order.push_back(t);
+                    break;
+            }
+        }
+        frames.finish();
+        sendAll();
+        result.bytesOut += out.size();
+        receive(result);
+        result.rounds++;
+    }
+
+private:
+    bool choose(BotTable& table) {
+        Game& game = table.game->getGame();
+        return table.plies < MAX_PLIES && captureOutcome(game, 0).winner == NO_SEAT &&
+               chooseBotAction(game, rng, table.pending);
+    }
+
+    void sendAll() {
+        size_t offset = 0;
+        while (offset < out.size()) {
+            const ssize_t sent = ::send(fd, out.data() + offset, out.size() - offset, MSG_NOSIGNAL);
+            if (sent <= 0) {
+                std::perror("send");
+                std::exit(1);
+            }
+            offset += static_cast<size_t>(sent);
+        }
+    }
+
+    void receive(LoadResult& result) {
+        size_t next = 0;            // Text replies come in the order of the requests
+        while (next < order.size()) {
+            char buffer[1 << 16];
+            const ssize_t received = ::recv(fd, buffer, sizeof(buffer), 0);
+            if (received <= 0) {
+                std::fprintf(stderr, "connection closed by the server\n");
+                std::exit(1);
+            }
+            result.bytesIn += static_cast<uint64_t>(received);
+            in.append(buffer, static_cast<size_t>(received));
+            size_t offset = 0;
+            if (binary) {
+                FrameView frame;
+                for (size_t size; (size = FrameView::parse(reinterpret_cast<const uint8_t*>(in.data()) + offset,
+                                                           in.size() - offset, frame)) != 0;
+                     offset += size) {
+                    for (const FrameView::Message& message : frame) {
+                        if (message.type == MessageType::Delta) {
+                            result.deltas++;
+                            continue;
+                        }
+                        const ReplyMessage reply = message.as<ReplyMessage>();
+                        onReply(tables[reply.tag], reply.code == 0, reply.value, static_cast<Role>(reply.extra), result);
+                        next++;
+                    }
+                }
+            } else {
+                for (size_t end; (end = in.find('\n', offset)) != std::string::npos; offset = end + 1) {
+                    BotTable& table = tables[order[next++]];
+                    const bool ok = in.compare(offset, 2, "OK") == 0;
+                    const uint32_t value = ok ? static_cast<uint32_t>(std::strtoul(in.c_str() + offset + 3, nullptr, 10)) : 0;
+                    Role role = Role::Governor;
+                    if (ok && table.phase == BotTable::Phase::Join) {
+                        const size_t space = in.find(' ', offset + 3);
+                        role = parseRole(in.substr(space + 1, end - space - 1));
+                    }
+                    onReply(table, ok, value, role, result);
+                }
+            }
+            in.erase(0, offset);
+        }
+    }
+
+    void onReply(BotTable& table, bool ok, uint32_t value, Role role, LoadResult& result) {
+        if (!ok) {
+            result.errors++;
+        }
+        switch (table.phase) {
+            case BotTable::Phase::Create:
+                table.id = value;
+                table.joined = 0;
+                table.phase = BotTable::Phase::Join;
+                break;
+            case BotTable::Phase::Join:
+                table.roles[table.joined++] = role;
+                if (table.joined == 2) {
+                    table.game = std::make_unique<Table>(std::vector<std::string>{"A", "B"},
+                                                         std::vector<Role>{table.roles[0], table.roles[1]});
+                    table.plies = 0;
+                    table.phase = BotTable::Phase::Play;
+                }
+                break;
+            case BotTable::Phase::Play:
+                if (ok) {
+                    applyAction(table.game->getGame(), table.pending);
+                    table.plies++;
+                    result.actions++;
+                } else {
+                    table.phase = BotTable::Phase::Leave;
+                }
+                break;
+            case BotTable::Phase::Leave:
+                table.phase = BotTable::Phase::Create;
+                break;
+        }
+    }
+
+    int fd = -1;
+    std::vector<BotTable> tables;
+    bool binary;
+    SplitMix64 rng;
+    std::string out;
+    std::string in;
+    std::vector<size_t> order;      // Table of each reply expected this round
+};
+
+LoadResult runLoad(uint16_t port, size_t numConnections, size_t numTables, bool binary, double seconds) {
+    std::vector<std::unique_ptr<BatchClient>> clients;
+    for (size_t c = 0; c < numConnections; ++c) {
+        clients.push_back(std::make_unique<BatchClient>(port, numTables, binary, gameSeed(9, c)));
+    }
+    LoadResult result;
+    const auto start = Clock::now();
+    while (secondsSince(start) < seconds) {
+        for (auto& client : clients) client->round(result);
+    }
+    return result;
+}
+
+void report(const char* name, const LoadResult& result, double seconds) {
+    std::printf("%-6s %9.0f actions/s, %7.0f rounds/s, %6.1f bytes sent and %6.1f received per action, "
+                "%llu deltas, %llu errors\n",
+                name, result.actions / seconds, result.rounds / seconds,
+                static_cast<double>(result.bytesOut) / result.actions, static_cast<double>(result.bytesIn) / result.actions,
+                static_cast<unsigned long long>(result.deltas), static_cast<unsigned long long>(result.errors));
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const size_t numConnections = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 16;
+    const size_t numTables = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 256;
+    const double seconds = argc > 3 ? std::strtod(argv[3], nullptr) : 3;
+
+    // In-memory decoding of ACT frames
+    {
+        std::string buffer;
+        FrameBuilder frames(buffer);
+        const size_t numMessages = 1 << 22;
+        for (size_t i = 0; i < numMessages; ++i) {
+            if (i % 256 == 0) frames.finish();
+            ActMessage& m = frames.add<ActMessage>();
+            m.type = static_cast<uint8_t>(MessageType::Act);
+            m.kind = static_cast<uint8_t>(i % NUM_ACTION_KINDS);
+            m.seat = static_cast<uint8_t>(i % 6);
+            m.target = NO_TARGET;
+            m.tag = static_cast<uint32_t>(i);
+            m.table = static_cast<uint32_t>(i >> 4);
+        }
+        frames.finish();
+        const auto start = Clock::now();
+        uint64_t checksum = 0;
+        size_t decoded = 0;
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(buffer.data());
+        FrameView frame;
+        for (size_t offset = 0, size; (size = FrameView::parse(data + offset, buffer.size() - offset, frame)) != 0;
+             offset += size) {
+            for (const FrameView::Message& message : frame) {
+                const ActMessage act = message.as<ActMessage>();
+                checksum += act.table + act.kind + act.seat;
+                decoded++;
+            }
+        }
+        const double elapsed = secondsSince(start);
+        std::printf("decoded %zu ACT messages in place: %.0f M messages/s, %.2f GB/s [checksum %llu]\n", decoded,
+                    decoded / elapsed / 1e6, buffer.size() / elapsed / 1e9, static_cast<unsigned long long>(checksum));
+    }
+
+    int portPipe[2];
+    if (::pipe(portPipe) != 0) {
+        std::perror("pipe");
+        return 1;
+    }
+    std::fflush(stdout);
+    const pid_t child = ::fork();
+    if (child == 0) {
+        std::signal(SIGTERM, stopServer);
+        ::close(portPipe[0]);
+        GameServer server;
+        const uint16_t port = server.port();
+        if (::write(portPipe[1], &port, sizeof(port)) != sizeof(port)) return 1;
+        ::close(portPipe[1]);
+        server.run(serverStop);
+        return 0;
+    }
+    ::close(portPipe[1]);
+    uint16_t port = 0;
+    if (::read(portPipe[0], &port, sizeof(port)) != sizeof(port)) {
+        std::fprintf(stderr, "the server did not start\n");
+        return 1;
+    }
+
+    std::printf("%zu connections x %zu tables, one batch per connection and round\n", numConnections, numTables);
+    const LoadResult text = runLoad(port, numConnections, numTables, false, seconds);
+    report("text", text, seconds);
+    const LoadResult binary = runLoad(port, numConnections, numTables, true, seconds);
+    report("binary", binary, seconds);
+
+    ::kill(child, SIGTERM);
+    ::waitpid(child, nullptr, 0);
+    return text.errors == 0 && binary.errors == 0 ? 0 : 1;
+}
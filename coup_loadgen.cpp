@@ -0,0 +1,126 @@
+// email: shiraba01@gmail.com
+/**
+ * @file coup_loadgen.cpp
+ * @brief Load generator for coup_server: thousands of bot players on this machine.
+ *
+ * Opens the connections to a server on 127.0.0.1 or a Unix socket, plays
+ * complete games with the built-in bots (see LoadGen.hpp) and prints the
+ * throughput, the games per table size and the histograms of ACT and table
+ * setup latency. SIGINT ends the run early and still prints the report.
+ *
+ * Usage: ./coup_loadgen [port | unix-socket-path] [--connections N] [--threads N] [--seconds S]
+ *                       [--games N] [--players 2:3,4:1] [--think none|const:MS|uniform:MIN-MAX|exp:MEAN[:MAX]]
+ *                       [--policy random|greedy|mixed] [--seed N]
+ * Exit status: 0 after a run without errors, 1 if the server answered with errors, 2 on bad usage or failure.
+ */
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <string>
+
+#include "LoadGen.hpp"
+
+using namespace coup;
+
+namespace {
+
+std::atomic<bool> stopRequested{false};
+
+void requestStop(int) {
+    stopRequested.store(true);
+}
+
+void printHistogram(const char* title, const LatencyHistogram& histogram) {
+    std::printf("%s: %llu samples, mean %.0f us, p50 %llu us, p90 %llu us, p99 %llu us, p99.9 %llu us, max %llu us\n",
+                title, static_cast<unsigned long long>(histogram.count()), histogram.mean(),
+                static_cast<unsigned long long>(histogram.percentile(0.5)),
+                static_cast<unsigned long long>(histogram.percentile(0.9)),
+                static_cast<unsigned long long>(histogram.percentile(0.99)),
+                static_cast<unsigned long long>(histogram.percentile(0.999)),
+                static_cast<unsigned long long>(histogram.max()));
+    uint64_t peak = 0;
+    for (size_t bucket = 0; bucket < LatencyHistogram::NUM_BUCKETS; ++bucket) {
+        if (histogram.at(bucket) > peak) peak = histogram.at(bucket);
+    }
+    for (size_t bucket = 0; bucket < LatencyHistogram::NUM_BUCKETS; ++bucket) {
+        if (histogram.at(bucket) == 0) continue;
+        const int width = static_cast<int>(40 * histogram.at(bucket) / peak);
+        std::printf("  %8llu - %8llu us %10llu %.*s\n", static_cast<unsigned long long>(LatencyHistogram::bucketLow(bucket)),
+                    static_cast<unsigned long long>(LatencyHistogram::bucketHigh(bucket) - 1),
+                    static_cast<unsigned long long>(histogram.at(bucket)), width,
+                    "########################################");
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    LoadOptions options;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg = argv[i];
+            if (arg.rfind("--", 0) != 0) {
+                if (arg.find('/') != std::string::npos) {
+                    options.unixPath = arg;
+                } else {
+                    options.port = static_cast<uint16_t>(std::strtoul(arg.c_str(), nullptr, 10));
+                }
+                continue;
+            }
+            if (i + 1 >= argc) {
+                throw std::invalid_argument("Missing value for " + arg);
+            }
+            const std::string value = argv[++i];
+            if (arg == "--connections") {
+                options.connections = std::strtoul(value.c_str(), nullptr, 10);
+            } else if (arg == "--threads") {
+                options.threads = std::strtoul(value.c_str(), nullptr, 10);
+            } else if (arg == "--seconds") {
+                options.seconds = std::strtod(value.c_str(), nullptr);
+            } else if (arg == "--games") {
+                options.gamesLimit = std::strtoull(value.c_str(), nullptr, 10);
+            } else if (arg == "--players") {
+                options.playerMix = parsePlayerMix(value);
+            } else if (arg == "--think") {
+                options.think = parseThinkTime(value);
+            } else if (arg == "--policy") {
+                options.policy = parseBotPolicy(value);
+            } else if (arg == "--seed") {
+                options.seed = std::strtoull(value.c_str(), nullptr, 10);
+            } else {
+                throw std::invalid_argument("Unknown option: " + arg);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "coup_loadgen: %s\n", e.what());
+        return 2;
+    }
+
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    try {
+        const LoadReport report = runLoad(options, &stopRequested);
+        std::printf("%llu games, %llu actions in %.2f s: %.0f actions/s, %.1f games/s, %llu errors\n",
+                    static_cast<unsigned long long>(report.games), static_cast<unsigned long long>(report.actions),
+                    report.seconds, report.actions / report.seconds, report.games / report.seconds,
+                    static_cast<unsigned long long>(report.errors));
+        if (report.refused != 0) {
+            std::printf("%llu tables refused by the overloaded server\n", static_cast<unsigned long long>(report.refused));
+        }
+        std::printf("games by table size:");
+        for (size_t i = 0; i < report.gamesBySize.size(); ++i) {
+            std::printf(" %zu:%llu", i + 2, static_cast<unsigned long long>(report.gamesBySize[i]));
+        }
+        std::printf("\n");
+        printHistogram("ACT latency", report.actLatency);
+        printHistogram("table setup latency", report.setupLatency);
+        return report.errors == 0 ? 0 : 1;
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "coup_loadgen: %s\n", e.what());
+        return 2;
+    }
+}
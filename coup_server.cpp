@@ -0,0 +1,104 @@
+// email: shiraba01@gmail.com
+/**
+ * @file coup_server.cpp
+ * @brief Hosts Coup tables for bots and human clients over a line-based text protocol.
+ *
+ * Listens on 127.0.0.1:<port>, or on a Unix socket when the argument is a
+ * path, with one shard (event loop thread) per core unless a shard count is
+ * given. Players who do not move within turn-ms gather, and reaction
+ * windows close after window-ms (no limits when 0 or absent). With a
+ * standby socket, the action log goes to a coup_standby listening there.
+ * With a log directory, every shard keeps a write-ahead log there and the
+ * tables survive a crash: the next server started on the directory with
+ * the same shard count recovers them. See Server.hpp for the commands.
+ * SIGINT and SIGTERM stop the server.
+ *
+ * Usage: ./coup_server [port | unix-socket-path] [shards] [turn-ms] [window-ms] [standby-socket | -] [log-directory]
+ * Exit status: 0 after a clean stop, 2 on error.
+ */
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <string>
+#include <thread>
+
+#include "Server.hpp"
+
+using namespace coup;
+
+namespace {
+
+std::atomic<bool> stopRequested{false};
+
+void requestStop(int) {
+    stopRequested.store(true);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    ServerOptions options;
+    options.port = 7777;
+    if (argc > 1) {
+        const std::string address = argv[1];
+        if (address.find('/') != std::string::npos) {
+            options.unixPath = address;
+        } else {
+            options.port = static_cast<uint16_t>(std::strtoul(argv[1], nullptr, 10));
+        }
+    }
+    options.shards = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : std::max(1u, std::thread::hardware_concurrency());
+    options.turnTimeoutMs = argc > 3 ? static_cast<uint32_t>(std::strtoul(argv[3], nullptr, 10)) : 0;
+    options.reactionWindowMs = argc > 4 ? static_cast<uint32_t>(std::strtoul(argv[4], nullptr, 10)) : 0;
+    if (argc > 5 && std::string(argv[5]) != "-") {
+        options.standbyPath = argv[5];
+    }
+    if (argc > 6) {
+        options.walDirectory = argv[6];
+    }
+
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    try {
+        GameServer server(options);
+        if (options.unixPath.empty()) {
+            std::printf("listening on 127.0.0.1:%u with %zu shards\n", server.port(), server.shardCount());
+        } else {
+            std::printf("listening on %s with %zu shards\n", options.unixPath.c_str(), server.shardCount());
+        }
+        if (!options.walDirectory.empty()) {
+            std::printf("recovered %zu tables from %s\n", server.tableCount(), options.walDirectory.c_str());
+        }
+        std::fflush(stdout);
+        server.run(stopRequested);
+
+        const ServerStats stats = server.stats();
+        std::printf("%llu connections, %llu commands (%llu errors), %llu tables open\n",
+                    static_cast<unsigned long long>(stats.accepted), static_cast<unsigned long long>(stats.commands),
+                    static_cast<unsigned long long>(stats.errors), static_cast<unsigned long long>(server.tableCount()));
+        for (const TableUsage& table : server.hottest(5)) {
+            std::printf("table %u: %llu actions, %.1f us CPU (%.1f us max), %.1f us mean latency\n", table.table,
+                        static_cast<unsigned long long>(table.actions), table.cpuNs / 1e3, table.maxActionNs / 1e3,
+                        table.actions ? table.latencyNs / 1e3 / table.actions : 0.0);
+        }
+        if (!options.walDirectory.empty()) {
+            std::printf("write-ahead log: %.1f MB in %llu commits, %llu compactions\n", stats.walBytes / 1e6,
+                        static_cast<unsigned long long>(stats.walCommits),
+                        static_cast<unsigned long long>(stats.walCompactions));
+        }
+        if (options.turnTimeoutMs != 0 || options.reactionWindowMs != 0) {
+            std::printf("%llu turns timed out, %llu reaction windows closed by their deadline\n",
+                        static_cast<unsigned long long>(stats.turnTimeouts),
+                        static_cast<unsigned long long>(stats.windowTimeouts));
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "coup_server: %s\n", e.what());
+        return 2;
+    }
+}
@@ -0,0 +1,86 @@
+// email: shiraba01@gmail.com
+/**
+ * @file coup_standby.cpp
+ * @brief Hot standby of a coup_server: follows its action log and takes over its tables when it dies.
+ *
+ * Listens on a Unix socket for the shards of a coup_server started with the
+ * same path as its standby-socket argument. Once every shard has
+ * disconnected, it serves the tables it replayed on 127.0.0.1:<port> (or a
+ * Unix socket path), with the same shard count; players rejoin with JOIN
+ * under their names. SIGINT and SIGTERM stop it.
+ *
+ * Usage: ./coup_standby <standby-socket> [port | unix-socket-path] [turn-ms] [window-ms]
+ * Exit status: 0 after a clean stop, 2 on error.
+ */
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <string>
+
+#include "Server.hpp"
+#include "Standby.hpp"
+
+using namespace coup;
+
+namespace {
+
+std::atomic<bool> stopRequested{false};
+
+void requestStop(int) {
+    stopRequested.store(true);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s <standby-socket> [port | unix-socket-path] [turn-ms] [window-ms]\n", argv[0]);
+        return 2;
+    }
+    ServerOptions options;
+    options.port = 7777;
+    if (argc > 2) {
+        const std::string address = argv[2];
+        if (address.find('/') != std::string::npos) {
+            options.unixPath = address;
+        } else {
+            options.port = static_cast<uint16_t>(std::strtoul(argv[2], nullptr, 10));
+        }
+    }
+    options.turnTimeoutMs = argc > 3 ? static_cast<uint32_t>(std::strtoul(argv[3], nullptr, 10)) : 0;
+    options.reactionWindowMs = argc > 4 ? static_cast<uint32_t>(std::strtoul(argv[4], nullptr, 10)) : 0;
+
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    try {
+        Standby standby(argv[1]);
+        std::printf("following on %s\n", argv[1]);
+        std::fflush(stdout);
+        while (!standby.leaderGone()) {
+            standby.poll(100);
+            if (stopRequested.load()) {
+                return 0;
+            }
+        }
+        options.shards = standby.shardCount();
+        const unsigned long long replayed = standby.stats().bytes;
+        GameServer server(options, standby.takeTables());
+        std::printf("took over %zu tables (%llu log bytes) on %zu shards\n", server.tableCount(), replayed,
+                    server.shardCount());
+        std::fflush(stdout);
+        server.run(stopRequested);
+
+        const ServerStats stats = server.stats();
+        std::printf("%llu connections, %llu commands (%llu errors), %llu tables open\n",
+                    static_cast<unsigned long long>(stats.accepted), static_cast<unsigned long long>(stats.commands),
+                    static_cast<unsigned long long>(stats.errors), static_cast<unsigned long long>(server.tableCount()));
+        return 0;
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "coup_standby: %s\n", e.what());
+        return 2;
+    }
+}
@@ -16,6 +16,7 @@
 #include "General.hpp"
 #include "Judge.hpp"
 #include "Merchant.hpp"
+#include "History.hpp"
 using namespace coup;
 
 /**
@@ -262,6 +263,52 @@ std::vector<std::string> getPlayerNames(sf::RenderWindow& window, sf::Font& font
 
 
 
+/**
+ * @brief Builds the action buttons (base actions plus role-specific ones) for a role.
+ *
+ * @param font Reference to the SFML Font used for the button labels.
+ * @param role The role of the current player.
+ * @param actionButtons Output vector of button labels (cleared first).
+ * @param actionButtonBoxes Output vector of button boxes (cleared first).
+ */
+void buildActionButtons(sf::Font& font, const std::string& role,
+                        std::vector<sf::Text>& actionButtons,
+                        std::vector<sf::RectangleShape>& actionButtonBoxes) {
+    actionButtons.clear();
+    actionButtonBoxes.clear();
+
+    std::vector<std::string> baseActions = { "Gather", "Tax", "Bribe", "Arrest", "Sanction", "Coup" };
+    std::vector<std::string> roleSpecificActions;
+    if (role == "Governor") roleSpecificActions.push_back("Block Tax");
+    if (role == "Spy") roleSpecificActions.push_back("Block Arrest");
+    if (role == "General") roleSpecificActions.push_back("Block Coup");
+    if (role == "Baron") roleSpecificActions.push_back("Invest");
+    if (role == "Judge") roleSpecificActions.push_back("Block Bribe");
+
+    std::vector<std::string> allActions = baseActions;
+    allActions.insert(allActions.end(), roleSpecificActions.begin(), roleSpecificActions.end());
+
+    int buttonY = 200;
+    for (const std::string& action : allActions) {
+        sf::Text text(action, font, 24);
+        text.setFillColor(sf::Color::Blue);
+        text.setPosition(120, buttonY + 10);
+
+        sf::RectangleShape box;
+        box.setSize(sf::Vector2f(200, 40));
+        box.setPosition(100, buttonY);
+        box.setFillColor(sf::Color(220, 220, 220));
+        box.setOutlineColor(sf::Color::Black);
+        box.setOutlineThickness(2);
+
+        actionButtons.push_back(text);
+        actionButtonBoxes.push_back(box);
+        buttonY += 50;
+    }
+}
+
+
+
 /**
  * @brief Entry point for the Coup GUI game.
  *
@@ -277,6 +324,7 @@ std::vector<std::string> getPlayerNames(sf::RenderWindow& window, sf::Font& font
  *     - Text input for target-based actions
  *     - Spacebar to proceed to the next turn
  *     - Enter key to confirm a target for targeted actions
+ *     - U key to undo back to the previous turn (using the game history)
  * 6. Executes the selected game actions (e.g., gather, tax, bribe, arrest, block, etc.).
  * 7. Displays output messages in a designated box and updates the game state accordingly.
  * 8. Handles game ending when a winner is declared.
@@ -364,35 +412,17 @@ int main() {
     outputText.setFillColor(sf::Color::Black);
     outputText.setPosition(100, 600);
 
-    std::vector<std::string> baseActions = { "Gather", "Tax", "Bribe", "Arrest", "Sanction", "Coup" };
-    std::string currentRole = playerRoles[0].second;
-    std::vector<std::string> roleSpecificActions;
-    if (currentRole == "Governor") roleSpecificActions.push_back("Block Tax");
-    if (currentRole == "Spy") roleSpecificActions.push_back("Block Arrest");
-    if (currentRole == "General") roleSpecificActions.push_back("Block Coup");
-    if (currentRole == "Baron") roleSpecificActions.push_back("Invest");
-    if (currentRole == "Judge") roleSpecificActions.push_back("Block Bribe");
+    buildActionButtons(font, playerRoles[0].second, actionButtons, actionButtonBoxes);
 
-    std::vector<std::string> allActions = baseActions;
-    allActions.insert(allActions.end(), roleSpecificActions.begin(), roleSpecificActions.end());
+    // Structurally shared history of the game, one snapshot per turn (used for undo)
+    GameHistory history;
+    std::vector<int> historyTurns;   // GUI turn index matching each snapshot
+    history.record(game);
+    historyTurns.push_back(currentTurn);
 
-    int buttonY = 200;
-    for (const std::string& action : allActions) {
-        sf::Text text(action, font, 24);
-        text.setFillColor(sf::Color::Blue);
-        text.setPosition(120, buttonY + 10);
-
-        sf::RectangleShape box;
-        box.setSize(sf::Vector2f(200, 40));
-        box.setPosition(100, buttonY);
-        box.setFillColor(sf::Color(220, 220, 220));
-        box.setOutlineColor(sf::Color::Black);
-        box.setOutlineThickness(2);
-
-        actionButtons.push_back(text);
-        actionButtonBoxes.push_back(box);
-        buttonY += 50;
-    }
+    sf::Text historyText("Turn 1  (U = undo)", font, 20);
+    historyText.setFillColor(sf::Color(90, 90, 90));
+    historyText.setPosition(500, 200);
 
     
 
@@ -536,37 +566,33 @@ if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::Space
     bankText.setString("Bank: " + std::to_string(game.getBankCoins()));
 
    
-    actionButtons.clear();
-    actionButtonBoxes.clear();
-
-    std::vector<std::string> baseActions = { "Gather", "Tax", "Bribe", "Arrest", "Sanction", "Coup" };
-    std::vector<std::string> roleSpecificActions;
-    if (currentRole == "Governor") roleSpecificActions.push_back("Block Tax");
-    if (currentRole == "Spy") roleSpecificActions.push_back("Block Arrest");
-    if (currentRole == "General") roleSpecificActions.push_back("Block Coup");
-    if (currentRole == "Baron") roleSpecificActions.push_back("Invest");
-    if (currentRole == "Judge") roleSpecificActions.push_back("Block Bribe");
+    buildActionButtons(font, currentRole, actionButtons, actionButtonBoxes);
 
-    std::vector<std::string> allActions = baseActions;
-    allActions.insert(allActions.end(), roleSpecificActions.begin(), roleSpecificActions.end());
+    history.record(game);
+    historyTurns.push_back(currentTurn);
+    historyText.setString("Turn " + std::to_string(history.size()) + "  (U = undo)");
 
-    int buttonY = 200;
-    for (const std::string& action : allActions) {
-        sf::Text text(action, font, 24);
-        text.setFillColor(sf::Color::Blue);
-        text.setPosition(120, buttonY + 10);
-
-        sf::RectangleShape box;
-        box.setSize(sf::Vector2f(200, 40));
-        box.setPosition(100, buttonY);
-        box.setFillColor(sf::Color(220, 220, 220));
-        box.setOutlineColor(sf::Color::Black);
-        box.setOutlineThickness(2);
+    waitingForSpace = false;
+}
 
-        actionButtons.push_back(text);
-        actionButtonBoxes.push_back(box);
-        buttonY += 50;
+// Undo: go back to the start of the previous turn (or of the current one if an
+// action was already played and SPACE was not pressed yet)
+if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::U && !isAwaitingTargetInput) {
+    if (!waitingForSpace && history.size() > 1) {
+        history.truncate(history.size() - 1);
+        historyTurns.pop_back();
     }
+    history.restore(game, history.size() - 1);
+    currentTurn = historyTurns.back();
+
+    auto currentPlayer = players[currentTurn];
+    currentPlayerText.setString("Current Player: " + currentPlayer->getName());
+    roleText.setString("Role: " + currentPlayer->getRole());
+    coinText.setString("Coins: " + std::to_string(currentPlayer->getCoins()));
+    bankText.setString("Bank: " + std::to_string(game.getBankCoins()));
+    outputText.setString("Undo: back to turn " + std::to_string(history.size()));
+    historyText.setString("Turn " + std::to_string(history.size()) + "  (U = undo)");
+    buildActionButtons(font, currentPlayer->getRole(), actionButtons, actionButtonBoxes);
 
     waitingForSpace = false;
 }
@@ -626,6 +652,7 @@ if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::Space
         window.draw(roleText);
         window.draw(coinText);
         window.draw(bankText);
+        window.draw(historyText);
         
         if (isAwaitingTargetInput) window.draw(targetInputText);
         for (size_t i = 0; i < actionButtons.size(); ++i) {
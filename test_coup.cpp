@@ -5,6 +5,46 @@
 #include "Spy.hpp"
 #include "Governor.hpp"
 #include "Baron.hpp"
+#include "History.hpp"
+#include "IndexedReplay.hpp"
+#include "LatencyHistogram.hpp"
+#include "LoadGen.hpp"
+#include "Matchmaker.hpp"
+#include "Archive.hpp"
+#include "EventExport.hpp"
+#include "Replay.hpp"
+#include "ReplaySink.hpp"
+#include "ResultsStore.hpp"
+#include "Simulator.hpp"
+#include "SpscQueue.hpp"
+#include "Standby.hpp"
+#include "Server.hpp"
+#include "Table.hpp"
+#include "TableRegistry.hpp"
+#include "TimerWheel.hpp"
+#include "Tournament.hpp"
+#include "TurnFlow.hpp"
+#include "Verifier.hpp"
+#include "Wire.hpp"
+#include "WriteAheadLog.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 using namespace coup;
 using namespace std;
@@ -60,3 +100,1770 @@ TEST_CASE("Simple flow") {
     baron.gather();        // Charlie gathers again
     CHECK(baron.getCoins() == 3); // Check Charlie has 3 coins again
 }
+
+TEST_CASE("Hot player state is stored per seat in the game") {
+    Game game;
+    Governor gov(game, "Alice");
+    Spy spy(game, "Bob");
+
+    CHECK(gov.getSeat() == 0);
+    CHECK(spy.getSeat() == 1);
+    CHECK(game.hasFlag(1, FLAG_ALIVE));
+    CHECK(game.hasFlag(1, FLAG_ARREST_ENABLED));
+
+    gov.gather();                      // Alice
+    spy.blockArrestNextTurn(gov);      // Bob blocks Alice's arrest and keeps the turn
+    CHECK(game.hasFlag(1, FLAG_EXTRA_TURN));
+    CHECK_FALSE(gov.isArrestEnabled());
+    CHECK(game.coinsAt(0) == 1);
+
+    spy.gather();                      // Bob uses the extra turn
+    CHECK_FALSE(spy.hasPendingExtraTurn());
+    CHECK(game.turn() == "Bob");
+    CHECK(game.getBankCoins() == 98);
+}
+
+TEST_CASE("Game history shares unchanged seats and restores past turns") {
+    Game game;
+    Governor gov(game, "Alice");
+    Spy spy(game, "Bob");
+    Baron baron(game, "Charlie");
+    GameHistory history;
+
+    history.record(game);
+    gov.tax();                         // Alice: +3
+    history.record(game);
+    spy.gather();                      // Bob: +1
+    history.record(game);
+
+    // Charlie never changed, so all three snapshots share his block
+    CHECK(history.at(0).seats[2] == history.at(2).seats[2]);
+    CHECK(history.at(1).seats[0] == history.at(2).seats[0]);
+    CHECK(history.distinctBlocks() == 5);
+
+    history.restore(game, 1);
+    CHECK(gov.getCoins() == 3);
+    CHECK(spy.getCoins() == 0);
+    CHECK(spy.getLastAction() == "");
+    CHECK(game.turn() == "Bob");
+    CHECK(game.getBankCoins() == 97);
+
+    history.restore(game, 0);
+    CHECK(gov.getCoins() == 0);
+    CHECK(game.turn() == "Alice");
+    CHECK(game.getBankCoins() == 100);
+}
+
+TEST_CASE("Memory footprint counts string heap blocks and vector capacity") {
+    Game game;
+    Governor shortName(game, "Al");
+    Spy longName(game, "A player name that does not fit in the small buffer");
+
+    CHECK(shortName.memoryFootprint().objectBytes == sizeof(Player));
+    CHECK(shortName.memoryFootprint().heapBytes == 0);
+    CHECK(longName.memoryFootprint().heapBytes > longName.getName().size());
+
+    MemoryFootprint gameOnly = game.memoryFootprint(false);
+    CHECK(gameOnly.objectBytes == sizeof(Game));
+    CHECK(gameOnly.heapBytes >= 2 * sizeof(Player*));
+    CHECK(game.memoryFootprint().total() ==
+          gameOnly.total() + shortName.memoryFootprint().total() + longName.memoryFootprint().total());
+}
+
+TEST_CASE("Binary replay records 1-2 bytes per action and rebuilds the same game") {
+    ReplayHeader header{42, {"Alice", "Bob", "Carol"}, {Role::Baron, Role::Spy, Role::Governor}};
+    Table table(header.names, header.roles);
+    Game& game = table.getGame();
+    ReplayRecorder recorder(header);
+    size_t headerSize = recorder.bytes().size();
+
+    recorder.apply(game, Action{ActionKind::Gather, 0});
+    recorder.apply(game, Action{ActionKind::Tax, 1});
+    recorder.apply(game, Action{ActionKind::Tax, 2});
+    recorder.apply(game, Action{ActionKind::BlockTax, 2, 1});   // Carol reacts out of turn
+    CHECK_THROWS(recorder.apply(game, Action{ActionKind::Gather, 2}));   // Not Carol's turn: not recorded
+    CHECK(recorder.actionCount() == 4);
+    CHECK(recorder.bytes().size() == headerSize + 5);
+
+    ReplayReader reader(recorder.bytes().data(), recorder.bytes().size());
+    CHECK(reader.seed() == 42);
+    CHECK(reader.name(2) == "Carol");
+    CHECK(reader.role(0) == Role::Baron);
+
+    auto replayed = replayGame(recorder.bytes().data(), recorder.bytes().size());
+    for (size_t s = 0; s < 3; ++s) {
+        CHECK(replayed->player(s).getCoins() == table.player(s).getCoins());
+    }
+    CHECK(replayed->getGame().getBankCoins() == game.getBankCoins());
+    CHECK(replayed->getGame().turn() == game.turn());
+}
+
+TEST_CASE("Simulated games replay to the same outcome") {
+    ReplayRecorder recorder(ReplayHeader{0, {"P1", "P2"}, {Role::Spy, Role::Judge}});
+    for (uint64_t g = 0; g < 50; ++g) {
+        SimOptions options;
+        options.seed = gameSeed(7, g);
+        GameOutcome result = simulateGame(options, &recorder);
+        CHECK(recorder.actionCount() == result.plies);
+
+        auto table = replayGame(recorder.bytes().data(), recorder.bytes().size());
+        if (result.winner != NO_SEAT) {
+            CHECK(table->getGame().winner() == table->player(result.winner).getName());
+        } else {
+            CHECK_THROWS(table->getGame().winner());
+        }
+    }
+}
+
+TEST_CASE("Replay archive indexes games and reads them back from the mapping") {
+    const std::string path = "test_archive.coup";
+    std::vector<GameOutcome> outcomes;
+    {
+        ArchiveWriter writer(path);
+        ReplayRecorder recorder(ReplayHeader{0, {"P1", "P2"}, {Role::Spy, Role::Judge}});
+        for (uint64_t g = 0; g < 20; ++g) {
+            SimOptions options;
+            options.seed = gameSeed(3, g);
+            outcomes.push_back(simulateGame(options, &recorder));
+            CHECK(writer.add(recorder.bytes().data(), recorder.bytes().size(), outcomes.back()) == g);
+        }
+        writer.finish();
+    }
+
+    ArchiveReader archive(path);
+    REQUIRE(archive.size() == 20);
+    for (size_t id = 0; id < archive.size(); ++id) {
+        CHECK(archive.entry(id).outcome() == outcomes[id]);
+        ReplayReader reader = archive.replay(id);
+        CHECK(reader.seed() == gameSeed(3, id));
+        CHECK(static_cast<uint8_t>(reader.role(0)) == archive.entry(id).roles[0]);
+
+        auto table = replayGame(archive.replayData(id), archive.entry(id).length);
+        CHECK(captureOutcome(table->getGame(), outcomes[id].plies) == outcomes[id]);
+    }
+    CHECK_THROWS_AS(archive.replay(20), std::out_of_range);
+
+    // An index entry whose offset wraps around past the end of the data
+    {
+        std::ifstream in(path, std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        const uint64_t offset = UINT64_MAX - 4;
+        std::memcpy(&bytes[bytes.size() - sizeof(ArchiveFooter) - 15 * sizeof(ArchiveEntry)], &offset, sizeof(offset));
+        std::ofstream out("test_archive_bad.coup", std::ios::binary);
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    }
+    ArchiveReader corrupt("test_archive_bad.coup");
+    CHECK_THROWS_AS(corrupt.replay(5), std::runtime_error);
+    CHECK_NOTHROW(corrupt.replay(4));
+    std::remove("test_archive_bad.coup");
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Replay sink streams compressed blocks from several threads") {
+    const std::string path = "test_sink.coupstream";
+    SinkOptions options;
+    options.codec = BlockCodec::Builtin;
+    options.blockSize = 512;          // Many small blocks
+    options.maxQueuedBlocks = 1;      // Producers have to wait for the writer
+    {
+        ReplaySink sink(path, options);
+        std::vector<std::thread> threads;
+        for (uint64_t t = 0; t < 2; ++t) {
+            threads.emplace_back([&sink, t]() {
+                ReplaySink::Producer producer(sink);
+                ReplayRecorder recorder(ReplayHeader{0, {"P1", "P2"}, {Role::Spy, Role::Judge}});
+                for (uint64_t g = t; g < 40; g += 2) {
+                    SimOptions sim;
+                    sim.seed = gameSeed(5, g);
+                    simulateGame(sim, &recorder);
+                    producer.add(recorder);
+                }
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        sink.close();
+        SinkStats stats = sink.stats();
+        CHECK(stats.games == 40);
+        CHECK(stats.blocks > 1);
+        CHECK(stats.ratio() > 1.0);
+        ReplaySink::Producer late(sink);
+        late.add(nullptr, 0);
+        CHECK_THROWS_AS(late.flush(), std::runtime_error);
+    }
+
+    // Every game comes back byte for byte, in any order
+    std::vector<bool> seen(40, false);
+    ReplayStreamReader reader(path);
+    ReplayRecorder recorder(ReplayHeader{0, {"P1", "P2"}, {Role::Spy, Role::Judge}});
+    const uint8_t* data;
+    size_t size;
+    while (reader.next(data, size)) {
+        uint64_t seed = ReplayReader(data, size).seed();
+        for (uint64_t g = 0; g < 40; ++g) {
+            if (gameSeed(5, g) != seed) continue;
+            SimOptions sim;
+            sim.seed = seed;
+            simulateGame(sim, &recorder);
+            CHECK(recorder.bytes() == std::vector<uint8_t>(data, data + size));
+            seen[g] = true;
+        }
+    }
+    CHECK(std::count(seen.begin(), seen.end(), true) == 40);
+    std::remove(path.c_str());
+
+    // Records that are not replays are kept verbatim
+    std::vector<uint8_t> raw = {3, 'a', 'b', 'c'};
+    std::vector<uint8_t> packed, unpacked;
+    compressBlock(BlockCodec::Builtin, raw.data(), raw.size(), packed);
+    decompressBlock(BlockCodec::Builtin, packed.data(), packed.size(), raw.size(), unpacked);
+    CHECK(unpacked == raw);
+    CHECK_THROWS_AS(decompressBlock(BlockCodec::Builtin, packed.data(), packed.size() - 1, raw.size(), unpacked),
+                    std::runtime_error);
+}
+
+TEST_CASE("Legal-move-indexed replays round-trip and shrink") {
+    ReplayRecorder recorder(ReplayHeader{0, {"P1", "P2"}, {Role::Spy, Role::Judge}});
+    size_t plainBytes = 0;
+    size_t indexedBytes = 0;
+    for (uint64_t g = 0; g < 30; ++g) {
+        SimOptions options;
+        options.seed = gameSeed(11, g);
+        GameOutcome result = simulateGame(options, &recorder);
+        std::vector<uint8_t> indexed = encodeIndexedReplay(recorder.bytes().data(), recorder.bytes().size());
+        CHECK(decodeIndexedReplay(indexed.data(), indexed.size()) == recorder.bytes());
+        auto table = replayIndexedGame(indexed.data(), indexed.size());
+        CHECK(captureOutcome(table->getGame(), result.plies) == result);
+        plainBytes += recorder.bytes().size();
+        indexedBytes += indexed.size();
+    }
+    CHECK(indexedBytes * 2 < plainBytes);
+
+    // A move the generator does not list (passing while other moves end the turn) goes through the escape symbol
+    Table table({"Alice", "Bob", "Carol"}, {Role::Spy, Role::Governor, Role::Judge});
+    ReplayRecorder manual(ReplayHeader{5, {"Alice", "Bob", "Carol"}, {Role::Spy, Role::Governor, Role::Judge}});
+    manual.apply(table.getGame(), Action{ActionKind::Gather, 0, NO_TARGET});
+    manual.apply(table.getGame(), Action{ActionKind::Pass, 1, NO_TARGET});
+    manual.apply(table.getGame(), Action{ActionKind::Tax, 2, NO_TARGET});
+    std::vector<uint8_t> indexed = encodeIndexedReplay(manual.bytes().data(), manual.bytes().size());
+    CHECK(decodeIndexedReplay(indexed.data(), indexed.size()) == manual.bytes());
+
+    indexed[1] = 'X';
+    CHECK_THROWS_AS(replayIndexedGame(indexed.data(), indexed.size()), std::runtime_error);
+}
+
+TEST_CASE("Replay verifier finds games that no longer reproduce their outcome") {
+    const std::string path = "test_verify.coup";
+    std::vector<GameOutcome> outcomes;
+    {
+        ArchiveWriter writer(path);
+        ReplayRecorder recorder(ReplayHeader{0, {"P1", "P2"}, {Role::Spy, Role::Judge}});
+        for (uint64_t g = 0; g < 40; ++g) {
+            SimOptions options;
+            options.seed = gameSeed(9, g);
+            outcomes.push_back(simulateGame(options, &recorder));
+            std::vector<uint8_t> replay = recorder.bytes();
+            GameOutcome recorded = outcomes.back();
+            if (g == 3) recorded.bank++;           // Index disagrees with the replay
+            if (g == 7) replay.push_back(0x0F);    // An action code the engine does not know
+            if (g == 9) recorded.winner = 200;     // A winner seat the game does not have
+            writer.add(replay.data(), replay.size(), recorded);
+        }
+    }
+
+    ArchiveReader archive(path);
+    VerifyReport report = verifyArchive(archive, 3);
+    CHECK(report.games == 40);
+    CHECK(report.divergent == 3);
+    REQUIRE(report.divergences.size() == 3);
+    CHECK(report.divergences[0].gameId == 3);
+    CHECK(report.divergences[0].ply == outcomes[3].plies);
+    CHECK(report.divergences[0].reason.find("bank") != std::string::npos);
+    CHECK(report.divergences[1].gameId == 7);
+    CHECK(report.divergences[1].ply == outcomes[7].plies);
+    CHECK(report.divergences[2].gameId == 9);
+    CHECK(report.divergences[2].reason.find("seat 200") != std::string::npos);
+
+    uint64_t actions = 0;
+    Divergence divergence;
+    CHECK(verifyGame(archive, 0, divergence, actions));
+    CHECK(actions == outcomes[0].plies);
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Game snapshots save and restore the complete game state") {
+    Table table({"Alice", "Bob", "Carol"}, {Role::Baron, Role::General, Role::Spy});
+    Game& game = table.getGame();
+    ReplayRecorder recorder(ReplayHeader{0, {"Alice", "Bob", "Carol"}, {Role::Baron, Role::General, Role::Spy}});
+    for (int round = 0; round < 4; ++round) {
+        recorder.apply(game, Action{ActionKind::Tax, 0, NO_TARGET});
+        recorder.apply(game, Action{ActionKind::Gather, 1, NO_TARGET});
+        recorder.apply(game, Action{ActionKind::Tax, 2, NO_TARGET});
+    }
+    recorder.apply(game, Action{ActionKind::Coup, 0, 2});
+
+    uint8_t buffer[sizeof(SnapshotBlob)];
+    CHECK(game.saveSnapshot(buffer, sizeof(buffer)) == sizeof(SnapshotBlob));
+    const GameOutcome saved = captureOutcome(game, 0);
+    const std::string turn = game.turn();
+
+    // Play on, then roll back
+    recorder.apply(game, Action{ActionKind::Gather, 1, NO_TARGET});
+    recorder.apply(game, Action{ActionKind::Gather, 0, NO_TARGET});
+    CHECK(captureOutcome(game, 0) != saved);
+    game.loadSnapshot(buffer, sizeof(buffer));
+    CHECK(captureOutcome(game, 0) == saved);
+    CHECK(game.turn() == turn);
+    CHECK(game.pendingCoupSeat() == 2);
+    CHECK(table.player(0).getLastAction() == "coup");
+    CHECK(table.player(1).getLastAction() == "gather");
+
+    // A game with the same seating accepts the blob, others are rejected without changes
+    Table copy({"A", "B", "C"}, {Role::Baron, Role::General, Role::Spy});
+    copy.getGame().loadSnapshot(buffer, sizeof(buffer));
+    CHECK(captureOutcome(copy.getGame(), 0) == saved);
+
+    Table other({"A", "B", "C"}, {Role::Baron, Role::Judge, Role::Spy});
+    CHECK_THROWS_AS(other.getGame().loadSnapshot(buffer, sizeof(buffer)), std::runtime_error);
+    CHECK(other.getGame().getBankCoins() == 100);
+    CHECK_THROWS_AS(game.loadSnapshot(buffer, sizeof(buffer) - 1), std::runtime_error);
+    CHECK_THROWS_AS(game.saveSnapshot(buffer, 8), std::invalid_argument);
+    buffer[4] = 99;   // Unknown version
+    CHECK_THROWS_AS(game.loadSnapshot(buffer, sizeof(buffer)), std::runtime_error);
+}
+
+TEST_CASE("Columnar results store answers filtered aggregate queries") {
+    const std::string path = "test_results.coupcols";
+    std::vector<GameResult> rows;
+    {
+        ResultsWriter writer(path, 7);    // Several small groups
+        ResultCollector collector;
+        for (uint64_t g = 0; g < 60; ++g) {
+            SimOptions options;
+            options.seed = gameSeed(13, g);
+            GameOutcome outcome = simulateGame(options, nullptr, &collector);
+            GameResult result = collector.result();
+            result.seed = options.seed;
+            CHECK(result.plies == outcome.plies);
+            CHECK(result.numPlayers == outcome.numPlayers);
+            rows.push_back(result);
+            writer.add(result);
+        }
+        writer.finish();
+    }
+
+    ResultsReader store(path);
+    REQUIRE(store.rowCount() == 60);
+    CHECK(store.groupCount() == 9);
+    GameResult last = store.row(59);
+    CHECK(last.seed == rows[59].seed);
+    CHECK(last.roleAt(0) == rows[59].roleAt(0));
+    CHECK(last.coups == rows[59].coups);
+    CHECK_THROWS_AS(store.row(60), std::out_of_range);
+
+    // Compare with a row-by-row computation
+    ResultsFilter filter;
+    filter.with(Role::General).decided();
+    ResultsSummary summary = queryResults(store, filter);
+    uint64_t games = 0, generalWins = 0, plies = 0;
+    const uint8_t general = static_cast<uint8_t>(Role::General);
+    for (const GameResult& r : rows) {
+        if (!(r.rolesPresent & (1u << general)) || r.winnerSeat == NO_CODE) continue;
+        games++;
+        plies += r.plies;
+        if (r.winnerRole == general) generalWins++;
+    }
+    CHECK(summary.games == games);
+    CHECK(summary.decided == games);
+    CHECK(summary.plies == plies);
+    CHECK(summary.gamesWithRole[general] == games);
+    CHECK(summary.winRate(Role::General) == doctest::Approx(games ? double(generalWins) / games : 0));
+    CHECK(queryResults(store, ResultsFilter().players(7)).games == 0);
+
+    // A group claiming more rows than fit before the index
+    {
+        std::ifstream in(path, std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        const uint64_t indexOffset = bytes.size() - 32 - 9 * 16;
+        std::memcpy(&bytes[bytes.size() - 32 - 16 + 8], &indexOffset, sizeof(indexOffset));
+        std::ofstream out("test_results_bad.coupcols", std::ios::binary);
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    }
+    CHECK_THROWS_AS(ResultsReader("test_results_bad.coupcols"), std::runtime_error);
+    std::remove("test_results_bad.coupcols");
+    std::remove(path.c_str());
+
+    CHECK_THROWS_AS(ResultsReader("test_coup.cpp"), std::runtime_error);
+}
+
+TEST_CASE("JSON-lines exporter writes one line per action with coin deltas") {
+    ReplayHeader header{42, {"Alice", "Bob", "Carol"}, {Role::Baron, Role::Spy, Role::Governor}};
+    Table table(header.names, header.roles);
+    Game& game = table.getGame();
+    const int bank = game.getBankCoins();
+    ReplayRecorder recorder(header);
+    recorder.apply(game, Action{ActionKind::Gather, 0});
+    recorder.apply(game, Action{ActionKind::Tax, 1});
+    recorder.apply(game, Action{ActionKind::Tax, 2});
+    recorder.apply(game, Action{ActionKind::BlockTax, 2, 1});
+    const std::vector<uint8_t>& replay = recorder.bytes();
+
+    const std::string path = "test_events.jsonl";
+    {
+        JsonlExporter exporter(path, ExportOptions{1, 1});
+        exporter.setGameId(5);
+        observeReplay(replay.data(), replay.size(), exporter);
+        CHECK(exporter.eventCount() == 4);
+    }
+    std::vector<std::string> lines;
+    std::ifstream in(path);
+    for (std::string line; std::getline(in, line);) lines.push_back(line);
+    REQUIRE(lines.size() == 4);
+    CHECK(lines[0] == "{\"game\":5,\"ply\":0,\"actor\":0,\"role\":\"Baron\",\"action\":\"gather\",\"target\":null,"
+                      "\"deltas\":[1,0,0],\"bank\":" + std::to_string(bank - 1) + "}");
+    CHECK(lines[3] == "{\"game\":5,\"ply\":3,\"actor\":2,\"role\":\"Governor\",\"action\":\"blockTax\",\"target\":1,"
+                      "\"deltas\":[0,-2,0],\"bank\":" + std::to_string(game.getBankCoins()) + "}");
+    std::remove(path.c_str());
+
+    // Sampling keeps or drops whole games, the same ones on every run
+    std::FILE* devNull = std::fopen("/dev/null", "wb");
+    REQUIRE(devNull != nullptr);
+    {
+        JsonlExporter sampled(devNull, ExportOptions{4, 1 << 12});
+        size_t kept = 0;
+        for (uint64_t id = 0; id < 64; ++id) {
+            const uint64_t before = sampled.eventCount();
+            observeReplay(replay.data(), replay.size(), sampled);
+            CHECK((sampled.eventCount() - before) % 4 == 0);
+            if (sampled.eventCount() > before) kept++;
+        }
+        CHECK(kept > 0);
+        CHECK(kept < 64);
+        CHECK(sampled.eventCount() == 4 * kept);
+    }
+    std::fclose(devNull);
+    CHECK_THROWS_AS(JsonlExporter(static_cast<std::FILE*>(nullptr)), std::invalid_argument);
+    CHECK_THROWS_AS(JsonlExporter(path, ExportOptions{0, 1}), std::invalid_argument);
+}
+
+TEST_CASE("Tournament resumed from a checkpoint matches an uninterrupted run") {
+    TournamentOptions options;
+    options.runSeed = 11;
+    options.games = 2000;
+    options.threads = 3;
+    TournamentReport reference = runTournament(options);
+    CHECK(reference.finished);
+    CHECK(reference.progress.summary.games == 2000);
+    CHECK(reference.checkpoints == 0);
+
+    const std::string path = "test_tournament.ckpt";
+    std::remove(path.c_str());
+    options.checkpointPath = path;
+    options.checkpointSeconds = 0;
+    options.threads = 2;
+    options.gamesLimit = 700;     // Killed after 700 games
+    TournamentReport first = runTournament(options);
+    CHECK_FALSE(first.finished);
+    CHECK(first.progress.nextGame == 700);
+    CHECK(first.checkpoints >= 1);
+
+    TournamentProgress saved;
+    REQUIRE(loadCheckpoint(path, options, saved));
+    CHECK(saved == first.progress);
+
+    // Nothing is played once stop is requested
+    std::atomic<bool> stop{true};
+    TournamentReport stopped = runTournament(options, &stop);
+    CHECK(stopped.played == 0);
+    CHECK(stopped.progress == first.progress);
+
+    options.gamesLimit = 0;
+    options.threads = 3;
+    TournamentReport resumed = runTournament(options);
+    CHECK(resumed.resumedFrom == 700);
+    CHECK(resumed.played == 1300);
+    CHECK(resumed.finished);
+    CHECK(resumed.progress == reference.progress);
+
+    // A checkpoint is only resumed by the run that wrote it
+    TournamentOptions other = options;
+    other.runSeed = 12;
+    CHECK_THROWS_AS(runTournament(other), std::runtime_error);
+    {
+        std::FILE* file = std::fopen(path.c_str(), "r+b");
+        REQUIRE(file != nullptr);
+        std::fseek(file, 64, SEEK_SET);
+        std::fputc(0x5A, file);
+        std::fclose(file);
+    }
+    CHECK_THROWS_AS(loadCheckpoint(path, options, saved), std::runtime_error);
+    std::remove(path.c_str());
+    CHECK_FALSE(loadCheckpoint(path, options, saved));
+}
+
+namespace {
+
+// Opens a connection to a server listening on the loopback
+int connectTo(const GameServer& server) {
+    const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(server.port());
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    REQUIRE(::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0);
+    return fd;
+}
+
+// Sends text commands and polls every shard of the server until every reply line arrived
+std::string request(GameServer& server, int fd, const std::string& lines, size_t replies) {
+    REQUIRE(::send(fd, lines.data(), lines.size(), 0) == static_cast<ssize_t>(lines.size()));
+    std::string received;
+    char buffer[4096];
+    while (static_cast<size_t>(std::count(received.begin(), received.end(), '\n')) < replies) {
+        server.poll(1);
+        const ssize_t n = ::recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (n > 0) received.append(buffer, static_cast<size_t>(n));
+    }
+    return received;
+}
+
+} // namespace
+
+TEST_CASE("Game server hosts tables over the text protocol") {
+    TableRegistry registry;
+    const uint32_t id = registry.create(2, 5);
+    CHECK(registry.join(id, 10, "Ann") == 0);
+    CHECK_THROWS_AS(registry.act(id, 10, Action{ActionKind::Gather, 0}), std::runtime_error);   // Not started
+    CHECK_THROWS_AS(registry.join(id, 11, "Ann"), std::invalid_argument);
+    CHECK(registry.join(id, 11, "Ben") == 1);
+    CHECK_THROWS_AS(registry.join(id, 12, "Cid"), std::runtime_error);
+    CHECK_THROWS_AS(registry.act(id, 11, Action{ActionKind::Gather, 0}), std::runtime_error);   // Seat 0 is Ann's
+    registry.act(id, 10, Action{ActionKind::Gather, 0});
+    TableStatus status = registry.status(id);
+    CHECK(status.started);
+    CHECK(status.turn == 1);
+    CHECK(status.coins[0] == 1);
+    CHECK(status.plies == 1);
+    registry.leave(id, 10);
+    CHECK(registry.size() == 1);
+    registry.leave(id, 11);
+    CHECK(registry.size() == 0);
+    CHECK_THROWS_AS(registry.status(id), std::runtime_error);
+
+    GameServer server;
+    REQUIRE(server.port() != 0);
+    const int fd = connectTo(server);
+
+    CHECK(request(server, fd, "PING\n", 1) == "PONG\n");
+    CHECK(server.stats().connections == 1);
+    CHECK(request(server, fd, "CREATE 2 7\n", 1) == "OK 1\n");
+    const std::string roleA = roleName(server.tables().roleAt(1, 0));
+    const std::string roleB = roleName(server.tables().roleAt(1, 1));
+    CHECK(request(server, fd, "JOIN 1 A\r\nJOIN 1 B\n", 2) == "OK 0 " + roleA + "\nOK 1 " + roleB + "\n");
+    CHECK(request(server, fd, "ACT 1 0 tax\n", 1) == "OK 1\n");
+    CHECK(request(server, fd, "ACT 1 1 gather\nSTATE 1\n", 2).find("STATE 1 playing 2/2 turn=0") != std::string::npos);
+    CHECK(request(server, fd, "ACT 1 0 coup 1\n", 1).rfind("ERR ", 0) == 0);
+    CHECK(request(server, fd, "ACT 1 0 fly\nNOPE\nCREATE 9\n", 3) ==
+          "ERR Unknown action: fly\nERR Unknown command: NOPE\nERR A table needs between 2 and 6 players.\n");
+    CHECK(server.stats().errors == 4);
+
+    ::close(fd);
+    for (int i = 0; i < 10 && server.stats().connections > 0; ++i) server.poll(10);
+    CHECK(server.stats().connections == 0);
+    CHECK(server.tables().size() == 0);
+}
+
+TEST_CASE("Binary wire protocol batches messages and pushes deltas") {
+    std::string bytes;
+    FrameBuilder builder(bytes);
+    for (uint32_t i = 0; i < 3; ++i) {
+        ActMessage& act = builder.add<ActMessage>();
+        act.type = static_cast<uint8_t>(MessageType::Act);
+        act.kind = static_cast<uint8_t>(ActionKind::Gather);
+        act.tag = i;
+        act.table = 7;
+    }
+    CHECK(builder.pending() == 3);
+    builder.finish();
+    REQUIRE(bytes.size() == sizeof(FrameHeader) + 3 * sizeof(ActMessage));
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(bytes.data());
+    FrameView frame;
+    CHECK(FrameView::parse(data, bytes.size() - 1, frame) == 0);          // Incomplete
+    REQUIRE(FrameView::parse(data, bytes.size(), frame) == bytes.size());
+    CHECK(frame.count() == 3);
+    uint32_t tags = 0;
+    for (const FrameView::Message& message : frame) {
+        CHECK(message.type == MessageType::Act);
+        CHECK(message.as<ActMessage>().table == 7);
+        tags += message.as<ActMessage>().tag;
+    }
+    CHECK(tags == 3);
+    std::string broken = bytes;
+    broken[sizeof(FrameHeader) + sizeof(ActMessage)] = 0x7F;             // Unknown message type
+    CHECK_THROWS_AS(FrameView::parse(reinterpret_cast<const uint8_t*>(broken.data()), broken.size(), frame),
+                    std::runtime_error);
+    broken = bytes;
+    broken[0] = 'A';
+    CHECK_THROWS_AS(FrameView::parse(reinterpret_cast<const uint8_t*>(broken.data()), broken.size(), frame),
+                    std::runtime_error);
+
+    GameServer server;
+    const int fd = connectTo(server);
+
+    // Sends a frame and runs the server until the given number of messages arrived
+    std::string in;
+    auto exchange = [&](const std::string& frameBytes, size_t count) {
+        REQUIRE(::send(fd, frameBytes.data(), frameBytes.size(), 0) == static_cast<ssize_t>(frameBytes.size()));
+        std::vector<std::string> messages;
+        char buffer[4096];
+        while (messages.size() < count) {
+            server.poll(10);
+            const ssize_t n = ::recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+            if (n > 0) in.append(buffer, static_cast<size_t>(n));
+            size_t offset = 0;
+            FrameView received;
+            for (size_t size; (size = FrameView::parse(reinterpret_cast<const uint8_t*>(in.data()) + offset,
+                                                       in.size() - offset, received)) != 0;
+                 offset += size) {
+                for (const FrameView::Message& message : received) {
+                    messages.emplace_back(reinterpret_cast<const char*>(message.data), messageSize(*message.data));
+                }
+            }
+            in.erase(0, offset);
+        }
+        return messages;
+    };
+    auto reply = [](const std::string& message) { return *reinterpret_cast<const ReplyMessage*>(message.data()); };
+
+    // The Create follows a 12-byte message, so its seed is not 8-byte aligned in the frame
+    std::string out;
+    FrameBuilder frames(out);
+    TableMessage& missing = frames.add<TableMessage>();
+    missing.type = static_cast<uint8_t>(MessageType::State);
+    missing.tag = 39;
+    missing.table = 99;
+    CreateMessage create{};
+    create.type = static_cast<uint8_t>(MessageType::Create);
+    create.players = 2;
+    create.tag = 40;
+    create.seed = 7;
+    frames.add(create);
+    frames.finish();
+    std::vector<std::string> replies = exchange(out, 2);
+    CHECK(replies[0][1] == static_cast<char>(WireCode::Rejected));
+    REQUIRE(replies[1][0] == static_cast<char>(MessageType::Reply));
+    CHECK(reply(replies[1]).tag == 40);
+    const uint32_t table = reply(replies[1]).value;
+
+    out.clear();
+    for (const char* name : {"Ann", "Ben"}) {
+        JoinMessage& join = frames.add<JoinMessage>();
+        join.type = static_cast<uint8_t>(MessageType::Join);
+        join.nameLength = 3;
+        join.table = table;
+        std::copy(name, name + 3, join.name);
+    }
+    frames.finish();
+    replies = exchange(out, 2);
+    CHECK(reply(replies[0]).value == 0);
+    CHECK(reply(replies[1]).value == 1);
+    CHECK(reply(replies[1]).extra == static_cast<uint8_t>(server.tables().roleAt(table, 1)));
+
+    // Three actions in one frame: two legal, one out of turn; each legal one is followed by its Delta
+    out.clear();
+    const Action actions[] = {{ActionKind::Tax, 0}, {ActionKind::Gather, 1}, {ActionKind::Gather, 1}};
+    for (uint32_t i = 0; i < 3; ++i) {
+        ActMessage& act = frames.add<ActMessage>();
+        act.type = static_cast<uint8_t>(MessageType::Act);
+        act.kind = static_cast<uint8_t>(actions[i].kind);
+        act.seat = actions[i].actor;
+        act.target = NO_TARGET;
+        act.tag = i;
+        act.table = table;
+    }
+    TableMessage& state = frames.add<TableMessage>();
+    state.type = static_cast<uint8_t>(MessageType::State);
+    state.tag = 9;
+    state.table = table;
+    frames.finish();
+    replies = exchange(out, 6);
+    REQUIRE(replies.size() == 6);
+    CHECK(reply(replies[0]).code == static_cast<uint8_t>(WireCode::Ok));
+    CHECK(reply(replies[0]).value == 1);
+    const DeltaMessage delta = *reinterpret_cast<const DeltaMessage*>(replies[1].data());
+    CHECK(delta.type == static_cast<uint8_t>(MessageType::Delta));
+    CHECK(delta.kind == static_cast<uint8_t>(ActionKind::Tax));
+    CHECK(delta.changedMask == 1);
+    CHECK(delta.coins[0] == 2);
+    CHECK(delta.turn == 1);
+    CHECK(reply(replies[2]).value == 2);
+    CHECK(reinterpret_cast<const DeltaMessage*>(replies[3].data())->coins[1] == 1);
+    CHECK(reinterpret_cast<const DeltaMessage*>(replies[3].data())->changedMask == 2);
+    CHECK(reply(replies[4]).code == static_cast<uint8_t>(WireCode::Rejected));
+    CHECK(reply(replies[4]).tag == 2);
+    const StatusMessage status = *reinterpret_cast<const StatusMessage*>(replies[5].data());
+    CHECK(status.tag == 9);
+    CHECK(status.plies == 2);
+    CHECK(status.coins[1] == 1);
+    CHECK((status.flags & STATUS_STARTED) != 0);
+    CHECK(server.stats().errors == 2);
+    CHECK(server.stats().deltas == 2);
+
+    ::close(fd);
+    for (int i = 0; i < 10 && server.stats().connections > 0; ++i) server.poll(10);
+    CHECK(server.tables().size() == 0);
+}
+
+TEST_CASE("Sharded server forwards commands to the shard owning the table") {
+    SpscQueue<int> queue(3);
+    CHECK(queue.capacity() == 4);
+    for (int i = 0; i < 4; ++i) CHECK(queue.push(int(i)));
+    CHECK_FALSE(queue.push(4));
+    int value = -1;
+    for (int i = 0; i < 4; ++i) {
+        REQUIRE(queue.pop(value));
+        CHECK(value == i);
+    }
+    CHECK_FALSE(queue.pop(value));
+
+    ServerOptions options;
+    options.shards = 3;
+    GameServer server(options);
+    CHECK(server.shardCount() == 3);
+    CHECK(server.shardOf(1) == 0);
+    CHECK(server.shardOf(2) == 1);
+    CHECK(server.shardOf(6) == 2);
+    int fds[3];
+    for (int& fd : fds) {       // Dealt out to shards 0, 1 and 2
+        fd = connectTo(server);
+    }
+
+    CHECK(request(server, fds[1], "CREATE 2 5\n", 1) == "OK 2\n");                  // Created on shard 1
+    const std::string roleA = roleName(server.tables(1).roleAt(2, 0));
+    const std::string roleB = roleName(server.tables(1).roleAt(2, 1));
+    // Remote and local commands of one connection are answered in order
+    CHECK(request(server, fds[0], "JOIN 2 Ann\nPING\nJOIN 2 Bob\nCREATE 2 3\nSTATE 2\n", 5) ==
+          "OK 0 " + roleA + "\nPONG\nOK 1 " + roleB + "\nOK 1\nSTATE 2 playing 2/2 turn=0 bank=100 coins=0,0 alive=11 "
+          "winner=-1 plies=0\n");
+    CHECK(request(server, fds[0], "ACT 2 0 gather\nACT 2 0 gather\n", 2).rfind("OK 1\nERR ", 0) == 0);
+    CHECK(request(server, fds[1], "ACT 2 1 gather\n", 1).rfind("ERR This seat is not yours.", 0) == 0);
+
+    // A binary client of shard 2 plays at table 1 of shard 0 and gets its deltas
+    std::string out;
+    FrameBuilder frames(out);
+    for (const char* name : {"Cy", "Di"}) {
+        JoinMessage& join = frames.add<JoinMessage>();
+        join.type = static_cast<uint8_t>(MessageType::Join);
+        join.nameLength = 2;
+        join.table = 1;
+        std::copy(name, name + 2, join.name);
+    }
+    ActMessage& act = frames.add<ActMessage>();
+    act.type = static_cast<uint8_t>(MessageType::Act);
+    act.kind = static_cast<uint8_t>(ActionKind::Tax);
+    act.target = NO_TARGET;
+    act.tag = 77;
+    act.table = 1;
+    frames.finish();
+    REQUIRE(::send(fds[2], out.data(), out.size(), 0) == static_cast<ssize_t>(out.size()));
+    std::vector<MessageType> types;
+    std::string in;
+    uint32_t tag = 0;
+    int16_t coins = 0;
+    while (types.size() < 4) {
+        server.poll(1);
+        char buffer[4096];
+        const ssize_t n = ::recv(fds[2], buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (n > 0) in.append(buffer, static_cast<size_t>(n));
+        FrameView frame;
+        size_t offset = 0;
+        for (size_t size; (size = FrameView::parse(reinterpret_cast<const uint8_t*>(in.data()) + offset,
+                                                   in.size() - offset, frame)) != 0;
+             offset += size) {
+            for (const FrameView::Message& message : frame) {
+                types.push_back(message.type);
+                if (message.type == MessageType::Reply) tag = message.as<ReplyMessage>().tag;
+                if (message.type == MessageType::Delta) coins = message.as<DeltaMessage>().coins[0];
+            }
+        }
+        in.erase(0, offset);
+    }
+    CHECK(types == std::vector<MessageType>{MessageType::Reply, MessageType::Reply, MessageType::Reply, MessageType::Delta});
+    CHECK(tag == 77);
+    CHECK(coins == 2);
+
+    // Disconnecting releases the seats held on other shards
+    CHECK(server.tableCount() == 2);
+    for (int fd : fds) ::close(fd);
+    for (int i = 0; i < 20 && server.stats().connections > 0; ++i) server.poll(1);
+    server.poll(1);
+    CHECK(server.stats().connections == 0);
+    CHECK(server.stats().accepted == 3);
+    CHECK(server.tableCount() == 0);
+}
+
+TEST_CASE("Spectators share one encoded frame per action and get keyframes") {
+    ServerOptions options;
+    options.shards = 2;
+    options.keyframeInterval = 2;
+    GameServer server(options);
+    int fds[4];
+    for (int& fd : fds) {       // Dealt out to shards 0, 1, 0 and 1
+        fd = connectTo(server);
+    }
+
+    // Polls every shard until a connection received the given number of lines or binary messages
+    std::string pending[4];
+    auto receiveLines = [&](int at, size_t lines) {
+        char buffer[4096];
+        while (static_cast<size_t>(std::count(pending[at].begin(), pending[at].end(), '\n')) < lines) {
+            server.poll(1);
+            const ssize_t n = ::recv(fds[at], buffer, sizeof(buffer), MSG_DONTWAIT);
+            if (n > 0) pending[at].append(buffer, static_cast<size_t>(n));
+        }
+        return std::exchange(pending[at], std::string());
+    };
+    auto receiveMessages = [&](int at, size_t count) {
+        std::vector<std::string> messages;
+        char buffer[4096];
+        while (messages.size() < count) {
+            server.poll(1);
+            const ssize_t n = ::recv(fds[at], buffer, sizeof(buffer), MSG_DONTWAIT);
+            if (n > 0) pending[at].append(buffer, static_cast<size_t>(n));
+            size_t offset = 0;
+            FrameView frame;
+            for (size_t size; (size = FrameView::parse(reinterpret_cast<const uint8_t*>(pending[at].data()) + offset,
+                                                       pending[at].size() - offset, frame)) != 0;
+                 offset += size) {
+                for (const FrameView::Message& message : frame) {
+                    messages.emplace_back(reinterpret_cast<const char*>(message.data), messageSize(*message.data));
+                }
+            }
+            pending[at].erase(0, offset);
+        }
+        return messages;
+    };
+    auto sendTableMessage = [&](int at, MessageType type, uint32_t table, uint32_t tag) {
+        std::string out;
+        FrameBuilder frames(out);
+        TableMessage& message = frames.add<TableMessage>();
+        message.type = static_cast<uint8_t>(type);
+        message.tag = tag;
+        message.table = table;
+        frames.finish();
+        REQUIRE(::send(fds[at], out.data(), out.size(), 0) == static_cast<ssize_t>(out.size()));
+    };
+
+    const std::string lines = "CREATE 2 5\n";
+    REQUIRE(::send(fds[0], lines.data(), lines.size(), 0) == static_cast<ssize_t>(lines.size()));
+    CHECK(receiveLines(0, 1) == "OK 1\n");                                 // Table 1 lives on shard 0
+    for (int at = 1; at < 4; ++at) {
+        sendTableMessage(at, MessageType::Watch, 1, 10 + at);
+        const std::vector<std::string> answer = receiveMessages(at, 1);
+        const StatusMessage& status = *reinterpret_cast<const StatusMessage*>(answer[0].data());
+        CHECK(status.type == static_cast<uint8_t>(MessageType::Status));
+        CHECK(status.tag == static_cast<uint32_t>(10 + at));
+        CHECK(status.joined == 0);
+    }
+    CHECK(server.stats().spectators == 3);
+    sendTableMessage(1, MessageType::Watch, 99, 5);
+    CHECK(receiveMessages(1, 1)[0][1] == static_cast<char>(WireCode::Rejected));
+
+    // Watching takes no seat: the text client still fills the table
+    const std::string play = "JOIN 1 Ann\nJOIN 1 Ben\nACT 1 0 gather\nACT 1 1 gather\n";
+    REQUIRE(::send(fds[0], play.data(), play.size(), 0) == static_cast<ssize_t>(play.size()));
+    CHECK(receiveLines(0, 4).find("OK 2\n") != std::string::npos);
+    for (int at = 1; at < 4; ++at) {
+        const std::vector<std::string> messages = receiveMessages(at, 3);
+        const DeltaMessage& first = *reinterpret_cast<const DeltaMessage*>(messages[0].data());
+        const DeltaMessage& second = *reinterpret_cast<const DeltaMessage*>(messages[1].data());
+        const StatusMessage& keyframe = *reinterpret_cast<const StatusMessage*>(messages[2].data());
+        CHECK(first.type == static_cast<uint8_t>(MessageType::Delta));
+        CHECK(first.plies == 1);
+        CHECK(first.changedMask == 1);
+        CHECK(second.plies == 2);
+        CHECK(second.coins[1] == 1);
+        CHECK(keyframe.type == static_cast<uint8_t>(MessageType::Keyframe));
+        CHECK(keyframe.plies == 2);
+        CHECK(keyframe.joined == 2);
+        CHECK(keyframe.coins[0] == 1);
+    }
+    // Each frame was encoded once, with one keyframe, and queued on three connections
+    CHECK(server.stats().keyframes == 1);
+    CHECK(server.stats().spectatorFrames == 6);
+    CHECK(server.stats().deltas == 0);
+
+    // A spectator that leaves stops getting frames and does not close the table
+    sendTableMessage(3, MessageType::Leave, 1, 6);
+    CHECK(receiveMessages(3, 1)[0][1] == static_cast<char>(WireCode::Ok));
+    CHECK(server.stats().spectators == 2);
+    REQUIRE(::send(fds[0], "ACT 1 0 gather\n", 15, 0) == 15);
+    CHECK(receiveLines(0, 1) == "OK 3\n");
+    CHECK(receiveMessages(1, 1)[0][0] == static_cast<char>(MessageType::Delta));
+    CHECK(receiveMessages(2, 1)[0][0] == static_cast<char>(MessageType::Delta));
+    for (int i = 0; i < 5; ++i) server.poll(1);
+    char byte;
+    CHECK(::recv(fds[3], &byte, 1, MSG_DONTWAIT) < 0);
+    CHECK(server.tableCount() == 1);
+
+    // A rejected Watch subscribes to nothing, even once a table gets that id
+    sendTableMessage(3, MessageType::Watch, 3, 7);
+    CHECK(receiveMessages(3, 1)[0][1] == static_cast<char>(WireCode::Rejected));
+    const std::string next = "CREATE 2 6\nJOIN 3 Cy\nJOIN 3 Di\n";
+    REQUIRE(::send(fds[0], next.data(), next.size(), 0) == static_cast<ssize_t>(next.size()));
+    CHECK(receiveLines(0, 3).find("OK 3\n") == 0);                           // Table 3 lives on shard 0 too
+    sendTableMessage(1, MessageType::Watch, 3, 8);
+    CHECK(receiveMessages(1, 1)[0][1] == static_cast<char>(WireCode::Ok));
+    REQUIRE(::send(fds[0], "ACT 3 0 gather\n", 15, 0) == 15);
+    CHECK(receiveLines(0, 1) == "OK 1\n");
+    CHECK(receiveMessages(1, 1)[0][0] == static_cast<char>(MessageType::Delta));
+    for (int i = 0; i < 5; ++i) server.poll(1);
+    CHECK(::recv(fds[3], &byte, 1, MSG_DONTWAIT) < 0);
+
+    for (int fd : fds) ::close(fd);
+    for (int i = 0; i < 20 && server.stats().connections > 0; ++i) server.poll(1);
+    server.poll(1);
+    CHECK(server.stats().spectators == 0);
+    CHECK(server.tableCount() == 0);
+}
+
+TEST_CASE("Output queues pause fast producers and drop clients over the limit") {
+    ServerOptions options;
+    options.outputLowWater = 2 << 10;
+    options.outputHighWater = 8 << 10;
+    options.outputLimit = 32 << 10;
+    options.socketSendBuffer = 4096;
+    options.keyframeInterval = 1;
+    ServerOptions unordered;
+    unordered.outputLowWater = 4 << 10;
+    unordered.outputHighWater = 2 << 10;
+    CHECK_THROWS_AS(GameServer{unordered}, std::invalid_argument);
+    GameServer server(options);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(server.port());
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    auto open = [&] {
+        const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        const int small = 4096;
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &small, sizeof(small));
+        REQUIRE(::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0);
+        return fd;
+    };
+    std::string received;
+    char buffer[1 << 16];
+    auto readLines = [&](int fd, size_t lines) {
+        while (static_cast<size_t>(std::count(received.begin(), received.end(), '\n')) < lines) {
+            server.poll(1);
+            const ssize_t n = ::recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+            if (n > 0) received.append(buffer, static_cast<size_t>(n));
+        }
+        return std::exchange(received, std::string());
+    };
+    std::string statusLines;
+    for (int i = 0; i < 1000; ++i) statusLines += "STATE 1\n";
+
+    // A client sending commands without reading its replies is no longer read, nor executed
+    const int fast = open();
+    REQUIRE(::send(fast, "CREATE 2\n", 9, 0) == 9);
+    for (int i = 0; i < 5; ++i) server.poll(1);
+    for (int burst = 0; burst < 6; ++burst) {
+        REQUIRE(::send(fast, statusLines.data(), statusLines.size(), 0) == static_cast<ssize_t>(statusLines.size()));
+        for (int i = 0; i < 5; ++i) server.poll(1);
+    }
+    CHECK(server.stats().pausedConnections == 1);
+    CHECK(server.stats().pauses == 1);
+    CHECK(server.stats().bytesInFlight > options.outputLowWater);
+    CHECK(server.stats().bytesInFlight <= options.outputHighWater + 128);
+    CHECK(server.stats().queuedSlices == 1);
+    CHECK(server.stats().commands < 1000);
+    // Once it reads, the server resumes and answers everything
+    CHECK(readLines(fast, 6001).rfind("OK 1\nSTATE 1 waiting 0/2", 0) == 0);
+    for (int i = 0; i < 5; ++i) server.poll(1);
+    CHECK(server.stats().commands == 6001);
+    CHECK(server.stats().pausedConnections == 0);
+    CHECK(server.stats().bytesInFlight == 0);
+    CHECK(server.stats().queuedSlices == 0);
+    CHECK(server.stats().writes < server.stats().commands);
+    CHECK(server.stats().overflows == 0);
+
+    // A spectator that stops reading is dropped once the frames of its tables go over the limit
+    constexpr uint32_t GAMES = 100;
+    std::string creates;
+    for (uint32_t game = 0; game < GAMES; ++game) creates += "CREATE 2 " + std::to_string(game + 1) + "\n";
+    REQUIRE(::send(fast, creates.data(), creates.size(), 0) == static_cast<ssize_t>(creates.size()));
+    std::istringstream created(readLines(fast, GAMES));
+    std::vector<uint32_t> tables;
+    for (std::string line; std::getline(created, line);) tables.push_back(static_cast<uint32_t>(std::stoul(line.substr(3))));
+    const int spectator = open();
+    std::string watch;
+    FrameBuilder frames(watch);
+    for (uint32_t table : tables) {
+        TableMessage& message = frames.add<TableMessage>();
+        message.type = static_cast<uint8_t>(MessageType::Watch);
+        message.table = table;
+    }
+    frames.finish();
+    REQUIRE(::send(spectator, watch.data(), watch.size(), 0) == static_cast<ssize_t>(watch.size()));
+    while (server.stats().spectators < GAMES) server.poll(1);
+    SplitMix64 rng(5);
+    for (size_t game = 0; game < GAMES && server.stats().overflows == 0; ++game) {
+        const std::string table = std::to_string(tables[game]);
+        const std::string joins = "JOIN " + table + " A\nJOIN " + table + " B\n";
+        REQUIRE(::send(fast, joins.data(), joins.size(), 0) == static_cast<ssize_t>(joins.size()));
+        std::istringstream replies(readLines(fast, 2));
+        std::vector<Role> roles;
+        for (std::string line; std::getline(replies, line);) roles.push_back(parseRole(line.substr(line.rfind(' ') + 1)));
+        Table copy({"A", "B"}, roles);
+        std::string acts;
+        size_t plies = 0;
+        Action action;
+        while (plies < 200 && captureOutcome(copy.getGame(), plies).winner == NO_SEAT &&
+               chooseBotAction(copy.getGame(), rng, action)) {
+            applyAction(copy.getGame(), action);
+            acts += "ACT " + table + ' ' + std::to_string(action.actor) + ' ' + actionName(action.kind);
+            if (actionHasTarget(action.kind)) acts += ' ' + std::to_string(action.target);
+            acts += '\n';
+            plies++;
+        }
+        REQUIRE(::send(fast, acts.data(), acts.size(), 0) == static_cast<ssize_t>(acts.size()));
+        readLines(fast, plies);
+    }
+    CHECK(server.stats().pauses == 2);
+    CHECK(server.stats().overflows == 1);
+    CHECK(server.stats().connections == 1);
+    CHECK(server.stats().spectators == 0);
+    CHECK(server.stats().bytesInFlight == 0);
+    CHECK(::recv(spectator, buffer, sizeof(buffer), 0) > 0);                 // What was sent before the close
+    ::close(spectator);
+    ::close(fast);
+    for (int i = 0; i < 10 && server.stats().connections > 0; ++i) server.poll(1);
+}
+
+TEST_CASE("Load generator plays complete games against a live server") {
+    LatencyHistogram histogram;
+    for (uint64_t micros : {3, 3, 100, 1000, 5000}) histogram.record(micros);
+    CHECK(histogram.count() == 5);
+    CHECK(histogram.max() == 5000);
+    CHECK(histogram.percentile(0.0) == 3);
+    CHECK(histogram.percentile(0.5) >= 100);
+    CHECK(histogram.percentile(0.5) < 113);                                  // Buckets are at most 12.5% wide
+    CHECK(histogram.percentile(1.0) == 5000);
+    for (size_t bucket = 1; bucket < 100; ++bucket) {
+        CHECK(LatencyHistogram::bucketLow(bucket) == LatencyHistogram::bucketHigh(bucket - 1));
+    }
+
+    CHECK(parsePlayerMix("4") == PlayerMix{0, 0, 1, 0, 0});
+    CHECK(parsePlayerMix("2:3,6:0.5") == PlayerMix{3, 0, 0, 0, 0.5});
+    CHECK_THROWS_AS(parsePlayerMix("7:1"), std::invalid_argument);
+    CHECK_THROWS_AS(parsePlayerMix("2:0"), std::invalid_argument);
+    CHECK(parseThinkTime("none").kind == ThinkTime::Kind::None);
+    const ThinkTime uniform = parseThinkTime("uniform:5-15");
+    CHECK(uniform.meanMs == 10);
+    const ThinkTime exponential = parseThinkTime("exp:4");
+    CHECK(exponential.maxMs == 80);
+    SplitMix64 rng(3);
+    for (int i = 0; i < 100; ++i) {
+        const uint64_t micros = uniform.sample(rng);
+        CHECK(micros >= 5000);
+        CHECK(micros <= 15000);
+        CHECK(exponential.sample(rng) <= 80000);
+    }
+    CHECK_THROWS_AS(parseThinkTime("uniform:9-1"), std::invalid_argument);
+    CHECK_THROWS_AS(parseBotPolicy("smart"), std::invalid_argument);
+
+    // The greedy bot launches a coup on the richest opponent when it can
+    Table table({"Ann", "Ben", "Cid"}, {Role::Baron, Role::Governor, Role::Judge});
+    Game& game = table.getGame();
+    for (int round = 0; round < 4; ++round) {
+        applyAction(game, Action{ActionKind::Tax, 0});
+        applyAction(game, Action{ActionKind::Tax, 1});
+        applyAction(game, Action{ActionKind::Gather, 2});
+    }
+    Action action;
+    REQUIRE(chooseGreedyAction(game, rng, action));
+    CHECK(action.kind == ActionKind::Coup);
+    CHECK(action.target == 1);
+
+    ServerOptions serverOptions;
+    serverOptions.shards = 2;
+    GameServer server(serverOptions);
+    std::atomic<bool> stop{false};
+    std::thread serving([&] { server.run(stop); });
+    LoadOptions options;
+    options.port = server.port();
+    options.connections = 24;
+    options.threads = 2;
+    options.seconds = 30;
+    options.gamesLimit = 30;
+    options.playerMix = parsePlayerMix("2:1,3:1,6:1");
+    options.policy = BotPolicy::Mixed;
+    const LoadReport report = runLoad(options);
+    stop = true;
+    serving.join();
+    CHECK(report.errors == 0);
+    CHECK(report.games >= 30);
+    CHECK(report.gamesBySize[0] + report.gamesBySize[1] + report.gamesBySize[4] == report.games);
+    CHECK(report.gamesBySize[2] + report.gamesBySize[3] == 0);
+    CHECK(report.actLatency.count() == report.actions);
+    CHECK(report.setupLatency.count() >= report.games);
+    CHECK(server.stats().errors == 0);
+}
+
+TEST_CASE("Turn flow coroutine waits for reactions from pooled frames") {
+    const FramePool::Stats before = FramePool::stats();
+    Table table({"Ann", "Ben", "Cid"}, {Role::Baron, Role::Governor, Role::Judge});
+    Game& game = table.getGame();
+    {
+        TurnFlow flow(table, true);
+        const FramePool::Stats running = FramePool::stats();
+        CHECK(running.liveFrames == before.liveFrames + 1);
+        CHECK(running.liveBytes - before.liveBytes <= 512);
+
+        CHECK(flow.offer(Action{ActionKind::Tax, 0}));
+        CHECK(flow.reacting());
+        CHECK(flow.waitingFor() == 0b010);                                    // The Governor
+        CHECK_THROWS_AS(flow.offer(Action{ActionKind::Gather, 1}), std::runtime_error);
+        CHECK_THROWS_AS(flow.offer(Action{ActionKind::Pass, 2}), std::runtime_error);
+        CHECK_FALSE(flow.offer(Action{ActionKind::Pass, 1}));                 // Declined, nothing applied
+        CHECK_FALSE(flow.reacting());
+        CHECK(game.coinsAt(0) == 2);
+
+        CHECK(flow.offer(Action{ActionKind::Gather, 1}));
+        CHECK(flow.offer(Action{ActionKind::Tax, 2}));
+        CHECK(flow.waitingFor() == 0b010);
+        CHECK_THROWS_AS(flow.offer(Action{ActionKind::BlockTax, 1, 0}), std::runtime_error);   // Not the tax
+        CHECK(flow.offer(Action{ActionKind::BlockTax, 1, 2}));
+        CHECK_FALSE(flow.reacting());
+        CHECK(game.coinsAt(2) == 0);
+        CHECK_THROWS_AS(flow.offer(Action{ActionKind::Gather, 1}), std::runtime_error);       // Engine: not Ben's turn
+        CHECK(flow.offer(Action{ActionKind::Gather, 0}));
+    }
+    const FramePool::Stats after = FramePool::stats();
+    CHECK(after.liveFrames == before.liveFrames);
+    {
+        Table other({"Ann", "Ben"}, {Role::Governor, Role::Governor});
+        TurnFlow flow(other, false);                                          // No reaction windows
+        CHECK(flow.offer(Action{ActionKind::Tax, 0}));
+        CHECK_FALSE(flow.reacting());
+        CHECK(flow.offer(Action{ActionKind::Gather, 1}));
+    }
+    CHECK(FramePool::stats().systemAllocations == after.systemAllocations);  // The frame was reused
+
+    TableRegistry registry;
+    const uint32_t id = registry.create(2, 11, true);
+    registry.join(id, 1, "Ann");
+    registry.join(id, 1, "Ben");
+    CHECK_FALSE(registry.status(id).reacting);
+}
+
+TEST_CASE("Timer wheel plays the default move of players who run out of time") {
+    TimerWheel wheel(100);
+    std::vector<uint64_t> expired;
+    const TimerWheel::TimerId soon = wheel.schedule(105, 1);
+    wheel.schedule(100 + 5000, 2);                                            // Level 2
+    const TimerWheel::TimerId cancelled = wheel.schedule(100 + 300000, 3);    // Level 3
+    wheel.schedule(100 + (uint64_t(1) << 30), 4);                             // Beyond the levels
+    wheel.schedule(50, 5);                                                    // Already past
+    CHECK(wheel.size() == 5);
+    CHECK(wheel.nextEvent() == 100);
+    CHECK(wheel.advance(104, expired) == 1);
+    CHECK(expired == std::vector<uint64_t>{5});
+    CHECK(wheel.nextEvent() == 105);
+    CHECK(wheel.cancel(cancelled));
+    CHECK_FALSE(wheel.cancel(cancelled));
+    CHECK(wheel.advance(5099, expired) == 1);                                 // Only the first one
+    CHECK_FALSE(wheel.cancel(soon));                                          // Expired already
+    CHECK(wheel.advance(5100, expired) == 1);
+    CHECK(wheel.advance(100 + (uint64_t(1) << 30) - 1, expired) == 0);
+    CHECK(wheel.advance(100 + (uint64_t(1) << 30), expired) == 1);
+    CHECK(expired == std::vector<uint64_t>{5, 1, 2, 4});
+    CHECK(wheel.size() == 0);
+    CHECK(wheel.nextEvent() == TimerWheel::NO_EVENT);
+
+    // A Governor at seat 0 may block the tax of seat 1
+    uint64_t seed = 1;
+    for (;; ++seed) {
+        SplitMix64 rng(seed);
+        if (drawRoles(rng, 3)[0] == Role::Governor) break;
+    }
+    ServerOptions options;
+    options.turnTimeoutMs = 100;
+    options.reactionWindowMs = 20;
+    GameServer server(options);
+    const int fd = connectTo(server);
+
+    CHECK(request(server, fd, "CREATE 3 " + std::to_string(seed) + " react\nJOIN 1 A\nJOIN 1 B\n", 3).rfind("OK 1\n", 0) == 0);
+    CHECK(server.stats().deadlines == 0);                                     // Still waiting for a player
+    const auto started = std::chrono::steady_clock::now();
+    request(server, fd, "JOIN 1 C\n", 1);
+    CHECK(server.stats().deadlines == 1);
+    while (server.stats().turnTimeouts == 0) server.poll(1000);
+    CHECK(std::chrono::steady_clock::now() - started >= std::chrono::milliseconds(100));
+    CHECK(request(server, fd, "STATE 1\n", 1).find("playing 3/3 turn=1 bank=99 coins=1,0,0") != std::string::npos);
+
+    const auto taxed = std::chrono::steady_clock::now();
+    CHECK(request(server, fd, "ACT 1 1 tax\nSTATE 1\n", 2).find("reacting") != std::string::npos);
+    while (server.stats().windowTimeouts == 0) server.poll(1000);
+    CHECK(std::chrono::steady_clock::now() - taxed >= std::chrono::milliseconds(20));
+    CHECK(server.stats().turnTimeouts == 1);
+    CHECK(request(server, fd, "STATE 1\n", 1).find("playing 3/3 turn=2 bank=97 coins=1,2,0") != std::string::npos);
+    CHECK(server.stats().deadlines == 1);                                     // Seat 2's turn
+    CHECK(request(server, fd, "ACT 1 2 gather\n", 1) == "OK 3\n");
+
+    // The deadline goes with the table
+    request(server, fd, "LEAVE 1\n", 1);
+    CHECK(server.tables().size() == 0);
+    CHECK(server.stats().deadlines == 0);
+    ::close(fd);
+}
+
+TEST_CASE("Hot standby replays the action log and takes over the tables") {
+    const std::string path = "/tmp/coup_test_standby_" + std::to_string(::getpid()) + ".sock";
+    Standby standby(path);
+    ServerOptions options;
+    options.shards = 2;
+    options.standbyPath = path;
+    auto leader = std::make_unique<GameServer>(options);
+    while (standby.stats().connected < 2) standby.poll(10);
+    CHECK(standby.shardCount() == 2);
+
+    // Two partly played games, on whichever shards they land
+    int fd = connectTo(*leader);
+    std::vector<uint32_t> ids;
+    for (const char* seed : {"5", "6"}) {
+        const std::string created = request(*leader, fd, std::string("CREATE 3 ") + seed + "\n", 1);
+        REQUIRE(created.rfind("OK ", 0) == 0);
+        const uint32_t id = static_cast<uint32_t>(std::stoul(created.substr(3)));
+        ids.push_back(id);
+        const std::string table = std::to_string(id);
+        request(*leader, fd, "JOIN " + table + " A\nJOIN " + table + " B\nJOIN " + table + " C\n", 3);
+        for (int ply = 0; ply < 4; ++ply) {
+            const size_t seat = leader->tables(leader->shardOf(id)).status(id).turn;
+            CHECK(request(*leader, fd, "ACT " + table + " " + std::to_string(seat) + " gather\n", 1) ==
+                  "OK " + std::to_string(ply + 1) + "\n");
+        }
+    }
+    CHECK(request(*leader, fd, "ACT " + std::to_string(ids[1]) + " 1 tax\n", 1) == "OK 5\n");
+    const ServerStats shipped = leader->stats();
+    CHECK(shipped.logBytes > 0);
+    CHECK(shipped.logPending == 0);
+    CHECK(shipped.standbyLost == 0);
+
+    // Everything acknowledged is on the standby once the leader dies
+    std::vector<TableStatus> before;
+    for (const uint32_t id : ids) before.push_back(leader->tables(leader->shardOf(id)).status(id));
+    const size_t firstShard = leader->shardOf(ids[0]);
+    const size_t secondShard = leader->shardOf(ids[1]);
+    leader.reset();
+    ::close(fd);
+    while (!standby.leaderGone()) standby.poll(10);
+    CHECK(standby.stats().bytes == shipped.logBytes);
+    for (size_t i = 0; i < ids.size(); ++i) {
+        const TableStatus replayed = standby.tables(i == 0 ? firstShard : secondShard).status(ids[i]);
+        CHECK(replayed.plies == before[i].plies);
+        CHECK(replayed.turn == before[i].turn);
+        CHECK(replayed.bank == before[i].bank);
+        CHECK(std::equal(replayed.coins, replayed.coins + 3, before[i].coins));
+    }
+
+    // The players come back by name to the server taking over
+    ServerOptions takeoverOptions;
+    takeoverOptions.shards = 2;
+    CHECK_THROWS_AS(GameServer(options, std::vector<TableRegistry>(2)), std::invalid_argument);
+    GameServer takeover(takeoverOptions, standby.takeTables());
+    CHECK(takeover.tableCount() == 2);
+    fd = connectTo(takeover);
+    const std::string table = std::to_string(ids[1]);
+    CHECK(request(takeover, fd, "JOIN " + table + " Z\n", 1).rfind("ERR", 0) == 0);
+    CHECK(request(takeover, fd, "JOIN " + table + " B\n", 1).rfind("OK 1 ", 0) == 0);
+    const size_t seat = takeover.tables(secondShard).status(ids[1]).turn;
+    CHECK(request(takeover, fd, "ACT " + table + " " + std::to_string(seat) + " gather\n", 1).rfind("ERR", 0) == 0);
+    request(takeover, fd, "JOIN " + table + " A\nJOIN " + table + " C\n", 2);
+    CHECK(request(takeover, fd, "ACT " + table + " " + std::to_string(seat) + " gather\n", 1) == "OK 6\n");
+    ::close(fd);
+}
+
+TEST_CASE("Matchmaker forms tables of each size from lock-free queues") {
+    MpmcQueue<int> queue(5);
+    CHECK(queue.capacity() == 8);
+    for (int i = 0; i < 8; ++i) CHECK(queue.push(int(i)));
+    CHECK_FALSE(queue.push(8));
+    int batch[8] = {};
+    REQUIRE(queue.popBatch(batch, 3));
+    CHECK((batch[0] == 0 && batch[1] == 1 && batch[2] == 2));
+    CHECK_FALSE(queue.popBatch(batch, 6));                    // All or nothing
+    CHECK(queue.sizeApprox() == 5);
+    for (int i = 8; i < 11; ++i) CHECK(queue.push(int(i)));   // The next lap
+    REQUIRE(queue.popBatch(batch, 8));
+    CHECK((batch[0] == 3 && batch[7] == 10));
+    CHECK_FALSE(queue.pop(batch[0]));
+
+    CHECK_THROWS_AS(Matchmaker(4), std::invalid_argument);
+    Matchmaker maker(64);
+    CHECK_THROWS_AS(maker.enqueue(1, 0), std::invalid_argument);
+    CHECK_THROWS_AS(maker.enqueue(7, 0), std::invalid_argument);
+    for (uint64_t player = 0; player < 5; ++player) CHECK(maker.enqueue(2, player));
+    for (uint64_t player = 10; player < 13; ++player) CHECK(maker.enqueue(3, player));
+    std::vector<Match> matches;
+    LatencyHistogram waits;
+    CHECK(maker.assemble(matches, 100, waits) == 3);
+    REQUIRE(matches.size() == 3);
+    CHECK((matches[0].numPlayers == 2 && matches[0].players[0] == 0 && matches[0].players[1] == 1));
+    CHECK((matches[1].numPlayers == 3 && matches[1].players[2] == 12));        // Sizes taken in turn
+    CHECK((matches[2].numPlayers == 2 && matches[2].players[0] == 2));
+    CHECK(maker.waiting(2) == 1);
+    CHECK(waits.count() == 7);
+    for (uint64_t player = 0; player < 64; ++player) maker.enqueue(6, player);
+    CHECK_FALSE(maker.enqueue(6, 64));
+
+    // Players queued by several threads are matched exactly once, at a table of their size
+    Matchmaker shared(1024);
+    constexpr uint64_t PRODUCERS = 3;
+    constexpr uint64_t ROUNDS = 2000;
+    constexpr uint64_t TABLES = PRODUCERS * ROUNDS * 5;
+    std::atomic<uint64_t> formed{0};
+    std::vector<std::vector<Match>> found(2);
+    std::vector<LatencyHistogram> threadWaits(2);
+    std::vector<std::thread> threads;
+    for (uint64_t p = 0; p < PRODUCERS; ++p) {
+        threads.emplace_back([&shared, p] {
+            uint64_t next = 0;
+            for (uint64_t round = 0; round < ROUNDS; ++round) {
+                for (size_t size = 2; size <= 6; ++size) {
+                    for (size_t seat = 0; seat < size; ++seat) {
+                        const uint64_t player = (p << 48) | (uint64_t(size) << 40) | next++;
+                        while (!shared.enqueue(size, player)) std::this_thread::yield();
+                    }
+                }
+            }
+        });
+    }
+    for (size_t c = 0; c < 2; ++c) {
+        threads.emplace_back([&, c] {
+            while (formed.load() < TABLES) {
+                const size_t n = shared.assemble(found[c], 64, threadWaits[c]);
+                if (n == 0) std::this_thread::yield();
+                formed += n;
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    std::vector<uint64_t> players;
+    bool sizesMatch = true;
+    for (const auto& list : found) {
+        for (const Match& match : list) {
+            for (size_t seat = 0; seat < match.numPlayers; ++seat) {
+                sizesMatch = sizesMatch && ((match.players[seat] >> 40) & 0xFF) == match.numPlayers;
+                players.push_back(match.players[seat]);
+            }
+        }
+    }
+    CHECK(sizesMatch);
+    CHECK(found[0].size() + found[1].size() == TABLES);
+    CHECK(players.size() == PRODUCERS * ROUNDS * 20);
+    std::sort(players.begin(), players.end());
+    CHECK(std::adjacent_find(players.begin(), players.end()) == players.end());
+    threadWaits[0].merge(threadWaits[1]);
+    CHECK(threadWaits[0].count() == players.size());
+}
+
+TEST_CASE("Overloaded shards shed spectators first, then refuse new tables") {
+    ServerOptions options;
+    options.shards = 2;
+    options.overloadDepth = 20;             // Spectators are shed from 10 commands per round
+    GameServer server(options);
+    int fds[4];
+    for (int& fd : fds) {       // Dealt out to shards 0, 1, 0 and 1
+        fd = connectTo(server);
+    }
+    std::string pending[4];
+    auto request = [&](int at, const std::string& lines, size_t replies) {
+        REQUIRE(::send(fds[at], lines.data(), lines.size(), 0) == static_cast<ssize_t>(lines.size()));
+        char buffer[8192];
+        while (static_cast<size_t>(std::count(pending[at].begin(), pending[at].end(), '\n')) < replies) {
+            server.poll(1);
+            const ssize_t n = ::recv(fds[at], buffer, sizeof(buffer), MSG_DONTWAIT);
+            if (n > 0) pending[at].append(buffer, static_cast<size_t>(n));
+        }
+        return std::exchange(pending[at], std::string());
+    };
+    auto nextStatus = [&](int at) {
+        char buffer[4096];
+        for (;;) {
+            FrameView frame;
+            const size_t size = FrameView::parse(reinterpret_cast<const uint8_t*>(pending[at].data()),
+                                                 pending[at].size(), frame);
+            if (size != 0) {
+                StatusMessage status{};
+                std::memcpy(&status, (*frame.begin()).data, sizeof(status));
+                pending[at].erase(0, size);
+                return status;
+            }
+            server.poll(1);
+            const ssize_t n = ::recv(fds[at], buffer, sizeof(buffer), MSG_DONTWAIT);
+            if (n > 0) pending[at].append(buffer, static_cast<size_t>(n));
+        }
+    };
+    auto watch = [&](uint32_t table, uint32_t tag) {
+        std::string out;
+        FrameBuilder frames(out);
+        TableMessage& message = frames.add<TableMessage>();
+        message.type = static_cast<uint8_t>(MessageType::Watch);
+        message.tag = tag;
+        message.table = table;
+        frames.finish();
+        REQUIRE(::send(fds[1], out.data(), out.size(), 0) == static_cast<ssize_t>(out.size()));
+        return nextStatus(1);
+    };
+
+    CHECK(request(0, "CREATE 2 5\n", 1) == "OK 1\n");
+    CHECK(watch(1, 7).code == static_cast<uint8_t>(WireCode::Ok));
+    CHECK(server.stats().spectators == 1);
+
+    // A burst of commands on shard 1, after an idle spell so that it weighs fully
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    std::string burst;
+    for (int i = 0; i < 1000; ++i) burst += "PING\n";
+    request(3, burst, 1000);
+    CHECK(server.stats().queueDepth >= 20);
+
+    // Shard 1 drops the stream its spectator had of shard 0's table, and sheds new ones
+    const StatusMessage dropped = nextStatus(1);
+    CHECK(dropped.code == static_cast<uint8_t>(WireCode::Overloaded));
+    CHECK(dropped.table == 1);
+    for (int i = 0; i < 10 && server.stats().spectators > 0; ++i) server.poll(1);
+    CHECK(server.stats().spectators == 0);
+    const StatusMessage refused = watch(1, 8);
+    CHECK(refused.code == static_cast<uint8_t>(WireCode::Overloaded));
+    CHECK(refused.tag == 8);
+
+    // It refuses new tables; shard 0 still takes them
+    CHECK(request(3, "CREATE 2\n", 1) == "ERR Server overloaded, try again later.\n");
+    CHECK(request(0, "CREATE 2\n", 1) == "OK 3\n");
+    ServerStats stats = server.stats();
+    CHECK(stats.shedStreams == 1);
+    CHECK(stats.shedWatches == 1);
+    CHECK(stats.shedCreates == 1);
+    CHECK(stats.shedForDepth == 3);
+    CHECK(stats.shedForLatency == 0);
+    CHECK(stats.errors == 0);
+
+    // The load decays once the burst is over
+    while (server.stats().queueDepth >= 10) server.poll(5);
+    CHECK(request(3, "CREATE 2\n", 1) == "OK 2\n");
+    CHECK(watch(1, 9).code == static_cast<uint8_t>(WireCode::Ok));
+    CHECK(server.stats().spectators == 1);
+    for (int fd : fds) ::close(fd);
+}
+
+TEST_CASE("Server charges each table its actions, CPU time and latency, and lists the hottest") {
+    ServerOptions options;
+    options.shards = 2;
+    options.usagePublishMs = 0;             // Publish after every round that acted
+    GameServer server(options);
+    int fds[2];
+    for (int& fd : fds) {       // Dealt out to shards 0 and 1
+        fd = connectTo(server);
+    }
+    auto gathers = [](uint32_t table, int count) {
+        std::string lines;
+        for (int i = 0; i < count; ++i) {
+            lines += "ACT " + std::to_string(table) + ' ' + std::to_string(i % 2) + " gather\n";
+        }
+        return lines;
+    };
+
+    CHECK(request(server, fds[1], "TOP\n", 1) == "TOP 0\n");
+    CHECK(request(server, fds[0], "CREATE 2 3\nJOIN 1 A\nJOIN 1 B\n", 3).rfind("OK 1\n", 0) == 0);
+    CHECK(request(server, fds[1], "CREATE 2 4\nJOIN 2 C\nJOIN 2 D\n", 3).rfind("OK 2\n", 0) == 0);
+    request(server, fds[0], gathers(1, 14), 14);
+    request(server, fds[1], gathers(2, 4), 4);
+    request(server, fds[0], "STATE 2\n", 1);             // Not an action: not charged
+
+    // "TOP <k> <table>:<actions>:<cpu-ns>:<max-action-ns>:<mean-latency-ns>:<max-latency-ns>..."
+    std::istringstream top(request(server, fds[1], "TOP 5\n", 1));
+    std::string word;
+    size_t listed = 0;
+    top >> word >> listed;
+    CHECK(word == "TOP");
+    REQUIRE(listed == 2);
+    std::vector<std::vector<uint64_t>> entries;
+    for (size_t i = 0; i < listed; ++i) {
+        top >> word;
+        std::vector<uint64_t> fields;
+        std::istringstream parts(word);
+        for (std::string part; std::getline(parts, part, ':');) fields.push_back(std::stoull(part));
+        REQUIRE(fields.size() == 6);
+        entries.push_back(fields);
+    }
+    CHECK(entries[0][2] >= entries[1][2]);                                  // Hottest first
+    for (const auto& entry : entries) {
+        CHECK(entry[1] == (entry[0] == 1 ? 14u : 4u));
+        CHECK(entry[2] > 0);
+        CHECK(entry[3] <= entry[2]);
+        CHECK(entry[3] * entry[1] >= entry[2]);                             // The most expensive one
+        CHECK(entry[5] >= entry[4]);
+    }
+    const std::vector<TableUsage> hottest = server.hottest(1);
+    REQUIRE(hottest.size() == 1);
+    CHECK(hottest[0].table == entries[0][0]);
+
+    // The lists are read while the shards run; a table leaves the list when it closes
+    std::atomic<bool> stop{false};
+    std::thread loop([&] { server.run(stop); });
+    auto blocking = [&](int at, const std::string& lines, size_t replies) {
+        REQUIRE(::send(fds[at], lines.data(), lines.size(), 0) == static_cast<ssize_t>(lines.size()));
+        std::string received;
+        char buffer[4096];
+        while (static_cast<size_t>(std::count(received.begin(), received.end(), '\n')) < replies) {
+            const ssize_t n = ::recv(fds[at], buffer, sizeof(buffer), 0);
+            REQUIRE(n > 0);
+            received.append(buffer, static_cast<size_t>(n));
+        }
+        return received;
+    };
+    blocking(1, gathers(2, 2), 2);
+    blocking(0, "LEAVE 1\n", 1);
+    bool updated = false;
+    for (int i = 0; i < 1000 && !updated; ++i) {
+        const std::vector<TableUsage> list = server.hottest(HOT_TABLES);
+        updated = list.size() == 1 && list[0].table == 2 && list[0].actions == 6;
+        if (!updated) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CHECK(updated);
+    stop = true;
+    loop.join();
+    for (int fd : fds) ::close(fd);
+}
+
+TEST_CASE("Write-ahead log recovers the tables of a crashed server from its snapshot and tail") {
+    const std::string directory = "/tmp/coup_test_wal_" + std::to_string(::getpid());
+    std::filesystem::remove_all(directory);
+    uint64_t seed = 1;
+    for (;; ++seed) {
+        SplitMix64 rng(seed);
+        if (drawRoles(rng, 2)[0] == Role::Governor) break;
+    }
+    ServerOptions options;
+    options.shards = 2;
+    options.walDirectory = directory;
+    options.walCommitMs = 1;
+    options.walCompactBytes = 256;
+
+    // A game with a reaction window open, one played for a while, and one everybody left
+    auto server = std::make_unique<GameServer>(options);
+    int fd = connectTo(*server);
+    const uint32_t reacting = static_cast<uint32_t>(
+        std::stoul(request(*server, fd, "CREATE 2 " + std::to_string(seed) + " react\n", 1).substr(3)));
+    const std::string first = std::to_string(reacting);
+    request(*server, fd, "JOIN " + first + " A\nJOIN " + first + " B\nACT " + first + " 0 gather\n", 3);
+    CHECK(request(*server, fd, "ACT " + first + " 1 tax\n", 1) == "OK 2\n");
+    const uint32_t played = static_cast<uint32_t>(std::stoul(request(*server, fd, "CREATE 3 9\n", 1).substr(3)));
+    const std::string second = std::to_string(played);
+    request(*server, fd, "JOIN " + second + " A\nJOIN " + second + " B\nJOIN " + second + " C\n", 3);
+    for (int ply = 0; ply < 12; ++ply) {
+        const size_t seat = server->tables(server->shardOf(played)).status(played).turn;
+        CHECK(request(*server, fd, "ACT " + second + " " + std::to_string(seat) + " gather\n", 1) ==
+              "OK " + std::to_string(ply + 1) + "\n");
+    }
+    const uint32_t closed = static_cast<uint32_t>(std::stoul(request(*server, fd, "CREATE 2\n", 1).substr(3)));
+    request(*server, fd, "JOIN " + std::to_string(closed) + " A\nLEAVE " + std::to_string(closed) + "\n", 2);
+    while (server->stats().walCompactions == 0) server->poll(10);
+    CHECK(server->stats().walCommits > 0);
+    CHECK(server->stats().walHeld == 0);
+    std::vector<TableStatus> before;
+    for (const uint32_t id : {reacting, played}) before.push_back(server->tables(server->shardOf(id)).status(id));
+    CHECK(before[0].reacting);
+    server.reset();
+    ::close(fd);
+
+    // Half a batch, as a crash in the middle of a write leaves it
+    std::vector<std::filesystem::path> segments;
+    for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+        if (entry.path().extension() == ".wal") segments.push_back(entry.path());
+    }
+    CHECK(std::filesystem::exists(directory + "/shard0.snap"));
+    REQUIRE(!segments.empty());
+    std::ofstream(*std::max_element(segments.begin(), segments.end()), std::ios::app) << "torn";
+
+    ServerOptions otherShards = options;
+    otherShards.shards = 1;
+    CHECK_THROWS_AS(GameServer{otherShards}, std::runtime_error);
+    server = std::make_unique<GameServer>(options);
+    CHECK(server->stats().recoveredTables == 2);
+    CHECK(server->tableCount() == 2);
+    for (size_t i = 0; i < 2; ++i) {
+        const uint32_t id = i == 0 ? reacting : played;
+        const TableStatus recovered = server->tables(server->shardOf(id)).status(id);
+        CHECK(recovered.plies == before[i].plies);
+        CHECK(recovered.turn == before[i].turn);
+        CHECK(recovered.reacting == before[i].reacting);
+        CHECK(recovered.bank == before[i].bank);
+        CHECK(std::equal(recovered.coins, recovered.coins + 2, before[i].coins));
+    }
+
+    // Players come back by name; an acknowledgement waits for its commit
+    fd = connectTo(*server);
+    CHECK(std::stoul(request(*server, fd, "CREATE 2\n", 1).substr(3)) > closed);
+    CHECK(request(*server, fd, "JOIN " + first + " B\nJOIN " + first + " A\n", 2) == std::string("OK 1 ") +
+          roleName(server->tables(server->shardOf(reacting)).roleAt(reacting, 1)) + "\nOK 0 Governor\n");
+    CHECK(request(*server, fd, "ACT " + first + " 0 blockTax 1\n", 1) == "OK 3\n");
+    CHECK(server->tables(server->shardOf(reacting)).status(reacting).coins[1] == 0);
+    server.reset();
+    ::close(fd);
+
+    options.walCommitMs = 200;
+    server = std::make_unique<GameServer>(options);
+    fd = connectTo(*server);
+    request(*server, fd, "JOIN " + second + " A\nJOIN " + second + " B\nJOIN " + second + " C\n", 3);
+    const size_t seat = server->tables(server->shardOf(played)).status(played).turn;
+    const std::string act = "ACT " + second + " " + std::to_string(seat) + " gather\n";
+    REQUIRE(::send(fd, act.data(), act.size(), 0) == static_cast<ssize_t>(act.size()));
+    while (server->tables(server->shardOf(played)).status(played).plies == before[1].plies) server->poll(10);
+    server->poll(0);
+    char buffer[64];
+    CHECK(::recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT) < 0);              // Applied, not yet durable
+    CHECK(server->stats().walHeld == 1);
+    CHECK(request(*server, fd, "", 1) == "OK 13\n");
+    CHECK(server->stats().walHeld == 0);
+    server.reset();
+    ::close(fd);
+    std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("Write-ahead log compaction keeps the tables created before it rotates, and the ids of dropped ones") {
+    const std::string directory = "/tmp/coup_test_wal_compact_" + std::to_string(::getpid());
+    std::filesystem::remove_all(directory);
+    auto settle = [](WriteAheadLog& log, uint64_t compactions) {
+        for (int i = 0; i < 2000 && (log.durable() < log.appended() || log.stats().compactions < compactions); ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        REQUIRE(log.durable() == log.appended());
+        REQUIRE(log.stats().compactions == compactions);
+    };
+
+    // The newest table is dropped before the compaction: its id is not given out again
+    {
+        TableRegistry tables;
+        std::string journal;
+        WriteAheadLog log(directory, 0, 1, 1, tables, [] {});
+        tables.setJournal(&journal);
+        CHECK(tables.create(2, 1) == 1);
+        tables.join(1, 1, "alice");
+        tables.join(1, 2, "bob");
+        CHECK(tables.create(2, 2) == 2);
+        tables.join(2, 3, "carol");
+        tables.leave(2, 3);
+        log.append(journal.data(), journal.size());
+        journal.clear();
+        REQUIRE(log.compact(tables));
+        settle(log, 1);
+    }
+    {
+        TableRegistry tables;
+        std::string journal;
+        WriteAheadLog log(directory, 0, 1, 200, tables, [] {});
+        CHECK(tables.size() == 1);
+        CHECK(tables.nextTableId() == 3);
+        tables.setJournal(&journal);
+
+        // A table created after compact() but before the log's thread rotates, while it waits out commitMs
+        CHECK(tables.create(2, 3) == 3);
+        tables.join(3, 4, "dave");
+        log.append(journal.data(), journal.size());
+        journal.clear();
+        settle(log, 0);
+        tables.leave(3, 4);
+        log.append(journal.data(), journal.size());
+        journal.clear();
+        REQUIRE(log.compact(tables));
+        CHECK(tables.create(2, 4) == 4);
+        tables.join(4, 5, "erin");
+        log.append(journal.data(), journal.size());
+        journal.clear();
+        settle(log, 1);
+        tables.join(4, 6, "frank");
+        log.append(journal.data(), journal.size());
+        journal.clear();
+        settle(log, 1);
+    }
+    {
+        TableRegistry tables;
+        WriteAheadLog log(directory, 0, 1, 1, tables, [] {});
+        std::vector<uint32_t> ids = tables.ids();
+        std::sort(ids.begin(), ids.end());
+        CHECK(ids == std::vector<uint32_t>{1, 4});
+        CHECK(tables.status(4).started);
+        CHECK(tables.nextTableId() == 5);
+    }
+    std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("Write-ahead log failure stops every shard of a running server and is rethrown") {
+    const std::string directory = "/tmp/coup_test_wal_failure_" + std::to_string(::getpid());
+    std::filesystem::remove_all(directory);
+    ServerOptions options;
+    options.shards = 2;
+    options.walDirectory = directory;
+    options.walCommitMs = 1;
+    GameServer server(options);
+    std::atomic<bool> stop{false};
+    std::exception_ptr error;
+    std::thread loop([&] {
+        try {
+            server.run(stop);
+        } catch (...) {
+            error = std::current_exception();
+        }
+    });
+
+    // Segments may no longer grow: the next batch fails to be written
+    rlimit limit{};
+    REQUIRE(::getrlimit(RLIMIT_FSIZE, &limit) == 0);
+    rlimit small = limit;
+    small.rlim_cur = 64;
+    const auto handler = std::signal(SIGXFSZ, SIG_IGN);
+    REQUIRE(::setrlimit(RLIMIT_FSIZE, &small) == 0);
+    const int fd = connectTo(server);
+    REQUIRE(::send(fd, "CREATE 2\nCREATE 2\n", 18, 0) == 18);
+    loop.join();
+    ::setrlimit(RLIMIT_FSIZE, &limit);
+    std::signal(SIGXFSZ, handler);
+    ::close(fd);
+    REQUIRE(error);
+    CHECK_THROWS_WITH_AS(std::rethrow_exception(error), "Cannot write the write-ahead log.", std::runtime_error);
+    std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("Write-ahead log with a standby does not log the recovered tables again") {
+    const std::string directory = "/tmp/coup_test_wal_standby_" + std::to_string(::getpid());
+    const std::string path = directory + ".sock";
+    std::filesystem::remove_all(directory);
+    ServerOptions options;
+    options.standbyPath = path;
+    options.walDirectory = directory;
+    options.walCommitMs = 1;
+
+    uint32_t plies = 0;
+    for (int run = 0; run < 3; ++run) {
+        Standby standby(path);
+        GameServer server(options);
+        while (standby.stats().connected < 1) standby.poll(10);
+        const int fd = connectTo(server);
+        if (run == 0) {
+            CHECK(request(server, fd, "CREATE 2 5\nJOIN 1 A\nJOIN 1 B\n", 3).rfind("OK 1\n", 0) == 0);
+        } else {
+            CHECK(server.stats().recoveredTables == 1);
+            CHECK(server.tables().status(1).plies == plies);
+            request(server, fd, "JOIN 1 A\nJOIN 1 B\n", 2);
+        }
+        const size_t seat = server.tables().status(1).turn;
+        CHECK(request(server, fd, "ACT 1 " + std::to_string(seat) + " gather\n", 1) ==
+              "OK " + std::to_string(++plies) + "\n");
+        while (!standby.tables(0).hosts(1) || standby.tables(0).status(1).plies < plies) standby.poll(10);
+        ::close(fd);
+    }
+    std::filesystem::remove_all(directory);
+}
@@ -0,0 +1,75 @@
+// email: shiraba01@gmail.com
+/**
+ * @file tournament.cpp
+ * @brief Runs a long tournament of simulated games with resumable checkpoints.
+ *
+ * Progress and statistics are saved to the checkpoint file every interval
+ * and at the end. Restarting with the same arguments resumes from the last
+ * checkpoint and ends with the same statistics (and digest) as a run that
+ * was never interrupted. SIGINT and SIGTERM stop the run after the chunks in
+ * progress, with a final checkpoint.
+ *
+ * Usage: ./tournament <games> <checkpoint> [threads] [seed] [interval-seconds]
+ * Exit status: 0 when the run is complete, 1 if it was stopped early, 2 on error.
+ */
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+
+#include "Tournament.hpp"
+
+using namespace coup;
+
+namespace {
+
+std::atomic<bool> stopRequested{false};
+
+void requestStop(int) {
+    stopRequested.store(true);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::fprintf(stderr, "usage: %s <games> <checkpoint> [threads] [seed] [interval-seconds]\n", argv[0]);
+        return 2;
+    }
+    TournamentOptions options;
+    options.games = std::strtoull(argv[1], nullptr, 10);
+    options.checkpointPath = argv[2];
+    options.threads = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 0;
+    options.runSeed = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 1;
+    options.checkpointSeconds = argc > 5 ? std::strtod(argv[5], nullptr) : 60;
+
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+
+    try {
+        TournamentReport report = runTournament(options, &stopRequested);
+        const TournamentProgress& progress = report.progress;
+        const ResultsSummary& summary = progress.summary;
+
+        if (report.resumedFrom > 0) {
+            std::printf("resumed at game %llu\n", static_cast<unsigned long long>(report.resumedFrom));
+        }
+        std::printf("%llu / %llu games (%llu played in %.2f s, %zu checkpoints)\n",
+                    static_cast<unsigned long long>(progress.nextGame), static_cast<unsigned long long>(options.games),
+                    static_cast<unsigned long long>(report.played), report.seconds, report.checkpoints);
+        std::printf("decided %.1f%%, %.1f plies, %.2f coups, %.2f blocks per game\n",
+                    summary.games ? 100.0 * summary.decided / summary.games : 0.0, summary.meanPlies(),
+                    summary.meanCoups(), summary.meanBlocks());
+        for (size_t r = 0; r < NUM_ROLES; ++r) {
+            const Role role = static_cast<Role>(r);
+            std::printf("  %-9s won %5.1f%% of %llu games\n", roleName(role), 100 * summary.winRate(role),
+                        static_cast<unsigned long long>(summary.gamesWithRole[r]));
+        }
+        std::printf("digest %016llx\n", static_cast<unsigned long long>(progress.digest));
+        return report.finished ? 0 : 1;
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "tournament: %s\n", e.what());
+        return 2;
+    }
+}